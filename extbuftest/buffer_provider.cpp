@@ -0,0 +1,333 @@
+#include "buffer_provider.h"
+
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>      // For posix_memalign(), free()
+#include <fcntl.h>      // For open(), fcntl()
+#include <unistd.h>     // For close(), ftruncate(), lseek()
+#include <sys/ioctl.h>  // For ioctl()
+#include <sys/mman.h>   // For mmap(), munmap(), memfd_create()
+#include <linux/dma-buf.h> // For DMA_BUF_IOCTL_SYNC
+#include <linux/udmabuf.h> // For UDMABUF_CREATE
+
+// DRM includes (you'll need to link against libdrm)
+#include <libdrm/drm_fourcc.h>
+#include <gbm.h>        // GBM (Generic Buffer Management) is often used with DRM/EGL
+
+// Add these definitions if your gbm.h or drm.h doesn't define them
+// These values are standard for DRM/GBM FourCC codes and usage flags.
+#ifndef GBM_FORMAT_ARGB8888
+#define GBM_FORMAT_ARGB8888 DRM_FORMAT_ARGB8888 // GBM format usually mirrors DRM format
+#endif
+
+#ifndef GBM_FORMAT_R8
+#define GBM_FORMAT_R8 DRM_FORMAT_R8
+#endif
+
+#ifndef F_SEAL_SHRINK
+#define F_ADD_SEALS 1033   // 1024 + 9, see linux/fcntl.h
+#define F_SEAL_SHRINK 0x0002
+#endif
+
+const char *map_name(map_method method) {
+    switch (method) {
+        case map_method::mmap: return "mmap";
+        case map_method::gbm: return "gbm";
+        default: return "none";
+    }
+}
+
+// --- Persistent mapping of a whole dma-buf ---
+static bool map_dma_buf(provided_buffer &buf) {
+    off_t size = lseek(buf.dma_buf_fd, 0, SEEK_END);
+    void *mapping = size > 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, buf.dma_buf_fd, 0) : MAP_FAILED;
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    buf.map = map_method::mmap;
+    buf.mapping = mapping;
+    buf.size = size;
+    return true;
+}
+
+void buffer_provider::release(provided_buffer &buf) {
+    if (buf.map == map_method::mmap && buf.mapping) {
+        munmap(buf.mapping, buf.size);
+    }
+    buf.mapping = nullptr;
+    if (buf.dma_buf_fd >= 0) {
+        close(buf.dma_buf_fd);
+        buf.dma_buf_fd = -1;
+    }
+}
+
+// --- GBM on a DRM node ---
+class gbm_provider : public buffer_provider {
+public:
+    ~gbm_provider() {
+        if (gbm_dev) {
+            gbm_device_destroy(gbm_dev);
+        }
+        if (drm_fd != -1) {
+            close(drm_fd);
+        }
+    }
+
+    bool init(const char *path) {
+        drm_fd = open(path, O_RDWR | O_CLOEXEC);
+        if (drm_fd < 0) {
+            return false;
+        }
+
+        gbm_dev = gbm_create_device(drm_fd);
+        if (!gbm_dev) {
+            std::cerr << "Failed to create a GBM device on " << path << ". Errno: " << errno << std::endl;
+            return false;
+        }
+        node = path;
+        return true;
+    }
+
+    const char *name() const { return "gbm"; }
+
+    std::vector<map_method> map_methods() const { return { map_method::mmap, map_method::gbm }; }
+
+    bool allocate(int width, int height, int bytes_per_pixel, map_method map, provided_buffer &buf) {
+        // Use DRM_FORMAT_ARGB8888 for 32-bit RGBA. GBM_BO_USE_LINEAR for CPU access.
+        uint32_t format = bytes_per_pixel == 4 ? GBM_FORMAT_ARGB8888 : GBM_FORMAT_R8;
+        buf.bo = gbm_bo_create(gbm_dev, width, height, format, /*GBM_BO_USE_TEXTURE |*/ GBM_BO_USE_LINEAR);
+        if (!buf.bo) {
+            std::cerr << "ERROR: Failed to create GBM buffer object on " << node << ". Errno: " << errno << std::endl;
+            return false;
+        }
+        buf.stride = gbm_bo_get_stride(buf.bo);
+
+        buf.dma_buf_fd = gbm_bo_get_fd(buf.bo);
+        if (buf.dma_buf_fd < 0) {
+            std::cerr << "ERROR: Failed to get DMA_BUF FD from GBM BO. Errno: " << errno << std::endl;
+            release(buf);
+            return false;
+        }
+
+        if (map == map_method::mmap && !map_dma_buf(buf)) {
+            static bool reported = false;
+            if (!reported) {
+                std::cout << "The dma-buf can't be mapped directly (errno " << errno << "), using gbm_bo_map() instead." << std::endl;
+                reported = true;
+            }
+            map = map_method::gbm;
+        }
+        buf.map = map;
+        return true;
+    }
+
+    void release(provided_buffer &buf) {
+        buffer_provider::release(buf);
+        if (buf.bo) {
+            gbm_bo_destroy(buf.bo);
+            buf.bo = nullptr;
+        }
+    }
+
+private:
+    int drm_fd = -1;
+    struct gbm_device *gbm_dev = nullptr;
+    std::string node;
+};
+
+// --- udmabuf: dma-bufs made from memfd pages ---
+class udmabuf_provider : public buffer_provider {
+public:
+    ~udmabuf_provider() {
+        if (udmabuf_fd != -1) {
+            close(udmabuf_fd);
+        }
+    }
+
+    bool init() {
+        udmabuf_fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+        return udmabuf_fd >= 0;
+    }
+
+    const char *name() const { return "udmabuf"; }
+
+    // the pages are ordinary cached memory, there's nothing for gbm_bo_map() to do
+    std::vector<map_method> map_methods() const { return { map_method::mmap }; }
+
+    bool allocate(int width, int height, int bytes_per_pixel, map_method, provided_buffer &buf) {
+        // the same pitch alignment GPUs tend to want; udmabuf itself needs whole pages
+        buf.stride = (width * bytes_per_pixel + 63) & ~63u;
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t size = ((size_t)buf.stride * height + page - 1) / page * page;
+
+        // udmabuf only takes memfds that can't shrink under it
+        int memfd = memfd_create("extbuftest", MFD_ALLOW_SEALING);
+        if (memfd < 0) {
+            std::cerr << "ERROR: memfd_create failed. Errno: " << errno << std::endl;
+            return false;
+        }
+        if (ftruncate(memfd, size) != 0 || fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) != 0) {
+            std::cerr << "ERROR: Failed to size and seal the memfd. Errno: " << errno << std::endl;
+            close(memfd);
+            return false;
+        }
+
+        struct udmabuf_create create = {};
+        create.memfd = memfd;
+        create.flags = UDMABUF_FLAGS_CLOEXEC;
+        create.offset = 0;
+        create.size = size;
+        buf.dma_buf_fd = ioctl(udmabuf_fd, UDMABUF_CREATE, &create);
+        close(memfd); // the dma-buf keeps the pages
+        if (buf.dma_buf_fd < 0) {
+            std::cerr << "ERROR: UDMABUF_CREATE failed. Errno: " << errno << std::endl;
+            return false;
+        }
+
+        if (!map_dma_buf(buf)) {
+            std::cerr << "ERROR: Failed to map the udmabuf. Errno: " << errno << std::endl;
+            release(buf);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    int udmabuf_fd = -1;
+};
+
+// --- malloc: no dma-buf at all ---
+class malloc_provider : public buffer_provider {
+public:
+    const char *name() const { return "malloc"; }
+
+    std::vector<map_method> map_methods() const { return { map_method::none }; }
+
+    bool allocate(int width, int height, int bytes_per_pixel, map_method, provided_buffer &buf) {
+        // tightly packed: GLES2 can only upload rows that follow each other without padding in one call
+        buf.stride = width * bytes_per_pixel;
+        buf.size = (size_t)buf.stride * height;
+        buf.map = map_method::none;
+        if (posix_memalign(&buf.mapping, 64, buf.size) != 0) {
+            buf.mapping = nullptr;
+            std::cerr << "ERROR: Out of memory." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void release(provided_buffer &buf) {
+        free(buf.mapping);
+        buf.mapping = nullptr;
+    }
+};
+
+// --- Picking a provider ---
+
+// can it really allocate (a device node that opens isn't proof of that)?
+static bool try_allocate(buffer_provider &provider) {
+    provided_buffer buf;
+    if (!provider.allocate(64, 64, 4, provider.map_methods()[0], buf)) {
+        return false;
+    }
+    provider.release(buf);
+    return true;
+}
+
+static std::unique_ptr<buffer_provider> create_gbm_provider() {
+    // render nodes first: any GPU driver can allocate there, without needing to be the display (DRM master)
+    std::vector<std::string> nodes;
+    for (int i = 128; i < 136; ++i) nodes.push_back("/dev/dri/renderD" + std::to_string(i));
+    for (int i = 0; i < 4; ++i) nodes.push_back("/dev/dri/card" + std::to_string(i));
+
+    for (const std::string &node : nodes) {
+        std::unique_ptr<gbm_provider> provider(new gbm_provider());
+        if (provider->init(node.c_str()) && try_allocate(*provider)) {
+            std::cout << "Allocating buffers with GBM on " << node << std::endl;
+            return std::move(provider);
+        }
+    }
+    return nullptr;
+}
+
+static std::unique_ptr<buffer_provider> create_udmabuf_provider() {
+    std::unique_ptr<udmabuf_provider> provider(new udmabuf_provider());
+    if (provider->init() && try_allocate(*provider)) {
+        std::cout << "Allocating buffers with /dev/udmabuf" << std::endl;
+        return std::move(provider);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<buffer_provider> create_buffer_provider(const std::string &name) {
+    bool any = name == "auto";
+    std::unique_ptr<buffer_provider> provider;
+
+    if (any || name == "gbm") {
+        provider = create_gbm_provider();
+        if (!provider) {
+            std::cerr << "No DRM node to allocate GBM buffers on (ensure your user has permissions on /dev/dri, or run with sudo)." << std::endl;
+        }
+    }
+    if (!provider && (any || name == "udmabuf")) {
+        provider = create_udmabuf_provider();
+        if (!provider) {
+            std::cerr << "Can't allocate from /dev/udmabuf (is the udmabuf module loaded, and the node accessible?)." << std::endl;
+        }
+    }
+    if (!provider && (any || name == "malloc")) {
+        std::cout << "Allocating buffers with malloc (copied into the textures every frame)" << std::endl;
+        provider.reset(new malloc_provider());
+    }
+    return provider;
+}
+
+// --- CPU access ---
+
+// DMA_BUF_IOCTL_SYNC, retried when interrupted
+static bool dma_buf_sync(int fd, uint64_t flags) {
+    struct dma_buf_sync sync = {};
+    sync.flags = flags;
+    int ret;
+    do {
+        ret = ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+    } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+    return ret == 0;
+}
+
+uint8_t *begin_cpu_access(provided_buffer &buf, int width, int height, uint32_t &stride, void *&map_data) {
+    if (buf.map == map_method::mmap) {
+        // makes the CPU's view coherent (and waits for anything still writing the buffer); the mapping stays
+        if (!dma_buf_sync(buf.dma_buf_fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE)) {
+            std::cerr << "ERROR: DMA_BUF_SYNC_START failed. Errno: " << errno << std::endl;
+            return nullptr;
+        }
+        stride = buf.stride;
+        return static_cast<uint8_t *>(buf.mapping);
+    }
+
+    if (buf.map == map_method::none) {
+        stride = buf.stride;
+        return static_cast<uint8_t *>(buf.mapping);
+    }
+
+    // Map the GBM BO to CPU address space
+    // GBM_BO_TRANSFER_WRITE hints that we are writing data
+    // The mapping can have its own stride (e.g. a linear staging copy of a tiled BO), so use the one it reports.
+    void *cpu_map_ptr = gbm_bo_map(buf.bo, 0, 0, width, height, GBM_BO_TRANSFER_WRITE, &stride, &map_data);
+    if (!cpu_map_ptr) {
+        std::cerr << "ERROR: Failed to map GBM BO." << std::endl;
+        return nullptr;
+    }
+    return static_cast<uint8_t *>(cpu_map_ptr);
+}
+
+void end_cpu_access(provided_buffer &buf, void *map_data) {
+    if (buf.map == map_method::mmap) {
+        if (!dma_buf_sync(buf.dma_buf_fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE)) {
+            std::cerr << "ERROR: DMA_BUF_SYNC_END failed. Errno: " << errno << std::endl;
+        }
+    } else if (buf.map == map_method::gbm) {
+        gbm_bo_unmap(buf.bo, map_data);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef BUFFER_PROVIDER_H
+#define BUFFER_PROVIDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct gbm_bo;
+
+// --- Where the ring's buffers come from ---
+// gbm:     a GBM buffer object on the first DRM node GBM works on (render nodes first, so any GPU driver or vkms will do);
+// udmabuf: memfd pages turned into a dma-buf by /dev/udmabuf, no GPU or DRM driver needed at all;
+// malloc:  plain memory. Nothing can import it, so it gets copied into the textures every frame.
+// The first two hand out dma-buf fds for EGL_LINUX_DMA_BUF_EXT, which lets the producer kernels, the ring and the
+// timings be worked on and benchmarked on ordinary Linux boxes and VMs as well as on the Pi.
+
+// How the CPU gets at a buffer's memory:
+// mmap = the dma-buf fd mapped once when the buffer is allocated, every frame's writes bracketed by DMA_BUF_IOCTL_SYNC;
+// gbm = gbm_bo_map()/gbm_bo_unmap() around every frame (the driver may set up a new mapping, or a staging copy, each time);
+// none = plain memory, always there, nothing to sync.
+enum class map_method { mmap, gbm, none };
+
+const char *map_name(map_method method);
+
+struct provided_buffer {
+    int dma_buf_fd = -1;         // -1: plain memory that can't be imported; otherwise kept open until release
+    uint32_t stride = 0;         // bytes from one row to the next
+    size_t size = 0;
+    map_method map = map_method::none;
+    void *mapping = nullptr;     // the persistent CPU mapping (map_method::mmap and none)
+    struct gbm_bo *bo = nullptr; // gbm only
+};
+
+class buffer_provider {
+public:
+    virtual ~buffer_provider() {}
+
+    virtual const char *name() const = 0;
+
+    // the ways this provider's buffers can be accessed by the CPU, the preferred one first
+    virtual std::vector<map_method> map_methods() const = 0;
+
+    // width x height pixels of bytes_per_pixel each (4 for ARGB8888, 1 for the R8 buffers the YUV planes are put in),
+    // to be accessed with map (one of map_methods())
+    virtual bool allocate(int width, int height, int bytes_per_pixel, map_method map, provided_buffer &buf) = 0;
+
+    virtual void release(provided_buffer &buf);
+};
+
+// "gbm", "udmabuf" or "malloc"; "auto" is the first of those that can allocate a buffer here. nullptr on failure.
+std::unique_ptr<buffer_provider> create_buffer_provider(const std::string &name);
+
+// --- CPU access to a buffer ---
+// Returns where the buffer's memory is (nullptr on failure) and the stride to use there, which for gbm_bo_map() can
+// differ from the buffer's. Every begin_cpu_access that succeeded needs its end_cpu_access, with the same map_data.
+uint8_t *begin_cpu_access(provided_buffer &buf, int width, int height, uint32_t &stride, void *&map_data);
+void end_cpu_access(provided_buffer &buf, void *map_data);
+
+#endif // BUFFER_PROVIDER_H
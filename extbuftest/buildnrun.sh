@@ -1 +1,9 @@
-g++ -o extbuftest extbuftest.cpp -lEGL -lGLESv2 -ldrm -lgbm
\ No newline at end of file
+# pixel_kernels_neon.cpp is the only file built with NEON enabled (32-bit Pis older than the Pi 2 don't have it;
+# the kernels are picked at runtime)
+NEON_FLAGS=""
+case "$(uname -m)" in
+    armv6l|armv7l) NEON_FLAGS="-march=armv7-a -mfpu=neon -mfloat-abi=hard" ;;
+esac
+g++ -O2 -c pixel_kernels_neon.cpp $NEON_FLAGS -o pixel_kernels_neon.o && \
+g++ -O2 -o extbuftest extbuftest.cpp pixel_kernels.cpp pixel_kernels_sse2.cpp pixel_kernels_neon.o jpeg_producer.cpp buffer_provider.cpp frame_timing.cpp -lEGL -lGLESv2 -ldrm -lgbm -ljpeg -pthread && \
+./extbuftest "$@"
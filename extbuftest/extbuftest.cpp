@@ -1,12 +1,13 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <fcntl.h>      // For open()
-#include <unistd.h>     // For close(), mmap(), munmap()
-#include <sys/ioctl.h>  // For ioctl()
-#include <sys/mman.h>   // For mmap(), munmap()
+#include <memory>
+#include <algorithm>    // For std::find()
 #include <chrono>       // For timing (optional, but good for debugging)
 #include <thread>       // For sleep_for (optional)
+#include <cstring>      // For strcmp(), strstr()
+#include <cstdlib>      // For atoi()
+#include <iomanip>      // For std::setprecision()
 
 // DRM includes (you'll need to link against libdrm)
 //#include <xf86drm.h>
@@ -14,16 +15,9 @@
 #include <libdrm/drm.h>
 #include <libdrm/drm_mode.h>
 #include <libdrm/drm_fourcc.h> // Add this line
-#include <gbm.h>        // GBM (Generic Buffer Management) is often used with DRM/EGL
 
-// Add these definitions if your gbm.h or drm.h doesn't define them
-// These values are standard for DRM/GBM FourCC codes and usage flags.
-#ifndef GBM_FORMAT_ARGB8888
-#define GBM_FORMAT_ARGB8888 DRM_FORMAT_ARGB8888 // GBM format usually mirrors DRM format
-#endif
-
-#ifndef GBM_BO_USE_TEXTURE
-#define GBM_BO_USE_TEXTURE (1 << 4) // Common value for this flag in GBM
+#ifndef DRM_FORMAT_YUV420
+#define DRM_FORMAT_YUV420 fourcc_code('Y', 'U', '1', '2') // 3 planes: Y, U, V
 #endif
 
 
@@ -36,17 +30,61 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h> // For glEGLImageTargetTexture2DOES
 
+#include "pixel_kernels.h"
+#include "jpeg_producer.h"
+#include "buffer_provider.h"
+#include "frame_timing.h"
+
 // --- Global EGL/GL variables ---
 EGLDisplay egl_display = EGL_NO_DISPLAY;
 EGLContext egl_context = EGL_NO_CONTEXT;
 EGLSurface egl_surface = EGL_NO_SURFACE;
 
-// --- DRM/GBM related variables ---
-int drm_fd = -1;
-struct gbm_device *gbm_dev = nullptr;
-struct gbm_bo *gbm_bo = nullptr; // GBM Buffer Object for zero-copy
-GLuint texture_id = 0;
-EGLImageKHR egl_image = EGL_NO_IMAGE_KHR;
+// --- Where the buffers come from (GBM, udmabuf or malloc) ---
+std::unique_ptr<buffer_provider> provider;
+
+// --- Pixel formats the buffers can be in ---
+// The YUV formats are 4:2:0, 1.5 bytes per pixel instead of 4, which is what a video or JPEG decoder has anyway.
+enum class buffer_format { argb8888, nv12, yuv420 };
+
+const char *format_name(buffer_format format) {
+    switch (format) {
+        case buffer_format::nv12: return "nv12";
+        case buffer_format::yuv420: return "yuv420";
+        default: return "argb8888";
+    }
+}
+
+// How a YUV buffer gets to RGB on the GPU:
+// external = one multi-planar EGLImage sampled through GL_OES_EGL_image_external, the driver does the conversion;
+// shader = every plane imported as its own R8 (or GR88) EGLImage and converted in our fragment shader.
+enum class yuv_sampling { external, shader };
+
+// --- Ring of DMA_BUF buffers ---
+// Each slot is a buffer from the provider with its own EGLImage and texture. The slots are filled round-robin, and a slot is
+// only written again after the GPU has finished the draw that last sampled it (its fence), so the CPU writing frame N+1
+// never races with the GPU still reading frame N.
+// A YUV slot is one buffer holding all of its planes (see create_dma_buf_slot).
+// When the buffer can't be imported (malloc, or no EGL_EXT_image_dma_buf_import) the textures are ordinary ones that
+// the buffer is copied into after every update instead.
+struct dma_buf_slot {
+    provided_buffer buf;
+    bool upload = false; // copied into the textures with glTexSubImage2D instead of imported
+    buffer_format format = buffer_format::argb8888;
+    yuv_sampling sampling = yuv_sampling::external;
+    int num_planes = 1;
+    uint32_t offsets[3] = {}, pitches[3] = {}; // of each plane within the buffer
+    int num_textures = 1;                      // 1, except for YUV sampled by the shader (one per plane)
+    EGLImageKHR egl_images[3] = { EGL_NO_IMAGE_KHR, EGL_NO_IMAGE_KHR, EGL_NO_IMAGE_KHR };
+    GLuint textures[3] = {};
+    EGLSyncKHR fence = EGL_NO_SYNC_KHR; // signaled when the last draw using this slot is done
+    uint64_t gpu_ticket = 0;            // gpu_timer's for the fence, which it's waiting on too
+};
+std::vector<dma_buf_slot> ring;
+
+// --- JPEG files to decode into the buffers (cycled through; none = the animated gradient) ---
+std::vector<std::vector<uint8_t>> jpeg_files;
+std::vector<std::string> jpeg_names;
 
 // --- EGL Extension Pointers (must be loaded at runtime) ---
 // These are defined in eglext.h but need to be fetched via eglGetProcAddress
@@ -54,13 +92,35 @@ PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR_ptr = nullptr;
 PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR_ptr = nullptr;
 PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES_ptr = nullptr;
 
-// --- GLES2 Shader Program ---
-GLuint program_object = 0;
-GLuint vertex_shader = 0;
-GLuint fragment_shader = 0;
-GLint position_loc = -1;
-GLint texcoord_loc = -1;
-GLint sampler_loc = -1;
+// EGL_EXT_image_dma_buf_import and the above (optional; without them every buffer is copied into its texture)
+bool dma_buf_import = false;
+
+// GL_EXT_texture_format_BGRA8888, for copying ARGB8888 buffers into textures as they are
+bool bgra_upload = false;
+
+// EGL_KHR_fence_sync (optional; without it a slot is made reusable with glFinish)
+PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR_ptr = nullptr;
+PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR_ptr = nullptr;
+PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR_ptr = nullptr;
+
+// times the GPU's work on each frame off its fence (only with EGL_KHR_fence_sync)
+std::unique_ptr<fence_timer> gpu_timer;
+
+// --- GLES2 Shader Programs ---
+struct gl_program {
+    GLuint program_object = 0;
+    GLuint vertex_shader = 0;
+    GLuint fragment_shader = 0;
+    GLint position_loc = -1;
+    GLint texcoord_loc = -1;
+    GLint sampler_locs[3] = { -1, -1, -1 }; // texture unit i is bound to sampler_locs[i]
+};
+gl_program rgb_program;      // ARGB8888 textures
+gl_program external_program; // any samplerExternalOES texture (0 if GL_OES_EGL_image_external is missing)
+gl_program nv12_program;     // Y + interleaved UV textures, converted in the shader
+gl_program rgb_swizzled_program; // ARGB8888 copied into an RGBA texture (no GL_EXT_texture_format_BGRA8888)
+gl_program nv12_la_program;      // NV12 copied into luminance + luminance/alpha textures
+gl_program yuv420_program;   // Y + U + V textures, converted in the shader
 
 
 
@@ -92,9 +152,25 @@ bool load_egl_extensions() {
     eglDestroyImageKHR_ptr = (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
     glEGLImageTargetTexture2DOES_ptr = (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
 
-    if (!eglCreateImageKHR_ptr || !eglDestroyImageKHR_ptr || !glEGLImageTargetTexture2DOES_ptr) {
-        std::cerr << "ERROR: Failed to load required EGL extensions (eglCreateImageKHR, eglDestroyImageKHR, glEGLImageTargetTexture2DOES)." << std::endl;
-        return false;
+    const char *extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+    dma_buf_import = eglCreateImageKHR_ptr && eglDestroyImageKHR_ptr && glEGLImageTargetTexture2DOES_ptr &&
+                     extensions && strstr(extensions, "EGL_EXT_image_dma_buf_import");
+    if (!dma_buf_import) {
+        // e.g. an older Mesa software driver: everything but the zero-copy part can still be measured
+        std::cout << "EGL_EXT_image_dma_buf_import not available, buffers will be copied into the textures." << std::endl;
+    }
+
+
+    if (extensions && strstr(extensions, "EGL_KHR_fence_sync")) {
+        eglCreateSyncKHR_ptr = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+        eglClientWaitSyncKHR_ptr = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+        eglDestroySyncKHR_ptr = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    }
+    if (!eglCreateSyncKHR_ptr || !eglClientWaitSyncKHR_ptr || !eglDestroySyncKHR_ptr) {
+        eglCreateSyncKHR_ptr = nullptr;
+        std::cout << "EGL_KHR_fence_sync not available, buffers will be recycled (and the GPU timed) with glFinish()." << std::endl;
+    } else {
+        gpu_timer.reset(new fence_timer(egl_display, eglClientWaitSyncKHR_ptr));
     }
     return true;
 }
@@ -125,8 +201,10 @@ GLuint load_shader(GLenum type, const char* shader_src) {
     return shader;
 }
 
-// --- Initialize GLES2 shaders and program ---
-bool setup_gles_program() {
+// --- Build one program around the shared vertex shader ---
+// defines go in front of the fragment shader, for the variants that only differ in which channels they read
+bool build_program(gl_program &prog, const char *f_shader_str, const std::vector<const char *> &samplers,
+                   const char *defines = "") {
     const char v_shader_str[] =
         "attribute vec4 a_position;   \n"
         "attribute vec2 a_texcoord;   \n"
@@ -137,53 +215,49 @@ bool setup_gles_program() {
         "   v_texcoord = a_texcoord;  \n"
         "}                            \n";
 
-    const char f_shader_str[] =
-        "precision mediump float;     \n"
-        "varying vec2 v_texcoord;     \n"
-        "uniform sampler2D s_texture; \n"
-        "void main()                  \n"
-        "{                            \n"
-        "   gl_FragColor = texture2D(s_texture, v_texcoord); \n"
-        "}                            \n";
-
-    vertex_shader = load_shader(GL_VERTEX_SHADER, v_shader_str);
-    fragment_shader = load_shader(GL_FRAGMENT_SHADER, f_shader_str);
+    prog.vertex_shader = load_shader(GL_VERTEX_SHADER, v_shader_str);
+    prog.fragment_shader = load_shader(GL_FRAGMENT_SHADER, (std::string(defines) + f_shader_str).c_str());
 
-    if (!vertex_shader || !fragment_shader) {
+    if (!prog.vertex_shader || !prog.fragment_shader) {
         std::cerr << "Failed to load shaders." << std::endl;
         return false;
     }
 
-    program_object = glCreateProgram();
-    if (program_object == 0) {
+    prog.program_object = glCreateProgram();
+    if (prog.program_object == 0) {
         std::cerr << "Failed to create program object." << std::endl;
         return false;
     }
 
-    glAttachShader(program_object, vertex_shader);
-    glAttachShader(program_object, fragment_shader);
-    glLinkProgram(program_object);
+    glAttachShader(prog.program_object, prog.vertex_shader);
+    glAttachShader(prog.program_object, prog.fragment_shader);
+    glLinkProgram(prog.program_object);
 
     GLint linked;
-    glGetProgramiv(program_object, GL_LINK_STATUS, &linked);
+    glGetProgramiv(prog.program_object, GL_LINK_STATUS, &linked);
     if (!linked) {
         GLint info_len = 0;
-        glGetProgramiv(program_object, GL_INFO_LOG_LENGTH, &info_len);
+        glGetProgramiv(prog.program_object, GL_INFO_LOG_LENGTH, &info_len);
         if (info_len > 1) {
             std::vector<char> info_log(info_len);
-            glGetProgramInfoLog(program_object, info_len, NULL, info_log.data());
+            glGetProgramInfoLog(prog.program_object, info_len, NULL, info_log.data());
             std::cerr << "Error linking program:\n" << info_log.data() << std::endl;
         }
-        glDeleteProgram(program_object);
+        glDeleteProgram(prog.program_object);
+        prog.program_object = 0;
         return false;
     }
 
     // Get attribute and uniform locations
-    position_loc = glGetAttribLocation(program_object, "a_position");
-    texcoord_loc = glGetAttribLocation(program_object, "a_texcoord");
-    sampler_loc = glGetUniformLocation(program_object, "s_texture");
+    prog.position_loc = glGetAttribLocation(prog.program_object, "a_position");
+    prog.texcoord_loc = glGetAttribLocation(prog.program_object, "a_texcoord");
+    bool found = prog.position_loc != -1 && prog.texcoord_loc != -1;
+    for (size_t i = 0; i < samplers.size(); ++i) {
+        prog.sampler_locs[i] = glGetUniformLocation(prog.program_object, samplers[i]);
+        found = found && prog.sampler_locs[i] != -1;
+    }
 
-    if (position_loc == -1 || texcoord_loc == -1 || sampler_loc == -1) {
+    if (!found) {
         std::cerr << "Failed to get shader attribute/uniform locations." << std::endl;
         return false;
     }
@@ -191,18 +265,114 @@ bool setup_gles_program() {
     return true;
 }
 
-// --- Initialization ---
-bool init_egl_gles(int width, int height) {
-    egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-    if (egl_display == EGL_NO_DISPLAY) {
-        std::cerr << "ERROR: Failed to get EGL display. Error: " << egl_error_string(eglGetError()) << std::endl;
+void destroy_program(gl_program &prog) {
+    if (prog.program_object) glDeleteProgram(prog.program_object);
+    if (prog.vertex_shader) glDeleteShader(prog.vertex_shader);
+    if (prog.fragment_shader) glDeleteShader(prog.fragment_shader);
+    prog = gl_program();
+}
+
+// --- Initialize GLES2 shaders and programs ---
+bool setup_gles_program() {
+    const char rgb_shader_str[] =
+        "precision mediump float;     \n"
+        "varying vec2 v_texcoord;     \n"
+        "uniform sampler2D s_texture; \n"
+        "void main()                  \n"
+        "{                            \n"
+        "   gl_FragColor = texture2D(s_texture, v_texcoord).COLOR; \n"
+        "}                            \n";
+
+    // the driver converts YUV to RGB when sampling (using the color space hints given at import)
+    const char external_shader_str[] =
+        "#extension GL_OES_EGL_image_external : require \n"
+        "precision mediump float;     \n"
+        "varying vec2 v_texcoord;     \n"
+        "uniform samplerExternalOES s_texture; \n"
+        "void main()                  \n"
+        "{                            \n"
+        "   gl_FragColor = texture2D(s_texture, v_texcoord); \n"
+        "}                            \n";
+
+    // Full range BT.601 (what JPEG uses). R8 planes sample as (value, 0, 0, 1), GR88 as (first byte, second byte, 0, 1);
+    // the luminance (+ alpha) textures of the copy fallback as (value, value, value, 1) or (first, first, first, second).
+    const char nv12_shader_str[] =
+        "precision mediump float;     \n"
+        "varying vec2 v_texcoord;     \n"
+        "uniform sampler2D s_y;       \n"
+        "uniform sampler2D s_uv;      \n"
+        "void main()                  \n"
+        "{                            \n"
+        "   float y = texture2D(s_y, v_texcoord).r; \n"
+        "   vec2 uv = texture2D(s_uv, v_texcoord).UV - 0.5; \n"
+        "   gl_FragColor = vec4(y + 1.402 * uv.y, y - 0.344136 * uv.x - 0.714136 * uv.y, y + 1.772 * uv.x, 1.0); \n"
+        "}                            \n";
+
+    const char yuv420_shader_str[] =
+        "precision mediump float;     \n"
+        "varying vec2 v_texcoord;     \n"
+        "uniform sampler2D s_y;       \n"
+        "uniform sampler2D s_u;       \n"
+        "uniform sampler2D s_v;       \n"
+        "void main()                  \n"
+        "{                            \n"
+        "   float y = texture2D(s_y, v_texcoord).r; \n"
+        "   float u = texture2D(s_u, v_texcoord).r - 0.5; \n"
+        "   float v = texture2D(s_v, v_texcoord).r - 0.5; \n"
+        "   gl_FragColor = vec4(y + 1.402 * v, y - 0.344136 * u - 0.714136 * v, y + 1.772 * u, 1.0); \n"
+        "}                            \n";
+
+    if (!build_program(rgb_program, rgb_shader_str, { "s_texture" }, "#define COLOR rgba\n") ||
+        !build_program(rgb_swizzled_program, rgb_shader_str, { "s_texture" }, "#define COLOR bgra\n") ||
+        !build_program(nv12_program, nv12_shader_str, { "s_y", "s_uv" }, "#define UV rg\n") ||
+        !build_program(nv12_la_program, nv12_shader_str, { "s_y", "s_uv" }, "#define UV ra\n") ||
+        !build_program(yuv420_program, yuv420_shader_str, { "s_y", "s_u", "s_v" })) {
         return false;
     }
 
+    const char *gl_extensions = (const char *)glGetString(GL_EXTENSIONS);
+    bgra_upload = gl_extensions && strstr(gl_extensions, "GL_EXT_texture_format_BGRA8888");
+
+    // optional: without it YUV buffers are always converted by our shaders
+    if (gl_extensions && strstr(gl_extensions, "GL_OES_EGL_image_external")) {
+        if (!build_program(external_program, external_shader_str, { "s_texture" })) {
+            destroy_program(external_program);
+        }
+    }
+    if (!external_program.program_object) {
+        std::cout << "GL_OES_EGL_image_external not available, YUV buffers will be converted by the shader." << std::endl;
+    }
+
+    return true;
+}
+
+// --- Initialization ---
+// Mesa's surfaceless platform: needs no window system and no GPU (it falls back to the software driver)
+EGLDisplay get_surfaceless_display() {
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT_ptr =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!client_extensions || !strstr(client_extensions, "EGL_MESA_platform_surfaceless") || !eglGetPlatformDisplayEXT_ptr) {
+        return EGL_NO_DISPLAY;
+    }
+    return eglGetPlatformDisplayEXT_ptr(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+}
+
+bool init_egl_gles(int width, int height) {
     EGLint major, minor;
-    if (!eglInitialize(egl_display, &major, &minor)) {
-        std::cerr << "ERROR: Failed to initialize EGL. Error: " << egl_error_string(eglGetError()) << std::endl;
-        return false;
+    egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+        // the default display wants a window system (or a GPU) on desktop Mesa
+        std::cout << "No default EGL display (error: " << egl_error_string(eglGetError()) << "), trying the surfaceless platform." << std::endl;
+        egl_display = get_surfaceless_display();
+        if (egl_display == EGL_NO_DISPLAY) {
+            std::cerr << "ERROR: Failed to get EGL display. Error: " << egl_error_string(eglGetError()) << std::endl;
+            return false;
+        }
+        if (!eglInitialize(egl_display, &major, &minor)) {
+            std::cerr << "ERROR: Failed to initialize EGL. Error: " << egl_error_string(eglGetError()) << std::endl;
+            return false;
+        }
     }
     std::cout << "EGL initialized. Version: " << major << "." << minor << std::endl;
 
@@ -249,120 +419,398 @@ bool init_egl_gles(int width, int height) {
     return true;
 }
 
-// --- Initialize DRM/GBM and prepare for DMA_BUF ---
-bool init_drm_gbm(int width, int height) {
-    drm_fd = open("/dev/dri/card0", O_RDWR | O_CLOEXEC);
-    if (drm_fd < 0) {
-        std::cerr << "ERROR: Failed to open DRM device (/dev/dri/card0). Errno: " << errno << std::endl;
-        std::cerr << "       Ensure your user has permissions or run with sudo. Also ensure vc4 driver is loaded." << std::endl;
-        return false;
+// --- Import (part of) a DMA_BUF as an EGLImage ---
+// planes > 1 describes a multi-planar YUV image; all its planes live in the same dma-buf, at the given offsets.
+EGLImageKHR import_dma_buf(int dma_buf_fd, uint32_t fourcc, int width, int height, int planes,
+                           const uint32_t *offsets, const uint32_t *pitches) {
+    static const EGLint plane_attribs[3][3] = {
+        { EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT, EGL_DMA_BUF_PLANE0_PITCH_EXT },
+        { EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT, EGL_DMA_BUF_PLANE1_PITCH_EXT },
+        { EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT, EGL_DMA_BUF_PLANE2_PITCH_EXT },
+    };
+
+    // eglCreateImageKHR takes EGLint attributes (EGLAttrib is for the EGL 1.5 eglCreateImage)
+    std::vector<EGLint> attribs = {
+        EGL_WIDTH, width,
+        EGL_HEIGHT, height,
+        EGL_LINUX_DRM_FOURCC_EXT, (EGLint)fourcc,
+    };
+    for (int p = 0; p < planes; ++p) {
+        attribs.insert(attribs.end(), {
+            plane_attribs[p][0], dma_buf_fd,
+            plane_attribs[p][1], (EGLint)offsets[p],
+            plane_attribs[p][2], (EGLint)pitches[p],
+        });
+    }
+    if (planes > 1) {
+        // what our producers write (JPEG's YCbCr); the defaults would be limited range
+        attribs.insert(attribs.end(), {
+            EGL_YUV_COLOR_SPACE_HINT_EXT, EGL_ITU_REC601_EXT,
+            EGL_SAMPLE_RANGE_HINT_EXT, EGL_YUV_FULL_RANGE_EXT,
+        });
     }
+    attribs.push_back(EGL_NONE);
 
-    gbm_dev = gbm_create_device(drm_fd);
-    if (!gbm_dev) {
-        std::cerr << "ERROR: Failed to create GBM device. Errno: " << errno << std::endl;
-        close(drm_fd); drm_fd = -1;
-        return false;
+    return eglCreateImageKHR_ptr(egl_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, (EGLClientBuffer)NULL, attribs.data());
+}
+
+// --- Texture backed by an EGLImage ---
+GLuint create_image_texture(GLenum target, EGLImageKHR egl_image) {
+    GLuint texture_id = 0;
+    glGenTextures(1, &texture_id);
+    glBindTexture(target, texture_id);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glEGLImageTargetTexture2DOES_ptr(target, egl_image);
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR) {
+        std::cerr << "ERROR: glEGLImageTargetTexture2DOES failed: " << err << std::endl;
+        glDeleteTextures(1, &texture_id);
+        return 0;
     }
+    return texture_id;
+}
 
-    // Allocate a GBM buffer object that can be used for zero-copy
-    // Use DRM_FORMAT_ARGB8888 for 32-bit RGBA. GBM_BO_USE_LINEAR for CPU access.
-    gbm_bo = gbm_bo_create(gbm_dev, width, height, GBM_FORMAT_ARGB8888, /*GBM_BO_USE_TEXTURE |*/ GBM_BO_USE_LINEAR);
-    if (!gbm_bo) {
-        std::cerr << "ERROR: Failed to create GBM buffer object. Errno: " << errno << std::endl;
-        gbm_device_destroy(gbm_dev); gbm_dev = nullptr;
-        close(drm_fd); drm_fd = -1;
-        return false;
+// --- YUV slot: every plane as its own single-channel image, for the shader conversion ---
+bool import_yuv_planes(dma_buf_slot &slot, int dma_buf_fd, int width, int height) {
+    slot.sampling = yuv_sampling::shader;
+    slot.num_textures = slot.num_planes;
+    for (int p = 0; p < slot.num_planes; ++p) {
+        // NV12's second plane is U, V byte pairs: GR88 puts them in the red and green channels
+        bool uv_pairs = slot.format == buffer_format::nv12 && p == 1;
+        int w = p ? width / 2 : width, h = p ? height / 2 : height;
+        slot.egl_images[p] = import_dma_buf(dma_buf_fd, uv_pairs ? DRM_FORMAT_GR88 : DRM_FORMAT_R8, w, h, 1,
+                                            &slot.offsets[p], &slot.pitches[p]);
+        if (slot.egl_images[p] == EGL_NO_IMAGE_KHR) {
+            std::cerr << "ERROR: Failed to create EGLImage from plane " << p << " of the DMA_BUF. EGL error: "
+                      << egl_error_string(eglGetError()) << std::endl;
+            return false;
+        }
+        slot.textures[p] = create_image_texture(GL_TEXTURE_2D, slot.egl_images[p]);
+        if (!slot.textures[p]) {
+            return false;
+        }
     }
-    std::cout << "GBM buffer object created (width=" << width << ", height=" << height << ", stride=" << gbm_bo_get_stride(gbm_bo) << ")" << std::endl;
+    return true;
+}
 
+// --- Copy fallback: ordinary textures that the buffer gets uploaded into ---
+// What each plane is uploaded as. GLES2 has no one or two channel formats but luminance (+ alpha), which the shaders
+// read as .r (and .a); ARGB8888 goes in as it is with GL_EXT_texture_format_BGRA8888, or as RGBA and is swizzled back.
+GLenum upload_format(const dma_buf_slot &slot, int plane) {
+    if (slot.format == buffer_format::argb8888) return bgra_upload ? GL_BGRA_EXT : GL_RGBA;
+    if (slot.format == buffer_format::nv12 && plane == 1) return GL_LUMINANCE_ALPHA;
+    return GL_LUMINANCE;
+}
+
+int upload_bytes_per_pixel(GLenum format) {
+    switch (format) {
+        case GL_LUMINANCE: return 1;
+        case GL_LUMINANCE_ALPHA: return 2;
+        default: return 4;
+    }
+}
+
+bool create_upload_textures(dma_buf_slot &slot, int width, int height) {
+    slot.upload = true;
+    slot.sampling = yuv_sampling::shader;
+    slot.num_textures = slot.num_planes;
+    for (int p = 0; p < slot.num_planes; ++p) {
+        int w = p ? width / 2 : width, h = p ? height / 2 : height;
+        GLenum format = upload_format(slot, p);
+
+        glGenTextures(1, &slot.textures[p]);
+        glBindTexture(GL_TEXTURE_2D, slot.textures[p]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE, NULL);
+
+        GLenum err = glGetError();
+        if (err != GL_NO_ERROR) {
+            std::cerr << "ERROR: glTexImage2D failed: " << err << std::endl;
+            return false;
+        }
+    }
     return true;
 }
 
+// copies the freshly written planes (at pixels, the first one stride apart) into the slot's textures
+void upload_textures(const dma_buf_slot &slot, const uint8_t *pixels, uint32_t stride, int width, int height) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int p = 0; p < slot.num_planes; ++p) {
+        int w = p ? width / 2 : width, h = p ? height / 2 : height;
+        GLenum format = upload_format(slot, p);
+        uint32_t pitch = p ? slot.pitches[p] : stride;
+        const uint8_t *plane = pixels + slot.offsets[p];
+
+        glBindTexture(GL_TEXTURE_2D, slot.textures[p]);
+        if (pitch == (uint32_t)(w * upload_bytes_per_pixel(format))) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, GL_UNSIGNED_BYTE, plane);
+        } else {
+            // GLES2 has no GL_UNPACK_ROW_LENGTH: padded rows go up one by one
+            for (int y = 0; y < h; ++y) {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, w, 1, format, GL_UNSIGNED_BYTE, plane + (size_t)y * pitch);
+            }
+        }
+    }
+}
+
+// --- Create one ring slot: buffer -> DMA_BUF -> EGLImage -> texture ---
+bool create_dma_buf_slot(dma_buf_slot &slot, buffer_format format, yuv_sampling sampling, map_method map,
+                         int width, int height) {
+    slot.format = format;
+
+    // Allocate a buffer that can be used for zero-copy
+    // A YUV buffer is a one byte per pixel R8 buffer 1.5 times as high, with the chroma planes below the Y plane
+    // (GBM can't be relied on to allocate YUV formats).
+    bool yuv = format != buffer_format::argb8888;
+    if (!provider->allocate(width, yuv ? height * 3 / 2 : height, yuv ? 1 : 4, map, slot.buf)) {
+        return false;
+    }
+    std::cout << "Buffer allocated (" << provider->name() << ", " << format_name(format) << ", width=" << width
+              << ", height=" << height << ", stride=" << slot.buf.stride << ")" << std::endl;
 
-// --- Create Texture from DMA_BUF ---
-bool create_dma_buf_texture(int width, int height) {
-    int dma_buf_fd = gbm_bo_get_fd(gbm_bo);
-    if (dma_buf_fd < 0) {
-        std::cerr << "ERROR: Failed to get DMA_BUF FD from GBM BO. Errno: " << errno << std::endl;
+    uint32_t stride = slot.buf.stride;
+    if (yuv && stride % 2) {
+        std::cerr << "ERROR: Odd stride, can't lay out the chroma planes." << std::endl;
         return false;
     }
 
-    uint32_t stride = gbm_bo_get_stride(gbm_bo);
+    slot.offsets[0] = 0;
+    slot.pitches[0] = stride;
+    if (format == buffer_format::argb8888) {
+        slot.num_planes = 1;
+    } else if (format == buffer_format::nv12) {
+        slot.num_planes = 2;
+        slot.offsets[1] = stride * height;
+        slot.pitches[1] = stride;
+    } else {
+        // two half-stride chroma rows per buffer row
+        slot.num_planes = 3;
+        slot.offsets[1] = stride * height;
+        slot.pitches[1] = stride / 2;
+        slot.offsets[2] = slot.offsets[1] + stride / 2 * (height / 2);
+        slot.pitches[2] = stride / 2;
+    }
 
-    EGLAttrib attribs[] = {
-        EGL_WIDTH, (EGLAttrib)width,
-        EGL_HEIGHT, (EGLAttrib)height,
-        EGL_LINUX_DRM_FOURCC_EXT, DRM_FORMAT_ARGB8888,
-        EGL_DMA_BUF_PLANE0_FD_EXT, (EGLAttrib)dma_buf_fd,
-        EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0, // Single plane, offset 0
-        EGL_DMA_BUF_PLANE0_PITCH_EXT, (EGLAttrib)stride,
-        EGL_NONE
-    };
+    int dma_buf_fd = slot.buf.dma_buf_fd;
+    if (dma_buf_fd < 0 || !dma_buf_import) {
+        return create_upload_textures(slot, width, height);
+    }
 
-    egl_image = eglCreateImageKHR_ptr(egl_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, (EGLClientBuffer)NULL, attribs);
-    if (egl_image == EGL_NO_IMAGE_KHR) {
-        std::cerr << "ERROR: Failed to create EGLImage from DMA_BUF. EGL error: " << egl_error_string(eglGetError()) << std::endl;
-        close(dma_buf_fd); // Close the FD as EGLImage creation failed
-        return false;
+    bool ok = true;
+    if (format == buffer_format::argb8888) {
+        slot.num_textures = 1;
+        slot.egl_images[0] = import_dma_buf(dma_buf_fd, DRM_FORMAT_ARGB8888, width, height, 1, slot.offsets, slot.pitches);
+        if (slot.egl_images[0] == EGL_NO_IMAGE_KHR) {
+            std::cerr << "ERROR: Failed to create EGLImage from DMA_BUF. EGL error: " << egl_error_string(eglGetError()) << std::endl;
+            ok = false;
+        } else {
+            slot.textures[0] = create_image_texture(GL_TEXTURE_2D, slot.egl_images[0]);
+            ok = slot.textures[0] != 0;
+        }
+    } else {
+        if (sampling == yuv_sampling::external && external_program.program_object) {
+            slot.sampling = yuv_sampling::external;
+            slot.num_textures = 1;
+            uint32_t fourcc = format == buffer_format::nv12 ? DRM_FORMAT_NV12 : DRM_FORMAT_YUV420;
+            slot.egl_images[0] = import_dma_buf(dma_buf_fd, fourcc, width, height, slot.num_planes, slot.offsets, slot.pitches);
+            if (slot.egl_images[0] != EGL_NO_IMAGE_KHR) {
+                slot.textures[0] = create_image_texture(GL_TEXTURE_EXTERNAL_OES, slot.egl_images[0]);
+            }
+            if (!slot.textures[0]) {
+                static bool reported = false;
+                if (!reported) {
+                    std::cout << "Multi-planar " << format_name(format) << " import failed (EGL error: "
+                              << egl_error_string(eglGetError()) << "), converting in the shader instead." << std::endl;
+                    reported = true;
+                }
+                if (slot.egl_images[0] != EGL_NO_IMAGE_KHR) {
+                    eglDestroyImageKHR_ptr(egl_display, slot.egl_images[0]);
+                    slot.egl_images[0] = EGL_NO_IMAGE_KHR;
+                }
+                ok = import_yuv_planes(slot, dma_buf_fd, width, height);
+            }
+        } else {
+            ok = import_yuv_planes(slot, dma_buf_fd, width, height);
+        }
     }
-    std::cout << "EGLImageKHR created from DMA_BUF." << std::endl;
 
-    // DMA_BUF FD can be closed after EGLImageKHR is created, as EGL takes ownership
-    close(dma_buf_fd);
+    // the fd stays open with the buffer (it's needed for DMA_BUF_IOCTL_SYNC), EGL keeps its own reference anyway
+    return ok;
+}
 
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+// the fence must be signaled (or never have been flushed); gpu_timer has to be done with it too
+void destroy_fence(dma_buf_slot &slot) {
+    if (slot.fence != EGL_NO_SYNC_KHR) {
+        if (gpu_timer) {
+            gpu_timer->wait_done(slot.gpu_ticket);
+        }
+        eglDestroySyncKHR_ptr(egl_display, slot.fence);
+        slot.fence = EGL_NO_SYNC_KHR;
+        slot.gpu_ticket = 0;
+    }
+}
 
-    glEGLImageTargetTexture2DOES_ptr(GL_TEXTURE_2D, egl_image);
-    GLenum err = glGetError();
-    if (err != GL_NO_ERROR) {
-        std::cerr << "ERROR: glEGLImageTargetTexture2DOES failed: " << err << std::endl;
-        return false;
+void destroy_dma_buf_slot(dma_buf_slot &slot) {
+    destroy_fence(slot);
+    for (int i = 0; i < 3; ++i) {
+        if (slot.textures[i]) {
+            glDeleteTextures(1, &slot.textures[i]);
+            slot.textures[i] = 0;
+        }
+        if (slot.egl_images[i] != EGL_NO_IMAGE_KHR && eglDestroyImageKHR_ptr) {
+            eglDestroyImageKHR_ptr(egl_display, slot.egl_images[i]);
+            slot.egl_images[i] = EGL_NO_IMAGE_KHR;
+        }
+    }
+    provider->release(slot.buf);
+}
+
+void destroy_ring() {
+    for (dma_buf_slot &slot : ring) {
+        destroy_dma_buf_slot(slot);
     }
-    std::cout << "GLES texture created from EGLImageKHR." << std::endl;
+    ring.clear();
+}
 
+bool create_ring(int depth, buffer_format format, yuv_sampling sampling, map_method map, int width, int height) {
+    ring.resize(depth);
+    for (dma_buf_slot &slot : ring) {
+        if (!create_dma_buf_slot(slot, format, sampling, map, width, height)) {
+            destroy_ring();
+            return false;
+        }
+    }
+    std::cout << "DMA_BUF ring of " << depth << " buffer(s) created and " << (ring[0].upload ? "copied" : "linked")
+              << " to GLES." << std::endl;
     return true;
 }
 
+// --- Wait until the GPU is done with a slot's previous contents ---
+void wait_for_slot(dma_buf_slot &slot) {
+    if (slot.fence != EGL_NO_SYNC_KHR) {
+        // FLUSH_COMMANDS in case the draw that created the fence hasn't been submitted yet
+        eglClientWaitSyncKHR_ptr(egl_display, slot.fence, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+        destroy_fence(slot);
+    }
+}
+
+// --- Mark a slot as in use by everything submitted so far ---
+// Returns how long the GPU took with it when that's known right away (no fences, glFinish() instead), -1 when
+// gpu_timer will find out from the fence.
+double fence_slot(dma_buf_slot &slot) {
+    if (eglCreateSyncKHR_ptr) {
+        slot.fence = eglCreateSyncKHR_ptr(egl_display, EGL_SYNC_FENCE_KHR, NULL);
+        glFlush(); // get the draw (and the fence) to the GPU now rather than when the next slot is waited on
+        if (slot.fence != EGL_NO_SYNC_KHR) {
+            slot.gpu_ticket = gpu_timer->watch(slot.fence, std::chrono::steady_clock::now());
+            return -1;
+        }
+    }
+    auto finish_time = std::chrono::steady_clock::now();
+    glFinish(); // no fences: the only way to know the GPU is done
+    std::chrono::duration<double, std::milli> finish_duration = std::chrono::steady_clock::now() - finish_time;
+    return finish_duration.count();
+}
+
 // --- Update Texture Data (CPU writes to mapped buffer) ---
-void update_dma_buf_data(int width, int height, int frame_idx) {
-    // Map the GBM BO to CPU address space
-    // GBM_BO_TRANSFER_WRITE hints that we are writing data
-    void *cpu_map_ptr = gbm_bo_map(gbm_bo, 0, 0, width, height, GBM_BO_TRANSFER_WRITE, NULL, NULL);
-    if (!cpu_map_ptr) {
-        std::cerr << "ERROR: Failed to map GBM BO." << std::endl;
+// access_ms is the time spent getting access to the memory and giving it back (map/unmap or the sync ioctls),
+// upload_ms the time spent copying it into the textures (when they aren't imported)
+void update_dma_buf_data(dma_buf_slot &slot, int width, int height, int frame_idx, double &access_ms, double &upload_ms) {
+    bool yuv = slot.format != buffer_format::argb8888;
+    int map_height = yuv ? height * 3 / 2 : height;
+
+    auto begin_time = std::chrono::steady_clock::now();
+    uint32_t stride = 0;
+    void *map_data = nullptr;
+    unsigned char *pixels = begin_cpu_access(slot.buf, width, map_height, stride, map_data);
+    std::chrono::duration<double, std::milli> begin_duration = std::chrono::steady_clock::now() - begin_time;
+    access_ms = begin_duration.count();
+    upload_ms = 0;
+    if (!pixels) {
+        return;
+    }
+
+    // the chroma plane offsets are in buffer rows, which only match the mapping if it has the same stride
+    if (yuv && stride != slot.pitches[0]) {
+        std::cerr << "ERROR: The mapping's stride (" << stride << ") isn't the buffer's (" << slot.pitches[0]
+                  << "), can't find the chroma planes in it." << std::endl;
+        end_cpu_access(slot.buf, map_data);
         return;
     }
 
-    uint32_t stride = gbm_bo_get_stride(gbm_bo);
-    unsigned char *pixels = static_cast<unsigned char*>(cpu_map_ptr);
+    yuv_planes planes = {};
+    if (yuv) {
+        planes.y = pixels + slot.offsets[0];
+        planes.u = pixels + slot.offsets[1];
+        planes.y_stride = slot.pitches[0];
+        planes.uv_stride = slot.pitches[1];
+        if (slot.format == buffer_format::nv12) {
+            planes.v = planes.u + 1;
+            planes.uv_step = 2;
+        } else {
+            planes.v = pixels + slot.offsets[2];
+            planes.uv_step = 1;
+        }
+    }
 
-    // Simulate PNG decode into the mapped buffer
-    // IMPORTANT: Respect 'stride' for each row.
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            // Simple animated gradient (RGBA)
-            pixels[y * stride + x * 4 + 0] = (unsigned char)((x + frame_idx * 5) % 256); // R
-            pixels[y * stride + x * 4 + 1] = (unsigned char)((y + frame_idx * 3) % 256); // G
-            pixels[y * stride + x * 4 + 2] = (unsigned char)((frame_idx * 10) % 256);   // B
-            pixels[y * stride + x * 4 + 3] = 255;                                        // A
+    if (!jpeg_files.empty()) {
+        // Decode a real JPEG straight into the mapped buffer, scanline by scanline
+        size_t file_idx = frame_idx % jpeg_files.size();
+        jpeg_frame_info info;
+        std::string error;
+        bool ok = yuv ? decode_jpeg_into_yuv(jpeg_files[file_idx], planes, width, height, info, error)
+                      : decode_jpeg_into(jpeg_files[file_idx], pixels, stride, width, height, info, error);
+        if (!ok) {
+            std::cerr << "ERROR: Failed to decode " << jpeg_names[file_idx] << ": " << error << std::endl;
+        } else if (frame_idx < (int)jpeg_files.size()) {
+            std::cout << jpeg_names[file_idx] << ": " << info.image_width << "x" << info.image_height << " decoded at 1/"
+                      << info.scale_denom << " (" << info.width << "x" << info.height << ")" << std::endl;
         }
+    } else if (yuv) {
+        fill_gradient_yuv(planes, width, height, (uint8_t)(frame_idx * 5), (uint8_t)(frame_idx * 3), (uint8_t)(frame_idx * 10));
+    } else {
+        // Simulate PNG decode into the mapped buffer: an animated gradient, one row kernel call per row
+        // (written as ARGB8888, which is B, G, R, A in memory)
+        fill_gradient(select_pixel_kernels(), pixels, stride, width, height,
+                      (uint8_t)(frame_idx * 5), (uint8_t)(frame_idx * 3), (uint8_t)(frame_idx * 10));
+    }
+
+    // no import: the copy into the textures is part of the update (while the mapping is still valid)
+    if (slot.upload) {
+        auto upload_time = std::chrono::steady_clock::now();
+        upload_textures(slot, pixels, stride, width, height);
+        std::chrono::duration<double, std::milli> upload_duration = std::chrono::steady_clock::now() - upload_time;
+        upload_ms = upload_duration.count();
     }
 
-    gbm_bo_unmap(gbm_bo, cpu_map_ptr);
+    auto end_time = std::chrono::steady_clock::now();
+    end_cpu_access(slot.buf, map_data);
+    std::chrono::duration<double, std::milli> end_duration = std::chrono::steady_clock::now() - end_time;
+    access_ms += end_duration.count();
+}
+
+// --- The program that draws a slot ---
+const gl_program &slot_program(const dma_buf_slot &slot) {
+    if (slot.format == buffer_format::argb8888) return slot.upload && !bgra_upload ? rgb_swizzled_program : rgb_program;
+    if (slot.sampling == yuv_sampling::external) return external_program;
+    if (slot.format == buffer_format::nv12) return slot.upload ? nv12_la_program : nv12_program;
+    return yuv420_program;
 }
 
 // --- Render Frame ---
-void render_frame(int width, int height) {
+void render_frame(const dma_buf_slot &slot, int width, int height) {
     glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(program_object);
+    const gl_program &prog = slot_program(slot);
+    glUseProgram(prog.program_object);
 
     // Vertices for a full-screen quad
     GLfloat vertices[] = {
@@ -383,15 +831,19 @@ void render_frame(int width, int height) {
     // Indices for drawing two triangles to form a quad
     GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
 
-    glVertexAttribPointer(position_loc, 3, GL_FLOAT, GL_FALSE, 0, vertices);
-    glEnableVertexAttribArray(position_loc);
+    glVertexAttribPointer(prog.position_loc, 3, GL_FLOAT, GL_FALSE, 0, vertices);
+    glEnableVertexAttribArray(prog.position_loc);
 
-    glVertexAttribPointer(texcoord_loc, 2, GL_FLOAT, GL_FALSE, 0, texcoords);
-    glEnableVertexAttribArray(texcoord_loc);
+    glVertexAttribPointer(prog.texcoord_loc, 2, GL_FLOAT, GL_FALSE, 0, texcoords);
+    glEnableVertexAttribArray(prog.texcoord_loc);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glUniform1i(sampler_loc, 0);
+    GLenum target = slot.sampling == yuv_sampling::external && slot.format != buffer_format::argb8888
+                        ? GL_TEXTURE_EXTERNAL_OES : GL_TEXTURE_2D;
+    for (int i = 0; i < slot.num_textures; ++i) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(target, slot.textures[i]);
+        glUniform1i(prog.sampler_locs[i], i);
+    }
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices);
 
@@ -404,28 +856,16 @@ void render_frame(int width, int height) {
 void cleanup() {
     std::cout << "Cleaning up..." << std::endl;
 
-    if (program_object) glDeleteProgram(program_object);
-    if (vertex_shader) glDeleteShader(vertex_shader);
-    if (fragment_shader) glDeleteShader(fragment_shader);
-    if (texture_id) glDeleteTextures(1, &texture_id);
+    destroy_program(rgb_program);
+    destroy_program(external_program);
+    destroy_program(nv12_program);
+    destroy_program(rgb_swizzled_program);
+    destroy_program(nv12_la_program);
+    destroy_program(yuv420_program);
 
-    if (egl_image != EGL_NO_IMAGE_KHR && eglDestroyImageKHR_ptr) {
-        eglDestroyImageKHR_ptr(egl_display, egl_image);
-        egl_image = EGL_NO_IMAGE_KHR;
-    }
-
-    if (gbm_bo) {
-        gbm_bo_destroy(gbm_bo);
-        gbm_bo = nullptr;
-    }
-    if (gbm_dev) {
-        gbm_device_destroy(gbm_dev);
-        gbm_dev = nullptr;
-    }
-    if (drm_fd != -1) {
-        close(drm_fd);
-        drm_fd = -1;
-    }
+    destroy_ring();
+    gpu_timer.reset();
+    provider.reset();
 
     if (egl_display != EGL_NO_DISPLAY) {
         eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
@@ -443,11 +883,219 @@ void cleanup() {
     std::cout << "Cleanup complete." << std::endl;
 }
 
-int main() {
+// --- Per-frame timings of one run, stage by stage ---
+// Nothing is printed while the frames run (that would be measured too); the histograms are reported at the end.
+struct frame_stats {
+    buffer_format format = buffer_format::argb8888;
+    yuv_sampling sampling = yuv_sampling::external;
+    map_method map = map_method::mmap;
+    bool upload = false;
+    int depth = 0;
+    bool skipped = false;
+    stage_histogram wait;   // waiting for the slot's fence
+    stage_histogram access; // map + unmap, or sync start + end
+    stage_histogram fill;   // writing the pixels (gradient or JPEG decode)
+    stage_histogram copy;   // copying them into the textures (only when they can't be imported)
+    stage_histogram submit; // draw + fence + flush
+    stage_histogram gpu;    // flush until the fence signals: the GPU's part of the frame
+    stage_histogram frame;  // all of the CPU's part: wait + access + fill + copy + submit
+};
+
+// --- Render num_frames frames through a ring of the given depth and format ---
+bool run_frames(buffer_format format, yuv_sampling sampling, map_method map, int depth, int num_frames, bool paced,
+                int width, int height, frame_stats &stats) {
+    stats.format = format;
+    stats.map = map;
+    stats.depth = depth;
+    if (!create_ring(depth, format, sampling, map, width, height)) {
+        return false;
+    }
+    stats.sampling = ring[0].sampling;
+    stats.map = ring[0].buf.map;
+    stats.upload = ring[0].upload;
+
+    for (int frame_idx = 0; frame_idx < num_frames; ++frame_idx) {
+        dma_buf_slot &slot = ring[frame_idx % depth];
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        // 5. Update the pixel data in the DMA_BUF (simulating PNG decode), once the GPU is done with it
+        wait_for_slot(slot);
+        auto waited_time = std::chrono::steady_clock::now();
+        double access_ms = 0, upload_ms = 0;
+        update_dma_buf_data(slot, width, height, frame_idx, access_ms, upload_ms);
+        auto updated_time = std::chrono::steady_clock::now();
+
+        // 6. Render the frame using the texture
+        render_frame(slot, width, height);
+        double finish_ms = fence_slot(slot);
+
+        // In a real application, if using a window surface, you'd call:
+        // eglSwapBuffers(egl_display, egl_surface);
+        // For a pbuffer, you might read back the pixels for verification/saving.
+
+        auto end_time = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> wait_time = waited_time - start_time;
+        std::chrono::duration<double, std::milli> update_time = updated_time - waited_time;
+        std::chrono::duration<double, std::milli> render_time = end_time - updated_time;
+        std::chrono::duration<double, std::milli> frame_time = end_time - start_time;
+        stats.wait.add(wait_time.count());
+        stats.access.add(access_ms);
+        stats.fill.add(update_time.count() - access_ms - upload_ms);
+        if (slot.upload) {
+            stats.copy.add(upload_ms);
+        }
+        if (finish_ms >= 0) {
+            // glFinish() in place of a fence: that's the GPU's time, and it isn't part of submitting
+            stats.gpu.add(finish_ms);
+            stats.submit.add(render_time.count() - finish_ms);
+        } else {
+            stats.submit.add(render_time.count());
+        }
+        stats.frame.add(frame_time.count());
+
+        // Basic frame rate control (adjust as needed for your target FPS)
+        // For 60 FPS, target ~16.67ms per frame.
+        double target_ms = 1000.0 / 60.0;
+        double frame_ms = frame_time.count();
+        if (paced && frame_ms < target_ms) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<long long>(target_ms - frame_ms)));
+        }
+    }
+
+    glFinish();
+    if (gpu_timer) {
+        stats.gpu = gpu_timer->take();
+    }
+    destroy_ring();
+    return true;
+}
+
+// --- min/p50/p99/max of every stage of one run, and which side (CPU or GPU) holds the frame rate back ---
+void print_stats(const frame_stats &st, double mb) {
+    std::string format = format_name(st.format);
+    if (st.upload) {
+        format += " (copy)"; // into plain textures, converted by the shader if YUV
+    } else if (st.format != buffer_format::argb8888) {
+        format += st.sampling == yuv_sampling::external ? " (external)" : " (shader)";
+    }
+    std::cout << map_name(st.map) << ", " << format << ", " << mb << " MB written/frame, ring depth " << st.depth;
+    if (st.skipped) {
+        std::cout << ": skipped" << std::endl;
+        return;
+    }
+    std::cout << ", " << st.frame.count() << " frames" << std::endl;
+
+    struct stage { const char *name; const stage_histogram &hist; };
+    const stage stages[] = {
+        { "fence wait", st.wait }, { "map/sync", st.access }, { "fill", st.fill }, { "copy", st.copy },
+        { "submit", st.submit }, { "gpu", st.gpu }, { "cpu total", st.frame },
+    };
+    std::cout << "    stage      |   min ms |   p50 ms |   p99 ms |   max ms |  mean ms" << std::endl;
+    std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(4);
+    for (const stage &s : stages) {
+        if (!s.hist.count()) {
+            continue;
+        }
+        std::string name = s.name;
+        name.resize(10, ' ');
+        std::cout << "    " << name << " | " << std::setw(8) << s.hist.min_ms() << " | " << std::setw(8) << s.hist.percentile_ms(50)
+                  << " | " << std::setw(8) << s.hist.percentile_ms(99) << " | " << std::setw(8) << s.hist.max_ms()
+                  << " | " << std::setw(8) << s.hist.mean_ms() << std::endl;
+    }
+
+    // The ring lets the CPU work on one frame while the GPU draws another, so the slower of the two sets the pace.
+    // The CPU's share is its total minus waiting on fences (which is the GPU's time showing up on the CPU side).
+    if (st.gpu.count()) {
+        double cpu_ms = st.access.percentile_ms(50) + st.fill.percentile_ms(50) + st.copy.percentile_ms(50) + st.submit.percentile_ms(50);
+        double gpu_ms = st.gpu.percentile_ms(50);
+        std::cout << "    p50 CPU work " << cpu_ms << " ms vs GPU " << gpu_ms << " ms: "
+                  << (cpu_ms >= gpu_ms ? "CPU" : "GPU") << "-bound" << std::endl;
+    }
+    std::cout.flags(flags);
+}
+
+int main(int argc, char **argv) {
     const int WIDTH = 640;
     const int HEIGHT = 480;
     const int NUM_FRAMES = 300; // Simulate 300 frames
 
+    // --ring N: one paced run with N buffers. Without it, unpaced runs with 1, 2 and 3 buffers are compared
+    // (unpaced so that stalls on the GPU show up instead of hiding in the sleep).
+    std::vector<int> depths = { 1, 2, 3 };
+    bool paced = false;
+
+    // --format F: only that format. Without it every depth is run with ARGB8888, NV12 and YUV420 buffers.
+    std::vector<buffer_format> formats = { buffer_format::argb8888, buffer_format::nv12, buffer_format::yuv420 };
+    yuv_sampling sampling = yuv_sampling::external;
+
+    // --map M: only that way of getting at the buffer memory. Without it every way the provider has is run
+    // (for GBM: mmap and gbm), to compare their overhead.
+    std::vector<map_method> maps;
+
+    // --provider P: where the buffers come from. auto = GBM if there's a DRM node for it, else udmabuf, else malloc.
+    std::string provider_name = "auto";
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench-kernels") == 0) {
+            // only measure the pixel kernels (doesn't need a GPU)
+            benchmark_pixel_kernels(WIDTH, HEIGHT);
+            return 0;
+        } else if (strcmp(argv[i], "--ring") == 0 && i + 1 < argc) {
+            int depth = atoi(argv[++i]);
+            if (depth < 1) {
+                std::cerr << "The ring needs at least one buffer." << std::endl;
+                return 1;
+            }
+            depths = { depth };
+            paced = true;
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            formats.clear();
+            for (buffer_format format : { buffer_format::argb8888, buffer_format::nv12, buffer_format::yuv420 }) {
+                if (strcmp(name, format_name(format)) == 0) formats = { format };
+            }
+            if (formats.empty()) {
+                std::cerr << "Unknown format " << name << " (argb8888, nv12 or yuv420)." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, map_name(map_method::mmap)) == 0) {
+                maps = { map_method::mmap };
+            } else if (strcmp(name, map_name(map_method::gbm)) == 0) {
+                maps = { map_method::gbm };
+            } else {
+                std::cerr << "Unknown mapping " << name << " (mmap or gbm)." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--provider") == 0 && i + 1 < argc) {
+            provider_name = argv[++i];
+            if (provider_name != "auto" && provider_name != "gbm" && provider_name != "udmabuf" && provider_name != "malloc") {
+                std::cerr << "Unknown buffer provider " << provider_name << " (auto, gbm, udmabuf or malloc)." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--yuv-shader") == 0) {
+            // import YUV planes separately and convert in our shader even if the driver could sample them
+            sampling = yuv_sampling::shader;
+        } else if (strncmp(argv[i], "--", 2) != 0) {
+            // anything else is a JPEG file to show instead of the gradient
+            std::vector<uint8_t> data;
+            if (!load_file(argv[i], data)) {
+                std::cerr << "ERROR: Could not read " << argv[i] << std::endl;
+                return 1;
+            }
+            jpeg_files.push_back(std::move(data));
+            jpeg_names.push_back(argv[i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--bench-kernels] [--ring N] [--format argb8888|nv12|yuv420] [--yuv-shader] [--map mmap|gbm] [--provider auto|gbm|udmabuf|malloc] [file.jpg ...]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Using the " << select_pixel_kernels().name << " pixel kernels." << std::endl;
+
     std::cout << "Starting EGL_LINUX_DMA_BUF_EXT example..." << std::endl;
 
     // 1. Initialize EGL and GLES context
@@ -458,14 +1106,23 @@ int main() {
     }
     std::cout << "EGL/GLES initialized successfully." << std::endl;
 
-    // 2. Initialize DRM/GBM for DMA_BUF allocation
+    // 2. Initialize the buffer provider (DRM/GBM, udmabuf or malloc) for DMA_BUF allocation
     // This must happen after EGL is initialized to ensure driver readiness.
-    if (!init_drm_gbm(WIDTH, HEIGHT)) {
-        std::cerr << "Initialization of DRM/GBM failed. Exiting." << std::endl;
+    provider = create_buffer_provider(provider_name);
+    if (!provider) {
+        std::cerr << "Initialization of the " << provider_name << " buffer provider failed. Exiting." << std::endl;
+        cleanup();
+        return 1;
+    }
+    std::vector<map_method> provider_maps = provider->map_methods();
+    if (maps.empty()) {
+        maps = provider_maps;
+    } else if (std::find(provider_maps.begin(), provider_maps.end(), maps[0]) == provider_maps.end()) {
+        std::cerr << "Buffers from " << provider->name() << " can't be accessed with " << map_name(maps[0]) << ". Exiting." << std::endl;
         cleanup();
         return 1;
     }
-    std::cout << "DRM/GBM initialized successfully." << std::endl;
+    std::cout << "Buffer provider " << provider->name() << " initialized successfully." << std::endl;
 
     // 3. Create the GLES2 shader program
     if (!setup_gles_program()) {
@@ -475,40 +1132,31 @@ int main() {
     }
     std::cout << "GLES2 program setup successfully." << std::endl;
 
-    // 4. Create the GLES texture from the DMA_BUF
-    if (!create_dma_buf_texture(WIDTH, HEIGHT)) {
-        std::cerr << "Creation of DMA_BUF texture failed. Exiting." << std::endl;
-        cleanup();
-        return 1;
+    // --- Main Rendering Loop(s) ---
+    // 4. (per run) Create the ring of GLES textures from DMA_BUFs
+    std::vector<frame_stats> results;
+    for (map_method map : maps) {
+        for (buffer_format format : formats) {
+            for (int depth : depths) {
+                results.emplace_back();
+                if (!run_frames(format, sampling, map, depth, NUM_FRAMES, paced, WIDTH, HEIGHT, results.back())) {
+                    if (format == buffer_format::argb8888) {
+                        std::cerr << "Creation of DMA_BUF textures failed. Exiting." << std::endl;
+                        cleanup();
+                        return 1;
+                    }
+                    // not every driver can import (or GBM allocate) what the YUV formats need; compare what works
+                    std::cerr << "Creation of " << format_name(format) << " DMA_BUF textures failed, skipping it." << std::endl;
+                    results.back().skipped = true;
+                }
+            }
+        }
     }
-    std::cout << "DMA_BUF texture created and linked to GLES." << std::endl;
-
-    // --- Main Rendering Loop ---
-    for (int frame_idx = 0; frame_idx < NUM_FRAMES; ++frame_idx) {
-        std::cout << "Rendering frame " << frame_idx << "..." << std::endl;
-
-        auto start_time = std::chrono::high_resolution_clock::now();
 
-        // 5. Update the pixel data in the DMA_BUF (simulating PNG decode)
-        update_dma_buf_data(WIDTH, HEIGHT, frame_idx);
-
-        // 6. Render the frame using the texture
-        render_frame(WIDTH, HEIGHT);
-
-        // In a real application, if using a window surface, you'd call:
-        // eglSwapBuffers(egl_display, egl_surface);
-        // For a pbuffer, you might read back the pixels for verification/saving.
-
-        auto end_time = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> frame_time = end_time - start_time;
-        std::cout << "Frame " << frame_idx << " time: " << frame_time.count() << " ms" << std::endl;
-
-        // Basic frame rate control (adjust as needed for your target FPS)
-        // For 60 FPS, target ~16.67ms per frame.
-        double target_ms = 1000.0 / 60.0;
-        if (frame_time.count() < target_ms) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<long long>(target_ms - frame_time.count())));
-        }
+    // "map/sync" is the per-frame cost of getting at the memory: gbm_bo_map() + gbm_bo_unmap(), or the two sync ioctls
+    for (const frame_stats &st : results) {
+        double mb = (double)WIDTH * HEIGHT * (st.format == buffer_format::argb8888 ? 4.0 : 1.5) / (1024.0 * 1024.0);
+        print_stats(st, mb);
     }
 
     cleanup();
@@ -0,0 +1,128 @@
+#include "frame_timing.h"
+
+#include <algorithm>
+#include <cmath>
+
+// --- stage_histogram ---
+// Values below 2 * sub_buckets ns get a bucket each; above that a value with its top bit at position b goes into
+// bucket (b - sub_bits) * sub_buckets + (ns >> (b - sub_bits)), i.e. its top sub_bits + 1 bits pick the bucket.
+
+stage_histogram::stage_histogram()
+    : counts((max_bits - sub_bits + 1) * sub_buckets, 0), samples(0), min_ns(0), max_ns(0), sum_ns(0) {
+}
+
+int stage_histogram::bucket_of(uint64_t ns) {
+    const uint64_t max_ns = (1ull << max_bits) - 1;
+    if (ns > max_ns) ns = max_ns;
+    int shift = 0;
+    while ((ns >> shift) >= 2 * sub_buckets) {
+        ++shift;
+    }
+    return shift * sub_buckets + (int)(ns >> shift);
+}
+
+uint64_t stage_histogram::bucket_upper_ns(int bucket) {
+    if (bucket < 2 * sub_buckets) {
+        return bucket;
+    }
+    int shift = bucket / sub_buckets - 1;
+    uint64_t mantissa = bucket - shift * sub_buckets;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void stage_histogram::add(double ms) {
+    uint64_t ns = ms > 0 ? (uint64_t)std::llround(ms * 1e6) : 0;
+    ++counts[bucket_of(ns)];
+    if (!samples || ns < min_ns) min_ns = ns;
+    if (!samples || ns > max_ns) max_ns = ns;
+    sum_ns += ns;
+    ++samples;
+}
+
+void stage_histogram::clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    samples = 0;
+    min_ns = max_ns = 0;
+    sum_ns = 0;
+}
+
+double stage_histogram::percentile_ms(double p) const {
+    if (!samples) {
+        return 0;
+    }
+    // the rank of the sample wanted, 1-based: p50 of 300 frames is the 150th fastest
+    uint64_t rank = (uint64_t)std::ceil(p / 100.0 * samples);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t ns = std::max(min_ns, std::min(max_ns, bucket_upper_ns((int)i)));
+            return ns * 1e-6;
+        }
+    }
+    return max_ms();
+}
+
+// --- fence_timer ---
+
+fence_timer::fence_timer(EGLDisplay display, PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync)
+    : display(display), client_wait_sync(client_wait_sync) {
+    thread = std::thread(&fence_timer::thread_proc, this);
+}
+
+fence_timer::~fence_timer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_one();
+    thread.join();
+}
+
+uint64_t fence_timer::watch(EGLSyncKHR fence, std::chrono::steady_clock::time_point flushed) {
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back({ fence, flushed });
+        ticket = ++watched;
+    }
+    queued.notify_one();
+    return ticket;
+}
+
+void fence_timer::wait_done(uint64_t ticket) {
+    std::unique_lock<std::mutex> lock(mutex);
+    signaled.wait(lock, [&] { return done >= ticket; });
+}
+
+stage_histogram fence_timer::take() {
+    std::unique_lock<std::mutex> lock(mutex);
+    signaled.wait(lock, [&] { return done >= watched; });
+    stage_histogram result = times;
+    times.clear();
+    return result;
+}
+
+void fence_timer::thread_proc() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        queued.wait(lock, [&] { return stopping || !pending.empty(); });
+        // everything watched gets waited for, even when stopping, so nobody is left blocked in wait_done()
+        if (pending.empty()) {
+            return;
+        }
+        pending_fence next = pending.front();
+        pending.pop_front();
+        lock.unlock();
+
+        // no FLUSH_COMMANDS: there's no context on this thread, and the render loop has flushed already
+        client_wait_sync(display, next.fence, 0, EGL_FOREVER_KHR);
+        std::chrono::duration<double, std::milli> gpu_time = std::chrono::steady_clock::now() - next.flushed;
+
+        lock.lock();
+        times.add(gpu_time.count());
+        ++done;
+        signaled.notify_all();
+    }
+}
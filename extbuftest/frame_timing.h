@@ -0,0 +1,84 @@
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// --- Histogram of one stage's per-frame times ---
+// Fixed log-linear buckets (32 per power of two of nanoseconds, so within ~3% from 32 ns up to ~18 minutes): adding a
+// sample is a few instructions and never allocates, so it can be done every frame without disturbing what's measured.
+class stage_histogram {
+public:
+    stage_histogram();
+
+    void add(double ms);
+    void clear();
+
+    int count() const { return samples; }
+    double min_ms() const { return samples ? min_ns * 1e-6 : 0; }
+    double max_ms() const { return samples ? max_ns * 1e-6 : 0; }
+    double mean_ms() const { return samples ? sum_ns * 1e-6 / samples : 0; }
+
+    // p in [0, 100]: the time that p percent of the frames took at most (to bucket precision, within min and max)
+    double percentile_ms(double p) const;
+
+private:
+    enum { sub_bits = 5, sub_buckets = 1 << sub_bits, max_bits = 40 };
+
+    static int bucket_of(uint64_t ns);
+    static uint64_t bucket_upper_ns(int bucket);
+
+    std::vector<uint32_t> counts;
+    int samples;
+    uint64_t min_ns, max_ns;
+    double sum_ns;
+};
+
+// --- How long the GPU takes with each frame ---
+// The time from a frame's fence being flushed until it signals. A thread of its own waits on the fences, in the order
+// they were submitted, so the render loop (and the ring's overlap of CPU and GPU work) isn't held up by measuring it.
+class fence_timer {
+public:
+    fence_timer(EGLDisplay display, PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync);
+    ~fence_timer();
+
+    // Starts timing a fence that has just been flushed. Returns a ticket for wait_done(); the fence must not be
+    // destroyed before wait_done() on its ticket returns.
+    uint64_t watch(EGLSyncKHR fence, std::chrono::steady_clock::time_point flushed);
+
+    // blocks until the fence with that ticket has signaled and been timed (0 = no ticket, returns at once)
+    void wait_done(uint64_t ticket);
+
+    // the times of the fences that signaled since the last call; waits for all the watched ones first
+    stage_histogram take();
+
+private:
+    struct pending_fence {
+        EGLSyncKHR fence;
+        std::chrono::steady_clock::time_point flushed;
+    };
+
+    void thread_proc();
+
+    EGLDisplay display;
+    PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync;
+
+    std::mutex mutex;
+    std::condition_variable queued, signaled;
+    std::deque<pending_fence> pending;
+    uint64_t watched = 0, done = 0;
+    bool stopping = false;
+    stage_histogram times;
+
+    std::thread thread;
+};
+
+#endif // FRAME_TIMING_H
@@ -0,0 +1,269 @@
+#include "jpeg_producer.h"
+#include "pixel_kernels.h"
+
+#include <stdio.h>      // jpeglib.h needs FILE
+#include <string.h>     // For memset()
+#include <setjmp.h>     // For setjmp(), longjmp()
+#include <jpeglib.h>
+
+// --- libjpeg error handling (longjmp back instead of exit()) ---
+struct jpeg_error_jmp {
+    struct jpeg_error_mgr mgr;
+    jmp_buf jmp;
+    char message[JMSG_LENGTH_MAX];
+};
+
+static void jpeg_error_exit(j_common_ptr cinfo) {
+    jpeg_error_jmp *err = reinterpret_cast<jpeg_error_jmp *>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, err->message);
+    longjmp(err->jmp, 1);
+}
+
+static void jpeg_no_output(j_common_ptr) {
+    // warnings (e.g. corrupt data that could still be decoded) aren't worth printing every frame
+}
+
+bool load_file(const char *path, std::vector<uint8_t> &data) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    bool ok = size > 0;
+    if (ok) {
+        data.resize(size);
+        ok = fread(data.data(), 1, size, f) == (size_t)size;
+    }
+    fclose(f);
+    return ok;
+}
+
+// Reads the header and starts decoding at the largest scale that fits width x height (fills in everything in info but
+// the position). Must be called under the caller's setjmp.
+static bool start_scaled_decompress(jpeg_decompress_struct &cinfo, J_COLOR_SPACE color_space, bool fancy_upsampling,
+                                    int width, int height, jpeg_frame_info &info, std::string &error) {
+    jpeg_read_header(&cinfo, TRUE);
+
+    info.image_width = cinfo.image_width;
+    info.image_height = cinfo.image_height;
+
+    // libjpeg scales in the DCT domain, which skips most of the IDCT work instead of throwing pixels away afterwards
+    info.scale_denom = 1;
+    while (info.scale_denom < 8 &&
+           ((int)((cinfo.image_width + info.scale_denom - 1) / info.scale_denom) > width ||
+            (int)((cinfo.image_height + info.scale_denom - 1) / info.scale_denom) > height)) {
+        info.scale_denom *= 2;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = info.scale_denom;
+    cinfo.out_color_space = color_space;
+    cinfo.do_fancy_upsampling = fancy_upsampling ? TRUE : FALSE;
+
+    jpeg_start_decompress(&cinfo);
+
+    info.width = cinfo.output_width;
+    info.height = cinfo.output_height;
+    if (info.width > width || info.height > height) {
+        error = "image is " + std::to_string(info.image_width) + "x" + std::to_string(info.image_height) +
+                ", too big for the buffer even at 1/8 scale";
+        return false;
+    }
+    return true;
+}
+
+bool decode_jpeg_into(const std::vector<uint8_t> &jpeg, uint8_t *dst, uint32_t stride, int width, int height,
+                      jpeg_frame_info &info, std::string &error) {
+    const pixel_kernels &k = select_pixel_kernels();
+    const uint32_t black = 0xFF000000u;
+
+#ifndef JCS_EXTENSIONS
+    // plain libjpeg only does RGB: one scanline of scratch, expanded into the buffer row
+    // (never in place, since reading back from a mapped dma-buf is slow)
+    std::vector<uint8_t> rgb_row(width * 3);
+#endif
+
+    struct jpeg_decompress_struct cinfo;
+    jpeg_error_jmp err;
+    cinfo.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = jpeg_error_exit;
+    err.mgr.output_message = jpeg_no_output;
+
+    if (setjmp(err.jmp)) {
+        error = err.message;
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char *>(jpeg.data()), jpeg.size());
+#ifdef JCS_EXTENSIONS
+    // libjpeg-turbo writes B, G, R, A bytes directly, which is what DRM_FORMAT_ARGB8888 is in memory
+    bool started = start_scaled_decompress(cinfo, JCS_EXT_BGRA, true, width, height, info, error);
+#else
+    bool started = start_scaled_decompress(cinfo, JCS_RGB, true, width, height, info, error);
+#endif
+    if (!started) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    info.x = (width - info.width) / 2;
+    info.y = (height - info.height) / 2;
+
+    // clear the borders around the image (rows above/below here, left/right per decoded row)
+    for (int y = 0; y < info.y; ++y) {
+        k.fill_row(dst + (size_t)y * stride, width, black);
+    }
+    for (int y = info.y + info.height; y < height; ++y) {
+        k.fill_row(dst + (size_t)y * stride, width, black);
+    }
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint8_t *row = dst + (size_t)(info.y + cinfo.output_scanline) * stride;
+        k.fill_row(row, info.x, black);
+        k.fill_row(row + (info.x + info.width) * 4, width - info.x - info.width, black);
+
+#ifdef JCS_EXTENSIONS
+        JSAMPROW out = row + info.x * 4;
+        jpeg_read_scanlines(&cinfo, &out, 1);
+#else
+        JSAMPROW out = rgb_row.data();
+        jpeg_read_scanlines(&cinfo, &out, 1);
+
+        uint8_t *argb = row + info.x * 4;
+        for (int x = 0; x < info.width; ++x) {
+            argb[x * 4 + 0] = rgb_row[x * 3 + 2];
+            argb[x * 4 + 1] = rgb_row[x * 3 + 1];
+            argb[x * 4 + 2] = rgb_row[x * 3 + 0];
+            argb[x * 4 + 3] = 255;
+        }
+#endif
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+// chroma columns [x0, x1) of chroma row y to neutral (128, i.e. no color)
+static void clear_chroma(const yuv_planes &dst, int y, int x0, int x1) {
+    uint8_t *u_row = dst.u + (size_t)y * dst.uv_stride;
+    uint8_t *v_row = dst.v + (size_t)y * dst.uv_stride;
+    for (int x = x0; x < x1; ++x) {
+        u_row[x * dst.uv_step] = 128;
+        v_row[x * dst.uv_step] = 128;
+    }
+}
+
+// the Y of every Y, Cb, Cr triplet
+static void extract_luma(uint8_t *dst, const uint8_t *ycc, int width) {
+    for (int x = 0; x < width; ++x) {
+        dst[x] = ycc[x * 3];
+    }
+}
+
+// One row of 4:2:0 chroma from two rows of triplets, each sample the average of a 2x2 block
+// (the step is a template argument so that the compiler sees a constant stride in the loop).
+template <int step>
+static void average_chroma(uint8_t *u_row, uint8_t *v_row, const uint8_t *a, const uint8_t *b, int width) {
+    int x = 0;
+    for (; x < width / 2; ++x) {
+        const uint8_t *l0 = a + x * 6, *l1 = b + x * 6;
+        u_row[x * step] = (uint8_t)((l0[1] + l0[4] + l1[1] + l1[4] + 2) >> 2);
+        v_row[x * step] = (uint8_t)((l0[2] + l0[5] + l1[2] + l1[5] + 2) >> 2);
+    }
+    if (width & 1) {
+        // odd width: the last column only has one pixel
+        const uint8_t *l0 = a + x * 6, *l1 = b + x * 6;
+        u_row[x * step] = (uint8_t)((l0[1] + l1[1] + 1) >> 1);
+        v_row[x * step] = (uint8_t)((l0[2] + l1[2] + 1) >> 1);
+    }
+}
+
+bool decode_jpeg_into_yuv(const std::vector<uint8_t> &jpeg, const yuv_planes &dst, int width, int height,
+                          jpeg_frame_info &info, std::string &error) {
+    // two scanlines of Y, Cb, Cr triplets: one row of 4:2:0 chroma is averaged from both
+    std::vector<uint8_t> rows;
+
+    struct jpeg_decompress_struct cinfo;
+    jpeg_error_jmp err;
+    cinfo.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = jpeg_error_exit;
+    err.mgr.output_message = jpeg_no_output;
+
+    if (setjmp(err.jmp)) {
+        error = err.message;
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char *>(jpeg.data()), jpeg.size());
+    // Plain (replicating) upsampling: for the usual 4:2:0 JPEG, averaging it back down gives exactly the stored chroma,
+    // while the smooth upsampling would cost time here only to be averaged away.
+    if (!start_scaled_decompress(cinfo, JCS_YCbCr, false, width, height, info, error)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    // even, so that every 2x2 block of the image shares one chroma sample
+    info.x = ((width - info.width) / 2) & ~1;
+    info.y = ((height - info.height) / 2) & ~1;
+
+    // the chroma columns and rows that the image covers
+    const int uv_x0 = info.x / 2, uv_x1 = (info.x + info.width + 1) / 2;
+    const int uv_y0 = info.y / 2, uv_y1 = (info.y + info.height + 1) / 2;
+
+    for (int y = 0; y < info.y; ++y) {
+        memset(dst.y + (size_t)y * dst.y_stride, 0, width);
+    }
+    for (int y = info.y + info.height; y < height; ++y) {
+        memset(dst.y + (size_t)y * dst.y_stride, 0, width);
+    }
+    for (int y = 0; y < height / 2; ++y) {
+        if (y < uv_y0 || y >= uv_y1) {
+            clear_chroma(dst, y, 0, width / 2);
+        }
+    }
+
+    rows.resize((size_t)info.width * 3 * 2);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        int image_y = cinfo.output_scanline;
+        JSAMPROW src[2] = { rows.data(), rows.data() + info.width * 3 };
+        int lines = 1;
+        jpeg_read_scanlines(&cinfo, &src[0], 1);
+        if (cinfo.output_scanline < cinfo.output_height) {
+            jpeg_read_scanlines(&cinfo, &src[1], 1);
+            lines = 2;
+        } else {
+            src[1] = src[0]; // odd height: the last chroma row only comes from one image row
+        }
+
+        for (int line = 0; line < lines; ++line) {
+            uint8_t *y_row = dst.y + (size_t)(info.y + image_y + line) * dst.y_stride;
+            memset(y_row, 0, info.x);
+            memset(y_row + info.x + info.width, 0, width - info.x - info.width);
+            extract_luma(y_row + info.x, src[line], info.width);
+        }
+
+        int uv_y = (info.y + image_y) / 2;
+        clear_chroma(dst, uv_y, 0, uv_x0);
+        clear_chroma(dst, uv_y, uv_x1, width / 2);
+
+        uint8_t *u_row = dst.u + (size_t)uv_y * dst.uv_stride + uv_x0 * dst.uv_step;
+        uint8_t *v_row = dst.v + (size_t)uv_y * dst.uv_stride + uv_x0 * dst.uv_step;
+        if (dst.uv_step == 2) {
+            average_chroma<2>(u_row, v_row, src[0], src[1], info.width);
+        } else {
+            average_chroma<1>(u_row, v_row, src[0], src[1], info.width);
+        }
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
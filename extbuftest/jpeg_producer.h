@@ -0,0 +1,38 @@
+#ifndef JPEG_PRODUCER_H
+#define JPEG_PRODUCER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "pixel_kernels.h"
+
+// --- Software JPEG decode straight into a mapped dma-buf ---
+// The scanlines come out of libjpeg directly in ARGB8888 (B, G, R, A bytes) and go straight into the buffer rows,
+// stride apart, without a whole-image RGBA copy in between. Together with the EGL_LINUX_DMA_BUF_EXT import this is
+// a zero-copy decode -> texture path that doesn't need OpenMAX (which mainline KMS/vc4 doesn't have).
+
+struct jpeg_frame_info {
+    int image_width = 0, image_height = 0; // as stored in the file
+    int width = 0, height = 0;             // as decoded (after DCT scaling)
+    int scale_denom = 1;                   // 1, 2, 4 or 8
+    int x = 0, y = 0;                      // where the image was put in the buffer (centered)
+};
+
+// reads a whole file, false if it can't be read
+bool load_file(const char *path, std::vector<uint8_t> &data);
+
+// Decodes into a width x height ARGB8888 buffer. The image is scaled down by the smallest of 1/2, 1/4 and 1/8
+// that makes it fit, and centered; the rest of the buffer is cleared to opaque black.
+// Only writes to dst (never reads it back), which matters for write-combined mappings.
+bool decode_jpeg_into(const std::vector<uint8_t> &jpeg, uint8_t *dst, uint32_t stride, int width, int height,
+                      jpeg_frame_info &info, std::string &error);
+
+// The same into an NV12 or YUV420 buffer (width and height even). libjpeg hands out the YCbCr it stores, so there is
+// no color conversion on the CPU at all; chroma is averaged down to 4:2:0 and the image is placed on even coordinates
+// so that it lines up with the chroma samples. The border is cleared to black (Y=0, U=V=128, full range like JPEG).
+bool decode_jpeg_into_yuv(const std::vector<uint8_t> &jpeg, const yuv_planes &dst, int width, int height,
+                          jpeg_frame_info &info, std::string &error);
+
+#endif // JPEG_PRODUCER_H
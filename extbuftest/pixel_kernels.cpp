@@ -0,0 +1,270 @@
+#include "pixel_kernels.h"
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <string.h>
+
+#if defined(__arm__)
+#include <sys/auxv.h>   // For getauxval()
+#include <asm/hwcap.h>  // For HWCAP_NEON
+#endif
+
+// --- Scalar reference kernels ---
+
+static void scalar_gradient_row(uint8_t *dst, int width, uint8_t red_start, uint8_t green, uint8_t blue) {
+    // the byte arithmetic wraps at 256 by itself, no modulo needed
+    uint8_t red = red_start;
+    for (int x = 0; x < width; ++x) {
+        dst[0] = blue;
+        dst[1] = green;
+        dst[2] = red++;
+        dst[3] = 255;
+        dst += 4;
+    }
+}
+
+static void scalar_fill_row(uint8_t *dst, int width, uint32_t value) {
+    for (int x = 0; x < width; ++x) {
+        memcpy(dst + x * 4, &value, 4); // rows aren't necessarily aligned
+    }
+}
+
+static void scalar_copy_row(uint8_t *dst, const uint8_t *src, size_t bytes) {
+    memcpy(dst, src, bytes);
+}
+
+static void scalar_swizzle_rb_row(uint8_t *dst, const uint8_t *src, int width) {
+    for (int x = 0; x < width; ++x) {
+        uint8_t first = src[0]; // (dst may be src)
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = first;
+        dst[3] = src[3];
+        dst += 4;
+        src += 4;
+    }
+}
+
+const pixel_kernels &scalar_pixel_kernels() {
+    static const pixel_kernels kernels = {
+        "scalar", scalar_gradient_row, scalar_fill_row, scalar_copy_row, scalar_swizzle_rb_row
+    };
+    return kernels;
+}
+
+// --- Runtime selection ---
+
+static bool cpu_has_sse2() {
+#if defined(__x86_64__)
+    return true; // part of the x86-64 baseline
+#elif defined(__i386__)
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+static bool cpu_has_neon() {
+#if defined(__aarch64__)
+    return true; // always there on AArch64
+#elif defined(__arm__)
+    // the Pi 1 and Zero (ARMv6) don't have it
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+    return false;
+#endif
+}
+
+const pixel_kernels &select_pixel_kernels() {
+    static const pixel_kernels *selected = nullptr;
+
+    if (!selected) {
+        selected = &scalar_pixel_kernels();
+
+        const pixel_kernels *candidates[] = {
+            cpu_has_neon() ? neon_pixel_kernels() : nullptr,
+            cpu_has_sse2() ? sse2_pixel_kernels() : nullptr,
+        };
+
+        for (const pixel_kernels *k : candidates) {
+            if (k && check_pixel_kernels(*k)) {
+                selected = k;
+                break;
+            }
+        }
+    }
+
+    return *selected;
+}
+
+// --- Checking against the scalar reference ---
+
+static bool check_failed(const pixel_kernels &k, const char *kernel, int width, int offset) {
+    std::cerr << "ERROR: " << k.name << " " << kernel << " differs from the scalar kernel (width " << width
+              << ", offset " << offset << "), not using it." << std::endl;
+    return false;
+}
+
+bool check_pixel_kernels(const pixel_kernels &k) {
+    const pixel_kernels &ref = scalar_pixel_kernels();
+    const int max_width = 75; // several vector iterations plus every possible tail
+    const int guard = 16;     // bytes after the row that must not be touched
+
+    std::vector<uint8_t> src(max_width * 4 + 8);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    std::vector<uint8_t> expected(max_width * 4 + 8 + guard), actual(expected.size());
+
+    for (int offset = 0; offset < 4; ++offset) {
+        for (int width = 0; width <= max_width; ++width) {
+            uint8_t red_start = (uint8_t)(250 + width); // wraps inside the row for most widths
+            uint8_t *e = expected.data() + offset;
+            uint8_t *a = actual.data() + offset;
+            size_t bytes = expected.size();
+
+            memset(expected.data(), 0xCD, bytes);
+            memset(actual.data(), 0xCD, bytes);
+            ref.gradient_row(e, width, red_start, 0x12, 0x34);
+            k.gradient_row(a, width, red_start, 0x12, 0x34);
+            if (memcmp(expected.data(), actual.data(), bytes) != 0) return check_failed(k, "gradient_row", width, offset);
+
+            memset(expected.data(), 0xCD, bytes);
+            memset(actual.data(), 0xCD, bytes);
+            ref.fill_row(e, width, 0x80C0FFEEu);
+            k.fill_row(a, width, 0x80C0FFEEu);
+            if (memcmp(expected.data(), actual.data(), bytes) != 0) return check_failed(k, "fill_row", width, offset);
+
+            memset(expected.data(), 0xCD, bytes);
+            memset(actual.data(), 0xCD, bytes);
+            ref.copy_row(e, src.data() + (3 - offset), width * 4);
+            k.copy_row(a, src.data() + (3 - offset), width * 4);
+            if (memcmp(expected.data(), actual.data(), bytes) != 0) return check_failed(k, "copy_row", width, offset);
+
+            memset(expected.data(), 0xCD, bytes);
+            memset(actual.data(), 0xCD, bytes);
+            ref.swizzle_rb_row(e, src.data() + (3 - offset), width);
+            k.swizzle_rb_row(a, src.data() + (3 - offset), width);
+            if (memcmp(expected.data(), actual.data(), bytes) != 0) return check_failed(k, "swizzle_rb_row", width, offset);
+
+            // in place, which is how a decoded RGBA row gets converted inside the mapped buffer
+            memcpy(a, src.data() + (3 - offset), width * 4);
+            k.swizzle_rb_row(a, a, width);
+            if (memcmp(expected.data(), actual.data(), bytes) != 0) return check_failed(k, "swizzle_rb_row (in place)", width, offset);
+        }
+    }
+
+    return true;
+}
+
+// --- Benchmark ---
+
+template <typename F>
+static void bench_kernel(const char *variant, const char *kernel, size_t bytes_per_run, F run) {
+    // enough runs for about a quarter of a second, after one warm up run
+    run(0);
+    int runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    while (elapsed.count() < 0.25) {
+        run(++runs);
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    double mb_per_s = (double)bytes_per_run * runs / elapsed.count() / (1024.0 * 1024.0);
+    std::cout << "  " << variant << " " << kernel << ": " << (int)mb_per_s << " MB/s" << std::endl;
+}
+
+void benchmark_pixel_kernels(int width, int height) {
+    // a stride with padding, like the ones GBM hands out
+    uint32_t stride = ((width * 4) + 255) & ~255u;
+    std::vector<uint8_t> dst((size_t)stride * height), src((size_t)width * 4 * height);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = (uint8_t)i;
+    }
+
+    size_t bytes = (size_t)width * 4 * height;
+    std::cout << "Kernel throughput for " << width << "x" << height << " (stride " << stride << "), selected: "
+              << select_pixel_kernels().name << std::endl;
+
+    const pixel_kernels *variants[] = {
+        &scalar_pixel_kernels(),
+        cpu_has_sse2() ? sse2_pixel_kernels() : nullptr,
+        cpu_has_neon() ? neon_pixel_kernels() : nullptr,
+    };
+
+    for (const pixel_kernels *k : variants) {
+        if (!k) continue;
+
+        bench_kernel(k->name, "gradient_row", bytes, [&](int run) {
+            fill_gradient(*k, dst.data(), stride, width, height, (uint8_t)(run * 5), (uint8_t)(run * 3), (uint8_t)(run * 10));
+        });
+        bench_kernel(k->name, "fill_row", bytes, [&](int run) {
+            for (int y = 0; y < height; ++y) k->fill_row(dst.data() + (size_t)y * stride, width, 0xFF000000u | run);
+        });
+        bench_kernel(k->name, "copy_row", bytes, [&](int) {
+            copy_rows(*k, dst.data(), stride, src.data(), width * 4, width * 4, height);
+        });
+        bench_kernel(k->name, "swizzle_rb_row", bytes, [&](int) {
+            swizzle_rows(*k, dst.data(), stride, src.data(), width * 4, width, height);
+        });
+    }
+}
+
+// --- Whole buffers ---
+
+void fill_gradient(const pixel_kernels &k, uint8_t *base, uint32_t stride, int width, int height,
+                   uint8_t red_start, uint8_t green_start, uint8_t blue) {
+    uint8_t green = green_start;
+    for (int y = 0; y < height; ++y) {
+        k.gradient_row(base, width, red_start, green++, blue);
+        base += stride;
+    }
+}
+
+void copy_rows(const pixel_kernels &k, uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride,
+               size_t row_bytes, int height) {
+    for (int y = 0; y < height; ++y) {
+        k.copy_row(dst, src, row_bytes);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+void swizzle_rows(const pixel_kernels &k, uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride,
+                  int width, int height) {
+    for (int y = 0; y < height; ++y) {
+        k.swizzle_rb_row(dst, src, width);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+void fill_gradient_yuv(const yuv_planes &dst, int width, int height, uint8_t y_start, uint8_t u_start, uint8_t v) {
+    // every luma row is the same ramp: build it once, then copy it with the copy kernel
+    std::vector<uint8_t> ramp(width);
+    for (int x = 0; x < width; ++x) {
+        ramp[x] = (uint8_t)(y_start + x);
+    }
+    const pixel_kernels &k = select_pixel_kernels();
+    for (int y = 0; y < height; ++y) {
+        k.copy_row(dst.y + (size_t)y * dst.y_stride, ramp.data(), width);
+    }
+
+    for (int y = 0; y < height / 2; ++y) {
+        uint8_t *u_row = dst.u + (size_t)y * dst.uv_stride;
+        uint8_t *v_row = dst.v + (size_t)y * dst.uv_stride;
+        uint8_t u = (uint8_t)(u_start + y);
+        if (dst.uv_step == 1) {
+            memset(u_row, u, width / 2);
+            memset(v_row, v, width / 2);
+        } else {
+            for (int x = 0; x < width / 2; ++x) {
+                u_row[x * 2] = u;
+                u_row[x * 2 + 1] = v; // v_row is u_row + 1
+            }
+        }
+    }
+}
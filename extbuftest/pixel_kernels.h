@@ -0,0 +1,71 @@
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Row kernels for filling mapped dma-buf memory ---
+// Every pixel is ARGB8888 the way DRM defines it: a little endian 32-bit word, so the bytes in memory are B, G, R, A.
+// Rows don't have to be aligned and widths don't have to be a multiple of anything; callers step rows by the buffer's stride.
+struct pixel_kernels {
+    const char *name; // "scalar", "sse2" or "neon"
+
+    // dst[x] = A=255, R=(red_start + x) mod 256, G=green, B=blue
+    void (*gradient_row)(uint8_t *dst, int width, uint8_t red_start, uint8_t green, uint8_t blue);
+
+    // every pixel = value (a native ARGB8888 word)
+    void (*fill_row)(uint8_t *dst, int width, uint32_t value);
+
+    // plain copy; the vector versions use stores that don't read the destination first,
+    // which matters for write-combined mappings
+    void (*copy_row)(uint8_t *dst, const uint8_t *src, size_t bytes);
+
+    // R, G, B, A bytes <-> ARGB8888 (B, G, R, A bytes): swaps the first and third byte of every pixel,
+    // so the same kernel converts in both directions
+    void (*swizzle_rb_row)(uint8_t *dst, const uint8_t *src, int width);
+};
+
+// the plain C++ versions, also the reference that the others are checked against
+const pixel_kernels &scalar_pixel_kernels();
+
+// nullptr when the variant wasn't compiled in (wrong architecture or compiler flags)
+const pixel_kernels *sse2_pixel_kernels();
+const pixel_kernels *neon_pixel_kernels();
+
+// The fastest variant that this CPU supports and that gives the same results as the scalar one.
+// Checked once (on first use); a variant that doesn't match is reported on stderr and not used.
+const pixel_kernels &select_pixel_kernels();
+
+// compares every kernel of k against the scalar ones over odd widths and misaligned rows
+bool check_pixel_kernels(const pixel_kernels &k);
+
+// prints the throughput of every kernel of every variant that can run here, in bytes written per second
+void benchmark_pixel_kernels(int width, int height);
+
+// --- Whole buffers (stride aware) ---
+
+// the animated test pattern: red ramps along x, green along y
+void fill_gradient(const pixel_kernels &k, uint8_t *base, uint32_t stride, int width, int height,
+                   uint8_t red_start, uint8_t green_start, uint8_t blue);
+
+// row_bytes of each row; the strides may differ
+void copy_rows(const pixel_kernels &k, uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride,
+               size_t row_bytes, int height);
+
+// tightly packed RGBA (src_stride apart) into an ARGB8888 buffer, or the other way around
+void swizzle_rows(const pixel_kernels &k, uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride,
+                  int width, int height);
+
+// --- Planar YUV 4:2:0 buffers ---
+// NV12 is a Y plane followed by one plane of interleaved U, V byte pairs; YUV420 has separate U and V planes.
+// Chroma is half the width and half the height of luma either way, so a pixel is 1.5 bytes instead of ARGB8888's 4.
+struct yuv_planes {
+    uint8_t *y, *u, *v;          // for NV12, v = u + 1
+    uint32_t y_stride, uv_stride;
+    int uv_step;                 // bytes from one chroma sample to the next: 2 for NV12, 1 for YUV420
+};
+
+// the YUV version of fill_gradient: luma ramps along x, U along y, V is constant (width and height must be even)
+void fill_gradient_yuv(const yuv_planes &dst, int width, int height, uint8_t y_start, uint8_t u_start, uint8_t v);
+
+#endif // PIXEL_KERNELS_H
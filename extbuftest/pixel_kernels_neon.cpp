@@ -0,0 +1,97 @@
+#include "pixel_kernels.h"
+
+// On 32-bit ARM this file has to be built with -mfpu=neon (see buildnrun.sh); the rest of the program
+// isn't, so it still runs on the ARMv6 Pis, where select_pixel_kernels() never calls in here.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+#include <string.h>
+
+// --- NEON kernels (16 pixels per iteration, de-interleaved into B, G, R, A planes) ---
+
+static void neon_gradient_row(uint8_t *dst, int width, uint8_t red_start, uint8_t green, uint8_t blue) {
+    static const uint8_t ramp[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+    uint8x16x4_t p;
+    p.val[0] = vdupq_n_u8(blue);
+    p.val[1] = vdupq_n_u8(green);
+    p.val[2] = vaddq_u8(vdupq_n_u8(red_start), vld1q_u8(ramp)); // wraps at 256 like the scalar code
+    p.val[3] = vdupq_n_u8(255);
+    const uint8x16_t step = vdupq_n_u8(16);
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        vst4q_u8(dst + x * 4, p); // interleaves the planes back into B, G, R, A bytes
+        p.val[2] = vaddq_u8(p.val[2], step);
+    }
+
+    for (; x < width; ++x) {
+        dst[x * 4 + 0] = blue;
+        dst[x * 4 + 1] = green;
+        dst[x * 4 + 2] = (uint8_t)(red_start + x);
+        dst[x * 4 + 3] = 255;
+    }
+}
+
+static void neon_fill_row(uint8_t *dst, int width, uint32_t value) {
+    const uint8x16_t v = vreinterpretq_u8_u32(vdupq_n_u32(value));
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        vst1q_u8(dst + x * 4, v);
+    }
+    for (; x < width; ++x) {
+        memcpy(dst + x * 4, &value, 4);
+    }
+}
+
+static void neon_copy_row(uint8_t *dst, const uint8_t *src, size_t bytes) {
+    // full 64-byte blocks only ever write whole lines, which a write-combined mapping handles best
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64) {
+        uint8x16_t a = vld1q_u8(src + i);
+        uint8x16_t b = vld1q_u8(src + i + 16);
+        uint8x16_t c = vld1q_u8(src + i + 32);
+        uint8x16_t d = vld1q_u8(src + i + 48);
+        vst1q_u8(dst + i, a);
+        vst1q_u8(dst + i + 16, b);
+        vst1q_u8(dst + i + 32, c);
+        vst1q_u8(dst + i + 48, d);
+    }
+
+    memcpy(dst + i, src + i, bytes - i);
+}
+
+static void neon_swizzle_rb_row(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t p = vld4q_u8(src + x * 4);
+        uint8x16_t first = p.val[0];
+        p.val[0] = p.val[2];
+        p.val[2] = first;
+        vst4q_u8(dst + x * 4, p);
+    }
+
+    for (; x < width; ++x) {
+        uint8_t first = src[x * 4];
+        dst[x * 4 + 0] = src[x * 4 + 2];
+        dst[x * 4 + 1] = src[x * 4 + 1];
+        dst[x * 4 + 2] = first;
+        dst[x * 4 + 3] = src[x * 4 + 3];
+    }
+}
+
+const pixel_kernels *neon_pixel_kernels() {
+    static const pixel_kernels kernels = {
+        "neon", neon_gradient_row, neon_fill_row, neon_copy_row, neon_swizzle_rb_row
+    };
+    return &kernels;
+}
+
+#else
+
+const pixel_kernels *neon_pixel_kernels() {
+    return nullptr;
+}
+
+#endif // __ARM_NEON
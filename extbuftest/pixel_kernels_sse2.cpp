@@ -0,0 +1,122 @@
+#include "pixel_kernels.h"
+
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+#include <string.h>
+
+// --- SSE2 kernels (4 pixels per 128-bit register) ---
+
+static void sse2_gradient_row(uint8_t *dst, int width, uint8_t red_start, uint8_t green, uint8_t blue) {
+    int x = 0;
+
+    // 16 pixels per iteration: the red bytes of 16 pixels live in one register and step by 16 with a
+    // byte add (which wraps at 256 like the scalar code), then get widened into place in 4 ARGB words
+    const __m128i constant = _mm_set1_epi32((int)(0xFF000000u | ((uint32_t)green << 8) | blue));
+    const __m128i step = _mm_set1_epi8(16);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i red = _mm_add_epi8(_mm_set1_epi8((char)red_start),
+                               _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i red_lo = _mm_unpacklo_epi8(red, zero); // 8 x 16-bit
+        __m128i red_hi = _mm_unpackhi_epi8(red, zero);
+
+        __m128i p0 = _mm_or_si128(constant, _mm_slli_epi32(_mm_unpacklo_epi16(red_lo, zero), 16));
+        __m128i p1 = _mm_or_si128(constant, _mm_slli_epi32(_mm_unpackhi_epi16(red_lo, zero), 16));
+        __m128i p2 = _mm_or_si128(constant, _mm_slli_epi32(_mm_unpacklo_epi16(red_hi, zero), 16));
+        __m128i p3 = _mm_or_si128(constant, _mm_slli_epi32(_mm_unpackhi_epi16(red_hi, zero), 16));
+
+        _mm_storeu_si128((__m128i *)(dst + x * 4), p0);
+        _mm_storeu_si128((__m128i *)(dst + x * 4 + 16), p1);
+        _mm_storeu_si128((__m128i *)(dst + x * 4 + 32), p2);
+        _mm_storeu_si128((__m128i *)(dst + x * 4 + 48), p3);
+
+        red = _mm_add_epi8(red, step);
+    }
+
+    uint32_t fixed = 0xFF000000u | ((uint32_t)green << 8) | blue;
+    for (; x < width; ++x) {
+        uint32_t pixel = fixed | ((uint32_t)(uint8_t)(red_start + x) << 16);
+        memcpy(dst + x * 4, &pixel, 4);
+    }
+}
+
+static void sse2_fill_row(uint8_t *dst, int width, uint32_t value) {
+    const __m128i v = _mm_set1_epi32((int)value);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        _mm_storeu_si128((__m128i *)(dst + x * 4), v);
+    }
+    for (; x < width; ++x) {
+        memcpy(dst + x * 4, &value, 4);
+    }
+}
+
+static void sse2_copy_row(uint8_t *dst, const uint8_t *src, size_t bytes) {
+    // streaming stores need 16-byte aligned destinations; short rows aren't worth the setup
+    if (bytes < 64) {
+        memcpy(dst, src, bytes);
+        return;
+    }
+
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    bytes -= head;
+
+    // non-temporal: doesn't pull the destination into the cache just to overwrite it
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+        _mm_stream_si128((__m128i *)(dst + i), a);
+        _mm_stream_si128((__m128i *)(dst + i + 16), b);
+        _mm_stream_si128((__m128i *)(dst + i + 32), c);
+        _mm_stream_si128((__m128i *)(dst + i + 48), d);
+    }
+    _mm_sfence(); // the streamed data has to be visible before the GPU reads the buffer
+
+    memcpy(dst + i, src + i, bytes - i);
+}
+
+static void sse2_swizzle_rb_row(uint8_t *dst, const uint8_t *src, int width) {
+    // per 32-bit word: keep bytes 1 and 3, swap bytes 0 and 2 (a 16-bit rotate of the other two)
+    const __m128i keep = _mm_set1_epi32((int)0xFF00FF00u);
+    const __m128i swap = _mm_set1_epi32(0x00FF00FF);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+        __m128i rb = _mm_and_si128(v, swap);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_or_si128(_mm_and_si128(v, keep), rb));
+    }
+
+    for (; x < width; ++x) {
+        uint8_t first = src[x * 4];
+        dst[x * 4 + 0] = src[x * 4 + 2];
+        dst[x * 4 + 1] = src[x * 4 + 1];
+        dst[x * 4 + 2] = first;
+        dst[x * 4 + 3] = src[x * 4 + 3];
+    }
+}
+
+const pixel_kernels *sse2_pixel_kernels() {
+    static const pixel_kernels kernels = {
+        "sse2", sse2_gradient_row, sse2_fill_row, sse2_copy_row, sse2_swizzle_rb_row
+    };
+    return &kernels;
+}
+
+#else
+
+const pixel_kernels *sse2_pixel_kernels() {
+    return nullptr;
+}
+
+#endif // __SSE2__
@@ -4,31 +4,126 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <pthread.h>
 
 #include <interface/mmal/mmal.h>
 #include <interface/mmal/util/mmal_util.h>
 
-static volatile int jpeg_done = 0;
+static int jpeg_done = 0;
+static int format_seen = 0;              /* MMAL_EVENT_FORMAT_CHANGED arrived */
 static FILE *out_fp = NULL;
 
+/* the callbacks broadcast ev_cv on everything the loader waits for */
+static pthread_mutex_t ev_mx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  ev_cv = PTHREAD_COND_INITIALIZER;
+
+/* absolute CLOCK_REALTIME deadline for pthread_cond_timedwait */
+static void deadline_in(struct timespec *ts, int ms)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec  += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) { ts->tv_sec++; ts->tv_nsec -= 1000000000L; }
+}
+
+/* MMAL_EVENT_FORMAT_CHANGED, on the control port or the output port:
+ * the decoder has parsed the header and found the real output format */
+static void format_event(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buf)
+{
+    if (buf->cmd == MMAL_EVENT_FORMAT_CHANGED) {
+        MMAL_EVENT_FORMAT_CHANGED_T *ev = mmal_event_format_changed_get(buf);
+        pthread_mutex_lock(&ev_mx);
+        if (ev) {
+            mmal_format_full_copy(port->component->output[0]->format, ev->format);
+            format_seen = 1;
+        }
+        pthread_cond_broadcast(&ev_cv);
+        pthread_mutex_unlock(&ev_mx);
+    }
+}
+
+static void control_cb(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buf)
+{
+    format_event(port, buf);
+    mmal_buffer_header_release(buf);
+}
+
+/* buffers go back to their pool first and the loader is woken after, so
+ * it can't check a pool, miss the buffer and then sleep through the wake */
+static void wake_loader(void)
+{
+    pthread_mutex_lock(&ev_mx);
+    pthread_cond_broadcast(&ev_cv);
+    pthread_mutex_unlock(&ev_mx);
+}
+
+/* input buffers the decoder is done with go back to the pool */
+static void input_cb(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buf)
+{
+    (void)port;
+    mmal_buffer_header_release(buf);
+    wake_loader();
+}
+
 /* called for every buffer on decoder output port */
 static void jpeg_buffer_cb(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buf)
 {
-    if (buf->length) {
+    if (buf->cmd) {                      /* an event, not data */
+        format_event(port, buf);
+        mmal_buffer_header_release(buf);
+        return;
+    }
+    if (buf->length && out_fp) {
         mmal_buffer_header_mem_lock(buf);
         fwrite(buf->data, 1, buf->length, out_fp);
         mmal_buffer_header_mem_unlock(buf);
     }
-    if (buf->flags & MMAL_BUFFER_HEADER_FLAG_EOS)
+    if (buf->flags & MMAL_BUFFER_HEADER_FLAG_EOS) {
+        pthread_mutex_lock(&ev_mx);
         jpeg_done = 1;
-    mmal_buffer_header_release(buf);
+        pthread_mutex_unlock(&ev_mx);
+    }
+    mmal_buffer_header_release(buf);     /* back to out_pool for the loader to resend */
+    wake_loader();
+}
+
+/* hand the decoder every free output buffer */
+static void send_output_buffers(MMAL_PORT_T *out, MMAL_POOL_T *pool)
+{
+    MMAL_BUFFER_HEADER_T *b;
+    while ((b = mmal_queue_get(pool->queue)))
+        if (mmal_port_send_buffer(out, b)) { mmal_buffer_header_release(b); break; }
+}
+
+/* the header has been parsed: commit the real output format and give the
+ * decoder something to decode into */
+static MMAL_POOL_T *configure_output(MMAL_PORT_T *out)
+{
+    MMAL_STATUS_T st;
+    mmal_port_disable(out);
+    if ((st = mmal_port_format_commit(out))) {
+      fprintf(stderr,"dec_out commit failed %d\n",st);
+      return NULL;
+    }
+    MMAL_POOL_T *pool = mmal_port_pool_create(
+      out,
+      out->buffer_num_recommended,
+      out->buffer_size_recommended
+    );
+    if (!pool) { fprintf(stderr,"dec_out pool\n"); return NULL; }
+    mmal_port_enable(out, jpeg_buffer_cb);
+    send_output_buffers(out, pool);
+    return pool;
 }
 
 static void *loader(void *arg)
 {
     const char *infile  = arg;
     const char *outfile = "out.jpg";
+    MMAL_POOL_T *in_pool = NULL, *out_pool = NULL;
 
     /* 0) read the entire JPEG into RAM */
     FILE *fp = fopen(infile, "rb");
@@ -44,58 +139,98 @@ static void *loader(void *arg)
     MMAL_COMPONENT_T *dec = NULL;
     MMAL_STATUS_T st = mmal_component_create("vc.ril.image_decode", &dec);
     if (st) { fprintf(stderr,"can't create decode %d\n",st); goto cleanup; }
+    mmal_port_enable(dec->control, control_cb);
     mmal_component_enable(dec);
 
     MMAL_PORT_T *dec_in  = dec->input[0];
     MMAL_PORT_T *dec_out = dec->output[0];
 
-    /* 2) enable zero-copy & wait for the firmware to fill in width/height */
+    /* 2) input pool; zero-copy output, enabled so it can report the format */
+    in_pool = mmal_port_pool_create(
+      dec_in,
+      dec_in->buffer_num_recommended,
+      dec_in->buffer_size_recommended
+    );
+    if (!in_pool) { fprintf(stderr,"dec_in pool\n"); goto cleanup; }
     mmal_port_parameter_set_boolean(dec_out, MMAL_PARAMETER_ZERO_COPY, 1);
-    mmal_port_enable(dec_out, NULL);
-    for(int i=0; i<200 && !dec_out->format->es->video.width; ++i)
-        usleep(10000);
-    mmal_port_disable(dec_out);
-
-    /* 3) commit the real output format */
-    if ((st = mmal_port_format_commit(dec_out))) {
-      fprintf(stderr,"dec_out commit failed %d\n",st);
-      goto cleanup;
-    }
+    mmal_port_enable(dec_in, input_cb);
+    mmal_port_enable(dec_out, jpeg_buffer_cb);
 
-    /* 4) open the output file */
+    /* 3) open the output file */
     out_fp = fopen(outfile,"wb");
     if (!out_fp) { perror(outfile); goto cleanup; }
 
-    /* 5) create a buffer pool & hook our callback */
-    MMAL_POOL_T *pool = mmal_port_pool_create(
-      dec_out,
-      dec_out->buffer_num_recommended,
-      dec_out->buffer_size_recommended
-    );
-    mmal_port_enable(dec_out, jpeg_buffer_cb);
-
-    /* 6) push your JPEG data into the decoder */
+    /* 4) push your JPEG data into the decoder. Its output format arrives as
+     *    soon as the first buffer's header is parsed, and the output side is
+     *    set up right then, in between input buffers */
     uint8_t *ptr = in_buf;
     long left = sz;
-    while(left) {
-      MMAL_BUFFER_HEADER_T *b = mmal_queue_get(pool->queue);
-      if (!b) { usleep(1000); continue; }
-      int copy = left < b->alloc_size ? left : b->alloc_size;
-      mmal_buffer_header_mem_lock(b);
-      memcpy(b->data, ptr, copy);
-      mmal_buffer_header_mem_unlock(b);
-      b->length = copy;
-      ptr += copy;
-      left -= copy;
-      if (!left) b->flags = MMAL_BUFFER_HEADER_FLAG_EOS;
-      mmal_port_send_buffer(dec_in, b);
+    while (left || !out_pool) {
+      pthread_mutex_lock(&ev_mx);
+      int have_format = format_seen;
+      pthread_mutex_unlock(&ev_mx);
+      if (have_format && !out_pool && !(out_pool = configure_output(dec_out)))
+        goto cleanup;
+      if (out_pool) send_output_buffers(dec_out, out_pool);
+
+      MMAL_BUFFER_HEADER_T *b = left ? mmal_queue_get(in_pool->queue) : NULL;
+      if (b) {
+        int copy = left < b->alloc_size ? left : b->alloc_size;
+        mmal_buffer_header_mem_lock(b);
+        memcpy(b->data, ptr, copy);
+        mmal_buffer_header_mem_unlock(b);
+        b->length = copy;
+        ptr += copy;
+        left -= copy;
+        if (!left) b->flags = MMAL_BUFFER_HEADER_FLAG_EOS;
+        mmal_port_send_buffer(dec_in, b);
+        continue;
+      }
+
+      /* sleep until input_cb gives a buffer back or the format arrives */
+      struct timespec dl; deadline_in(&dl, 2000);
+      int timed_out = 0;
+      pthread_mutex_lock(&ev_mx);
+      while (!(left && mmal_queue_length(in_pool->queue)) &&
+             !(format_seen && !out_pool) &&
+             !(out_pool && mmal_queue_length(out_pool->queue)))
+        if (pthread_cond_timedwait(&ev_cv, &ev_mx, &dl) == ETIMEDOUT) {
+          timed_out = 1;
+          break;
+        }
+      pthread_mutex_unlock(&ev_mx);
+      if (timed_out) {
+        fprintf(stderr, out_pool ? "decoder stalled\n"
+                                 : "no output format from the decoder\n");
+        goto cleanup;
+      }
     }
 
-    /* 7) spin until EOS arrives in our callback */
-    while(!jpeg_done) usleep(1000);
+    /* 5) sleep until EOS arrives in our callback, recycling output buffers */
+    {
+        struct timespec dl; deadline_in(&dl, 5000);
+        pthread_mutex_lock(&ev_mx);
+        while (!jpeg_done) {
+            if (mmal_queue_length(out_pool->queue)) {
+                pthread_mutex_unlock(&ev_mx);
+                send_output_buffers(dec_out, out_pool);
+                pthread_mutex_lock(&ev_mx);
+                continue;
+            }
+            if (pthread_cond_timedwait(&ev_cv, &ev_mx, &dl) == ETIMEDOUT) break;
+        }
+        if (!jpeg_done) fprintf(stderr,"no EOS from the decoder\n");
+        pthread_mutex_unlock(&ev_mx);
+    }
 
 cleanup:
-    if (dec) mmal_component_destroy(dec);
+    if (dec) {
+        if (dec->input[0]->is_enabled)  mmal_port_disable(dec->input[0]);
+        if (dec->output[0]->is_enabled) mmal_port_disable(dec->output[0]);
+        if (in_pool)  mmal_port_pool_destroy(dec->input[0], in_pool);
+        if (out_pool) mmal_port_pool_destroy(dec->output[0], out_pool);
+        mmal_component_destroy(dec);
+    }
     free(in_buf);
     if (out_fp) fclose(out_fp);
     return NULL;
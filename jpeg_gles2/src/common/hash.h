@@ -0,0 +1,58 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "datatypes.h"
+#include <string.h>	// for memcpy
+
+// Fast non-cryptographic 64-bit hash (MurmurHash64A) used to identify buffers by their contents.
+// It consumes 8 bytes per step so hashing a compressed image is far cheaper than decoding it.
+inline uint64_t HashBytes64(const uint8_t *p8Data, size_t stSizeBytes, uint64_t u64Seed = 0)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+
+	uint64_t h = u64Seed ^ (stSizeBytes * m);
+
+	const uint8_t *p8End = p8Data + (stSizeBytes & ~((size_t) 7));
+
+	while (p8Data != p8End)
+	{
+		uint64_t k;
+		memcpy(&k, p8Data, sizeof(k));	// memcpy so that unaligned buffers are safe on ARM
+		p8Data += 8;
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	// remaining 0-7 bytes
+	switch (stSizeBytes & 7)
+	{
+	case 7: h ^= uint64_t(p8Data[6]) << 48;
+	case 6: h ^= uint64_t(p8Data[5]) << 40;
+	case 5: h ^= uint64_t(p8Data[4]) << 32;
+	case 4: h ^= uint64_t(p8Data[3]) << 24;
+	case 3: h ^= uint64_t(p8Data[2]) << 16;
+	case 2: h ^= uint64_t(p8Data[1]) << 8;
+	case 1: h ^= uint64_t(p8Data[0]);
+		h *= m;
+	};
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+// Hashes a NUL terminated string (NULL hashes like ""). Chain several strings by passing each result as the next seed.
+inline uint64_t HashString64(const char *cpszText, uint64_t u64Seed = 0)
+{
+	return HashBytes64((const uint8_t *) cpszText, cpszText ? strlen(cpszText) : 0, u64Seed);
+}
+
+#endif // HASH_H
@@ -0,0 +1,141 @@
+#include "AtlasPacker.h"
+
+AtlasPacker::AtlasPacker(unsigned int uWidth, unsigned int uHeight) :
+m_uWidth(uWidth),
+m_uHeight(uHeight),
+m_uUsedArea(0)
+{
+	Rect r = { 0, 0, uWidth, uHeight };
+	m_vFree.push_back(r);
+}
+
+bool AtlasPacker::Insert(unsigned int uWidth, unsigned int uHeight, unsigned int *puX, unsigned int *puY)
+{
+	int iBest = -1;
+	unsigned int uBestShortSide = 0, uBestLongSide = 0;
+
+	// best short side fit: the free rectangle that leaves the least room along its tighter side
+	for (unsigned int u = 0; u < m_vFree.size(); u++)
+	{
+		const Rect &r = m_vFree[u];
+
+		if ((r.uWidth < uWidth) || (r.uHeight < uHeight))
+		{
+			continue;
+		}
+
+		unsigned int uLeftoverX = r.uWidth - uWidth;
+		unsigned int uLeftoverY = r.uHeight - uHeight;
+		unsigned int uShortSide = (uLeftoverX < uLeftoverY) ? uLeftoverX : uLeftoverY;
+		unsigned int uLongSide = (uLeftoverX < uLeftoverY) ? uLeftoverY : uLeftoverX;
+
+		if ((iBest == -1) || (uShortSide < uBestShortSide) || ((uShortSide == uBestShortSide) && (uLongSide < uBestLongSide)))
+		{
+			iBest = (int) u;
+			uBestShortSide = uShortSide;
+			uBestLongSide = uLongSide;
+		}
+	}
+
+	if (iBest == -1)
+	{
+		return false;
+	}
+
+	Rect free = m_vFree[iBest];
+	m_vFree.erase(m_vFree.begin() + iBest);
+
+	*puX = free.uX;
+	*puY = free.uY;
+	m_uUsedArea += uWidth * uHeight;
+
+	// split what is left along the shorter leftover side so that the bigger leftover piece stays as big as possible
+	Rect right, bottom;
+	right.uX = free.uX + uWidth;
+	right.uY = free.uY;
+	right.uWidth = free.uWidth - uWidth;
+	bottom.uX = free.uX;
+	bottom.uY = free.uY + uHeight;
+	bottom.uHeight = free.uHeight - uHeight;
+
+	if (right.uWidth < bottom.uHeight)
+	{
+		right.uHeight = uHeight;
+		bottom.uWidth = free.uWidth;
+	}
+	else
+	{
+		right.uHeight = free.uHeight;
+		bottom.uWidth = uWidth;
+	}
+
+	if ((right.uWidth != 0) && (right.uHeight != 0))
+	{
+		m_vFree.push_back(right);
+	}
+
+	if ((bottom.uWidth != 0) && (bottom.uHeight != 0))
+	{
+		m_vFree.push_back(bottom);
+	}
+
+	return true;
+}
+
+void AtlasPacker::Free(unsigned int uX, unsigned int uY, unsigned int uWidth, unsigned int uHeight)
+{
+	m_uUsedArea -= uWidth * uHeight;
+
+	// nothing left so start over with one big rectangle
+	if (m_uUsedArea == 0)
+	{
+		m_vFree.clear();
+		Rect r = { 0, 0, m_uWidth, m_uHeight };
+		m_vFree.push_back(r);
+		return;
+	}
+
+	Rect r = { uX, uY, uWidth, uHeight };
+	m_vFree.push_back(r);
+	MergeFree();
+}
+
+void AtlasPacker::MergeFree()
+{
+	bool bMerged = true;
+
+	while (bMerged)
+	{
+		bMerged = false;
+
+		for (unsigned int i = 0; (i < m_vFree.size()) && !bMerged; i++)
+		{
+			for (unsigned int j = i + 1; j < m_vFree.size(); j++)
+			{
+				Rect &a = m_vFree[i];
+				const Rect &b = m_vFree[j];
+
+				// same columns, one directly above the other
+				if ((a.uX == b.uX) && (a.uWidth == b.uWidth) && ((a.uY + a.uHeight == b.uY) || (b.uY + b.uHeight == a.uY)))
+				{
+					a.uY = (a.uY < b.uY) ? a.uY : b.uY;
+					a.uHeight += b.uHeight;
+					bMerged = true;
+				}
+				// same rows, side by side
+				else if ((a.uY == b.uY) && (a.uHeight == b.uHeight) && ((a.uX + a.uWidth == b.uX) || (b.uX + b.uWidth == a.uX)))
+				{
+					a.uX = (a.uX < b.uX) ? a.uX : b.uX;
+					a.uWidth += b.uWidth;
+					bMerged = true;
+				}
+
+				if (bMerged)
+				{
+					m_vFree.erase(m_vFree.begin() + j);
+					break;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef ATLASPACKER_H
+#define ATLASPACKER_H
+
+#include <vector>
+
+using namespace std;
+
+// Guillotine rectangle packer for one atlas page.
+// Keeps a list of free rectangles; each insert goes in the free rectangle that it fits best and the leftover
+//  space is split in two along the shorter leftover side.
+// Freed rectangles go back on the list and are merged with free neighbors that share a whole edge with them,
+//  so pages don't fragment forever when images come and go.
+// Pure bookkeeping (no GL calls).
+class AtlasPacker
+{
+public:
+	AtlasPacker(unsigned int uWidth, unsigned int uHeight);
+
+	// finds room for a uWidth x uHeight rectangle, returns false if there isn't any
+	bool Insert(unsigned int uWidth, unsigned int uHeight, unsigned int *puX, unsigned int *puY);
+
+	// gives back a rectangle that was returned by Insert
+	void Free(unsigned int uX, unsigned int uY, unsigned int uWidth, unsigned int uHeight);
+
+	bool IsEmpty() const { return m_uUsedArea == 0; }
+	unsigned int GetUsedArea() const { return m_uUsedArea; }
+	unsigned int GetFreeRectCount() const { return (unsigned int) m_vFree.size(); }
+
+private:
+	struct Rect
+	{
+		unsigned int uX, uY, uWidth, uHeight;
+	};
+
+	// merges pairs of free rectangles that make up a bigger rectangle until there are none left
+	void MergeFree();
+
+	unsigned int m_uWidth, m_uHeight;
+	unsigned int m_uUsedArea;
+	vector<Rect> m_vFree;
+};
+
+#endif // ATLASPACKER_H
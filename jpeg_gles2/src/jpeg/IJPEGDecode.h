@@ -19,6 +19,34 @@ public:
 
 	// blocks until background JPEG decompression is finished.
 	virtual bool WaitJPEGDecompressorReady() = 0;
+
+	// returns true once WaitJPEGDecompressorReady would return without blocking,
+	//  so that a render loop can keep drawing frames while a decode is in progress instead of stalling on it
+	virtual bool IsJPEGDecompressorReady() = 0;
+
+	// decode at 1/uScaleDenom of the full size (1, 2, 4 or 8). Takes effect on the next decode.
+	virtual void SetOutputScale(unsigned int uScaleDenom) = 0;
+
+	// picks the largest reduction (up to 1/8) that still leaves the image at least this big, overriding SetOutputScale.
+	// 0x0 turns this off.
+	virtual void SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight) = 0;
+
+	// returns the EGL image that the last decode went into (0 if nothing has been decoded yet)
+	virtual void *GetEGLImage() = 0;
+
+	// hands the current EGL image over to the caller (who must free it with IVideoObjectEGLImage::DeleteEGLImage)
+	//  so that the next decode goes into a new EGL image instead of overwriting it.
+	virtual void DetachEGLImage() = 0;
+
+	// returns the dimensions of the last decoded image
+	virtual void GetDimensions(unsigned int *puWidth, unsigned int *puHeight) = 0;
+
+	// Asks for the next decodes to be shown as Y, Cb and Cr planes (converted to RGB by the shader) instead of an RGBA EGL image.
+	// Returns false if this decoder can only produce RGBA.
+	virtual bool SetOutputYUV(bool bYUV) = 0;
+
+	// returns how many bytes of texture memory the last decoded image takes up
+	virtual size_t GetImageBytes() = 0;
 };
 
 typedef shared_ptr<IJPEGDecode> IJPEGDecodeSPtr;
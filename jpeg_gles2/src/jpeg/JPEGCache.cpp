@@ -0,0 +1,260 @@
+#include "JPEGCache.h"
+#include "../common/hash.h"
+
+IJPEGDecodeSPtr JPEGCache::GetInstance(IJPEGDecode *pDecoder, IVideoObjectEGLImage *pEGLImage, size_t stBudgetBytes, ILogger *pLogger)
+{
+	return IJPEGDecodeSPtr(new JPEGCache(pDecoder, pEGLImage, stBudgetBytes, pLogger), JPEGCache::deleter());
+}
+
+void JPEGCache::SetInputBufSizeHint(size_t stInputBufSizeBytes)
+{
+	m_pDecoder->SetInputBufSizeHint(stInputBufSizeBytes);
+}
+
+bool JPEGCache::DecompressJPEGStart(const uint8_t *p8SrcJpeg, size_t stSizeBytes)
+{
+	uint64_t u64Hash = HashBytes64(p8SrcJpeg, stSizeBytes, m_u64ScaleSeed);
+
+	EntryMap::iterator mi = m_mapEntries.find(u64Hash);
+
+	if ((mi != m_mapEntries.end()) && (mi->second->stCompressedBytes == stSizeBytes))
+	{
+		// move to the front so it becomes the most recently used
+		m_lstEntries.splice(m_lstEntries.begin(), m_lstEntries, mi->second);
+		m_pCurrent = &m_lstEntries.front();
+
+		if (m_pCurrent->eglImage != m_pShownImage)
+		{
+			m_pIEGLImage->SetDisplayEGLImage(m_pCurrent->eglImage);
+			m_pShownImage = m_pCurrent->eglImage;
+		}
+
+		m_uHits++;
+		m_bPendingHit = true;
+		return true;
+	}
+
+	m_uMisses++;
+
+	// make the decoder go to a new EGL image so that whatever we have already cached is left alone
+	m_pDecoder->DetachEGLImage();
+
+	bool bRes = m_pDecoder->DecompressJPEGStart(p8SrcJpeg, stSizeBytes);
+
+	if (bRes)
+	{
+		m_bPendingMiss = true;
+		m_u64PendingHash = u64Hash;
+		m_stPendingCompressedBytes = stSizeBytes;
+	}
+
+	return bRes;
+}
+
+bool JPEGCache::WaitJPEGDecompressorReady()
+{
+	bool bRes = false;
+
+	if (m_bPendingHit)
+	{
+		m_bPendingHit = false;
+		return true;
+	}
+
+	if (!m_bPendingMiss)
+	{
+		m_pLogger->Log("JPEGCache::WaitJPEGDecompressorReady: Not decoding");
+		return false;
+	}
+
+	m_bPendingMiss = false;
+
+	bRes = m_pDecoder->WaitJPEGDecompressorReady();
+
+	void *eglImage = m_pDecoder->GetEGLImage();
+
+	// the decoder may have gone back into an image we already cache (if it couldn't detach), which now holds the new
+	//  picture (or garbage), so the entry for what it used to hold must go before the new one is entered below
+	if ((eglImage != 0) && (eglImage == m_pLastDecoded))
+	{
+		Forget(eglImage);
+	}
+	m_pLastDecoded = eglImage;
+
+	// if decoding failed, the image contents are garbage so don't keep them around
+	if (!bRes)
+	{
+		// and what the screen shows now is up to the decoder
+		m_pShownImage = 0;
+
+		if (eglImage != 0)
+		{
+			m_pDecoder->DetachEGLImage();
+			m_pIEGLImage->DeleteEGLImage(eglImage);
+			m_pLastDecoded = 0;
+		}
+		return false;
+	}
+
+	CacheEntry entry;
+	entry.u64Hash = m_u64PendingHash;
+	entry.stCompressedBytes = m_stPendingCompressedBytes;
+	entry.eglImage = eglImage;
+	m_pDecoder->GetDimensions(&entry.uWidth, &entry.uHeight);
+	entry.stDecodedBytes = (size_t) entry.uWidth * entry.uHeight * 4;	// RGBA
+
+	// a colliding entry (same hash, different size) gets replaced
+	EntryMap::iterator mi = m_mapEntries.find(entry.u64Hash);
+	if (mi != m_mapEntries.end())
+	{
+		CacheEntry &old = *mi->second;
+		if (old.eglImage == m_pShownImage)
+		{
+			m_pShownImage = 0;
+		}
+		m_pIEGLImage->DeleteEGLImage(old.eglImage);
+		m_stBytesUsed -= old.stDecodedBytes;
+		m_lstEntries.erase(mi->second);
+		m_mapEntries.erase(mi);
+	}
+
+	m_lstEntries.push_front(entry);
+	m_mapEntries[entry.u64Hash] = m_lstEntries.begin();
+	m_stBytesUsed += entry.stDecodedBytes;
+	m_pCurrent = &m_lstEntries.front();
+
+	// the decoder has published it, so it is what the next frame shows
+	m_pShownImage = eglImage;
+
+	Evict();
+
+	return true;
+}
+
+void JPEGCache::SetOutputScale(unsigned int uScaleDenom)
+{
+	m_uScaleDenom = uScaleDenom;
+	m_u64ScaleSeed = ((uint64_t) m_uScaleDenom << 48) | ((uint64_t) m_uTargetWidth << 24) | m_uTargetHeight;
+	m_pDecoder->SetOutputScale(uScaleDenom);
+}
+
+void JPEGCache::SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight)
+{
+	m_uTargetWidth = uWidth;
+	m_uTargetHeight = uHeight;
+	m_u64ScaleSeed = ((uint64_t) m_uScaleDenom << 48) | ((uint64_t) m_uTargetWidth << 24) | m_uTargetHeight;
+	m_pDecoder->SetOutputTargetSize(uWidth, uHeight);
+}
+
+void *JPEGCache::GetEGLImage()
+{
+	void *pRes = 0;
+
+	if (m_pCurrent)
+	{
+		pRes = m_pCurrent->eglImage;
+	}
+
+	return pRes;
+}
+
+void JPEGCache::GetDimensions(unsigned int *puWidth, unsigned int *puHeight)
+{
+	*puWidth = 0;
+	*puHeight = 0;
+
+	if (m_pCurrent)
+	{
+		*puWidth = m_pCurrent->uWidth;
+		*puHeight = m_pCurrent->uHeight;
+	}
+}
+
+void JPEGCache::GetStats(JPEGCacheStats *pStats) const
+{
+	pStats->uHits = m_uHits;
+	pStats->uMisses = m_uMisses;
+	pStats->uEvictions = m_uEvictions;
+	pStats->uEntries = (unsigned int) m_lstEntries.size();
+	pStats->stBytesUsed = m_stBytesUsed;
+	pStats->stBudgetBytes = m_stBudgetBytes;
+}
+
+void JPEGCache::Forget(void *eglImage)
+{
+	for (EntryList::iterator li = m_lstEntries.begin(); li != m_lstEntries.end(); li++)
+	{
+		if (li->eglImage == eglImage)
+		{
+			if (&(*li) == m_pCurrent)
+			{
+				m_pCurrent = NULL;
+			}
+
+			m_stBytesUsed -= li->stDecodedBytes;
+			m_mapEntries.erase(li->u64Hash);
+			m_lstEntries.erase(li);
+			break;
+		}
+	}
+}
+
+void JPEGCache::Evict()
+{
+	EntryList::iterator li = m_lstEntries.end();
+
+	// walk from least recently used towards the front
+	while ((m_stBytesUsed > m_stBudgetBytes) && (li != m_lstEntries.begin()))
+	{
+		li--;
+
+		// the displayed image and the image openmax is still attached to must survive
+		if ((&(*li) == m_pCurrent) || (li->eglImage == m_pLastDecoded))
+		{
+			continue;
+		}
+
+		m_pIEGLImage->DeleteEGLImage(li->eglImage);
+		m_stBytesUsed -= li->stDecodedBytes;
+		m_mapEntries.erase(li->u64Hash);
+		li = m_lstEntries.erase(li);
+		m_uEvictions++;
+	}
+}
+
+JPEGCache::JPEGCache(IJPEGDecode *pDecoder, IVideoObjectEGLImage *pEGLImage, size_t stBudgetBytes, ILogger *pLogger) :
+m_pDecoder(pDecoder),
+m_pIEGLImage(pEGLImage),
+m_pLogger(pLogger),
+m_pCurrent(NULL),
+m_pShownImage(0),
+m_bPendingHit(false),
+m_bPendingMiss(false),
+m_u64PendingHash(0),
+m_stPendingCompressedBytes(0),
+m_pLastDecoded(0),
+m_u64ScaleSeed(0),
+m_uScaleDenom(1),
+m_uTargetWidth(0),
+m_uTargetHeight(0),
+m_stBudgetBytes(stBudgetBytes),
+m_stBytesUsed(0),
+m_uHits(0),
+m_uMisses(0),
+m_uEvictions(0)
+{
+}
+
+JPEGCache::~JPEGCache()
+{
+	for (EntryList::iterator li = m_lstEntries.begin(); li != m_lstEntries.end(); li++)
+	{
+		// the decoder frees the image it was last attached to when it shuts down
+		if (li->eglImage == m_pDecoder->GetEGLImage())
+		{
+			continue;
+		}
+
+		m_pIEGLImage->DeleteEGLImage(li->eglImage);
+	}
+}
@@ -0,0 +1,118 @@
+#ifndef JPEGCACHE_H
+#define JPEGCACHE_H
+
+#include "IJPEGDecode.h"
+#include "../io/logger.h"
+#include "../video/VideoObjects/IVideoObjectEGLImage.h"
+
+#include <list>
+#include <map>
+
+using namespace std;
+
+struct JPEGCacheStats
+{
+	unsigned int uHits;
+	unsigned int uMisses;
+	unsigned int uEvictions;
+	unsigned int uEntries;
+	size_t stBytesUsed;
+	size_t stBudgetBytes;
+};
+
+// Sits in front of a real decoder and keeps decoded images resident (as EGL images) keyed on a hash of the compressed bytes.
+// A hit just points the renderer at the already decoded texture instead of decoding again.
+// Least recently used images are freed once the decoded size of everything in the cache goes over the byte budget
+//  (GPU memory on the pi is very limited).
+class JPEGCache : public IJPEGDecode, public MpoDeleter
+{
+public:
+	static IJPEGDecodeSPtr GetInstance(IJPEGDecode *pDecoder, IVideoObjectEGLImage *pEGLImage, size_t stBudgetBytes, ILogger *pLogger);
+
+	void SetInputBufSizeHint(size_t stInputBufSizeBytes);
+
+	bool DecompressJPEGStart(const uint8_t *p8SrcJpeg, size_t stSizeBytes);
+
+	bool WaitJPEGDecompressorReady();
+
+	// cache hits are ready straight away
+	bool IsJPEGDecompressorReady() { return m_bPendingHit || (m_bPendingMiss && m_pDecoder->IsJPEGDecompressorReady()); }
+
+	// the scaling settings are part of the cache key so the same JPEG at two sizes is two entries
+	void SetOutputScale(unsigned int uScaleDenom);
+
+	void SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight);
+
+	// returns the EGL image of the last image decoded or found in the cache
+	void *GetEGLImage();
+
+	// images are owned by the cache so this does nothing
+	void DetachEGLImage() { }
+
+	void GetDimensions(unsigned int *puWidth, unsigned int *puHeight);
+
+	// entries are EGL images so there is nothing to keep YUV planes in
+	bool SetOutputYUV(bool bYUV) { return !bYUV; }
+
+	size_t GetImageBytes() { return m_pCurrent ? m_pCurrent->stDecodedBytes : 0; }
+
+	void GetStats(JPEGCacheStats *pStats) const;
+
+private:
+	JPEGCache(IJPEGDecode *pDecoder, IVideoObjectEGLImage *pEGLImage, size_t stBudgetBytes, ILogger *pLogger);
+	virtual ~JPEGCache();
+
+	void DeleteInstance() { delete this; }
+
+	// frees least recently used images until we are within budget
+	void Evict();
+
+	// drops the entry for an image without freeing the image
+	void Forget(void *eglImage);
+
+	struct CacheEntry
+	{
+		uint64_t u64Hash;
+		size_t stCompressedBytes;	// stored to make hash collisions even less likely to matter
+		void *eglImage;
+		unsigned int uWidth, uHeight;
+		size_t stDecodedBytes;
+	};
+
+	typedef list<CacheEntry> EntryList;
+	typedef map<uint64_t, EntryList::iterator> EntryMap;
+
+	IJPEGDecode *m_pDecoder;
+	IVideoObjectEGLImage *m_pIEGLImage;
+	ILogger *m_pLogger;
+
+	EntryList m_lstEntries;	// most recently used is at the front
+	EntryMap m_mapEntries;
+
+	// the entry that is currently being displayed (never evicted)
+	CacheEntry *m_pCurrent;
+
+	// the EGL image that is on screen as far as we know (0 if unsure). Hits on it leave the display alone:
+	//  SetDisplayEGLImage would throw away the post-processed copy of it and the rest of its per-image state.
+	void *m_pShownImage;
+
+	// set by DecompressJPEGStart so that WaitJPEGDecompressorReady knows what to do
+	bool m_bPendingHit;
+	bool m_bPendingMiss;
+	uint64_t m_u64PendingHash;
+	size_t m_stPendingCompressedBytes;
+
+	// the image the decoder last rendered into; openmax may still hold a buffer header for it so it is never evicted
+	void *m_pLastDecoded;
+
+	// seed for the hash, derived from the scaling settings
+	uint64_t m_u64ScaleSeed;
+	unsigned int m_uScaleDenom, m_uTargetWidth, m_uTargetHeight;
+
+	size_t m_stBudgetBytes;
+	size_t m_stBytesUsed;
+
+	unsigned int m_uHits, m_uMisses, m_uEvictions;
+};
+
+#endif // JPEGCACHE_H
@@ -0,0 +1,40 @@
+#ifndef JPEGERRORJMP_H
+#define JPEGERRORJMP_H
+
+#ifdef USE_LIBJPEG
+
+#include <stdio.h>	// jpeglib.h needs FILE
+#include <setjmp.h>
+#include <jpeglib.h>
+
+// libjpeg's default error handler calls exit(), so we jump back out instead
+struct jpeg_error_jmp
+{
+	struct jpeg_error_mgr pub;
+	jmp_buf jmp;
+	char szMsg[JMSG_LENGTH_MAX];
+};
+
+static inline void OnJpegError(j_common_ptr cinfo)
+{
+	jpeg_error_jmp *pErr = (jpeg_error_jmp *) cinfo->err;
+	(*cinfo->err->format_message)(cinfo, pErr->szMsg);
+	longjmp(pErr->jmp, 1);
+}
+
+// don't spam the console with warnings about slightly corrupt data
+static inline void OnJpegMessage(j_common_ptr)
+{
+}
+
+// points cinfo at err (the caller must still setjmp(err.jmp) before calling into libjpeg)
+static inline void InitJpegErrorJmp(struct jpeg_decompress_struct *cinfo, jpeg_error_jmp *err)
+{
+	cinfo->err = jpeg_std_error(&err->pub);
+	err->pub.error_exit = OnJpegError;
+	err->pub.output_message = OnJpegMessage;
+}
+
+#endif // USE_LIBJPEG
+
+#endif // JPEGERRORJMP_H
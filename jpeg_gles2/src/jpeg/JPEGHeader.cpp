@@ -0,0 +1,273 @@
+#include "JPEGHeader.h"
+#include <string.h>
+
+// markers we care about
+#define M_SOI	0xD8
+#define M_EOI	0xD9
+#define M_SOS	0xDA
+#define M_DRI	0xDD
+#define M_APP1	0xE1
+#define M_TEM	0x01
+
+static inline unsigned int Read16BE(const uint8_t *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static inline unsigned int Read16(const uint8_t *p, bool bBigEndian)
+{
+	return bBigEndian ? ((p[0] << 8) | p[1]) : ((p[1] << 8) | p[0]);
+}
+
+static inline uint32_t Read32(const uint8_t *p, bool bBigEndian)
+{
+	return bBigEndian ?
+		(((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]) :
+		(((uint32_t) p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0]);
+}
+
+// SOF0-SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+static inline bool IsSOF(uint8_t u8Marker)
+{
+	return (u8Marker >= 0xC0) && (u8Marker <= 0xCF) && (u8Marker != 0xC4) && (u8Marker != 0xC8) && (u8Marker != 0xCC);
+}
+
+// pulls the orientation tag out of IFD0 of an EXIF APP1 segment
+static void ParseExifOrientation(const uint8_t *p8Seg, size_t stSegBytes, JPEGHeaderInfo *pInfo)
+{
+	// "Exif\0\0" followed by the TIFF header
+	if ((stSegBytes < 6 + 8) || (memcmp(p8Seg, "Exif\0\0", 6) != 0))
+	{
+		return;
+	}
+
+	const uint8_t *p8Tiff = p8Seg + 6;
+	size_t stTiffBytes = stSegBytes - 6;
+	bool bBigEndian;
+
+	if ((p8Tiff[0] == 'M') && (p8Tiff[1] == 'M'))
+	{
+		bBigEndian = true;
+	}
+	else if ((p8Tiff[0] == 'I') && (p8Tiff[1] == 'I'))
+	{
+		bBigEndian = false;
+	}
+	else
+	{
+		return;
+	}
+
+	// the offset comes straight from the file: compare without adding to it (u32IFDOffset + 2 wraps for 0xFFFFFFFE)
+	uint32_t u32IFDOffset = Read32(p8Tiff + 4, bBigEndian);
+	if ((u32IFDOffset < 8) || (stTiffBytes < 2) || (u32IFDOffset > stTiffBytes - 2))
+	{
+		return;
+	}
+
+	unsigned int uEntries = Read16(p8Tiff + u32IFDOffset, bBigEndian);
+	size_t stEntries = (size_t) u32IFDOffset + 2;
+
+	// entries are checked as offsets before they are turned into pointers
+	for (unsigned int u = 0; u < uEntries; u++)
+	{
+		if (stEntries + (size_t) (u + 1) * 12 > stTiffBytes)
+		{
+			break;
+		}
+
+		const uint8_t *p8Entry = p8Tiff + stEntries + (size_t) u * 12;
+
+		// 0x112 is orientation, type SHORT with the value stored inline
+		if (Read16(p8Entry, bBigEndian) == 0x112)
+		{
+			unsigned int uValue = Read16(p8Entry + 8, bBigEndian);
+			if ((uValue >= 1) && (uValue <= 8))
+			{
+				pInfo->uOrientation = uValue;
+			}
+			break;
+		}
+	}
+}
+
+static JPEGSubsampling ClassifySubsampling(const JPEGHeaderInfo *pInfo)
+{
+	if (pInfo->uComponents == 1)
+	{
+		return JPEG_SUBSAMPLING_GRAY;
+	}
+
+	if (pInfo->uComponents != 3)
+	{
+		return JPEG_SUBSAMPLING_OTHER;
+	}
+
+	const JPEGComponentInfo *c = pInfo->components;
+
+	// both chroma components must match and must divide evenly into luma
+	if ((c[1].u8H != c[2].u8H) || (c[1].u8V != c[2].u8V) ||
+		(c[1].u8H == 0) || (c[1].u8V == 0) ||
+		(c[0].u8H % c[1].u8H) || (c[0].u8V % c[1].u8V))
+	{
+		return JPEG_SUBSAMPLING_OTHER;
+	}
+
+	unsigned int uH = c[0].u8H / c[1].u8H;
+	unsigned int uV = c[0].u8V / c[1].u8V;
+
+	if ((uH == 1) && (uV == 1)) return JPEG_SUBSAMPLING_444;
+	if ((uH == 2) && (uV == 1)) return JPEG_SUBSAMPLING_422;
+	if ((uH == 2) && (uV == 2)) return JPEG_SUBSAMPLING_420;
+	if ((uH == 1) && (uV == 2)) return JPEG_SUBSAMPLING_440;
+	if ((uH == 4) && (uV == 1)) return JPEG_SUBSAMPLING_411;
+
+	return JPEG_SUBSAMPLING_OTHER;
+}
+
+bool ParseJPEGHeader(const uint8_t *p8Jpeg, size_t stSizeBytes, JPEGHeaderInfo *pInfo)
+{
+	bool bGotSOF = false;
+
+	memset(pInfo, 0, sizeof(*pInfo));
+	pInfo->uOrientation = 1;
+
+	if ((stSizeBytes < 4) || (p8Jpeg[0] != 0xFF) || (p8Jpeg[1] != M_SOI))
+	{
+		return false;
+	}
+
+	size_t stPos = 2;
+
+	while (stPos + 4 <= stSizeBytes)
+	{
+		if (p8Jpeg[stPos] != 0xFF)
+		{
+			return false;	// corrupt, expected a marker
+		}
+
+		// any number of 0xFF fill bytes may come before the marker code
+		while ((stPos < stSizeBytes) && (p8Jpeg[stPos] == 0xFF))
+		{
+			stPos++;
+		}
+
+		if (stPos + 2 >= stSizeBytes)
+		{
+			break;
+		}
+
+		uint8_t u8Marker = p8Jpeg[stPos++];
+
+		// standalone markers have no length
+		if ((u8Marker == M_TEM) || ((u8Marker >= 0xD0) && (u8Marker <= 0xD7)))
+		{
+			continue;
+		}
+
+		if (u8Marker == M_EOI)
+		{
+			break;
+		}
+
+		unsigned int uLen = Read16BE(p8Jpeg + stPos);
+		if ((uLen < 2) || (stPos + uLen > stSizeBytes))
+		{
+			return false;
+		}
+
+		const uint8_t *p8Seg = p8Jpeg + stPos + 2;
+		size_t stSegBytes = uLen - 2;
+
+		if (IsSOF(u8Marker))
+		{
+			if (stSegBytes < 6)
+			{
+				return false;
+			}
+
+			pInfo->u8SOFMarker = u8Marker;
+			pInfo->stFrameOffset = stPos - 2;
+			pInfo->uPrecision = p8Seg[0];
+			pInfo->uHeight = Read16BE(p8Seg + 1);
+			pInfo->uWidth = Read16BE(p8Seg + 3);
+			pInfo->uComponents = p8Seg[5];
+
+			// low two bits: 0 = sequential, 2 = progressive, 3 = lossless. bit 3 set means arithmetic coding.
+			pInfo->bProgressive = ((u8Marker & 3) == 2);
+			pInfo->bLossless = ((u8Marker & 3) == 3);
+			pInfo->bArithmetic = ((u8Marker & 8) != 0);
+
+			if ((pInfo->uComponents == 0) || (stSegBytes < 6 + (size_t) pInfo->uComponents * 3))
+			{
+				return false;
+			}
+
+			for (unsigned int u = 0; (u < pInfo->uComponents) && (u < JPEG_MAX_COMPONENTS); u++)
+			{
+				const uint8_t *p8Comp = p8Seg + 6 + (u * 3);
+				pInfo->components[u].u8ID = p8Comp[0];
+				pInfo->components[u].u8H = p8Comp[1] >> 4;
+				pInfo->components[u].u8V = p8Comp[1] & 0xF;
+			}
+
+			pInfo->eSubsampling = ClassifySubsampling(pInfo);
+			bGotSOF = true;
+		}
+		else if (u8Marker == M_DRI)
+		{
+			if (stSegBytes >= 2)
+			{
+				pInfo->uRestartInterval = Read16BE(p8Seg);
+			}
+		}
+		else if (u8Marker == M_APP1)
+		{
+			ParseExifOrientation(p8Seg, stSegBytes, pInfo);
+		}
+		else if (u8Marker == M_SOS)
+		{
+			// everything we need comes before the first scan
+			pInfo->stScanOffset = stPos - 2;
+			break;
+		}
+
+		stPos += uLen;
+	}
+
+	// a height of 0 means it is defined by a DNL marker later on, which nothing we use supports
+	return bGotSOF && (pInfo->uWidth != 0) && (pInfo->uHeight != 0);
+}
+
+unsigned int JPEGScaleRequest::GetScaleDenom(unsigned int uSrcWidth, unsigned int uSrcHeight) const
+{
+	if ((uTargetWidth == 0) && (uTargetHeight == 0))
+	{
+		return uScaleDenom;
+	}
+
+	unsigned int uDenom = 1;
+
+	while ((uDenom < 8) &&
+		(JPEGScaledSize(uSrcWidth, uDenom * 2) >= uTargetWidth) &&
+		(JPEGScaledSize(uSrcHeight, uDenom * 2) >= uTargetHeight))
+	{
+		uDenom *= 2;
+	}
+
+	return uDenom;
+}
+
+const char *JPEGSubsamplingName(JPEGSubsampling eSubsampling)
+{
+	switch (eSubsampling)
+	{
+	case JPEG_SUBSAMPLING_GRAY: return "gray";
+	case JPEG_SUBSAMPLING_444: return "4:4:4";
+	case JPEG_SUBSAMPLING_422: return "4:2:2";
+	case JPEG_SUBSAMPLING_420: return "4:2:0";
+	case JPEG_SUBSAMPLING_440: return "4:4:0";
+	case JPEG_SUBSAMPLING_411: return "4:1:1";
+	default: return "other";
+	}
+}
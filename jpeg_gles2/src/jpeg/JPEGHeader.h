@@ -0,0 +1,84 @@
+#ifndef JPEGHEADER_H
+#define JPEGHEADER_H
+
+#include "../common/datatypes.h"
+#include <stddef.h>
+
+typedef enum
+{
+	JPEG_SUBSAMPLING_GRAY,	// one component
+	JPEG_SUBSAMPLING_444,
+	JPEG_SUBSAMPLING_422,
+	JPEG_SUBSAMPLING_420,
+	JPEG_SUBSAMPLING_440,
+	JPEG_SUBSAMPLING_411,
+	JPEG_SUBSAMPLING_OTHER	// anything else (including 4 component CMYK/YCCK)
+} JPEGSubsampling;
+
+struct JPEGComponentInfo
+{
+	uint8_t u8ID;
+	uint8_t u8H;	// horizontal sampling factor
+	uint8_t u8V;	// vertical sampling factor
+};
+
+#define JPEG_MAX_COMPONENTS 4
+
+struct JPEGHeaderInfo
+{
+	unsigned int uWidth, uHeight;
+
+	// the SOFn marker (0xC0 = baseline, 0xC1 = extended sequential, 0xC2 = progressive, etc)
+	uint8_t u8SOFMarker;
+	bool bProgressive;
+	bool bArithmetic;
+	bool bLossless;
+	unsigned int uPrecision;	// bits per sample
+
+	unsigned int uComponents;
+	JPEGComponentInfo components[JPEG_MAX_COMPONENTS];
+	JPEGSubsampling eSubsampling;
+
+	// MCUs between restart markers (0 if there are no restart markers)
+	unsigned int uRestartInterval;
+
+	// EXIF orientation (1-8), 1 if the image has no orientation tag
+	unsigned int uOrientation;
+
+	// offset of the SOFn marker
+	size_t stFrameOffset;
+
+	// offset of the SOS marker (ie where the entropy coded data starts)
+	size_t stScanOffset;
+};
+
+// The output scaling a caller asked for (see IJPEGDecode::SetOutputScale and SetOutputTargetSize)
+struct JPEGScaleRequest
+{
+	JPEGScaleRequest() : uScaleDenom(1), uTargetWidth(0), uTargetHeight(0) { }
+
+	// returns true if uScaleDenom is one that both libjpeg's DCT scaling and our resize setup support
+	static bool IsValidDenom(unsigned int uScaleDenom) { return (uScaleDenom == 1) || (uScaleDenom == 2) || (uScaleDenom == 4) || (uScaleDenom == 8); }
+
+	// If a target size is set, returns the largest reduction (1, 2, 4 or 8) that keeps the image at least as big as the target,
+	//  otherwise returns uScaleDenom.
+	unsigned int GetScaleDenom(unsigned int uSrcWidth, unsigned int uSrcHeight) const;
+
+	unsigned int uScaleDenom;
+	unsigned int uTargetWidth, uTargetHeight;	// 0x0 means no target
+};
+
+// size of one dimension after scaling by 1/uScaleDenom (rounded up, same as libjpeg)
+inline unsigned int JPEGScaledSize(unsigned int uSize, unsigned int uScaleDenom)
+{
+	return (uSize + uScaleDenom - 1) / uScaleDenom;
+}
+
+// Scans the markers at the start of a JPEG (up to the first SOS) without decoding anything.
+// Returns false if the buffer does not look like a JPEG or no frame header is found.
+bool ParseJPEGHeader(const uint8_t *p8Jpeg, size_t stSizeBytes, JPEGHeaderInfo *pInfo);
+
+// human-readable name for logging
+const char *JPEGSubsamplingName(JPEGSubsampling eSubsampling);
+
+#endif // JPEGHEADER_H
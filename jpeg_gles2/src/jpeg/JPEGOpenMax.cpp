@@ -5,6 +5,7 @@
 #ifdef USE_OPENMAX
 
 #include "JPEGOpenMax.h"
+#include "JPEGHeader.h"
 #include "../common/common.h"
 #include <string.h>
 #include <stdexcept>
@@ -13,10 +14,10 @@
 // arbitrary timeout value which is subject to change
 #define TIMEOUT_MS 2000
 
-IJPEGDecodeSPtr JPEGOpenMax::GetInstance(IVideoObjectEGLImage *pEGLImage, IOMXComponent *pCompDecode, IOMXComponent *pCompRender, IMemoryAligned *pMemoryAligned, ILogger *pLogger)
+IJPEGDecodeSPtr JPEGOpenMax::GetInstance(IVideoObjectEGLImage *pEGLImage, IOMXComponent *pCompDecode, IOMXComponent *pCompResize, IOMXComponent *pCompRender, IMemoryAligned *pMemoryAligned, ILogger *pLogger)
 {
 	IJPEGDecodeSPtr pRes;
-	JPEGOpenMax *pInstance = new JPEGOpenMax(pEGLImage, pCompDecode, pCompRender, pMemoryAligned, pLogger);
+	JPEGOpenMax *pInstance = new JPEGOpenMax(pEGLImage, pCompDecode, pCompResize, pCompRender, pMemoryAligned, pLogger);
 
 	if (pInstance->Init())
 	{
@@ -93,6 +94,45 @@ bool JPEGOpenMax::DecompressJPEGStart(const uint8_t *p8SrcJpeg, size_t stSizeByt
 
 	try
 	{
+		if (!m_bInitialized)
+		{
+			throw runtime_error("SetInputBufSizeHint must be called first");
+		}
+
+		// look at the header first so that input the hardware can't handle never reaches it
+		JPEGHeaderInfo hdr;
+		if (!ParseJPEGHeader(p8SrcJpeg, stSizeBytes, &hdr))
+		{
+			throw runtime_error("Not a valid JPEG");
+		}
+
+		if (stSizeBytes > m_stMaxJpegSizeBytes)
+		{
+			throw runtime_error("JPEG is larger than the input buffer size hint");
+		}
+
+		// the decoder->renderer tunnel is set up for the resolution of the first image and is never reconfigured
+		if ((m_pHeaderOutput != NULL) && ((hdr.uWidth != m_uSrcWidth) || (hdr.uHeight != m_uSrcHeight)))
+		{
+			throw runtime_error("JPEG resolution differs from the image the renderer was set up for");
+		}
+
+		unsigned int uScaleDenom = m_scale.GetScaleDenom(hdr.uWidth, hdr.uHeight);
+
+		if ((m_pHeaderOutput != NULL) && (uScaleDenom != m_uScaleDenom))
+		{
+			throw runtime_error("JPEG scale differs from the scale the resizer was set up for");
+		}
+
+		if ((uScaleDenom > 1) && (m_pCompResize == NULL))
+		{
+			throw runtime_error("Scaling requires the resize component");
+		}
+
+		m_uSrcWidth = hdr.uWidth;
+		m_uSrcHeight = hdr.uHeight;
+		m_uScaleDenom = uScaleDenom;
+
 		// get buffer to fill
 		OMX_BUFFERHEADERTYPE *pBufHeader = m_vpBufHeaders[m_uSrcBufVectorIndex];
 		m_uSrcBufVectorIndex++;
@@ -192,6 +232,9 @@ void JPEGOpenMax::EmptyThisBuffer(OMX_BUFFERHEADERTYPE *pBufHeader)
 
 	// assign new texture to render to
 
+	// decode into a target that isn't on screen so that rendering can carry on while we decode
+	m_eglImage = m_pIEGLImage->AcquireDecodeTarget(m_uWidth, m_uHeight);
+
 	// enable output port of Renderer
 	m_pCompRender->SendCommand(OMX_CommandPortEnable, m_iOutPortRender, NULL);
 
@@ -202,6 +245,23 @@ void JPEGOpenMax::EmptyThisBuffer(OMX_BUFFERHEADERTYPE *pBufHeader)
 	m_pCompRender->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortEnable, m_iOutPortRender, TIMEOUT_MS);
 }
 
+void JPEGOpenMax::SetOutputScale(unsigned int uScaleDenom)
+{
+	if (!JPEGScaleRequest::IsValidDenom(uScaleDenom))
+	{
+		m_pLogger->Log("JPEGOpenMax::SetOutputScale: scale must be 1, 2, 4 or 8");
+		return;
+	}
+
+	m_scale.uScaleDenom = uScaleDenom;
+}
+
+void JPEGOpenMax::SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight)
+{
+	m_scale.uTargetWidth = uWidth;
+	m_scale.uTargetHeight = uHeight;
+}
+
 bool JPEGOpenMax::WaitJPEGDecompressorReady()
 {
 	bool bRes = false;
@@ -229,6 +289,10 @@ bool JPEGOpenMax::WaitJPEGDecompressorReady()
 		assert(m_pCompRender->GetPendingFillCount() == 0);
 
 		m_bDecoding = false;
+
+		// the image is complete so it is now safe to show it (from the start of the next frame)
+		m_pIEGLImage->PublishDecodeTarget(m_eglImage);
+
 		bRes = true;
 	}
 	catch (std::exception &ex)
@@ -239,21 +303,28 @@ bool JPEGOpenMax::WaitJPEGDecompressorReady()
 	return bRes;
 }
 
-JPEGOpenMax::JPEGOpenMax(IVideoObjectEGLImage *pIEGLImage, IOMXComponent *pCompDecode, IOMXComponent *pCompRender, IMemoryAligned *pMemoryAligned, ILogger *pLogger) :
+JPEGOpenMax::JPEGOpenMax(IVideoObjectEGLImage *pIEGLImage, IOMXComponent *pCompDecode, IOMXComponent *pCompResize, IOMXComponent *pCompRender, IMemoryAligned *pMemoryAligned, ILogger *pLogger) :
 m_pIEGLImage(pIEGLImage),
 m_pCompDecode(pCompDecode),
+m_pCompResize(pCompResize),
 m_pCompRender(pCompRender),
 m_pMemoryAligned(pMemoryAligned),
 m_pLogger(pLogger),
 m_bInitialized(false),
 m_iInPortDecode(0),
 m_iOutPortDecode(0),
+m_iInPortResize(0),
+m_iOutPortResize(0),
 m_iInPortRender(0),
 m_iOutPortRender(0),
 m_uSrcBufVectorIndex(0),
 m_bDecoding(false),
 m_uWidth(0),
 m_uHeight(0),
+m_uSrcWidth(0),
+m_uSrcHeight(0),
+m_uScaleDenom(1),
+m_bResizing(false),
 m_pHeaderOutput(NULL),
 m_stMaxJpegSizeBytes(0)
 {
@@ -297,6 +368,25 @@ bool JPEGOpenMax::Init()
 		m_iInPortRender = port.nStartPortNumber;
 		m_iOutPortRender = port.nStartPortNumber+1;
 
+		// get ports for resizer
+		if (m_pCompResize)
+		{
+			m_pCompResize->GetParameter(OMX_IndexParamImageInit, &port);
+
+			if (port.nPorts != 2)
+			{
+				throw runtime_error("Unexpected number of ports returned");
+			}
+
+			m_iInPortResize = port.nStartPortNumber;
+			m_iOutPortResize = port.nStartPortNumber+1;
+
+			m_pCompResize->SendCommand(OMX_CommandPortDisable, m_iInPortResize, NULL);
+			m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortDisable, m_iInPortResize, TIMEOUT_MS);
+			m_pCompResize->SendCommand(OMX_CommandPortDisable, m_iOutPortResize, NULL);
+			m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortDisable, m_iOutPortResize, TIMEOUT_MS);
+		}
+
 		// disable all ports to get to a sane state
 		m_pCompDecode->SendCommand(OMX_CommandPortDisable, m_iInPortDecode, NULL);
 		m_pCompDecode->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortDisable, m_iInPortDecode, TIMEOUT_MS);
@@ -346,6 +436,13 @@ void JPEGOpenMax::Shutdown()
 	// flush tunnel
 	m_pCompDecode->SendCommand(OMX_CommandFlush, m_iOutPortDecode, NULL);
 	m_pCompDecode->WaitForEvent(OMX_EventCmdComplete, OMX_CommandFlush, m_iOutPortDecode, TIMEOUT_MS);
+	if (m_bResizing)
+	{
+		m_pCompResize->SendCommand(OMX_CommandFlush, m_iInPortResize, NULL);
+		m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandFlush, m_iInPortResize, TIMEOUT_MS);
+		m_pCompResize->SendCommand(OMX_CommandFlush, m_iOutPortResize, NULL);
+		m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandFlush, m_iOutPortResize, TIMEOUT_MS);
+	}
 	m_pCompRender->SendCommand(OMX_CommandFlush, m_iInPortRender, NULL);
 	m_pCompRender->WaitForEvent(OMX_EventCmdComplete, OMX_CommandFlush, m_iInPortRender, TIMEOUT_MS);
 
@@ -379,25 +476,54 @@ void JPEGOpenMax::Shutdown()
 	m_pCompDecode->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortDisable, m_iOutPortDecode, TIMEOUT_MS);
 	m_pCompRender->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortDisable, m_iInPortRender, TIMEOUT_MS);
 
+	if (m_bResizing)
+	{
+		m_pCompResize->SendCommand(OMX_CommandPortDisable, m_iInPortResize, NULL);
+		m_pCompResize->SendCommand(OMX_CommandPortDisable, m_iOutPortResize, NULL);
+		m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortDisable, m_iInPortResize, TIMEOUT_MS);
+		m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortDisable, m_iOutPortResize, TIMEOUT_MS);
+	}
+
 	// OMX_SetupTunnel with 0's to remove tunnel
 	m_pCompDecode->RemoveTunnel(m_iOutPortDecode);
 	m_pCompRender->RemoveTunnel(m_iInPortRender);
+	if (m_bResizing)
+	{
+		m_pCompResize->RemoveTunnel(m_iInPortResize);
+		m_pCompResize->RemoveTunnel(m_iOutPortResize);
+	}
 
 	// change handle states to IDLE
 	m_pCompDecode->SendCommand(OMX_CommandStateSet, OMX_StateIdle, NULL);
 	m_pCompRender->SendCommand(OMX_CommandStateSet, OMX_StateIdle, NULL);
+	if (m_bResizing)
+	{
+		m_pCompResize->SendCommand(OMX_CommandStateSet, OMX_StateIdle, NULL);
+	}
 
 	// wait for state change complete
 	m_pCompDecode->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateIdle, TIMEOUT_MS);
 	m_pCompRender->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateIdle, TIMEOUT_MS);
+	if (m_bResizing)
+	{
+		m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateIdle, TIMEOUT_MS);
+	}
 
 	// change handle states to LOADED
 	m_pCompDecode->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, NULL);
 	m_pCompRender->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, NULL);
+	if (m_bResizing)
+	{
+		m_pCompResize->SendCommand(OMX_CommandStateSet, OMX_StateLoaded, NULL);
+	}
 
 	// wait for state change complete
 	m_pCompDecode->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateLoaded, TIMEOUT_MS);
 	m_pCompRender->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateLoaded, TIMEOUT_MS);
+	if (m_bResizing)
+	{
+		m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateLoaded, TIMEOUT_MS);
+	}
 
 	// free EGL image
 	if (m_eglImage != 0)
@@ -410,12 +536,23 @@ void JPEGOpenMax::OnDecoderOutputChanged()
 {
 	OMX_PARAM_PORTDEFINITIONTYPE portdef;
 
-	// establish tunnel between decoder output and renderer input
+	// the renderer is fed by the decoder, or by the resizer if we are scaling
+	IOMXComponent *pCompSrc = m_pCompDecode;
+	int iOutPortSrc = m_iOutPortDecode;
+
+	if (m_uScaleDenom > 1)
+	{
+		SetupResizer();
+		pCompSrc = m_pCompResize;
+		iOutPortSrc = m_iOutPortResize;
+	}
+
+	// establish tunnel between decoder (or resizer) output and renderer input
 	// (this will automatically set up the renderer's input port)
-	m_pCompDecode->SetupTunnel(m_iOutPortDecode, m_pCompRender, m_iInPortRender);
+	pCompSrc->SetupTunnel(iOutPortSrc, m_pCompRender, m_iInPortRender);
 
 	// enable output of decoder and input of Render (ie enable tunnel)
-	m_pCompDecode->SendCommand(OMX_CommandPortEnable, m_iOutPortDecode, NULL);
+	pCompSrc->SendCommand(OMX_CommandPortEnable, iOutPortSrc, NULL);
 	m_pCompRender->SendCommand(OMX_CommandPortEnable, m_iInPortRender, NULL);
 
 	// put renderer in idle state (this allows the outport of the decoder to become enabled)
@@ -425,7 +562,7 @@ void JPEGOpenMax::OnDecoderOutputChanged()
 	m_pCompRender->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateIdle, TIMEOUT_MS);
 
 	// once the state changes, both ports should become enabled and the renderer output should generate a settings changed event
-	m_pCompDecode->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortEnable, m_iOutPortDecode, TIMEOUT_MS);
+	pCompSrc->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortEnable, iOutPortSrc, TIMEOUT_MS);
 	m_pCompRender->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortEnable, m_iInPortRender, TIMEOUT_MS);
 	m_pCompRender->WaitForEvent(OMX_EventPortSettingsChanged, m_iOutPortRender, 0, TIMEOUT_MS);
 
@@ -450,8 +587,47 @@ void JPEGOpenMax::OnDecoderOutputChanged()
 	m_uWidth = (unsigned int) portdef.format.image.nFrameWidth;
 	m_uHeight = (unsigned int) portdef.format.image.nFrameHeight;
 
-	// create EGL image surfaces
-	m_eglImage = m_pIEGLImage->CreateEGLImage(m_uWidth, m_uHeight);
+	// (the EGL image itself is created by EmptyThisBuffer now that we know the resolution)
+}
+
+void JPEGOpenMax::SetupResizer()
+{
+	OMX_PARAM_PORTDEFINITIONTYPE portdef;
+
+	// decoder output -> resizer input
+	m_pCompDecode->SetupTunnel(m_iOutPortDecode, m_pCompResize, m_iInPortResize);
+
+	m_pCompDecode->SendCommand(OMX_CommandPortEnable, m_iOutPortDecode, NULL);
+	m_pCompResize->SendCommand(OMX_CommandPortEnable, m_iInPortResize, NULL);
+
+	m_pCompResize->SendCommand(OMX_CommandStateSet, OMX_StateIdle, NULL);
+	m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateIdle, TIMEOUT_MS);
+
+	m_pCompDecode->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortEnable, m_iOutPortDecode, TIMEOUT_MS);
+	m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandPortEnable, m_iInPortResize, TIMEOUT_MS);
+
+	// the resizer output takes on the input format until we tell it otherwise
+	m_pCompResize->WaitForEvent(OMX_EventPortSettingsChanged, m_iOutPortResize, 0, TIMEOUT_MS);
+
+	portdef.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+	portdef.nVersion.nVersion = OMX_VERSION;
+	portdef.nPortIndex = m_iOutPortResize;
+	m_pCompResize->GetParameter(OMX_IndexParamPortDefinition, &portdef);
+
+	// same scaled size that libjpeg would produce, so both decoders give the same result for the same request
+	portdef.format.image.nFrameWidth = JPEGScaledSize(m_uSrcWidth, m_uScaleDenom);
+	portdef.format.image.nFrameHeight = JPEGScaledSize(m_uSrcHeight, m_uScaleDenom);
+	portdef.format.image.eColorFormat = OMX_COLOR_FormatYUV420PackedPlanar;
+
+	// let the resizer pick the stride and slice height
+	portdef.format.image.nStride = 0;
+	portdef.format.image.nSliceHeight = 0;
+	m_pCompResize->SetParameter(OMX_IndexParamPortDefinition, &portdef);
+
+	m_pCompResize->SendCommand(OMX_CommandStateSet, OMX_StateExecuting, NULL);
+	m_pCompResize->WaitForEvent(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateExecuting, TIMEOUT_MS);
+
+	m_bResizing = true;
 }
 
 #endif // USE_OPENMAX
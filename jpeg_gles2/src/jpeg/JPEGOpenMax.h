@@ -6,6 +6,7 @@
 #define JPEGOPENMAX_H
 
 #include "IJPEGDecode.h"
+#include "JPEGHeader.h"
 #include "../openmax/OMXComponent.h"
 #include "../io/IMemoryAligned.h"
 #include "../io/logger.h"
@@ -19,7 +20,8 @@ class JPEGOpenMax : public IJPEGDecode, public MpoDeleter
 {
 public:
 
-	static IJPEGDecodeSPtr GetInstance(IVideoObjectEGLImage *pEGLImage, IOMXComponent *pCompDecode, IOMXComponent *pCompRender, IMemoryAligned *pMemoryAligned, ILogger *pLogger);
+	// pCompResize may be NULL, in which case only full size decodes are possible
+	static IJPEGDecodeSPtr GetInstance(IVideoObjectEGLImage *pEGLImage, IOMXComponent *pCompDecode, IOMXComponent *pCompResize, IOMXComponent *pCompRender, IMemoryAligned *pMemoryAligned, ILogger *pLogger);
 
 	void SetInputBufSizeHint(size_t stInputBufSizeBytes);
 
@@ -27,10 +29,30 @@ public:
 
 	bool WaitJPEGDecompressorReady();
 
+	// the image is complete as soon as the renderer hands its buffer back
+	bool IsJPEGDecompressorReady() { return m_bDecoding && m_pCompRender->IsFillPending(m_pHeaderOutput); }
+
+	// The resizer is part of the tunnel, so like the resolution, the scale is fixed once the first image has been decoded.
+	// Images that would need a different scale after that are rejected (and go to the software decoder if there is one).
+	void SetOutputScale(unsigned int uScaleDenom);
+
+	void SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight);
+
+	void *GetEGLImage() { return m_eglImage; }
+
+	void DetachEGLImage() { m_pIEGLImage->ReleaseDecodeTarget(m_eglImage); m_eglImage = 0; }
+
+	void GetDimensions(unsigned int *puWidth, unsigned int *puHeight) { *puWidth = m_uWidth; *puHeight = m_uHeight; }
+
+	// egl_render only writes RGBA
+	bool SetOutputYUV(bool bYUV) { return !bYUV; }
+
+	size_t GetImageBytes() { return (size_t) m_uWidth * m_uHeight * 4; }
+
 private:
 	void EmptyThisBuffer(OMX_BUFFERHEADERTYPE *pBufHeader);
 
-	JPEGOpenMax(IVideoObjectEGLImage *pIEGLImage, IOMXComponent *pCompDecode, IOMXComponent *pCompRender, IMemoryAligned *pMemoryAligned, ILogger *pLogger);
+	JPEGOpenMax(IVideoObjectEGLImage *pIEGLImage, IOMXComponent *pCompDecode, IOMXComponent *pCompResize, IOMXComponent *pCompRender, IMemoryAligned *pMemoryAligned, ILogger *pLogger);
 	virtual ~JPEGOpenMax();
 
 	void DeleteInstance() { delete this; }
@@ -43,14 +65,18 @@ private:
 
 	void OnDecoderOutputChangedAgain();
 
+	// tunnels the decoder into the resizer and sets the resizer's output to the scaled size
+	void SetupResizer();
+
 	IVideoObjectEGLImage *m_pIEGLImage;
-	IOMXComponent *m_pCompDecode, *m_pCompRender;
+	IOMXComponent *m_pCompDecode, *m_pCompResize, *m_pCompRender;
 	IMemoryAligned *m_pMemoryAligned;
 	ILogger *m_pLogger;
 	bool m_bInitialized;
 
 	// openmax ports (in is for source jpeg, out is for decoded buffer)
 	int m_iInPortDecode, m_iOutPortDecode;
+	int m_iInPortResize, m_iOutPortResize;
 	int m_iInPortRender, m_iOutPortRender;
 
 	vector<OMX_BUFFERHEADERTYPE *> m_vpBufHeaders;	// vector to hold all of the buffer headers
@@ -64,6 +90,16 @@ private:
 	// width and height of image(s) we are decoding
 	unsigned int m_uWidth, m_uHeight;
 
+	// width and height according to the JPEG header of the image the renderer was set up for
+	unsigned int m_uSrcWidth, m_uSrcHeight;
+
+	// requested scaling, and the scale the tunnel was set up for
+	JPEGScaleRequest m_scale;
+	unsigned int m_uScaleDenom;
+
+	// whether the resizer is in the tunnel
+	bool m_bResizing;
+
 	// pointer to struct containing info about output buffer
 	OMX_BUFFERHEADERTYPE *m_pHeaderOutput;
 
@@ -0,0 +1,268 @@
+#ifdef USE_LIBJPEG
+
+#include "JPEGRegion.h"
+#include "JPEGErrorJmp.h"
+#include <string.h>
+
+JPEGRegionDecoder::JPEGRegionDecoder() :
+m_uMCUWidth(8),
+m_uMCUHeight(8),
+m_uMCUsPerRow(0),
+m_stDataOffset(0),
+m_stDataEnd(0),
+m_uRestartSeeks(0)
+{
+	memset(&m_hdr, 0, sizeof(m_hdr));
+}
+
+bool JPEGRegionDecoder::SetSource(const uint8_t *p8Jpeg, size_t stSizeBytes)
+{
+	m_vJpeg.clear();
+	m_vRestarts.clear();
+
+	if (!ParseJPEGHeader(p8Jpeg, stSizeBytes, &m_hdr) || (m_hdr.stScanOffset == 0))
+	{
+		return false;
+	}
+
+	m_vJpeg.assign(p8Jpeg, p8Jpeg + stSizeBytes);
+
+	// a single component scan is not interleaved so its MCU is one 8x8 block, otherwise it is the biggest sampling factor's worth of blocks
+	m_uMCUWidth = 8;
+	m_uMCUHeight = 8;
+	if (m_hdr.uComponents > 1)
+	{
+		for (unsigned int u = 0; (u < m_hdr.uComponents) && (u < JPEG_MAX_COMPONENTS); u++)
+		{
+			if (m_hdr.components[u].u8H * 8U > m_uMCUWidth) m_uMCUWidth = m_hdr.components[u].u8H * 8;
+			if (m_hdr.components[u].u8V * 8U > m_uMCUHeight) m_uMCUHeight = m_hdr.components[u].u8V * 8;
+		}
+	}
+	m_uMCUsPerRow = (m_hdr.uWidth + m_uMCUWidth - 1) / m_uMCUWidth;
+
+	const uint8_t *p8SOS = p8Jpeg + m_hdr.stScanOffset;
+	unsigned int uSOSLen = (p8SOS[2] << 8) | p8SOS[3];
+	unsigned int uScanComponents = p8SOS[4];
+	m_stDataOffset = m_hdr.stScanOffset + 2 + uSOSLen;
+	m_stDataEnd = stSizeBytes;
+
+	// Restart markers can only be used to seek if everything is in this one scan.
+	// (a progressive or non-interleaved image has more scans after this one)
+	if ((m_hdr.uRestartInterval == 0) || m_hdr.bProgressive || m_hdr.bArithmetic || m_hdr.bLossless ||
+		(uScanComponents != m_hdr.uComponents) || (m_stDataOffset > stSizeBytes))
+	{
+		return true;
+	}
+
+	for (size_t st = m_stDataOffset; st + 1 < stSizeBytes; st++)
+	{
+		if (p8Jpeg[st] != 0xFF)
+		{
+			continue;
+		}
+
+		uint8_t u8Next = p8Jpeg[st + 1];
+
+		// a stuffed zero (or fill byte) is part of the data
+		if ((u8Next == 0x00) || (u8Next == 0xFF))
+		{
+			continue;
+		}
+
+		if ((u8Next >= 0xD0) && (u8Next <= 0xD7))
+		{
+			m_vRestarts.push_back(st);
+			st++;
+			continue;
+		}
+
+		// any other marker (normally EOI) ends the scan
+		m_stDataEnd = st;
+		break;
+	}
+
+	return true;
+}
+
+unsigned int JPEGRegionDecoder::BuildSeekStream(unsigned int uFirstMCURow, unsigned int uEndMCURow, byteSA &vStream)
+{
+	unsigned int uInterval = m_hdr.uRestartInterval;
+	unsigned int uFirstMCU = uFirstMCURow * m_uMCUsPerRow;
+
+	// find the last restart interval that begins both at or before the first MCU we need and at the start of an MCU row
+	unsigned int uStartInterval = uFirstMCU / uInterval;
+	while ((uStartInterval > 0) && (((uStartInterval * uInterval) % m_uMCUsPerRow) != 0))
+	{
+		uStartInterval--;
+	}
+
+	// interval n starts right after the n-th restart marker
+	if ((uStartInterval == 0) || (uStartInterval > m_vRestarts.size()))
+	{
+		vStream.clear();
+		return 0;
+	}
+
+	unsigned int uStartRow = (uStartInterval * uInterval) / m_uMCUsPerRow;
+
+	// stop at the restart marker that ends the interval holding the last MCU we need
+	unsigned int uEndInterval = ((uEndMCURow * m_uMCUsPerRow) + uInterval - 1) / uInterval;
+	size_t stStart = m_vRestarts[uStartInterval - 1] + 2;
+	size_t stEnd = (uEndInterval - 1 < m_vRestarts.size()) ? m_vRestarts[uEndInterval - 1] : m_stDataEnd;
+
+	// headers (everything up to the entropy coded data) + the intervals we want + EOI
+	vStream.resize(m_stDataOffset + (stEnd - stStart) + 2);
+	memcpy(vStream.data(), m_vJpeg.data(), m_stDataOffset);
+	memcpy(vStream.data() + m_stDataOffset, m_vJpeg.data() + stStart, stEnd - stStart);
+	vStream[vStream.size() - 2] = 0xFF;
+	vStream[vStream.size() - 1] = 0xD9;
+
+	// the decoder expects the first restart marker in a scan to be RST0, so renumber the ones we kept
+	for (unsigned int u = uStartInterval; (u < uEndInterval - 1) && (u < m_vRestarts.size()); u++)
+	{
+		vStream[m_stDataOffset + (m_vRestarts[u] - stStart) + 1] = 0xD0 + ((u - uStartInterval) & 7);
+	}
+
+	// the new stream's image starts at uStartRow and is only as tall as we need
+	unsigned int uHeight = (uEndMCURow - uStartRow) * m_uMCUHeight;
+	unsigned int uRemaining = m_hdr.uHeight - (uStartRow * m_uMCUHeight);
+	if (uHeight > uRemaining)
+	{
+		uHeight = uRemaining;
+	}
+
+	uint8_t *p8SOFHeight = vStream.data() + m_hdr.stFrameOffset + 5;
+	p8SOFHeight[0] = (uint8_t) (uHeight >> 8);
+	p8SOFHeight[1] = (uint8_t) (uHeight & 0xFF);
+
+	return uStartRow * m_uMCUHeight;
+}
+
+bool JPEGRegionDecoder::DecodeRegion(unsigned int uX, unsigned int uY, unsigned int uWidth, unsigned int uHeight,
+	byteSA &vPixels, unsigned int *puWidth, unsigned int *puHeight, string &strError)
+{
+	if (m_vJpeg.empty())
+	{
+		strError = "No source image";
+		return false;
+	}
+
+	// clip to the image
+	if ((uX >= m_hdr.uWidth) || (uY >= m_hdr.uHeight) || (uWidth == 0) || (uHeight == 0))
+	{
+		strError = "Region is outside of the image";
+		return false;
+	}
+
+	if (uX + uWidth > m_hdr.uWidth) uWidth = m_hdr.uWidth - uX;
+	if (uY + uHeight > m_hdr.uHeight) uHeight = m_hdr.uHeight - uY;
+
+	const uint8_t *p8Src = m_vJpeg.data();
+	size_t stSrcBytes = m_vJpeg.size();
+	unsigned int uSrcFirstRow = 0;	// the image row that the first row of p8Src corresponds to
+	byteSA vSeek;
+
+	if (!m_vRestarts.empty())
+	{
+		unsigned int uFirstMCURow = uY / m_uMCUHeight;
+		unsigned int uEndMCURow = (uY + uHeight + m_uMCUHeight - 1) / m_uMCUHeight;
+
+		uSrcFirstRow = BuildSeekStream(uFirstMCURow, uEndMCURow, vSeek);
+
+		if (!vSeek.empty())
+		{
+			p8Src = vSeek.data();
+			stSrcBytes = vSeek.size();
+			m_uRestartSeeks++;
+		}
+	}
+
+	struct jpeg_decompress_struct cinfo;
+	jpeg_error_jmp err;
+	byteSA vRow;
+
+	InitJpegErrorJmp(&cinfo, &err);
+
+	if (setjmp(err.jmp))
+	{
+		strError = err.szMsg;
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, (unsigned char *) p8Src, stSrcBytes);
+	jpeg_read_header(&cinfo, TRUE);
+
+#ifdef JCS_EXTENSIONS
+	cinfo.out_color_space = JCS_EXT_RGBA;
+	const unsigned int uBytesPerPixel = 4;
+#else
+	cinfo.out_color_space = JCS_RGB;
+	const unsigned int uBytesPerPixel = 3;
+#endif
+
+	// Fancy upsampling blends in chroma from neighbouring MCUs, which aren't there at the edges of a cropped region.
+	// Plain upsampling only looks at each pixel's own MCU, so neighbouring regions join up without seams.
+	cinfo.do_fancy_upsampling = FALSE;
+
+	jpeg_start_decompress(&cinfo);
+
+	JDIMENSION uCropX = uX;
+
+#ifdef LIBJPEG_TURBO_VERSION
+	// widens the crop out to iMCU boundaries, so uCropX can move left of uX
+	JDIMENSION uCropWidth = uWidth;
+	jpeg_crop_scanline(&cinfo, &uCropX, &uCropWidth);
+
+	jpeg_skip_scanlines(&cinfo, uY - uSrcFirstRow);
+#else
+	// plain libjpeg can't crop or skip so decode and throw away what we don't need
+	uCropX = 0;
+	vRow.resize((size_t) cinfo.output_width * uBytesPerPixel);
+	while (cinfo.output_scanline < uY - uSrcFirstRow)
+	{
+		JSAMPROW row = vRow.data();
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+#endif // LIBJPEG_TURBO_VERSION
+
+	vRow.resize((size_t) cinfo.output_width * uBytesPerPixel);
+	vPixels.resize((size_t) uWidth * uHeight * 4);
+
+	unsigned int uSkipBytes = (uX - uCropX) * uBytesPerPixel;
+
+	for (unsigned int uRow = 0; uRow < uHeight; uRow++)
+	{
+		JSAMPROW row = vRow.data();
+		jpeg_read_scanlines(&cinfo, &row, 1);
+
+		const uint8_t *p8In = vRow.data() + uSkipBytes;
+		uint8_t *p8Out = vPixels.data() + ((size_t) uRow * uWidth * 4);
+
+		if (uBytesPerPixel == 4)
+		{
+			memcpy(p8Out, p8In, (size_t) uWidth * 4);
+		}
+		else
+		{
+			for (unsigned int u = 0; u < uWidth; u++, p8In += 3, p8Out += 4)
+			{
+				p8Out[0] = p8In[0];
+				p8Out[1] = p8In[1];
+				p8Out[2] = p8In[2];
+				p8Out[3] = 0xFF;
+			}
+		}
+	}
+
+	// we usually stop before the end of the image so don't make libjpeg read (and complain about) the rest
+	jpeg_abort_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+
+	*puWidth = uWidth;
+	*puHeight = uHeight;
+	return true;
+}
+
+#endif // USE_LIBJPEG
@@ -0,0 +1,66 @@
+#ifndef JPEGREGION_H
+#define JPEGREGION_H
+
+#ifdef USE_LIBJPEG
+
+#include "JPEGHeader.h"
+#include "../common/common.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Decodes rectangles out of one (usually very large) JPEG without decoding the whole image.
+// Columns outside the rectangle are cropped at MCU boundaries (libjpeg-turbo's jpeg_crop_scanline).
+// Rows above the rectangle are skipped by starting the entropy decoder at a restart marker when the image has
+//  restart markers on MCU row boundaries, otherwise they are skipped with jpeg_skip_scanlines (which still has to
+//  entropy decode them but skips the IDCT and color conversion).
+// Makes no GL calls so it can be used from any thread, but an instance must only be used by one thread at a time.
+class JPEGRegionDecoder
+{
+public:
+	JPEGRegionDecoder();
+
+	// Copies the JPEG and indexes its restart markers.
+	// Returns false if it is not a JPEG that libjpeg could decode.
+	bool SetSource(const uint8_t *p8Jpeg, size_t stSizeBytes);
+
+	const JPEGHeaderInfo &GetHeader() const { return m_hdr; }
+
+	// size of one MCU in pixels; regions that are aligned to this decode without any waste
+	unsigned int GetMCUWidth() const { return m_uMCUWidth; }
+	unsigned int GetMCUHeight() const { return m_uMCUHeight; }
+
+	// Decodes the rectangle (clipped to the image) into tightly packed RGBA (top row first).
+	// Returns false and fills in strError on failure.
+	bool DecodeRegion(unsigned int uX, unsigned int uY, unsigned int uWidth, unsigned int uHeight,
+		byteSA &vPixels, unsigned int *puWidth, unsigned int *puHeight, string &strError);
+
+	// how many DecodeRegion calls were able to start at a restart marker instead of the start of the scan
+	unsigned int GetRestartSeeks() const { return m_uRestartSeeks; }
+
+private:
+	// Builds a stream that contains MCU rows [uFirstMCURow, uEndMCURow) starting at the closest restart marker
+	//  on an MCU row boundary at or above uFirstMCURow.
+	// Returns the first pixel row of the new stream, or 0 (with vStream left empty) if there is no such marker.
+	unsigned int BuildSeekStream(unsigned int uFirstMCURow, unsigned int uEndMCURow, byteSA &vStream);
+
+	byteSA m_vJpeg;
+	JPEGHeaderInfo m_hdr;
+
+	unsigned int m_uMCUWidth, m_uMCUHeight;
+	unsigned int m_uMCUsPerRow;
+
+	// where the entropy coded data of the (only) scan starts and ends
+	size_t m_stDataOffset, m_stDataEnd;
+
+	// offset of each restart marker in the scan (empty if we can't seek with them)
+	vector<size_t> m_vRestarts;
+
+	unsigned int m_uRestartSeeks;
+};
+
+#endif // USE_LIBJPEG
+
+#endif // JPEGREGION_H
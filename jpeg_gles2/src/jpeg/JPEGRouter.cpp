@@ -0,0 +1,228 @@
+#include "JPEGRouter.h"
+#include <string.h>
+
+// the first 8 bytes of every PNG file
+static const uint8_t g_u8PNGSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+IJPEGDecodeSPtr JPEGRouter::GetInstance(IJPEGDecode *pHardware, IJPEGDecode *pSoftware, IJPEGDecode *pPNG, ILogger *pLogger)
+{
+	return IJPEGDecodeSPtr(new JPEGRouter(pHardware, pSoftware, pPNG, pLogger), JPEGRouter::deleter());
+}
+
+bool JPEGRouter::IsHardwareSupported(const JPEGHeaderInfo &hdr)
+{
+	if (hdr.bProgressive || hdr.bArithmetic || hdr.bLossless || (hdr.uPrecision != 8))
+	{
+		return false;
+	}
+
+	switch (hdr.eSubsampling)
+	{
+	case JPEG_SUBSAMPLING_GRAY:
+	case JPEG_SUBSAMPLING_444:
+	case JPEG_SUBSAMPLING_422:
+	case JPEG_SUBSAMPLING_420:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void JPEGRouter::SetInputBufSizeHint(size_t stInputBufSizeBytes)
+{
+	if (m_pHardware)
+	{
+		m_pHardware->SetInputBufSizeHint(stInputBufSizeBytes);
+	}
+
+	if (m_pSoftware)
+	{
+		m_pSoftware->SetInputBufSizeHint(stInputBufSizeBytes);
+	}
+
+	if (m_pPNG)
+	{
+		m_pPNG->SetInputBufSizeHint(stInputBufSizeBytes);
+	}
+}
+
+bool JPEGRouter::DecompressJPEGStart(const uint8_t *p8SrcJpeg, size_t stSizeBytes)
+{
+	JPEGHeaderInfo hdr;
+
+	if (m_pPNG && (stSizeBytes >= sizeof(g_u8PNGSignature)) && (memcmp(p8SrcJpeg, g_u8PNGSignature, sizeof(g_u8PNGSignature)) == 0))
+	{
+		if (!m_pPNG->DecompressJPEGStart(p8SrcJpeg, stSizeBytes))
+		{
+			return false;
+		}
+
+		m_pActive = m_pPNG;
+		m_stats.uPNG++;
+		return true;
+	}
+
+	if (!ParseJPEGHeader(p8SrcJpeg, stSizeBytes, &hdr))
+	{
+		m_stats.uInvalid++;
+		m_pLogger->Log("JPEGRouter: input is not a valid JPEG");
+		return false;
+	}
+
+	if (m_pHardware && IsHardwareSupported(hdr))
+	{
+		if (m_pHardware->DecompressJPEGStart(p8SrcJpeg, stSizeBytes))
+		{
+			m_pActive = m_pHardware;
+			m_stats.uHardware++;
+			return true;
+		}
+
+		m_stats.uHardwareRejected++;
+	}
+	else if (hdr.bProgressive)
+	{
+		m_stats.uProgressive++;
+	}
+	else if (hdr.bArithmetic || hdr.bLossless || (hdr.uPrecision != 8))
+	{
+		m_stats.uUnsupportedCoding++;
+	}
+	else if (hdr.uComponents == 4)
+	{
+		m_stats.uUnsupportedColor++;
+	}
+	else if (m_pHardware)
+	{
+		m_stats.uUnsupportedSubsampling++;
+	}
+
+	if (!m_pSoftware)
+	{
+		m_pLogger->Log("JPEGRouter: image can't be decoded in hardware and there is no software decoder");
+		return false;
+	}
+
+	if (!m_pSoftware->DecompressJPEGStart(p8SrcJpeg, stSizeBytes))
+	{
+		return false;
+	}
+
+	m_pActive = m_pSoftware;
+	m_stats.uSoftware++;
+	return true;
+}
+
+bool JPEGRouter::WaitJPEGDecompressorReady()
+{
+	if (!m_pActive)
+	{
+		m_pLogger->Log("JPEGRouter::WaitJPEGDecompressorReady: Not decoding");
+		return false;
+	}
+
+	return m_pActive->WaitJPEGDecompressorReady();
+}
+
+void JPEGRouter::SetOutputScale(unsigned int uScaleDenom)
+{
+	if (m_pHardware)
+	{
+		m_pHardware->SetOutputScale(uScaleDenom);
+	}
+
+	if (m_pSoftware)
+	{
+		m_pSoftware->SetOutputScale(uScaleDenom);
+	}
+
+	if (m_pPNG)
+	{
+		m_pPNG->SetOutputScale(uScaleDenom);
+	}
+}
+
+void JPEGRouter::SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight)
+{
+	if (m_pHardware)
+	{
+		m_pHardware->SetOutputTargetSize(uWidth, uHeight);
+	}
+
+	if (m_pSoftware)
+	{
+		m_pSoftware->SetOutputTargetSize(uWidth, uHeight);
+	}
+
+	if (m_pPNG)
+	{
+		m_pPNG->SetOutputTargetSize(uWidth, uHeight);
+	}
+}
+
+bool JPEGRouter::SetOutputYUV(bool bYUV)
+{
+	bool bRes = !bYUV;
+
+	if (m_pHardware)
+	{
+		m_pHardware->SetOutputYUV(bYUV);
+	}
+
+	if (m_pSoftware)
+	{
+		bRes = m_pSoftware->SetOutputYUV(bYUV);
+	}
+
+	if (m_pPNG)
+	{
+		m_pPNG->SetOutputYUV(bYUV);
+	}
+
+	return bRes;
+}
+
+void *JPEGRouter::GetEGLImage()
+{
+	return m_pActive ? m_pActive->GetEGLImage() : 0;
+}
+
+void JPEGRouter::DetachEGLImage()
+{
+	// detach from all of them so that none overwrites an image the caller is holding on to
+	if (m_pHardware)
+	{
+		m_pHardware->DetachEGLImage();
+	}
+
+	if (m_pSoftware)
+	{
+		m_pSoftware->DetachEGLImage();
+	}
+
+	if (m_pPNG)
+	{
+		m_pPNG->DetachEGLImage();
+	}
+}
+
+void JPEGRouter::GetDimensions(unsigned int *puWidth, unsigned int *puHeight)
+{
+	*puWidth = 0;
+	*puHeight = 0;
+
+	if (m_pActive)
+	{
+		m_pActive->GetDimensions(puWidth, puHeight);
+	}
+}
+
+JPEGRouter::JPEGRouter(IJPEGDecode *pHardware, IJPEGDecode *pSoftware, IJPEGDecode *pPNG, ILogger *pLogger) :
+m_pHardware(pHardware),
+m_pSoftware(pSoftware),
+m_pPNG(pPNG),
+m_pLogger(pLogger),
+m_pActive(NULL)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
@@ -0,0 +1,77 @@
+#ifndef JPEGROUTER_H
+#define JPEGROUTER_H
+
+#include "IJPEGDecode.h"
+#include "JPEGHeader.h"
+#include "../io/logger.h"
+
+struct JPEGRouteStats
+{
+	unsigned int uHardware;		// decodes sent to the hardware decoder
+	unsigned int uSoftware;		// decodes sent to the software decoder (for any reason)
+
+	// why images went to the software decoder
+	unsigned int uProgressive;
+	unsigned int uUnsupportedCoding;	// arithmetic, lossless or not 8 bits per sample
+	unsigned int uUnsupportedSubsampling;
+	unsigned int uUnsupportedColor;	// CMYK/YCCK (4 components), which the software decoder converts to RGB itself
+	unsigned int uHardwareRejected;	// the hardware decoder refused it (ie a resolution change)
+
+	unsigned int uPNG;			// PNGs (sent to the PNG decoder)
+
+	unsigned int uInvalid;		// not a JPEG (or PNG) at all
+};
+
+// Looks at each JPEG's header and sends it to the hardware decoder if the hardware can handle it, or to the software decoder if not.
+// The hardware decoder doesn't report unsupported input, it just times out (stalling the display for seconds), so we must not give it anything it can't do.
+// PNGs (recognized by their signature) go to the PNG decoder.
+class JPEGRouter : public IJPEGDecode, public MpoDeleter
+{
+public:
+	// either JPEG decoder may be NULL (in which case everything goes to the other one), pPNG may be NULL if PNGs aren't wanted
+	static IJPEGDecodeSPtr GetInstance(IJPEGDecode *pHardware, IJPEGDecode *pSoftware, IJPEGDecode *pPNG, ILogger *pLogger);
+
+	void SetInputBufSizeHint(size_t stInputBufSizeBytes);
+
+	bool DecompressJPEGStart(const uint8_t *p8SrcJpeg, size_t stSizeBytes);
+
+	bool WaitJPEGDecompressorReady();
+
+	bool IsJPEGDecompressorReady() { return m_pActive ? m_pActive->IsJPEGDecompressorReady() : false; }
+
+	void SetOutputScale(unsigned int uScaleDenom);
+
+	void SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight);
+
+	void *GetEGLImage();
+
+	void DetachEGLImage();
+
+	void GetDimensions(unsigned int *puWidth, unsigned int *puHeight);
+
+	// only the software decoder has to agree (images sent to the hardware or PNG decoder are still shown as RGBA)
+	bool SetOutputYUV(bool bYUV);
+
+	size_t GetImageBytes() { return m_pActive ? m_pActive->GetImageBytes() : 0; }
+
+	void GetStats(JPEGRouteStats *pStats) const { *pStats = m_stats; }
+
+	// returns true if the broadcom image_decode component can decode this image
+	static bool IsHardwareSupported(const JPEGHeaderInfo &hdr);
+
+private:
+	JPEGRouter(IJPEGDecode *pHardware, IJPEGDecode *pSoftware, IJPEGDecode *pPNG, ILogger *pLogger);
+	virtual ~JPEGRouter() { }
+
+	void DeleteInstance() { delete this; }
+
+	IJPEGDecode *m_pHardware, *m_pSoftware, *m_pPNG;
+	ILogger *m_pLogger;
+
+	// whichever decoder got the last image
+	IJPEGDecode *m_pActive;
+
+	JPEGRouteStats m_stats;
+};
+
+#endif // JPEGROUTER_H
@@ -0,0 +1,437 @@
+#ifdef USE_LIBJPEG
+
+#include "JPEGSoftware.h"
+#include "JPEGErrorJmp.h"
+#include <string.h>
+
+// libjpeg 7 made the IDCT output size separate for each direction
+#if JPEG_LIB_VERSION >= 70
+#define DCT_H_SCALED(compptr) ((compptr)->DCT_h_scaled_size)
+#define DCT_V_SCALED(compptr) ((compptr)->DCT_v_scaled_size)
+#define MIN_DCT_V_SCALED(cinfo) ((cinfo)->min_DCT_v_scaled_size)
+#else
+#define DCT_H_SCALED(compptr) ((compptr)->DCT_scaled_size)
+#define DCT_V_SCALED(compptr) ((compptr)->DCT_scaled_size)
+#define MIN_DCT_V_SCALED(cinfo) ((cinfo)->min_DCT_scaled_size)
+#endif
+
+IJPEGDecodeSPtr JPEGSoftware::GetInstance(IVideoObjectEGLImage *pEGLImage, IVideoObjectYUV *pYUV, ILogger *pLogger)
+{
+	return IJPEGDecodeSPtr(new JPEGSoftware(pEGLImage, pYUV, pLogger), JPEGSoftware::deleter());
+}
+
+bool JPEGSoftware::DecompressJPEGStart(const uint8_t *p8SrcJpeg, size_t stSizeBytes)
+{
+	if (m_bDecoding)
+	{
+		m_pLogger->Log("JPEGSoftware::DecompressJPEGStart: previous decode has not been waited for");
+		return false;
+	}
+
+	m_vSrc.assign(p8SrcJpeg, p8SrcJpeg + stSizeBytes);
+
+	// the header is needed to turn a target size into a scale (if it won't parse, libjpeg will report why)
+	JPEGHeaderInfo hdr;
+	m_uScaleDenom = 1;
+	m_bDecodeYUV = false;
+	if (ParseJPEGHeader(p8SrcJpeg, stSizeBytes, &hdr))
+	{
+		m_uScaleDenom = m_scale.GetScaleDenom(hdr.uWidth, hdr.uHeight);
+		m_bDecodeYUV = m_bYUV && IsYUVDecodable(hdr);
+	}
+
+	m_bThreadDone = false;
+
+	if (pthread_create(&m_thread, NULL, ThreadProc, this) != 0)
+	{
+		m_pLogger->Log("JPEGSoftware::DecompressJPEGStart: pthread_create failed");
+		return false;
+	}
+
+	m_bDecoding = true;
+	return true;
+}
+
+void JPEGSoftware::SetOutputScale(unsigned int uScaleDenom)
+{
+	if (!JPEGScaleRequest::IsValidDenom(uScaleDenom))
+	{
+		m_pLogger->Log("JPEGSoftware::SetOutputScale: scale must be 1, 2, 4 or 8");
+		return;
+	}
+
+	m_scale.uScaleDenom = uScaleDenom;
+}
+
+bool JPEGSoftware::SetOutputYUV(bool bYUV)
+{
+	if (bYUV && !m_pIYUV)
+	{
+		return false;
+	}
+
+	m_bYUV = bYUV;
+	return true;
+}
+
+void JPEGSoftware::SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight)
+{
+	m_scale.uTargetWidth = uWidth;
+	m_scale.uTargetHeight = uHeight;
+}
+
+bool JPEGSoftware::WaitJPEGDecompressorReady()
+{
+	bool bRes = false;
+
+	if (!m_bDecoding)
+	{
+		m_pLogger->Log("JPEGSoftware::WaitJPEGDecompressorReady exception: Not decoding");
+		return false;
+	}
+
+	pthread_join(m_thread, NULL);
+	m_bDecoding = false;
+
+	if (!m_bDecodeOK)
+	{
+		m_pLogger->Log("JPEGSoftware decode failed: " + m_strError);
+		return false;
+	}
+
+	try
+	{
+		if (m_bDecodeYUV)
+		{
+			ShowYUV();
+		}
+		else
+		{
+			// upload into a target that isn't on screen (the video object handles resolution changes)
+			m_eglImage = m_pIEGLImage->AcquireDecodeTarget(m_uWidth, m_uHeight);
+			m_pIEGLImage->UpdateEGLImage(m_eglImage, m_vPixels.data(), m_uWidth, m_uHeight);
+			m_pIEGLImage->PublishDecodeTarget(m_eglImage);
+			m_stImageBytes = (size_t) m_uWidth * m_uHeight * 4;
+		}
+
+		bRes = true;
+	}
+	catch (std::exception &ex)
+	{
+		m_pLogger->Log((string) "JPEGSoftware::WaitJPEGDecompressorReady exception: " + ex.what());
+	}
+
+	return bRes;
+}
+
+bool JPEGSoftware::DecodeToRGBA(const uint8_t *p8SrcJpeg, size_t stSizeBytes, unsigned int uScaleDenom, byteSA &vPixels, unsigned int *puWidth, unsigned int *puHeight, string &strError)
+{
+	struct jpeg_decompress_struct cinfo;
+	jpeg_error_jmp err;
+
+	InitJpegErrorJmp(&cinfo, &err);
+
+	if (setjmp(err.jmp))
+	{
+		strError = err.szMsg;
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, (unsigned char *) p8SrcJpeg, stSizeBytes);
+	jpeg_read_header(&cinfo, TRUE);
+
+	// libjpeg scales in the DCT domain, which skips most of the IDCT work rather than throwing pixels away afterwards
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = uScaleDenom;
+
+	// libjpeg can't convert CMYK/YCCK (Adobe's 4 component JPEGs) to RGB at all, and plain libjpeg 6b not even grayscale,
+	//  so those come out in their own color space and are turned into RGBA below
+	bool bCMYK = (cinfo.jpeg_color_space == JCS_CMYK) || (cinfo.jpeg_color_space == JCS_YCCK);
+	bool bGray = (cinfo.jpeg_color_space == JCS_GRAYSCALE);
+
+	if (bCMYK)
+	{
+		cinfo.out_color_space = JCS_CMYK;	// libjpeg does YCCK -> CMYK itself
+	}
+	else if (bGray)
+	{
+		cinfo.out_color_space = JCS_GRAYSCALE;
+	}
+	else
+	{
+#ifdef JCS_EXTENSIONS
+		// libjpeg-turbo can write RGBA directly
+		cinfo.out_color_space = JCS_EXT_RGBA;
+#else
+		cinfo.out_color_space = JCS_RGB;
+#endif
+	}
+
+	jpeg_start_decompress(&cinfo);
+
+	unsigned int uWidth = cinfo.output_width;
+	unsigned int uHeight = cinfo.output_height;
+	unsigned int uPitch = uWidth * 4;
+
+	// Photoshop (which writes the Adobe marker) stores CMYK inverted, 255 = no ink
+	bool bInvertedCMYK = (cinfo.saw_Adobe_marker != 0);
+
+	vPixels.resize((size_t) uPitch * uHeight);
+
+	while (cinfo.output_scanline < cinfo.output_height)
+	{
+		uint8_t *p8Row = vPixels.data() + ((size_t) cinfo.output_scanline * uPitch);
+		JSAMPROW row = p8Row;
+		jpeg_read_scanlines(&cinfo, &row, 1);
+
+		if (bCMYK)
+		{
+			// 4 bytes in, 4 bytes out, so this can go forwards: R = (1 - C) * (1 - K) etc
+			for (unsigned int x = 0; x < uWidth; x++)
+			{
+				uint8_t *p8 = p8Row + (x * 4);
+				unsigned int uC = p8[0], uM = p8[1], uY = p8[2], uK = p8[3];
+				if (!bInvertedCMYK)
+				{
+					uC = 255 - uC; uM = 255 - uM; uY = 255 - uY; uK = 255 - uK;
+				}
+				p8[0] = (uint8_t) ((uC * uK + 127) / 255);
+				p8[1] = (uint8_t) ((uM * uK + 127) / 255);
+				p8[2] = (uint8_t) ((uY * uK + 127) / 255);
+				p8[3] = 0xFF;
+			}
+		}
+		else if (bGray)
+		{
+			// expand gray to RGBA in place, working backwards so we don't overwrite what we haven't read yet
+			for (int x = (int) uWidth - 1; x >= 0; x--)
+			{
+				uint8_t u8Gray = p8Row[x];
+				p8Row[x * 4 + 3] = 0xFF;
+				p8Row[x * 4 + 2] = u8Gray;
+				p8Row[x * 4 + 1] = u8Gray;
+				p8Row[x * 4 + 0] = u8Gray;
+			}
+		}
+#ifndef JCS_EXTENSIONS
+		else
+		{
+			// expand RGB to RGBA in place, working backwards so we don't overwrite what we haven't read yet
+			for (int x = (int) uWidth - 1; x >= 0; x--)
+			{
+				p8Row[x * 4 + 3] = 0xFF;
+				p8Row[x * 4 + 2] = p8Row[x * 3 + 2];
+				p8Row[x * 4 + 1] = p8Row[x * 3 + 1];
+				p8Row[x * 4 + 0] = p8Row[x * 3 + 0];
+			}
+		}
+#endif
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+
+	*puWidth = uWidth;
+	*puHeight = uHeight;
+	return true;
+}
+
+void JPEGSoftware::ShowYUV()
+{
+	YUVSlot &slot = m_yuvSlots[m_uNextYUVSlot];
+
+	if (slot.yuvImage && ((slot.uWidth != m_yuv.uWidth) || (slot.uHeight != m_yuv.uHeight) ||
+		(slot.uChromaWidth != m_yuv.uChromaWidth) || (slot.uChromaHeight != m_yuv.uChromaHeight)))
+	{
+		m_pIYUV->DeleteYUVImage(slot.yuvImage);
+		slot.yuvImage = NULL;
+	}
+
+	if (!slot.yuvImage)
+	{
+		slot.yuvImage = m_pIYUV->CreateYUVImage(m_yuv.uWidth, m_yuv.uHeight, m_yuv.uChromaWidth, m_yuv.uChromaHeight);
+		slot.uWidth = m_yuv.uWidth;
+		slot.uHeight = m_yuv.uHeight;
+		slot.uChromaWidth = m_yuv.uChromaWidth;
+		slot.uChromaHeight = m_yuv.uChromaHeight;
+	}
+
+	m_pIYUV->UpdateYUVImage(slot.yuvImage, m_yuv.vY.data(), m_yuv.vCb.data(), m_yuv.vCr.data());
+	m_pIYUV->SetDisplayYUVImage(slot.yuvImage);
+	m_uNextYUVSlot ^= 1;
+
+	m_stImageBytes = m_yuv.vY.size() + m_yuv.vCb.size() + m_yuv.vCr.size();
+}
+
+bool JPEGSoftware::IsYUVDecodable(const JPEGHeaderInfo &hdr)
+{
+	if (hdr.uComponents != 3)
+	{
+		return false;
+	}
+
+	const JPEGComponentInfo *pY = &hdr.components[0], *pCb = &hdr.components[1], *pCr = &hdr.components[2];
+
+	// luma at full resolution and both chroma planes the same size
+	return (pY->u8H >= pCb->u8H) && (pY->u8V >= pCb->u8V) && (pCb->u8H == pCr->u8H) && (pCb->u8V == pCr->u8V);
+}
+
+bool JPEGSoftware::DecodeToYUV(const uint8_t *p8SrcJpeg, size_t stSizeBytes, unsigned int uScaleDenom, JPEGYUVPlanes &planes, string &strError)
+{
+	struct jpeg_decompress_struct cinfo;
+	jpeg_error_jmp err;
+
+	InitJpegErrorJmp(&cinfo, &err);
+
+	if (setjmp(err.jmp))
+	{
+		strError = err.szMsg;
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, (unsigned char *) p8SrcJpeg, stSizeBytes);
+	jpeg_read_header(&cinfo, TRUE);
+
+	// an Adobe RGB JPEG has 3 components too
+	if ((cinfo.num_components != 3) || (cinfo.jpeg_color_space != JCS_YCbCr))
+	{
+		strError = "not a YCbCr image";
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = uScaleDenom;
+	cinfo.out_color_space = JCS_YCbCr;
+	cinfo.raw_data_out = TRUE;
+
+	jpeg_start_decompress(&cinfo);
+
+	// libjpeg hands out whole blocks, so each plane is first decoded with padding to the right and below
+	byteSA *pvPlanes[3] = { &planes.vY, &planes.vCb, &planes.vCr };
+	unsigned int uPitches[3], uRowsPerCall[3];
+	vector<JSAMPROW> vRows[3];
+	JSAMPARRAY rowArrays[3];
+
+	for (int c = 0; c < 3; c++)
+	{
+		jpeg_component_info *compptr = &cinfo.comp_info[c];
+		uPitches[c] = compptr->width_in_blocks * DCT_H_SCALED(compptr);
+		uRowsPerCall[c] = compptr->v_samp_factor * DCT_V_SCALED(compptr);
+		pvPlanes[c]->resize((size_t) uPitches[c] * uRowsPerCall[c] * cinfo.total_iMCU_rows);
+		vRows[c].resize(uRowsPerCall[c]);
+		rowArrays[c] = vRows[c].data();
+	}
+
+	// one iMCU row per call
+	for (unsigned int uRow = 0; cinfo.output_scanline < cinfo.output_height; uRow++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			uint8_t *p8Dst = pvPlanes[c]->data() + ((size_t) uRow * uRowsPerCall[c] * uPitches[c]);
+
+			for (unsigned int u = 0; u < uRowsPerCall[c]; u++)
+			{
+				vRows[c][u] = p8Dst + ((size_t) u * uPitches[c]);
+			}
+		}
+
+		jpeg_read_raw_data(&cinfo, rowArrays, cinfo.max_v_samp_factor * MIN_DCT_V_SCALED(&cinfo));
+	}
+
+	unsigned int uWidths[3], uHeights[3];
+
+	// squeeze out the padding (rows only ever move towards the start so this can be done in place)
+	for (int c = 0; c < 3; c++)
+	{
+		uWidths[c] = cinfo.comp_info[c].downsampled_width;
+		uHeights[c] = cinfo.comp_info[c].downsampled_height;
+		uint8_t *p8Plane = pvPlanes[c]->data();
+
+		for (unsigned int y = 1; y < uHeights[c]; y++)
+		{
+			memmove(p8Plane + ((size_t) y * uWidths[c]), p8Plane + ((size_t) y * uPitches[c]), uWidths[c]);
+		}
+
+		pvPlanes[c]->resize((size_t) uWidths[c] * uHeights[c]);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+
+	planes.uWidth = uWidths[0];
+	planes.uHeight = uHeights[0];
+	planes.uChromaWidth = uWidths[1];
+	planes.uChromaHeight = uHeights[1];
+	return true;
+}
+
+void *JPEGSoftware::ThreadProc(void *pArg)
+{
+	JPEGSoftware *pThis = (JPEGSoftware *) pArg;
+
+	if (pThis->m_bDecodeYUV)
+	{
+		pThis->m_bDecodeOK = DecodeToYUV(pThis->m_vSrc.data(), pThis->m_vSrc.size(), pThis->m_uScaleDenom, pThis->m_yuv, pThis->m_strError);
+		pThis->m_uWidth = pThis->m_yuv.uWidth;
+		pThis->m_uHeight = pThis->m_yuv.uHeight;
+	}
+	else
+	{
+		pThis->m_bDecodeOK = DecodeToRGBA(pThis->m_vSrc.data(), pThis->m_vSrc.size(), pThis->m_uScaleDenom, pThis->m_vPixels,
+			&pThis->m_uWidth, &pThis->m_uHeight, pThis->m_strError);
+	}
+
+	// the results must be visible to the other thread before the flag is
+	__sync_synchronize();
+	pThis->m_bThreadDone = true;
+
+	return NULL;
+}
+
+JPEGSoftware::JPEGSoftware(IVideoObjectEGLImage *pEGLImage, IVideoObjectYUV *pYUV, ILogger *pLogger) :
+m_pIEGLImage(pEGLImage),
+m_pIYUV(pYUV),
+m_pLogger(pLogger),
+m_bYUV(false),
+m_bDecodeYUV(false),
+m_uNextYUVSlot(0),
+m_stImageBytes(0),
+m_uScaleDenom(1),
+m_bDecoding(false),
+m_bDecodeOK(false),
+m_bThreadDone(false),
+m_uWidth(0),
+m_uHeight(0),
+m_eglImage(0)
+{
+	memset(m_yuvSlots, 0, sizeof(m_yuvSlots));
+	m_yuv.uWidth = m_yuv.uHeight = m_yuv.uChromaWidth = m_yuv.uChromaHeight = 0;
+}
+
+JPEGSoftware::~JPEGSoftware()
+{
+	if (m_bDecoding)
+	{
+		pthread_join(m_thread, NULL);
+	}
+
+	if (m_eglImage != 0)
+	{
+		m_pIEGLImage->DeleteEGLImage(m_eglImage);
+	}
+
+	for (unsigned int u = 0; u < 2; u++)
+	{
+		if (m_yuvSlots[u].yuvImage)
+		{
+			m_pIYUV->DeleteYUVImage(m_yuvSlots[u].yuvImage);
+		}
+	}
+}
+
+#endif // USE_LIBJPEG
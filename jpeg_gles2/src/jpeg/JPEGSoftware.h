@@ -0,0 +1,126 @@
+#ifndef JPEGSOFTWARE_H
+#define JPEGSOFTWARE_H
+
+#ifdef USE_LIBJPEG
+
+#include "IJPEGDecode.h"
+#include "JPEGHeader.h"
+#include "../common/common.h"
+#include "../io/logger.h"
+#include "../video/VideoObjects/IVideoObjectEGLImage.h"
+#include "../video/VideoObjects/IVideoObjectYUV.h"
+
+#include <pthread.h>
+#include <string>
+
+using namespace std;
+
+// a decoded image as separate Y, Cb and Cr planes (each tightly packed, top row first)
+struct JPEGYUVPlanes
+{
+	byteSA vY, vCb, vCr;
+	unsigned int uWidth, uHeight;
+	unsigned int uChromaWidth, uChromaHeight;
+};
+
+// Decodes with libjpeg on a background thread and uploads the result to a texture.
+// Much slower than the hardware decoder but it handles everything libjpeg does (progressive, odd subsampling, etc).
+class JPEGSoftware : public IJPEGDecode, public MpoDeleter
+{
+public:
+	// pYUV may be NULL if the video object can't show YUV images
+	static IJPEGDecodeSPtr GetInstance(IVideoObjectEGLImage *pEGLImage, IVideoObjectYUV *pYUV, ILogger *pLogger);
+
+	// nothing to preallocate
+	void SetInputBufSizeHint(size_t) { }
+
+	bool DecompressJPEGStart(const uint8_t *p8SrcJpeg, size_t stSizeBytes);
+
+	// uploads the decoded pixels so this must be called from the thread that owns the GL context
+	bool WaitJPEGDecompressorReady();
+
+	bool IsJPEGDecompressorReady() { return m_bDecoding && m_bThreadDone; }
+
+	void SetOutputScale(unsigned int uScaleDenom);
+
+	void SetOutputTargetSize(unsigned int uWidth, unsigned int uHeight);
+
+	void *GetEGLImage() { return m_eglImage; }
+
+	void DetachEGLImage() { m_pIEGLImage->ReleaseDecodeTarget(m_eglImage); m_eglImage = 0; }
+
+	void GetDimensions(unsigned int *puWidth, unsigned int *puHeight) { *puWidth = m_uWidth; *puHeight = m_uHeight; }
+
+	// YCbCr images are then decoded without color conversion or chroma upsampling (anything else is still decoded to RGBA)
+	bool SetOutputYUV(bool bYUV);
+
+	size_t GetImageBytes() { return m_stImageBytes; }
+
+	// Decodes a JPEG into tightly packed RGBA (top row first), scaled down by 1/uScaleDenom in the DCT domain (1, 2, 4 or 8).
+	// Grayscale and CMYK/YCCK (plain or Adobe inverted) images are converted to RGBA too.
+	// Makes no GL calls so it is safe to call from any thread. Returns false and fills in strError on failure.
+	static bool DecodeToRGBA(const uint8_t *p8SrcJpeg, size_t stSizeBytes, unsigned int uScaleDenom, byteSA &vPixels, unsigned int *puWidth, unsigned int *puHeight, string &strError);
+
+	// Same as DecodeToRGBA but hands back libjpeg's raw (still subsampled) planes.
+	// The image must be 3 component YCbCr with Cb and Cr sampled the same way (see IsYUVDecodable).
+	static bool DecodeToYUV(const uint8_t *p8SrcJpeg, size_t stSizeBytes, unsigned int uScaleDenom, JPEGYUVPlanes &planes, string &strError);
+
+	// returns true if DecodeToYUV can handle an image with this header
+	static bool IsYUVDecodable(const JPEGHeaderInfo &hdr);
+
+private:
+	JPEGSoftware(IVideoObjectEGLImage *pEGLImage, IVideoObjectYUV *pYUV, ILogger *pLogger);
+	virtual ~JPEGSoftware();
+
+	void DeleteInstance() { delete this; }
+
+	static void *ThreadProc(void *pArg);
+
+	// uploads the planes into whichever YUV image isn't on screen and shows it
+	void ShowYUV();
+
+	IVideoObjectEGLImage *m_pIEGLImage;
+	IVideoObjectYUV *m_pIYUV;
+	ILogger *m_pLogger;
+
+	// compressed input (copied so the caller doesn't have to keep it around) and decoded output
+	byteSA m_vSrc;
+	byteSA m_vPixels;
+	JPEGYUVPlanes m_yuv;
+
+	// YUV output requested, and whether the decode in progress produces it
+	bool m_bYUV;
+	bool m_bDecodeYUV;
+
+	// two YUV images so that the one on screen is never the one being uploaded to
+	struct YUVSlot
+	{
+		void *yuvImage;
+		unsigned int uWidth, uHeight, uChromaWidth, uChromaHeight;
+	};
+	YUVSlot m_yuvSlots[2];
+	unsigned int m_uNextYUVSlot;
+
+	size_t m_stImageBytes;
+
+	JPEGScaleRequest m_scale;
+
+	// scale of the decode in progress
+	unsigned int m_uScaleDenom;
+
+	pthread_t m_thread;
+	bool m_bDecoding;
+	bool m_bDecodeOK;
+
+	// set by the decode thread once it is done with everything
+	volatile bool m_bThreadDone;
+	string m_strError;
+
+	unsigned int m_uWidth, m_uHeight;
+
+	void *m_eglImage;
+};
+
+#endif // USE_LIBJPEG
+
+#endif // JPEGSOFTWARE_H
@@ -0,0 +1,256 @@
+#ifdef USE_LIBJPEG
+
+#include "JPEGTileView.h"
+#include <string.h>
+#include <sys/time.h>
+#include <stdexcept>
+
+static unsigned int GetMs()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (unsigned int) ((tv.tv_sec * 1000) + (tv.tv_usec / 1000));
+}
+
+JPEGTileViewSPtr JPEGTileView::GetInstance(IVideoObjectEGLImage *pEGLImage, IVideoObjectSprites *pSprites,
+	unsigned int uTileSize, size_t stBudgetBytes, ILogger *pLogger)
+{
+	return JPEGTileViewSPtr(new JPEGTileView(pEGLImage, pSprites, uTileSize, stBudgetBytes, pLogger), JPEGTileView::deleter());
+}
+
+bool JPEGTileView::SetImage(const uint8_t *p8Jpeg, size_t stSizeBytes)
+{
+	FreeTiles();
+	m_setFailed.clear();
+	m_pSprites->ClearSprites();
+
+	m_bHaveImage = m_decoder.SetSource(p8Jpeg, stSizeBytes);
+
+	if (!m_bHaveImage)
+	{
+		m_pLogger->Log("JPEGTileView::SetImage: not a JPEG");
+		return false;
+	}
+
+	const JPEGHeaderInfo &hdr = m_decoder.GetHeader();
+
+	// tiles must start on MCU boundaries or the decoder has to decode (and throw away) partial MCUs
+	unsigned int uMCUWidth = m_decoder.GetMCUWidth();
+	unsigned int uMCUHeight = m_decoder.GetMCUHeight();
+	m_uTileWidth = ((m_uTileSizeHint + uMCUWidth - 1) / uMCUWidth) * uMCUWidth;
+	m_uTileHeight = ((m_uTileSizeHint + uMCUHeight - 1) / uMCUHeight) * uMCUHeight;
+
+	m_uColumns = (hdr.uWidth + m_uTileWidth - 1) / m_uTileWidth;
+
+	// default to showing the whole image
+	SetView(0, 0, hdr.uWidth, hdr.uHeight);
+
+	return true;
+}
+
+void JPEGTileView::GetImageSize(unsigned int *puWidth, unsigned int *puHeight) const
+{
+	*puWidth = m_decoder.GetHeader().uWidth;
+	*puHeight = m_decoder.GetHeader().uHeight;
+}
+
+void JPEGTileView::SetView(int iX, int iY, unsigned int uWidth, unsigned int uHeight)
+{
+	m_iViewX = iX;
+	m_iViewY = iY;
+	m_uViewWidth = (uWidth != 0) ? uWidth : 1;
+	m_uViewHeight = (uHeight != 0) ? uHeight : 1;
+}
+
+bool JPEGTileView::Update()
+{
+	if (!m_bHaveImage)
+	{
+		return false;
+	}
+
+	bool bRes = true;
+	const JPEGHeaderInfo &hdr = m_decoder.GetHeader();
+
+	m_uUpdateCount++;
+	m_pSprites->ClearSprites();
+
+	// the part of the view that is actually on the image
+	int iLeft = (m_iViewX > 0) ? m_iViewX : 0;
+	int iTop = (m_iViewY > 0) ? m_iViewY : 0;
+	int iRight = m_iViewX + (int) m_uViewWidth;
+	int iBottom = m_iViewY + (int) m_uViewHeight;
+	if (iRight > (int) hdr.uWidth) iRight = hdr.uWidth;
+	if (iBottom > (int) hdr.uHeight) iBottom = hdr.uHeight;
+
+	if ((iLeft >= iRight) || (iTop >= iBottom))
+	{
+		return true;	// nothing visible
+	}
+
+	unsigned int uFirstCol = iLeft / m_uTileWidth;
+	unsigned int uEndCol = (iRight + m_uTileWidth - 1) / m_uTileWidth;
+	unsigned int uFirstRow = iTop / m_uTileHeight;
+	unsigned int uEndRow = (iBottom + m_uTileHeight - 1) / m_uTileHeight;
+
+	for (unsigned int uRow = uFirstRow; uRow < uEndRow; uRow++)
+	{
+		for (unsigned int uCol = uFirstCol; uCol < uEndCol; uCol++)
+		{
+			unsigned int uTileX = uCol * m_uTileWidth;
+			unsigned int uTileY = uRow * m_uTileHeight;
+			unsigned int uKey = (uRow * m_uColumns) + uCol;
+
+			TileMap::iterator mi = m_mapTiles.find(uKey);
+
+			if (mi != m_mapTiles.end())
+			{
+				m_stats.uTileHits++;
+			}
+			else if (m_setFailed.count(uKey) != 0)
+			{
+				bRes = false;
+				continue;
+			}
+			else
+			{
+				unsigned int uStartMs = GetMs();
+				unsigned int uWidth = 0, uHeight = 0;
+				string strError;
+
+				if (!m_decoder.DecodeRegion(uTileX, uTileY, m_uTileWidth, m_uTileHeight, m_vPixels, &uWidth, &uHeight, strError))
+				{
+					m_pLogger->Log("JPEGTileView tile decode failed: " + strError);
+					m_setFailed.insert(uKey);
+					bRes = false;
+					continue;
+				}
+
+				Tile tile;
+
+				try
+				{
+					tile.eglImage = m_pIEGLImage->CreateEGLImage(uWidth, uHeight);
+					m_pIEGLImage->UpdateEGLImage(tile.eglImage, m_vPixels.data(), uWidth, uHeight);
+				}
+				catch (std::exception &ex)
+				{
+					m_pLogger->Log((string) "JPEGTileView tile upload failed: " + ex.what());
+					bRes = false;
+					continue;
+				}
+
+				tile.uWidth = uWidth;
+				tile.uHeight = uHeight;
+				mi = m_mapTiles.insert(TileMap::value_type(uKey, tile)).first;
+
+				m_stats.uTilesDecoded++;
+				m_stats.stBytesResident += (size_t) uWidth * uHeight * 4;
+				m_stats.uDecodeMs += GetMs() - uStartMs;
+			}
+
+			Tile &tile = mi->second;
+			tile.uLastVisible = m_uUpdateCount;
+
+			// the part of the tile that is in view, in image pixels
+			int iX0 = ((int) uTileX > iLeft) ? (int) uTileX : iLeft;
+			int iY0 = ((int) uTileY > iTop) ? (int) uTileY : iTop;
+			int iX1 = ((int) (uTileX + tile.uWidth) < iRight) ? (int) (uTileX + tile.uWidth) : iRight;
+			int iY1 = ((int) (uTileY + tile.uHeight) < iBottom) ? (int) (uTileY + tile.uHeight) : iBottom;
+
+			VideoSprite sprite;
+			sprite.eglImage = tile.eglImage;
+			sprite.fLeft = (float) (iX0 - m_iViewX) / m_uViewWidth;
+			sprite.fRight = (float) (iX1 - m_iViewX) / m_uViewWidth;
+			sprite.fTop = (float) (iY0 - m_iViewY) / m_uViewHeight;
+			sprite.fBottom = (float) (iY1 - m_iViewY) / m_uViewHeight;
+			sprite.fU0 = (float) (iX0 - (int) uTileX) / tile.uWidth;
+			sprite.fU1 = (float) (iX1 - (int) uTileX) / tile.uWidth;
+			sprite.fV0 = (float) (iY0 - (int) uTileY) / tile.uHeight;
+			sprite.fV1 = (float) (iY1 - (int) uTileY) / tile.uHeight;
+			m_pSprites->AddSprite(sprite);
+		}
+	}
+
+	Evict();
+
+	return bRes;
+}
+
+void JPEGTileView::Evict()
+{
+	while (m_stats.stBytesResident > m_stBudgetBytes)
+	{
+		TileMap::iterator miOldest = m_mapTiles.end();
+
+		for (TileMap::iterator mi = m_mapTiles.begin(); mi != m_mapTiles.end(); mi++)
+		{
+			// visible tiles stay no matter what
+			if (mi->second.uLastVisible == m_uUpdateCount)
+			{
+				continue;
+			}
+
+			if ((miOldest == m_mapTiles.end()) || (mi->second.uLastVisible < miOldest->second.uLastVisible))
+			{
+				miOldest = mi;
+			}
+		}
+
+		// everything left is on screen
+		if (miOldest == m_mapTiles.end())
+		{
+			break;
+		}
+
+		m_pIEGLImage->DeleteEGLImage(miOldest->second.eglImage);
+		m_stats.stBytesResident -= (size_t) miOldest->second.uWidth * miOldest->second.uHeight * 4;
+		m_stats.uEvictions++;
+		m_mapTiles.erase(miOldest);
+	}
+}
+
+void JPEGTileView::FreeTiles()
+{
+	for (TileMap::iterator mi = m_mapTiles.begin(); mi != m_mapTiles.end(); mi++)
+	{
+		m_pIEGLImage->DeleteEGLImage(mi->second.eglImage);
+	}
+
+	m_mapTiles.clear();
+	m_stats.stBytesResident = 0;
+}
+
+void JPEGTileView::GetStats(JPEGTileStats *pStats) const
+{
+	*pStats = m_stats;
+	pStats->uRestartSeeks = m_decoder.GetRestartSeeks();
+	pStats->uTilesResident = (unsigned int) m_mapTiles.size();
+}
+
+JPEGTileView::JPEGTileView(IVideoObjectEGLImage *pEGLImage, IVideoObjectSprites *pSprites, unsigned int uTileSize, size_t stBudgetBytes, ILogger *pLogger) :
+m_pIEGLImage(pEGLImage),
+m_pSprites(pSprites),
+m_pLogger(pLogger),
+m_bHaveImage(false),
+m_uTileSizeHint(uTileSize),
+m_uTileWidth(uTileSize),
+m_uTileHeight(uTileSize),
+m_uColumns(0),
+m_iViewX(0),
+m_iViewY(0),
+m_uViewWidth(1),
+m_uViewHeight(1),
+m_uUpdateCount(0),
+m_stBudgetBytes(stBudgetBytes)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+JPEGTileView::~JPEGTileView()
+{
+	m_pSprites->ClearSprites();
+	FreeTiles();
+}
+
+#endif // USE_LIBJPEG
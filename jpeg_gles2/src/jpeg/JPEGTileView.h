@@ -0,0 +1,106 @@
+#ifndef JPEGTILEVIEW_H
+#define JPEGTILEVIEW_H
+
+#ifdef USE_LIBJPEG
+
+#include "JPEGRegion.h"
+#include "../common/mpo_deleter.h"
+#include "../io/logger.h"
+#include "../video/VideoObjects/IVideoObjectEGLImage.h"
+#include "../video/VideoObjects/IVideoObjectSprites.h"
+
+#include <map>
+#include <set>
+
+using namespace std;
+
+struct JPEGTileStats
+{
+	unsigned int uTilesDecoded;
+	unsigned int uTileHits;		// visible tiles that were already resident
+	unsigned int uEvictions;
+	unsigned int uRestartSeeks;	// decodes that started at a restart marker
+	unsigned int uTilesResident;
+	size_t stBytesResident;
+	unsigned int uDecodeMs;		// total time spent decoding and uploading tiles
+};
+
+// Shows a window onto an image that is much bigger than the screen.
+// The image is split into a grid of MCU aligned tiles. Only tiles that are visible get decoded (each into its own texture),
+//  so panning only costs the tiles that come into view instead of a decode of the whole image.
+// Tiles that have scrolled out of view stay resident (for panning back) until the byte budget is exceeded.
+// All methods must be called from the thread that owns the GL context.
+class JPEGTileView : public MpoDeleter
+{
+public:
+	static shared_ptr<JPEGTileView> GetInstance(IVideoObjectEGLImage *pEGLImage, IVideoObjectSprites *pSprites,
+		unsigned int uTileSize, size_t stBudgetBytes, ILogger *pLogger);
+
+	// frees all tiles of the previous image; returns false if the image can't be decoded
+	bool SetImage(const uint8_t *p8Jpeg, size_t stSizeBytes);
+
+	void GetImageSize(unsigned int *puWidth, unsigned int *puHeight) const;
+
+	// selects the rectangle of the image (in image pixels) that fills the screen
+	void SetView(int iX, int iY, unsigned int uWidth, unsigned int uHeight);
+
+	// Decodes any tiles that have come into view and replaces the video object's sprites with the visible tiles.
+	// Call once per frame before RenderFrame. Returns false if a visible tile failed to decode (now or earlier).
+	bool Update();
+
+	void GetStats(JPEGTileStats *pStats) const;
+
+private:
+	JPEGTileView(IVideoObjectEGLImage *pEGLImage, IVideoObjectSprites *pSprites, unsigned int uTileSize, size_t stBudgetBytes, ILogger *pLogger);
+	virtual ~JPEGTileView();
+
+	void DeleteInstance() { delete this; }
+
+	// frees the least recently visible tiles (never ones that are visible now) until we are within budget
+	void Evict();
+
+	void FreeTiles();
+
+	struct Tile
+	{
+		void *eglImage;
+		unsigned int uWidth, uHeight;
+		unsigned int uLastVisible;	// the Update count when this was last on screen
+	};
+
+	// keyed on row * columns + column
+	typedef map<unsigned int, Tile> TileMap;
+
+	IVideoObjectEGLImage *m_pIEGLImage;
+	IVideoObjectSprites *m_pSprites;
+	ILogger *m_pLogger;
+
+	JPEGRegionDecoder m_decoder;
+	bool m_bHaveImage;
+
+	// requested tile size, and the actual one (rounded up to whole MCUs) for the current image
+	unsigned int m_uTileSizeHint;
+	unsigned int m_uTileWidth, m_uTileHeight;
+	unsigned int m_uColumns;
+
+	int m_iViewX, m_iViewY;
+	unsigned int m_uViewWidth, m_uViewHeight;
+
+	TileMap m_mapTiles;
+	unsigned int m_uUpdateCount;
+
+	// tiles of the current image that failed to decode, so they aren't decoded (and logged) again every frame
+	set<unsigned int> m_setFailed;
+
+	// decode output (kept around to avoid reallocating for every tile)
+	byteSA m_vPixels;
+
+	size_t m_stBudgetBytes;
+	JPEGTileStats m_stats;
+};
+
+typedef shared_ptr<JPEGTileView> JPEGTileViewSPtr;
+
+#endif // USE_LIBJPEG
+
+#endif // JPEGTILEVIEW_H
@@ -0,0 +1,911 @@
+#ifdef USE_PNG
+
+#include "PNGDecode.h"
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// rows in flight between the stages (and how many a stage handles per lock)
+#define PNG_RING_ROWS 64
+#define PNG_BATCH_ROWS 8
+
+// images with less than this many RGBA bytes aren't worth starting threads for
+#define PNG_THREADED_MIN_BYTES (256 * 1024)
+
+static const uint8_t g_u8PNGSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+// where each Adam7 pass starts and how far apart its pixels are
+static const unsigned int g_uAdam7X0[7] = { 0, 4, 0, 2, 0, 1, 0 };
+static const unsigned int g_uAdam7Y0[7] = { 0, 0, 4, 0, 2, 0, 1 };
+static const unsigned int g_uAdam7DX[7] = { 8, 8, 4, 4, 2, 2, 1 };
+static const unsigned int g_uAdam7DY[7] = { 8, 8, 8, 4, 4, 2, 2 };
+
+static inline uint32_t ReadBE32(const uint8_t *p8)
+{
+	return ((uint32_t) p8[0] << 24) | ((uint32_t) p8[1] << 16) | ((uint32_t) p8[2] << 8) | p8[3];
+}
+
+static unsigned int PNGChannels(unsigned int uColorType)
+{
+	switch (uColorType)
+	{
+	case 2: return 3;
+	case 4: return 2;
+	case 6: return 4;
+	default: return 1;	// gray and palette
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// One image decode. The calling thread inflates rows into a ring, one thread undoes the row filters in order
+//  (each row depends on the one above it) and the workers convert finished rows to RGBA in any order.
+// A ring slot is reused once its row has been converted and the row below it no longer needs it for unfiltering.
+class PNGPipeline
+{
+public:
+	PNGPipeline(const PNGHeaderInfo &hdr, uint8_t *p8Dst, unsigned int uDstPitch);
+	~PNGPipeline();
+
+	// PLTE and tRNS chunk contents (either may be NULL)
+	void SetPalette(const uint8_t *p8Plte, unsigned int uPlteBytes, const uint8_t *p8Trns, unsigned int uTrnsBytes);
+
+	// the IDAT chunks in file order (their concatenation is one zlib stream)
+	void AddIDAT(const uint8_t *p8Data, unsigned int uBytes);
+
+	bool Run(unsigned int uWorkers, string &strError);
+
+private:
+	// one filtered row of one Adam7 pass (a non-interlaced image is a single pass)
+	struct Row
+	{
+		unsigned int uPass;
+		unsigned int uY;		// row within the pass
+		unsigned int uWidth;	// pixels in this row
+		unsigned int uBytes;	// without the filter byte
+		bool bFirstInPass;		// unfiltered against a row of zeros
+	};
+
+	bool InflateRow(unsigned int uRow, string &strError);
+	bool UnfilterRow(unsigned int uRow, string &strError);
+	void ConvertRow(unsigned int uRow);
+
+	// start of the row's data in its ring slot (the bpp bytes in front of it are always 0 so the left neighbor of the first pixel is 0)
+	uint8_t *RowData(unsigned int uRow) { return &m_vRing[(uRow % PNG_RING_ROWS) * m_uSlotBytes + m_uBpp]; }
+
+	void Abort(const string &strError);
+
+	void InflateStage(string &strError);
+	static void *UnfilterThreadProc(void *pArg);
+	static void *ConvertThreadProc(void *pArg);
+
+	PNGHeaderInfo m_hdr;
+	uint8_t *m_p8Dst;
+	unsigned int m_uDstPitch;
+
+	// bytes per complete pixel (at least 1), which is how far back the filters look
+	unsigned int m_uBpp;
+
+	vector<Row> m_vRows;
+	byteSA m_vRing;
+	unsigned int m_uSlotBytes;
+	byteSA m_vZeroRow;
+
+	// RGBA (in memory order) for each palette index, with tRNS applied
+	uint8_t m_u8Palette[256][4];
+
+	// tRNS color key for gray and RGB images, at the image's bit depth
+	bool m_bColorKey;
+	unsigned int m_uKey[3];
+
+	vector<const uint8_t *> m_vIDAT;
+	vector<unsigned int> m_vIDATBytes;
+	unsigned int m_uNextIDAT;
+	z_stream m_zs;
+	bool m_bZInit;
+
+	// progress (guarded by m_mutex when threaded)
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_condInflated, m_condUnfiltered, m_condRoom;
+	unsigned int m_uInflated;		// rows inflated
+	unsigned int m_uUnfiltered;		// rows unfiltered
+	unsigned int m_uNextConvert;	// next row to hand to a worker
+	unsigned int m_uConverted;		// rows converted (all of them, in order; see m_vConvertDone)
+	byteSA m_vConvertDone;			// per ring slot, converted but not counted in m_uConverted yet
+	bool m_bAbort;
+	string m_strAbort;
+};
+
+PNGPipeline::PNGPipeline(const PNGHeaderInfo &hdr, uint8_t *p8Dst, unsigned int uDstPitch) :
+m_hdr(hdr),
+m_p8Dst(p8Dst),
+m_uDstPitch(uDstPitch),
+m_uSlotBytes(0),
+m_bColorKey(false),
+m_uNextIDAT(0),
+m_bZInit(false),
+m_uInflated(0),
+m_uUnfiltered(0),
+m_uNextConvert(0),
+m_uConverted(0),
+m_bAbort(false)
+{
+	unsigned int uBitsPerPixel = PNGChannels(hdr.uColorType) * hdr.uBitDepth;
+	m_uBpp = (uBitsPerPixel + 7) / 8;
+
+	unsigned int uPasses = hdr.bInterlaced ? 7 : 1;
+	unsigned int uMaxBytes = 0;
+
+	for (unsigned int uPass = 0; uPass < uPasses; uPass++)
+	{
+		unsigned int uX0 = hdr.bInterlaced ? g_uAdam7X0[uPass] : 0, uDX = hdr.bInterlaced ? g_uAdam7DX[uPass] : 1;
+		unsigned int uY0 = hdr.bInterlaced ? g_uAdam7Y0[uPass] : 0, uDY = hdr.bInterlaced ? g_uAdam7DY[uPass] : 1;
+		unsigned int uPassWidth = (hdr.uWidth > uX0) ? ((hdr.uWidth - uX0 + uDX - 1) / uDX) : 0;
+		unsigned int uPassHeight = (hdr.uHeight > uY0) ? ((hdr.uHeight - uY0 + uDY - 1) / uDY) : 0;
+
+		// empty passes aren't in the data at all
+		if ((uPassWidth == 0) || (uPassHeight == 0))
+		{
+			continue;
+		}
+
+		Row row;
+		row.uPass = uPass;
+		row.uWidth = uPassWidth;
+		row.uBytes = (unsigned int) (((unsigned long long) uPassWidth * uBitsPerPixel + 7) / 8);
+
+		for (unsigned int uY = 0; uY < uPassHeight; uY++)
+		{
+			row.uY = uY;
+			row.bFirstInPass = (uY == 0);
+			m_vRows.push_back(row);
+		}
+
+		if (row.uBytes > uMaxBytes)
+		{
+			uMaxBytes = row.uBytes;
+		}
+	}
+
+	m_uSlotBytes = m_uBpp + uMaxBytes;
+	m_vRing.assign((size_t) m_uSlotBytes * PNG_RING_ROWS, 0);
+	m_vZeroRow.assign(m_uSlotBytes, 0);
+	m_vConvertDone.assign(PNG_RING_ROWS, 0);
+
+	for (unsigned int u = 0; u < 256; u++)
+	{
+		m_u8Palette[u][0] = m_u8Palette[u][1] = m_u8Palette[u][2] = 0;
+		m_u8Palette[u][3] = 0xFF;
+	}
+	m_uKey[0] = m_uKey[1] = m_uKey[2] = 0;
+
+	memset(&m_zs, 0, sizeof(m_zs));
+
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_condInflated, NULL);
+	pthread_cond_init(&m_condUnfiltered, NULL);
+	pthread_cond_init(&m_condRoom, NULL);
+}
+
+PNGPipeline::~PNGPipeline()
+{
+	if (m_bZInit)
+	{
+		inflateEnd(&m_zs);
+	}
+
+	pthread_cond_destroy(&m_condRoom);
+	pthread_cond_destroy(&m_condUnfiltered);
+	pthread_cond_destroy(&m_condInflated);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+void PNGPipeline::SetPalette(const uint8_t *p8Plte, unsigned int uPlteBytes, const uint8_t *p8Trns, unsigned int uTrnsBytes)
+{
+	if (m_hdr.uColorType == 3)
+	{
+		for (unsigned int u = 0; (u < 256) && (u * 3 + 2 < uPlteBytes); u++)
+		{
+			m_u8Palette[u][0] = p8Plte[u * 3 + 0];
+			m_u8Palette[u][1] = p8Plte[u * 3 + 1];
+			m_u8Palette[u][2] = p8Plte[u * 3 + 2];
+		}
+
+		// one alpha per palette entry, the ones that aren't listed are opaque
+		for (unsigned int u = 0; (u < 256) && (u < uTrnsBytes); u++)
+		{
+			m_u8Palette[u][3] = p8Trns[u];
+		}
+	}
+	// gray: one 16-bit sample, RGB: three
+	else if ((m_hdr.uColorType == 0) && (uTrnsBytes >= 2))
+	{
+		m_bColorKey = true;
+		m_uKey[0] = (p8Trns[0] << 8) | p8Trns[1];
+	}
+	else if ((m_hdr.uColorType == 2) && (uTrnsBytes >= 6))
+	{
+		m_bColorKey = true;
+		m_uKey[0] = (p8Trns[0] << 8) | p8Trns[1];
+		m_uKey[1] = (p8Trns[2] << 8) | p8Trns[3];
+		m_uKey[2] = (p8Trns[4] << 8) | p8Trns[5];
+	}
+}
+
+void PNGPipeline::AddIDAT(const uint8_t *p8Data, unsigned int uBytes)
+{
+	m_vIDAT.push_back(p8Data);
+	m_vIDATBytes.push_back(uBytes);
+}
+
+bool PNGPipeline::InflateRow(unsigned int uRow, string &strError)
+{
+	const Row &row = m_vRows[uRow];
+
+	// the filter byte lands right in front of the row (in the last pad byte, which is put back to 0 by UnfilterRow)
+	m_zs.next_out = RowData(uRow) - 1;
+	m_zs.avail_out = row.uBytes + 1;
+
+	while (m_zs.avail_out != 0)
+	{
+		if (m_zs.avail_in == 0)
+		{
+			if (m_uNextIDAT == m_vIDAT.size())
+			{
+				strError = "image data is truncated";
+				return false;
+			}
+
+			m_zs.next_in = (Bytef *) m_vIDAT[m_uNextIDAT];
+			m_zs.avail_in = m_vIDATBytes[m_uNextIDAT];
+			m_uNextIDAT++;
+			continue;
+		}
+
+		int iRes = inflate(&m_zs, Z_NO_FLUSH);
+
+		if ((iRes == Z_STREAM_END) && (m_zs.avail_out != 0))
+		{
+			strError = "image data ends early";
+			return false;
+		}
+
+		if ((iRes != Z_OK) && (iRes != Z_STREAM_END) && (iRes != Z_BUF_ERROR))
+		{
+			strError = (string) "inflate failed: " + (m_zs.msg ? m_zs.msg : "corrupt data");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static inline uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+	int p = (int) a + b - c;
+	int pa = (p > a) ? (p - a) : (a - p);
+	int pb = (p > b) ? (p - b) : (b - p);
+	int pc = (p > c) ? (p - c) : (c - p);
+
+	if ((pa <= pb) && (pa <= pc))
+	{
+		return a;
+	}
+
+	return (pb <= pc) ? b : c;
+}
+
+bool PNGPipeline::UnfilterRow(unsigned int uRow, string &strError)
+{
+	const Row &row = m_vRows[uRow];
+	uint8_t *p8Cur = RowData(uRow);
+	const uint8_t *p8Prior = row.bFirstInPass ? (&m_vZeroRow[m_uBpp]) : RowData(uRow - 1);
+	unsigned int uBytes = row.uBytes;
+	unsigned int uBpp = m_uBpp;
+	unsigned int u;
+
+	uint8_t u8Filter = p8Cur[-1];
+	p8Cur[-1] = 0;
+
+	switch (u8Filter)
+	{
+	case 0:	// none
+		break;
+	case 1:	// sub (the pad in front of the row takes care of the first pixel)
+		for (u = uBpp; u < uBytes; u++)
+		{
+			p8Cur[u] = (uint8_t) (p8Cur[u] + p8Cur[u - uBpp]);
+		}
+		break;
+	case 2:	// up
+		for (u = 0; u < uBytes; u++)
+		{
+			p8Cur[u] = (uint8_t) (p8Cur[u] + p8Prior[u]);
+		}
+		break;
+	case 3:	// average
+		for (u = 0; u < uBytes; u++)
+		{
+			p8Cur[u] = (uint8_t) (p8Cur[u] + ((p8Cur[(int) u - (int) uBpp] + p8Prior[u]) >> 1));
+		}
+		break;
+	case 4:	// paeth
+		for (u = 0; u < uBytes; u++)
+		{
+			p8Cur[u] = (uint8_t) (p8Cur[u] + Paeth(p8Cur[(int) u - (int) uBpp], p8Prior[u], p8Prior[(int) u - (int) uBpp]));
+		}
+		break;
+	default:
+		strError = "unknown row filter";
+		return false;
+	}
+
+	return true;
+}
+
+void PNGPipeline::ConvertRow(unsigned int uRow)
+{
+	const Row &row = m_vRows[uRow];
+	const uint8_t *p8Src = RowData(uRow);
+	unsigned int uX0 = m_hdr.bInterlaced ? g_uAdam7X0[row.uPass] : 0, uDX = m_hdr.bInterlaced ? g_uAdam7DX[row.uPass] : 1;
+	unsigned int uY0 = m_hdr.bInterlaced ? g_uAdam7Y0[row.uPass] : 0, uDY = m_hdr.bInterlaced ? g_uAdam7DY[row.uPass] : 1;
+	uint8_t *p8Out = m_p8Dst + ((size_t) (uY0 + row.uY * uDY) * m_uDstPitch) + uX0 * 4;
+	unsigned int uStep = uDX * 4;
+	unsigned int uWidth = row.uWidth;
+	unsigned int uDepth = m_hdr.uBitDepth;
+	unsigned int x;
+
+	// the common case for UI assets
+	if ((m_hdr.uColorType == 6) && (uDepth == 8) && (uDX == 1))
+	{
+		memcpy(p8Out, p8Src, uWidth * 4);
+		return;
+	}
+
+	switch (m_hdr.uColorType)
+	{
+	case 6:	// RGBA (16 bit samples keep their high byte)
+	case 2:	// RGB
+	case 4:	// gray + alpha
+	{
+		unsigned int uChannels = PNGChannels(m_hdr.uColorType);
+		unsigned int uSampleBytes = uDepth / 8;
+		unsigned int uPixelBytes = uChannels * uSampleBytes;
+
+		for (x = 0; x < uWidth; x++, p8Out += uStep, p8Src += uPixelBytes)
+		{
+			if (m_hdr.uColorType == 4)
+			{
+				p8Out[0] = p8Out[1] = p8Out[2] = p8Src[0];
+				p8Out[3] = p8Src[uSampleBytes];
+				continue;
+			}
+
+			p8Out[0] = p8Src[0];
+			p8Out[1] = p8Src[uSampleBytes];
+			p8Out[2] = p8Src[uSampleBytes * 2];
+
+			if (m_hdr.uColorType == 6)
+			{
+				p8Out[3] = p8Src[uSampleBytes * 3];
+			}
+			else if (m_bColorKey)
+			{
+				unsigned int uR = p8Src[0], uG = p8Src[uSampleBytes], uB = p8Src[uSampleBytes * 2];
+
+				if (uSampleBytes == 2)
+				{
+					uR = (uR << 8) | p8Src[1];
+					uG = (uG << 8) | p8Src[3];
+					uB = (uB << 8) | p8Src[5];
+				}
+
+				p8Out[3] = ((uR == m_uKey[0]) && (uG == m_uKey[1]) && (uB == m_uKey[2])) ? 0 : 0xFF;
+			}
+			else
+			{
+				p8Out[3] = 0xFF;
+			}
+		}
+		break;
+	}
+	case 3:	// palette (1, 2, 4 or 8 bit indices)
+	case 0:	// gray (1, 2, 4, 8 or 16 bits)
+	{
+		// what a sample of each bit depth has to be multiplied by to get to 0..255
+		static const unsigned int uScale[9] = { 0, 255, 85, 0, 17, 0, 0, 0, 1 };
+		unsigned int uMask = (1 << uDepth) - 1;
+
+		for (x = 0; x < uWidth; x++, p8Out += uStep)
+		{
+			unsigned int uSample;
+
+			if (uDepth == 16)
+			{
+				uSample = (p8Src[x * 2] << 8) | p8Src[x * 2 + 1];
+			}
+			else
+			{
+				// packed samples start at the most significant bits
+				unsigned int uBit = x * uDepth;
+				uSample = (p8Src[uBit >> 3] >> (8 - uDepth - (uBit & 7))) & uMask;
+			}
+
+			if (m_hdr.uColorType == 3)
+			{
+				memcpy(p8Out, m_u8Palette[uSample], 4);
+				continue;
+			}
+
+			uint8_t u8Gray = (uint8_t) ((uDepth == 16) ? (uSample >> 8) : (uSample * uScale[uDepth]));
+			p8Out[0] = p8Out[1] = p8Out[2] = u8Gray;
+			p8Out[3] = (m_bColorKey && (uSample == m_uKey[0])) ? 0 : 0xFF;
+		}
+		break;
+	}
+	}
+}
+
+void PNGPipeline::Abort(const string &strError)
+{
+	pthread_mutex_lock(&m_mutex);
+	if (!m_bAbort)
+	{
+		m_bAbort = true;
+		m_strAbort = strError;
+	}
+	pthread_cond_broadcast(&m_condInflated);
+	pthread_cond_broadcast(&m_condUnfiltered);
+	pthread_cond_broadcast(&m_condRoom);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void PNGPipeline::InflateStage(string &strError)
+{
+	unsigned int uRows = (unsigned int) m_vRows.size();
+	unsigned int uRow = 0;
+
+	while (uRow < uRows)
+	{
+		// wait until the slots we are about to overwrite are no longer needed
+		pthread_mutex_lock(&m_mutex);
+		while (!m_bAbort && ((uRow >= m_uConverted + PNG_RING_ROWS) || (uRow + 1 >= m_uUnfiltered + PNG_RING_ROWS)))
+		{
+			pthread_cond_wait(&m_condRoom, &m_mutex);
+		}
+
+		unsigned int uLimit = m_uConverted + PNG_RING_ROWS;
+		if (m_uUnfiltered + PNG_RING_ROWS - 1 < uLimit)
+		{
+			uLimit = m_uUnfiltered + PNG_RING_ROWS - 1;
+		}
+		bool bAbort = m_bAbort;
+		pthread_mutex_unlock(&m_mutex);
+
+		if (bAbort)
+		{
+			return;
+		}
+
+		unsigned int uEnd = uRow + PNG_BATCH_ROWS;
+		if (uEnd > uLimit) uEnd = uLimit;
+		if (uEnd > uRows) uEnd = uRows;
+
+		for (; uRow < uEnd; uRow++)
+		{
+			if (!InflateRow(uRow, strError))
+			{
+				Abort(strError);
+				return;
+			}
+		}
+
+		pthread_mutex_lock(&m_mutex);
+		m_uInflated = uRow;
+		pthread_cond_signal(&m_condInflated);
+		pthread_mutex_unlock(&m_mutex);
+	}
+}
+
+void *PNGPipeline::UnfilterThreadProc(void *pArg)
+{
+	PNGPipeline *pThis = (PNGPipeline *) pArg;
+	unsigned int uRows = (unsigned int) pThis->m_vRows.size();
+	unsigned int uRow = 0;
+	string strError;
+
+	while (uRow < uRows)
+	{
+		pthread_mutex_lock(&pThis->m_mutex);
+		while (!pThis->m_bAbort && (pThis->m_uInflated == uRow))
+		{
+			pthread_cond_wait(&pThis->m_condInflated, &pThis->m_mutex);
+		}
+		unsigned int uEnd = pThis->m_uInflated;
+		bool bAbort = pThis->m_bAbort;
+		pthread_mutex_unlock(&pThis->m_mutex);
+
+		if (bAbort)
+		{
+			break;
+		}
+
+		if (uEnd > uRow + PNG_BATCH_ROWS)
+		{
+			uEnd = uRow + PNG_BATCH_ROWS;
+		}
+
+		for (; uRow < uEnd; uRow++)
+		{
+			if (!pThis->UnfilterRow(uRow, strError))
+			{
+				pThis->Abort(strError);
+				return NULL;
+			}
+		}
+
+		pthread_mutex_lock(&pThis->m_mutex);
+		pThis->m_uUnfiltered = uRow;
+		pthread_cond_broadcast(&pThis->m_condUnfiltered);
+		pthread_cond_signal(&pThis->m_condRoom);
+		pthread_mutex_unlock(&pThis->m_mutex);
+	}
+
+	return NULL;
+}
+
+void *PNGPipeline::ConvertThreadProc(void *pArg)
+{
+	PNGPipeline *pThis = (PNGPipeline *) pArg;
+	unsigned int uRows = (unsigned int) pThis->m_vRows.size();
+
+	pthread_mutex_lock(&pThis->m_mutex);
+
+	for (;;)
+	{
+		while (!pThis->m_bAbort && (pThis->m_uNextConvert < uRows) && (pThis->m_uNextConvert == pThis->m_uUnfiltered))
+		{
+			pthread_cond_wait(&pThis->m_condUnfiltered, &pThis->m_mutex);
+		}
+
+		if (pThis->m_bAbort || (pThis->m_uNextConvert == uRows))
+		{
+			break;
+		}
+
+		// take a few rows, but leave some for the other workers
+		unsigned int uRow = pThis->m_uNextConvert;
+		unsigned int uEnd = pThis->m_uUnfiltered;
+		if (uEnd > uRow + PNG_BATCH_ROWS / 2)
+		{
+			uEnd = uRow + PNG_BATCH_ROWS / 2;
+		}
+		pThis->m_uNextConvert = uEnd;
+		pthread_mutex_unlock(&pThis->m_mutex);
+
+		for (unsigned int u = uRow; u < uEnd; u++)
+		{
+			pThis->ConvertRow(u);
+		}
+
+		pthread_mutex_lock(&pThis->m_mutex);
+
+		// rows finish out of order but the inflater can only reuse slots from the oldest one up
+		for (unsigned int u = uRow; u < uEnd; u++)
+		{
+			pThis->m_vConvertDone[u % PNG_RING_ROWS] = 1;
+		}
+		while ((pThis->m_uConverted < uRows) && pThis->m_vConvertDone[pThis->m_uConverted % PNG_RING_ROWS])
+		{
+			pThis->m_vConvertDone[pThis->m_uConverted % PNG_RING_ROWS] = 0;
+			pThis->m_uConverted++;
+		}
+		pthread_cond_signal(&pThis->m_condRoom);
+	}
+
+	pthread_mutex_unlock(&pThis->m_mutex);
+	return NULL;
+}
+
+bool PNGPipeline::Run(unsigned int uWorkers, string &strError)
+{
+	if (inflateInit(&m_zs) != Z_OK)
+	{
+		strError = "inflateInit failed";
+		return false;
+	}
+	m_bZInit = true;
+
+	unsigned int uRows = (unsigned int) m_vRows.size();
+
+	// everything on this thread, one row at a time
+	if (uWorkers == 0)
+	{
+		for (unsigned int uRow = 0; uRow < uRows; uRow++)
+		{
+			if (!InflateRow(uRow, strError) || !UnfilterRow(uRow, strError))
+			{
+				return false;
+			}
+			ConvertRow(uRow);
+		}
+		return true;
+	}
+
+	pthread_t threadUnfilter;
+	vector<pthread_t> vWorkers;
+
+	if (pthread_create(&threadUnfilter, NULL, UnfilterThreadProc, this) != 0)
+	{
+		strError = "pthread_create failed";
+		return false;
+	}
+
+	for (unsigned int u = 0; u < uWorkers; u++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, ConvertThreadProc, this) == 0)
+		{
+			vWorkers.push_back(thread);
+		}
+	}
+
+	if (vWorkers.empty())
+	{
+		Abort("pthread_create failed");
+	}
+
+	InflateStage(strError);
+
+	// the workers stop once every row is converted (or on an error)
+	pthread_join(threadUnfilter, NULL);
+	for (unsigned int u = 0; u < vWorkers.size(); u++)
+	{
+		pthread_join(vWorkers[u], NULL);
+	}
+
+	if (m_bAbort)
+	{
+		strError = m_strAbort;
+		return false;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+IJPEGDecodeSPtr PNGDecode::GetInstance(IVideoObjectEGLImage *pEGLImage, ILogger *pLogger)
+{
+	return IJPEGDecodeSPtr(new PNGDecode(pEGLImage, pLogger), PNGDecode::deleter());
+}
+
+bool PNGDecode::IsPNG(const uint8_t *p8Src, size_t stSizeBytes)
+{
+	return (stSizeBytes >= sizeof(g_u8PNGSignature)) && (memcmp(p8Src, g_u8PNGSignature, sizeof(g_u8PNGSignature)) == 0);
+}
+
+bool PNGDecode::ParsePNGHeader(const uint8_t *p8Src, size_t stSizeBytes, PNGHeaderInfo *pHdr)
+{
+	// signature, then IHDR has to be the first chunk (length, type, 13 bytes of data)
+	if (!IsPNG(p8Src, stSizeBytes) || (stSizeBytes < 8 + 8 + 13) || (ReadBE32(p8Src + 8) != 13) || (memcmp(p8Src + 12, "IHDR", 4) != 0))
+	{
+		return false;
+	}
+
+	const uint8_t *p8 = p8Src + 16;
+	pHdr->uWidth = ReadBE32(p8);
+	pHdr->uHeight = ReadBE32(p8 + 4);
+	pHdr->uBitDepth = p8[8];
+	pHdr->uColorType = p8[9];
+	pHdr->bInterlaced = (p8[12] == 1);
+
+	// compression and filter method 0 are the only ones there are
+	if ((pHdr->uWidth == 0) || (pHdr->uHeight == 0) || (pHdr->uWidth > 0x7FFF) || (pHdr->uHeight > 0x7FFF) ||
+		(p8[10] != 0) || (p8[11] != 0) || (p8[12] > 1))
+	{
+		return false;
+	}
+
+	switch (pHdr->uColorType)
+	{
+	case 0:
+		return (pHdr->uBitDepth == 1) || (pHdr->uBitDepth == 2) || (pHdr->uBitDepth == 4) || (pHdr->uBitDepth == 8) || (pHdr->uBitDepth == 16);
+	case 3:
+		return (pHdr->uBitDepth == 1) || (pHdr->uBitDepth == 2) || (pHdr->uBitDepth == 4) || (pHdr->uBitDepth == 8);
+	case 2:
+	case 4:
+	case 6:
+		return (pHdr->uBitDepth == 8) || (pHdr->uBitDepth == 16);
+	default:
+		return false;
+	}
+}
+
+bool PNGDecode::DecodeToRGBA(const uint8_t *p8SrcPng, size_t stSizeBytes, uint8_t *p8Dst, unsigned int uDstPitch, unsigned int uWorkers, string &strError)
+{
+	PNGHeaderInfo hdr;
+
+	if (!ParsePNGHeader(p8SrcPng, stSizeBytes, &hdr))
+	{
+		strError = "not a PNG (or an unsupported one)";
+		return false;
+	}
+
+	PNGPipeline pipeline(hdr, p8Dst, uDstPitch);
+
+	// walk the chunks (CRCs aren't checked, zlib's own checksum covers the image data)
+	const uint8_t *p8Plte = NULL, *p8Trns = NULL;
+	unsigned int uPlteBytes = 0, uTrnsBytes = 0;
+	bool bHaveIDAT = false;
+	size_t stPos = 8;
+
+	while (stPos + 12 <= stSizeBytes)
+	{
+		uint32_t u32Len = ReadBE32(p8SrcPng + stPos);
+		const uint8_t *p8Type = p8SrcPng + stPos + 4;
+		const uint8_t *p8Data = p8SrcPng + stPos + 8;
+
+		if (u32Len > stSizeBytes - stPos - 12)
+		{
+			strError = "chunk runs past the end of the file";
+			return false;
+		}
+
+		if (memcmp(p8Type, "IDAT", 4) == 0)
+		{
+			pipeline.AddIDAT(p8Data, u32Len);
+			bHaveIDAT = true;
+		}
+		else if (memcmp(p8Type, "PLTE", 4) == 0)
+		{
+			p8Plte = p8Data;
+			uPlteBytes = u32Len;
+		}
+		else if (memcmp(p8Type, "tRNS", 4) == 0)
+		{
+			p8Trns = p8Data;
+			uTrnsBytes = u32Len;
+		}
+		else if (memcmp(p8Type, "IEND", 4) == 0)
+		{
+			break;
+		}
+
+		stPos += 12 + u32Len;
+	}
+
+	if (!bHaveIDAT)
+	{
+		strError = "no image data";
+		return false;
+	}
+
+	if ((hdr.uColorType == 3) && !p8Plte)
+	{
+		strError = "palette image without a palette";
+		return false;
+	}
+
+	pipeline.SetPalette(p8Plte, uPlteBytes, p8Trns, uTrnsBytes);
+
+	if (uWorkers == 0)
+	{
+		long lCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+
+		// one core for inflating, one for unfiltering, the rest (at most 4) for converting,
+		//  unless there's only one core or the image is too small to make up for starting threads
+		if ((lCPUs > 1) && ((unsigned long long) hdr.uWidth * hdr.uHeight * 4 >= PNG_THREADED_MIN_BYTES))
+		{
+			uWorkers = (lCPUs > 3) ? (unsigned int) (lCPUs - 2) : 1;
+			if (uWorkers > 4) uWorkers = 4;
+		}
+	}
+
+	return pipeline.Run(uWorkers, strError);
+}
+
+bool PNGDecode::DecompressJPEGStart(const uint8_t *p8SrcPng, size_t stSizeBytes)
+{
+	if (m_bDecoding)
+	{
+		m_pLogger->Log("PNGDecode::DecompressJPEGStart: previous decode has not been waited for");
+		return false;
+	}
+
+	if (!ParsePNGHeader(p8SrcPng, stSizeBytes, &m_hdr))
+	{
+		m_pLogger->Log("PNGDecode::DecompressJPEGStart: not a PNG (or an unsupported one)");
+		return false;
+	}
+
+	m_vSrc.assign(p8SrcPng, p8SrcPng + stSizeBytes);
+	m_vPixels.resize((size_t) m_hdr.uWidth * m_hdr.uHeight * 4);
+
+	m_bThreadDone = false;
+
+	if (pthread_create(&m_thread, NULL, ThreadProc, this) != 0)
+	{
+		m_pLogger->Log("PNGDecode::DecompressJPEGStart: pthread_create failed");
+		return false;
+	}
+
+	m_bDecoding = true;
+	return true;
+}
+
+bool PNGDecode::WaitJPEGDecompressorReady()
+{
+	bool bRes = false;
+
+	if (!m_bDecoding)
+	{
+		m_pLogger->Log("PNGDecode::WaitJPEGDecompressorReady: Not decoding");
+		return false;
+	}
+
+	pthread_join(m_thread, NULL);
+	m_bDecoding = false;
+
+	if (!m_bDecodeOK)
+	{
+		m_pLogger->Log("PNGDecode decode failed: " + m_strError);
+		return false;
+	}
+
+	try
+	{
+		// upload into a target that isn't on screen (the video object handles resolution changes)
+		m_eglImage = m_pIEGLImage->AcquireDecodeTarget(m_hdr.uWidth, m_hdr.uHeight);
+		m_pIEGLImage->UpdateEGLImage(m_eglImage, m_vPixels.data(), m_hdr.uWidth, m_hdr.uHeight);
+		m_pIEGLImage->PublishDecodeTarget(m_eglImage);
+		m_stImageBytes = m_vPixels.size();
+		bRes = true;
+	}
+	catch (std::exception &ex)
+	{
+		m_pLogger->Log((string) "PNGDecode::WaitJPEGDecompressorReady exception: " + ex.what());
+	}
+
+	return bRes;
+}
+
+void *PNGDecode::ThreadProc(void *pArg)
+{
+	PNGDecode *pThis = (PNGDecode *) pArg;
+
+	pThis->m_bDecodeOK = DecodeToRGBA(pThis->m_vSrc.data(), pThis->m_vSrc.size(), pThis->m_vPixels.data(), pThis->m_hdr.uWidth * 4, 0, pThis->m_strError);
+
+	// the results must be visible to the other thread before the flag is
+	__sync_synchronize();
+	pThis->m_bThreadDone = true;
+
+	return NULL;
+}
+
+PNGDecode::PNGDecode(IVideoObjectEGLImage *pEGLImage, ILogger *pLogger) :
+m_pIEGLImage(pEGLImage),
+m_pLogger(pLogger),
+m_stImageBytes(0),
+m_bDecoding(false),
+m_bDecodeOK(false),
+m_bThreadDone(false),
+m_eglImage(0)
+{
+	memset(&m_hdr, 0, sizeof(m_hdr));
+}
+
+PNGDecode::~PNGDecode()
+{
+	if (m_bDecoding)
+	{
+		pthread_join(m_thread, NULL);
+	}
+
+	if (m_eglImage != 0)
+	{
+		m_pIEGLImage->DeleteEGLImage(m_eglImage);
+	}
+}
+
+#endif // USE_PNG
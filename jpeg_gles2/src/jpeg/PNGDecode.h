@@ -0,0 +1,102 @@
+#ifndef PNGDECODE_H
+#define PNGDECODE_H
+
+#ifdef USE_PNG
+
+#include "IJPEGDecode.h"
+#include "../common/common.h"
+#include "../io/logger.h"
+#include "../video/VideoObjects/IVideoObjectEGLImage.h"
+
+#include <pthread.h>
+#include <string>
+
+using namespace std;
+
+struct PNGHeaderInfo
+{
+	unsigned int uWidth, uHeight;
+	unsigned int uBitDepth;		// 1, 2, 4, 8 or 16 (bits per sample)
+	unsigned int uColorType;	// 0 gray, 2 RGB, 3 palette, 4 gray + alpha, 6 RGBA
+	bool bInterlaced;			// Adam7
+};
+
+// Decodes PNGs (UI assets with alpha, etc) behind the same interface as the JPEG decoders.
+// Inflating, undoing the row filters and converting to RGBA each run on their own thread(s) and overlap row by row,
+//  so a big image isn't three passes over the whole thing one after the other.
+// PNG has nothing like JPEG's DCT scaling, so images are always decoded at full size (and only as RGBA).
+class PNGDecode : public IJPEGDecode, public MpoDeleter
+{
+public:
+	static IJPEGDecodeSPtr GetInstance(IVideoObjectEGLImage *pEGLImage, ILogger *pLogger);
+
+	// nothing to preallocate
+	void SetInputBufSizeHint(size_t) { }
+
+	bool DecompressJPEGStart(const uint8_t *p8SrcPng, size_t stSizeBytes);
+
+	// uploads the decoded pixels so this must be called from the thread that owns the GL context
+	bool WaitJPEGDecompressorReady();
+
+	bool IsJPEGDecompressorReady() { return m_bDecoding && m_bThreadDone; }
+
+	// no scaled decoding for PNG
+	void SetOutputScale(unsigned int) { }
+
+	void SetOutputTargetSize(unsigned int, unsigned int) { }
+
+	void *GetEGLImage() { return m_eglImage; }
+
+	void DetachEGLImage() { m_pIEGLImage->ReleaseDecodeTarget(m_eglImage); m_eglImage = 0; }
+
+	void GetDimensions(unsigned int *puWidth, unsigned int *puHeight) { *puWidth = m_hdr.uWidth; *puHeight = m_hdr.uHeight; }
+
+	bool SetOutputYUV(bool bYUV) { return !bYUV; }
+
+	size_t GetImageBytes() { return m_stImageBytes; }
+
+	// true if the data starts with the PNG signature
+	static bool IsPNG(const uint8_t *p8Src, size_t stSizeBytes);
+
+	// reads the IHDR chunk, returns false if it is missing or describes something PNG doesn't allow
+	static bool ParsePNGHeader(const uint8_t *p8Src, size_t stSizeBytes, PNGHeaderInfo *pHdr);
+
+	// Decodes into uWidth x uHeight RGBA pixels (see ParsePNGHeader) at p8Dst, with rows uDstPitch bytes apart.
+	// Every byte of the image area is written exactly once and nothing is read back, so p8Dst may be a write-combined mapping.
+	// uWorkers is the number of threads converting rows to RGBA (on top of this thread, which inflates, and one that unfilters);
+	//  0 decides from the number of CPUs and the size of the image (small images are decoded on this thread alone).
+	// Makes no GL calls. Returns false and fills in strError on failure.
+	static bool DecodeToRGBA(const uint8_t *p8SrcPng, size_t stSizeBytes, uint8_t *p8Dst, unsigned int uDstPitch, unsigned int uWorkers, string &strError);
+
+private:
+	PNGDecode(IVideoObjectEGLImage *pEGLImage, ILogger *pLogger);
+	virtual ~PNGDecode();
+
+	void DeleteInstance() { delete this; }
+
+	static void *ThreadProc(void *pArg);
+
+	IVideoObjectEGLImage *m_pIEGLImage;
+	ILogger *m_pLogger;
+
+	// compressed input (copied so the caller doesn't have to keep it around) and decoded output
+	byteSA m_vSrc;
+	byteSA m_vPixels;
+
+	PNGHeaderInfo m_hdr;
+	size_t m_stImageBytes;
+
+	pthread_t m_thread;
+	bool m_bDecoding;
+	bool m_bDecodeOK;
+
+	// set by the decode thread once it is done with everything
+	volatile bool m_bThreadDone;
+	string m_strError;
+
+	void *m_eglImage;
+};
+
+#endif // USE_PNG
+
+#endif // PNGDECODE_H
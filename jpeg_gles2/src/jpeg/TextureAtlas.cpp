@@ -0,0 +1,208 @@
+#include "TextureAtlas.h"
+#include <string.h>
+#include <stdexcept>
+
+#ifdef USE_LIBJPEG
+#include "JPEGSoftware.h"
+#endif // USE_LIBJPEG
+
+// empty pixels to the right of and below each image so that linear filtering never picks up a neighbor
+#define ATLAS_GUTTER 1
+
+TextureAtlasSPtr TextureAtlas::GetInstance(IVideoObjectEGLImage *pEGLImage, unsigned int uPageSize, unsigned int uMaxPages, ILogger *pLogger)
+{
+	return TextureAtlasSPtr(new TextureAtlas(pEGLImage, uPageSize, uMaxPages, pLogger), TextureAtlas::deleter());
+}
+
+unsigned int TextureAtlas::AddRGBA(const uint8_t *p8RGBA, unsigned int uWidth, unsigned int uHeight)
+{
+	unsigned int uPaddedWidth = uWidth + ATLAS_GUTTER;
+	unsigned int uPaddedHeight = uHeight + ATLAS_GUTTER;
+
+	if ((uWidth == 0) || (uHeight == 0) || (uPaddedWidth > m_uPageSize) || (uPaddedHeight > m_uPageSize))
+	{
+		m_stats.uFailedAdds++;
+		return 0;
+	}
+
+	Entry entry;
+	bool bFound = false;
+
+	// the first page that has room
+	for (unsigned int u = 0; (u < m_vPages.size()) && !bFound; u++)
+	{
+		if (m_vPages[u].pPacker->Insert(uPaddedWidth, uPaddedHeight, &entry.uX, &entry.uY))
+		{
+			entry.uPage = u;
+			bFound = true;
+		}
+	}
+
+	if (!bFound && (m_vPages.size() < m_uMaxPages))
+	{
+		Page page;
+
+		try
+		{
+			page.eglImage = m_pIEGLImage->CreateEGLImage(m_uPageSize, m_uPageSize);
+		}
+		catch (std::exception &ex)
+		{
+			m_pLogger->Log((string) "TextureAtlas could not create a page: " + ex.what());
+			m_stats.uFailedAdds++;
+			return 0;
+		}
+
+		page.pPacker = new AtlasPacker(m_uPageSize, m_uPageSize);
+		m_vPages.push_back(page);
+
+		entry.uPage = m_vPages.size() - 1;
+		bFound = page.pPacker->Insert(uPaddedWidth, uPaddedHeight, &entry.uX, &entry.uY);
+	}
+
+	if (!bFound)
+	{
+		m_stats.uFailedAdds++;
+		return 0;
+	}
+
+	Page &page = m_vPages[entry.uPage];
+
+	try
+	{
+		m_pIEGLImage->UpdateEGLImageRect(page.eglImage, entry.uX, entry.uY, p8RGBA, uWidth, uHeight);
+	}
+	catch (std::exception &ex)
+	{
+		m_pLogger->Log((string) "TextureAtlas upload failed: " + ex.what());
+		page.pPacker->Free(entry.uX, entry.uY, uPaddedWidth, uPaddedHeight);
+		m_stats.uFailedAdds++;
+		return 0;
+	}
+
+	entry.uWidth = uWidth;
+	entry.uHeight = uHeight;
+
+	// 0 means failure
+	if (m_uNextID == 0)
+	{
+		m_uNextID++;
+	}
+
+	unsigned int uID = m_uNextID++;
+	m_mapEntries[uID] = entry;
+	m_stats.uAdds++;
+
+	return uID;
+}
+
+#ifdef USE_LIBJPEG
+unsigned int TextureAtlas::AddJPEG(const uint8_t *p8Jpeg, size_t stSizeBytes, unsigned int uScaleDenom)
+{
+	unsigned int uWidth = 0, uHeight = 0;
+	string strError;
+
+	if (!JPEGSoftware::DecodeToRGBA(p8Jpeg, stSizeBytes, uScaleDenom, m_vPixels, &uWidth, &uHeight, strError))
+	{
+		m_pLogger->Log("TextureAtlas decode failed: " + strError);
+		m_stats.uFailedAdds++;
+		return 0;
+	}
+
+	return AddRGBA(m_vPixels.data(), uWidth, uHeight);
+}
+#endif // USE_LIBJPEG
+
+void TextureAtlas::Remove(unsigned int uID)
+{
+	map<unsigned int, Entry>::iterator mi = m_mapEntries.find(uID);
+
+	if (mi == m_mapEntries.end())
+	{
+		return;
+	}
+
+	const Entry &entry = mi->second;
+
+	// the pixels stay in the texture until something else is put there
+	m_vPages[entry.uPage].pPacker->Free(entry.uX, entry.uY, entry.uWidth + ATLAS_GUTTER, entry.uHeight + ATLAS_GUTTER);
+	m_mapEntries.erase(mi);
+	m_stats.uRemoves++;
+}
+
+bool TextureAtlas::GetSprite(unsigned int uID, VideoSprite *pSprite) const
+{
+	map<unsigned int, Entry>::const_iterator mi = m_mapEntries.find(uID);
+
+	if (mi == m_mapEntries.end())
+	{
+		return false;
+	}
+
+	const Entry &entry = mi->second;
+	float fPageSize = (float) m_uPageSize;
+
+	// sample texel centers at the edges so that linear filtering stays inside the image
+	pSprite->eglImage = m_vPages[entry.uPage].eglImage;
+	pSprite->fU0 = (entry.uX + 0.5f) / fPageSize;
+	pSprite->fV0 = (entry.uY + 0.5f) / fPageSize;
+	pSprite->fU1 = (entry.uX + entry.uWidth - 0.5f) / fPageSize;
+	pSprite->fV1 = (entry.uY + entry.uHeight - 0.5f) / fPageSize;
+
+	return true;
+}
+
+bool TextureAtlas::GetSize(unsigned int uID, unsigned int *puWidth, unsigned int *puHeight) const
+{
+	map<unsigned int, Entry>::const_iterator mi = m_mapEntries.find(uID);
+
+	if (mi == m_mapEntries.end())
+	{
+		return false;
+	}
+
+	*puWidth = mi->second.uWidth;
+	*puHeight = mi->second.uHeight;
+	return true;
+}
+
+void TextureAtlas::GetStats(TextureAtlasStats *pStats) const
+{
+	*pStats = m_stats;
+	pStats->uPages = (unsigned int) m_vPages.size();
+	pStats->uImages = (unsigned int) m_mapEntries.size();
+	pStats->uFreeRects = 0;
+	pStats->uUsedPercent = 0;
+
+	unsigned long long u64Used = 0;
+
+	for (unsigned int u = 0; u < m_vPages.size(); u++)
+	{
+		pStats->uFreeRects += m_vPages[u].pPacker->GetFreeRectCount();
+		u64Used += m_vPages[u].pPacker->GetUsedArea();
+	}
+
+	if (!m_vPages.empty())
+	{
+		pStats->uUsedPercent = (unsigned int) ((u64Used * 100) / ((unsigned long long) m_uPageSize * m_uPageSize * m_vPages.size()));
+	}
+}
+
+TextureAtlas::TextureAtlas(IVideoObjectEGLImage *pEGLImage, unsigned int uPageSize, unsigned int uMaxPages, ILogger *pLogger) :
+m_pIEGLImage(pEGLImage),
+m_pLogger(pLogger),
+m_uPageSize(uPageSize),
+m_uMaxPages(uMaxPages),
+m_uNextID(1)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	for (unsigned int u = 0; u < m_vPages.size(); u++)
+	{
+		m_pIEGLImage->DeleteEGLImage(m_vPages[u].eglImage);
+		delete m_vPages[u].pPacker;
+	}
+}
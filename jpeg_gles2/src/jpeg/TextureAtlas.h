@@ -0,0 +1,89 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include "AtlasPacker.h"
+#include "../common/common.h"
+#include "../common/mpo_deleter.h"
+#include "../io/logger.h"
+#include "../video/VideoObjects/IVideoObjectEGLImage.h"
+#include "../video/VideoObjects/IVideoObjectSprites.h"
+
+#include <map>
+
+using namespace std;
+
+struct TextureAtlasStats
+{
+	unsigned int uPages;
+	unsigned int uImages;
+	unsigned int uAdds;
+	unsigned int uRemoves;
+	unsigned int uFailedAdds;		// images that didn't fit anywhere (or failed to decode)
+	unsigned int uFreeRects;		// over all pages (a rough measure of fragmentation)
+	unsigned int uUsedPercent;		// how much of the pages' area holds images
+};
+
+// Packs many small images (thumbnails etc) into a few big EGL images ("pages") instead of giving each its own texture.
+// Sprites that show images from the same page can be drawn with one texture bind (and one draw call by the batched sprite renderer).
+// Space of removed images is reused by later ones.
+// All methods must be called from the thread that owns the GL context.
+class TextureAtlas : public MpoDeleter
+{
+public:
+	// uMaxPages of uPageSize x uPageSize pages are created as they are needed
+	static shared_ptr<TextureAtlas> GetInstance(IVideoObjectEGLImage *pEGLImage, unsigned int uPageSize, unsigned int uMaxPages, ILogger *pLogger);
+
+	// Copies tightly packed RGBA pixels into the atlas.
+	// Returns an ID for the image, or 0 if there is no room (remove something and try again).
+	unsigned int AddRGBA(const uint8_t *p8RGBA, unsigned int uWidth, unsigned int uHeight);
+
+#ifdef USE_LIBJPEG
+	// decodes (at 1/uScaleDenom of full size) straight into the atlas, returns 0 on failure
+	unsigned int AddJPEG(const uint8_t *p8Jpeg, size_t stSizeBytes, unsigned int uScaleDenom);
+#endif // USE_LIBJPEG
+
+	void Remove(unsigned int uID);
+
+	// fills in the image and texture coordinates for a sprite that shows the whole image (the screen position is left alone)
+	bool GetSprite(unsigned int uID, VideoSprite *pSprite) const;
+
+	bool GetSize(unsigned int uID, unsigned int *puWidth, unsigned int *puHeight) const;
+
+	void GetStats(TextureAtlasStats *pStats) const;
+
+private:
+	TextureAtlas(IVideoObjectEGLImage *pEGLImage, unsigned int uPageSize, unsigned int uMaxPages, ILogger *pLogger);
+	virtual ~TextureAtlas();
+
+	void DeleteInstance() { delete this; }
+
+	struct Page
+	{
+		void *eglImage;
+		AtlasPacker *pPacker;
+	};
+
+	struct Entry
+	{
+		unsigned int uPage;
+		unsigned int uX, uY, uWidth, uHeight;
+	};
+
+	IVideoObjectEGLImage *m_pIEGLImage;
+	ILogger *m_pLogger;
+
+	unsigned int m_uPageSize, m_uMaxPages;
+	vector<Page> m_vPages;
+
+	map<unsigned int, Entry> m_mapEntries;
+	unsigned int m_uNextID;
+
+	// decode output (kept around to avoid reallocating for every image)
+	byteSA m_vPixels;
+
+	TextureAtlasStats m_stats;
+};
+
+typedef shared_ptr<TextureAtlas> TextureAtlasSPtr;
+
+#endif // TEXTUREATLAS_H
@@ -3,10 +3,22 @@
 // http://my-cool-projects.blogspot.com
 
 #ifdef USE_EGL
-#ifdef IS_RPI
+#if defined(IS_RPI) || defined(IS_HEADLESS)
 
 #include <stdio.h>
+#ifdef IS_RPI
 #include "platform/PlatformRPI.h"
+typedef PlatformRPI MainPlatform;
+#else
+#include "platform/PlatformHeadless.h"
+typedef PlatformHeadless MainPlatform;
+#endif // IS_RPI
+#include "platform/PresentScheduler.h"
+#include "jpeg/JPEGCache.h"
+#include "jpeg/JPEGHeader.h"
+#include "jpeg/JPEGTileView.h"
+#include "jpeg/TextureAtlas.h"
+#include "jpeg/PNGDecode.h"
 #include "io/logger_console.h"
 #include "common/common.h"
 
@@ -17,6 +29,7 @@
 #include <sys/time.h>
 #include <stdexcept>
 #include <vector>
+#include <math.h>
 
 using namespace std;
 
@@ -56,6 +69,35 @@ byteSA read_file(const char *strFilePath)
 	return buf;
 }
 
+// writes tightly packed RGBA as a binary PPM (alpha is dropped)
+bool WritePPM(const char *strFilePath, const byteSA &vRGBA, unsigned int uWidth, unsigned int uHeight)
+{
+	FILE *F = fopen(strFilePath, "wb");
+	if (!F)
+	{
+		return false;
+	}
+
+	fprintf(F, "P6\n%u %u\n255\n", uWidth, uHeight);
+
+	byteSA vRow(uWidth * 3);
+	for (unsigned int y = 0; y < uHeight; y++)
+	{
+		const uint8_t *p8Src = &vRGBA[y * uWidth * 4];
+		for (unsigned int x = 0; x < uWidth; x++)
+		{
+			vRow[x * 3] = p8Src[x * 4];
+			vRow[x * 3 + 1] = p8Src[x * 4 + 1];
+			vRow[x * 3 + 2] = p8Src[x * 4 + 2];
+		}
+		fwrite(vRow.data(), 1, vRow.size(), F);
+	}
+
+	bool bRes = (ferror(F) == 0);
+	fclose(F);
+	return bRes;
+}
+
 unsigned int RefreshTimer()
 {
 	unsigned int result = 0;
@@ -74,12 +116,218 @@ unsigned int RefreshTimer()
 	return result;
 }
 
-// entry point for RPIbroad platform
+// Draws an increasing number of sprites (up to uMaxQuads) for a few hundred frames each and reports what a frame costs.
+// The sprites move every frame so the vertices are rebuilt every frame, and they alternate between textures so that
+//  drawing them in the order they were added would need a texture change for every quad.
+void RunQuadBenchmark(IVideoObject *pVideo, unsigned int uMaxQuads)
+{
+	const unsigned int uTextures = 8;
+	const unsigned int uTexSize = 64;
+	const unsigned int uFrames = 300;
+
+	IVideoObjectEGLImage *pImages = pVideo->ToEGLImage();
+	IVideoObjectSprites *pSprites = pVideo->ToSprites();
+
+	// one solid color per texture
+	vector<void *> vImages;
+	byteSA vPixels(uTexSize * uTexSize * 4);
+	for (unsigned int t = 0; t < uTextures; t++)
+	{
+		for (unsigned int u = 0; u < vPixels.size(); u += 4)
+		{
+			vPixels[u] = (t & 1) ? 0xFF : 0x40;
+			vPixels[u + 1] = (t & 2) ? 0xFF : 0x40;
+			vPixels[u + 2] = (t & 4) ? 0xFF : 0x40;
+			vPixels[u + 3] = 0xFF;
+		}
+
+		void *pImage = pImages->CreateEGLImage(uTexSize, uTexSize);
+		pImages->UpdateEGLImage(pImage, vPixels.data(), uTexSize, uTexSize);
+		vImages.push_back(pImage);
+	}
+
+	vector<unsigned int> vCounts;
+	for (unsigned int uCount = 1; uCount < uMaxQuads; uCount *= 10)
+	{
+		vCounts.push_back(uCount);
+	}
+	vCounts.push_back(uMaxQuads);
+
+	for (unsigned int c = 0; (c < vCounts.size()) && !g_bQuitFlag; c++)
+	{
+		unsigned int uQuads = vCounts[c];
+
+		// smallest square grid that fits them all
+		unsigned int uColumns = (unsigned int) ceil(sqrt((double) uQuads));
+		float fCell = 1.0f / uColumns;
+
+		unsigned int uStartMs = RefreshTimer();
+		unsigned int uFrame = 0;
+
+		for (; (uFrame < uFrames) && !g_bQuitFlag; uFrame++)
+		{
+			pSprites->ClearSprites();
+
+			for (unsigned int q = 0; q < uQuads; q++)
+			{
+				VideoSprite sprite;
+				sprite.eglImage = vImages[q % uTextures];
+				sprite.fLeft = ((q % uColumns) + 0.1f) * fCell;
+				sprite.fRight = sprite.fLeft + (0.8f * fCell);
+				sprite.fTop = ((q / uColumns) + 0.1f) * fCell;
+				sprite.fBottom = sprite.fTop + (0.8f * fCell);
+				sprite.fRotation = (uFrame * 0.02f) + q;
+				pSprites->AddSprite(sprite);
+			}
+
+			pVideo->RenderFrame();
+			pVideo->Flip();
+		}
+
+		unsigned int uMs = RefreshTimer() - uStartMs;
+
+		VideoRenderStats render;
+		pVideo->GetRenderStats(&render);
+
+		printf("%4u quads: %.2f ms per frame, %u draw calls and %u GL calls per frame\n",
+			uQuads, uFrame ? ((double) uMs / uFrame) : 0.0, render.uLastFrameDraws, render.uLastFrameCalls);
+	}
+
+	pSprites->ClearSprites();
+
+	for (unsigned int t = 0; t < vImages.size(); t++)
+	{
+		pImages->DeleteEGLImage(vImages[t]);
+	}
+}
+
+void PrintUsage(const char *strName)
+{
+	printf("Usage: %s [options] [jpeg or png path]\n", strName);
+	printf("       %s -q <count>\n", strName);
+	printf("  -c <MB>     decoded image cache size in MB (default: no cache)\n");
+	printf("  -s <denom>  decode at 1/denom of full size, denom is 1, 2, 4 or 8\n");
+	printf("  -t <WxH>    decode at the smallest scale that is still at least WxH (overrides -s)\n");
+	printf("  -n <count>  number of decode target textures (2 to 4, default 3) so decoding never touches the image on screen\n");
+	printf("  -b <count>  decode the image count times back to back, print the average latency and texture size, then quit\n");
+	printf("  -q <count>  draw 1 up to count (at most 1000) quads from several textures and print the cost per frame, then quit\n");
+	printf("  -r <fps>    present at a steady fps (with adaptive vsync) and decode continuously instead of rendering flat out\n");
+	printf("  -y          show decoded images as YUV planes converted by the shader instead of RGBA (software decoder only)\n");
+	printf("  -p <amount> prescale the image to its letterboxed size once (instead of every frame) and sharpen it by amount (0 for none)\n");
+	printf("  -f <count>  quit after count frames\n");
+	printf("  -o <path>   save the last frame as a PPM image\n");
+#ifdef USE_LIBJPEG
+	printf("  -v <WxH>    pan a WxH window around the image, decoding only the tiles that come into view\n");
+	printf("  -a <count>  show count 1/8 size copies of the image packed into a texture atlas, replacing one every few frames\n");
+#endif // USE_LIBJPEG
+}
+
+// entry point for RPIbroad platform (or any linux box when built headless)
 int main(int argc, char **argv)
 {
-	if (argc != 2)
+	// for time to first frame
+	unsigned int uLaunchTime = RefreshTimer();
+
+	// no cache by default so that we benchmark the decoder itself
+	size_t stCacheBytes = 0;
+	unsigned int uScaleDenom = 1;
+	unsigned int uTargetWidth = 0, uTargetHeight = 0;
+	unsigned int uBenchDecodes = 0;
+	unsigned int uViewWidth = 0, uViewHeight = 0;
+	unsigned int uBenchQuads = 0;
+	unsigned int uThumbnails = 0;
+	unsigned int uDecodeTargets = 3;
+	unsigned int uMaxFrames = 0;
+	unsigned int uTargetFPS = 0;
+	bool bYUV = false;
+	VideoPostProcess post;
+	const char *strSnapshotPath = NULL;
+	int iOpt;
+
+	while ((iOpt = getopt(argc, argv, "c:s:t:n:b:q:r:yp:f:o:v:a:")) != -1)
+	{
+		switch (iOpt)
+		{
+		case 'c':
+			stCacheBytes = (size_t) atoi(optarg) * 1024 * 1024;
+			break;
+		case 's':
+			uScaleDenom = (unsigned int) atoi(optarg);
+			if (!JPEGScaleRequest::IsValidDenom(uScaleDenom))
+			{
+				printf("Scale must be 1, 2, 4 or 8\n");
+				return 1;
+			}
+			break;
+		case 't':
+			if (sscanf(optarg, "%ux%u", &uTargetWidth, &uTargetHeight) != 2)
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'n':
+			uDecodeTargets = (unsigned int) atoi(optarg);
+			if ((uDecodeTargets < 2) || (uDecodeTargets > 4))
+			{
+				printf("Decode target count must be 2 to 4\n");
+				return 1;
+			}
+			break;
+		case 'b':
+			uBenchDecodes = (unsigned int) atoi(optarg);
+			break;
+		case 'q':
+			uBenchQuads = (unsigned int) atoi(optarg);
+			if ((uBenchQuads == 0) || (uBenchQuads > 1000))
+			{
+				printf("Quad count must be 1 to 1000\n");
+				return 1;
+			}
+			break;
+		case 'r':
+			uTargetFPS = (unsigned int) atoi(optarg);
+			if (uTargetFPS == 0)
+			{
+				printf("Frame rate must be at least 1\n");
+				return 1;
+			}
+			break;
+		case 'y':
+			bYUV = true;
+			break;
+		case 'p':
+			post.bEnabled = true;
+			post.fSharpen = (float) atof(optarg);
+			break;
+		case 'f':
+			uMaxFrames = (unsigned int) atoi(optarg);
+			break;
+		case 'o':
+			strSnapshotPath = optarg;
+			break;
+#ifdef USE_LIBJPEG
+		case 'v':
+			if ((sscanf(optarg, "%ux%u", &uViewWidth, &uViewHeight) != 2) || (uViewWidth == 0) || (uViewHeight == 0))
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'a':
+			uThumbnails = (unsigned int) atoi(optarg);
+			break;
+#endif // USE_LIBJPEG
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	// the quad benchmark doesn't need an image
+	if ((optind != argc - 1) && !((uBenchQuads != 0) && (optind == argc)))
 	{
-		printf("Usage: %s [jpeg path]\n", argv[0]);
+		PrintUsage(argv[0]);
 		return 0;
 	}
 
@@ -88,8 +336,8 @@ int main(int argc, char **argv)
 	signal(SIGTERM, OnSigInt);
 	signal(SIGHUP, OnSigInt);
 
-	IPlatformSPtr platform = PlatformRPI::GetInstance();
-	PlatformRPI *pPlatform = (PlatformRPI *) platform.get();
+	IPlatformSPtr platform = MainPlatform::GetInstance();
+	MainPlatform *pPlatform = (MainPlatform *) platform.get();
 	if (pPlatform == 0)
 	{
 		return 1;
@@ -100,50 +348,394 @@ int main(int argc, char **argv)
 	// init
 	pPlatform->SetLogger(logger.get());
 	IVideoObject *pVideo = pPlatform->VideoInit();
+	if (pVideo == 0)
+	{
+		return 1;
+	}
+	unsigned int uVideoInitMs = RefreshTimer() - uLaunchTime;
+	pVideo->ToEGLImage()->SetDecodeTargetCount(uDecodeTargets);
+	pVideo->SetPostProcess(post);
+
+	if (uBenchQuads != 0)
+	{
+		RunQuadBenchmark(pVideo, uBenchQuads);
+		return 0;
+	}
+
+	const char *strJpegPath = argv[optind];
 	IJPEGDecode *pJPEG = pPlatform->GetJPEGDecoder();
 
-	byteSA fileJPEG = read_file(argv[1]);	// load in jpeg file
+	// optionally put the decoded image cache in front of the decoder
+	IJPEGDecodeSPtr cache;
+	if (stCacheBytes != 0)
+	{
+		cache = JPEGCache::GetInstance(pJPEG, pVideo->ToEGLImage(), stCacheBytes, logger.get());
+		pJPEG = cache.get();
+	}
+
+	byteSA fileJPEG = read_file(strJpegPath);	// load in jpeg file
 	const uint8_t *pBufJPEG = fileJPEG.data();
 	size_t stSizeBytes = fileJPEG.size();
 
+	JPEGHeaderInfo hdr;
+#ifdef USE_PNG
+	PNGHeaderInfo hdrPNG;
+	if (PNGDecode::ParsePNGHeader(pBufJPEG, stSizeBytes, &hdrPNG))
+	{
+		// the tile view and the atlas only take JPEGs
+		if ((uViewWidth != 0) || (uThumbnails != 0))
+		{
+			printf("-v and -a only work with JPEGs\n");
+			return 1;
+		}
+
+		printf("%s: %ux%u PNG, color type %u, %u bits per sample%s\n", strJpegPath,
+			hdrPNG.uWidth, hdrPNG.uHeight, hdrPNG.uColorType, hdrPNG.uBitDepth, hdrPNG.bInterlaced ? ", interlaced" : "");
+	}
+	else
+#endif // USE_PNG
+	if (!ParseJPEGHeader(pBufJPEG, stSizeBytes, &hdr))
+	{
+		printf("%s does not appear to be a JPEG\n", strJpegPath);
+		return 1;
+	}
+	else
+	{
+		printf("%s: %ux%u, %u components (%s), %s, restart interval %u, orientation %u\n", strJpegPath,
+			hdr.uWidth, hdr.uHeight, hdr.uComponents, JPEGSubsamplingName(hdr.eSubsampling),
+			hdr.bProgressive ? "progressive" : "sequential", hdr.uRestartInterval, hdr.uOrientation);
+	}
+
+	pJPEG->SetOutputScale(uScaleDenom);
+	pJPEG->SetOutputTargetSize(uTargetWidth, uTargetHeight);
+
+	if (bYUV && !pJPEG->SetOutputYUV(true))
+	{
+		printf("This decoder can't output YUV planes (the cache and the hardware decoder only produce RGBA)\n");
+		return 1;
+	}
+
 	// tell jpeg decoder what the buffer size needs to be (mandatory)
 	pJPEG->SetInputBufSizeHint(stSizeBytes);
 	//pJPEG->SetInputBufSizeHint(1024 * 500);
 
+	// time decodes on their own (each one is displayed so that we know it really finished)
+	if (uBenchDecodes != 0)
+	{
+		unsigned int uOK = 0;
+		unsigned int uBenchStart = RefreshTimer();
+		uint64_t u64RenderUs = 0;
+
+		for (unsigned int u = 0; (u < uBenchDecodes) && !g_bQuitFlag; u++)
+		{
+			if (pJPEG->DecompressJPEGStart(pBufJPEG, stSizeBytes) && pJPEG->WaitJPEGDecompressorReady())
+			{
+				uOK++;
+			}
+
+			uint64_t u64RenderStart = PresentScheduler::GetTimeUs();
+			pVideo->RenderFrame();
+			pVideo->Flip();
+			u64RenderUs += PresentScheduler::GetTimeUs() - u64RenderStart;
+		}
+
+		unsigned int uBenchMs = RefreshTimer() - uBenchStart;
+		unsigned int uWidth = 0, uHeight = 0;
+		pJPEG->GetDimensions(&uWidth, &uHeight);
+
+		printf("Decoded %u of %u at %ux%u, average %.2f ms per decode (including one frame displayed), texture %u KB (%s)\n",
+			uOK, uBenchDecodes, uWidth, uHeight, uOK ? ((double) uBenchMs / uOK) : 0.0, (unsigned int) (pJPEG->GetImageBytes() / 1024),
+			bYUV ? "YUV" : "RGBA");
+		printf("Render and flip: average %.2f ms per frame\n", uBenchDecodes ? ((double) u64RenderUs / 1000.0 / uBenchDecodes) : 0.0);
+
+		// what a static image costs per frame (this is where post-processing's cached result pays off)
+		uint64_t u64RedrawStart = PresentScheduler::GetTimeUs();
+		for (unsigned int u = 0; (u < uBenchDecodes) && !g_bQuitFlag; u++)
+		{
+			pVideo->RenderFrame();
+			pVideo->Flip();
+		}
+		printf("Redrawing the last image: average %.2f ms per frame\n",
+			uBenchDecodes ? ((double) (PresentScheduler::GetTimeUs() - u64RedrawStart) / 1000.0 / uBenchDecodes) : 0.0);
+
+		g_bQuitFlag = true;
+	}
+
+#ifdef USE_LIBJPEG
+	// tile mode pans around the image instead of decoding the whole thing
+	JPEGTileViewSPtr tiles;
+	int iPanX = 0, iPanY = 0, iPanDX = 4, iPanDY = 3;
+	if (uViewWidth != 0)
+	{
+		// use the cache budget for tiles if there is one
+		tiles = JPEGTileView::GetInstance(pVideo->ToEGLImage(), pVideo->ToSprites(), 512,
+			(stCacheBytes != 0) ? stCacheBytes : (32 * 1024 * 1024), logger.get());
+
+		if (!tiles->SetImage(pBufJPEG, stSizeBytes))
+		{
+			return 1;
+		}
+
+		// no panning in a direction the whole image already fits in
+		if (uViewWidth >= hdr.uWidth) iPanDX = 0;
+		if (uViewHeight >= hdr.uHeight) iPanDY = 0;
+	}
+
+	// thumbnail mode decodes many small copies of the image into shared textures
+	TextureAtlasSPtr atlas;
+	vector<unsigned int> vThumbs;
+	unsigned int uNextReplace = 0;
+	bool bThumbsChanged = true;
+	if (uThumbnails != 0)
+	{
+		atlas = TextureAtlas::GetInstance(pVideo->ToEGLImage(), 2048, 4, logger.get());
+
+		for (unsigned int u = 0; u < uThumbnails; u++)
+		{
+			unsigned int uID = atlas->AddJPEG(pBufJPEG, stSizeBytes, 8);
+			if (uID == 0)
+			{
+				printf("Atlas is full after %u thumbnails\n", u);
+				break;
+			}
+			vThumbs.push_back(uID);
+		}
+	}
+#endif // USE_LIBJPEG
+
+	// paced mode renders at the display's cadence and shows each decode on the first frame after it finishes
+	PresentSchedulerSPtr scheduler;
+	if (uTargetFPS != 0)
+	{
+		scheduler = PresentScheduler::GetInstance(pVideo, uTargetFPS, true, logger.get());
+		if (!scheduler)
+		{
+			return 1;
+		}
+	}
+
 	unsigned int uStartTime = RefreshTimer();
 	unsigned int uFramesDisplayed = 0;
+	unsigned int uDecodesShown = 0;
+	bool bDecoding = false;
+	uint64_t u64DecodeStartUs = 0;
 
-
-	
 	// main loop here, run as fast as possible to benchmark
 	while (!g_bQuitFlag)
 	{
-		// decode
-		if(uFramesDisplayed % 25 == 0) {
-			pJPEG->DecompressJPEGStart(pBufJPEG, stSizeBytes);
-			if(uFramesDisplayed < 600) pJPEG->WaitJPEGDecompressorReady();
+#ifdef USE_LIBJPEG
+		if (tiles)
+		{
+			// bounce the view around the image
+			if ((iPanX + iPanDX < 0) || (iPanX + iPanDX + (int) uViewWidth > (int) hdr.uWidth)) iPanDX = -iPanDX;
+			if ((iPanY + iPanDY < 0) || (iPanY + iPanDY + (int) uViewHeight > (int) hdr.uHeight)) iPanDY = -iPanDY;
+			iPanX += iPanDX;
+			iPanY += iPanDY;
+
+			tiles->SetView(iPanX, iPanY, uViewWidth, uViewHeight);
+			tiles->Update();
+		}
+		else if (atlas)
+		{
+			// evict one thumbnail and decode it again so that freed atlas space gets reused
+			if ((uFramesDisplayed % 10 == 9) && !vThumbs.empty())
+			{
+				unsigned int &uID = vThumbs[uNextReplace];
+				atlas->Remove(uID);
+				uID = atlas->AddJPEG(pBufJPEG, stSizeBytes, 8);
+				uNextReplace = (uNextReplace + 1) % vThumbs.size();
+				bThumbsChanged = true;
+			}
+
+			if (bThumbsChanged)
+			{
+				IVideoObjectSprites *pSprites = pVideo->ToSprites();
+				unsigned int uColumns = 1;
+				while (uColumns * uColumns < vThumbs.size())
+				{
+					uColumns++;
+				}
+				float fCell = 1.0f / uColumns;
+
+				pSprites->ClearSprites();
+
+				for (unsigned int u = 0; u < vThumbs.size(); u++)
+				{
+					VideoSprite sprite;
+					if (atlas->GetSprite(vThumbs[u], &sprite))
+					{
+						sprite.fLeft = (u % uColumns) * fCell;
+						sprite.fRight = sprite.fLeft + fCell;
+						sprite.fTop = (u / uColumns) * fCell;
+						sprite.fBottom = sprite.fTop + fCell;
+						pSprites->AddSprite(sprite);
+					}
+				}
+
+				bThumbsChanged = false;
+			}
+		}
+		else
+#endif // USE_LIBJPEG
+		{
+			// decode in the background and keep rendering until it is done (it shows up at the start of the next frame)
+			if (bDecoding && pJPEG->IsJPEGDecompressorReady())
+			{
+				if (pJPEG->WaitJPEGDecompressorReady())
+				{
+					uDecodesShown++;
+
+					if (scheduler)
+					{
+						scheduler->ImageReady(u64DecodeStartUs);
+					}
+				}
+				bDecoding = false;
+			}
+
+			// when paced, the next decode starts as soon as the decoder is free
+			if (!bDecoding && (scheduler || (uFramesDisplayed % 25 == 0)))
+			{
+				u64DecodeStartUs = PresentScheduler::GetTimeUs();
+				bDecoding = pJPEG->DecompressJPEGStart(pBufJPEG, stSizeBytes);
+			}
 		}
 
 
 		// render
-		pVideo->RenderFrame();
-		pVideo->Flip();
+		if (scheduler)
+		{
+			scheduler->WaitForNextFrame();
+			scheduler->Present();
+		}
+		else
+		{
+			pVideo->RenderFrame();
+			pVideo->Flip();
+		}
 
 		uFramesDisplayed++;
+
+		// startup cost (shader compiles, the first decode) is what a restart looks like to the viewer
+		if (uFramesDisplayed == 1)
+		{
+			VideoRenderStats render;
+			pVideo->GetRenderStats(&render);
+			printf("Time to first frame: %u ms (video init %u ms, shader programs loaded from cache: %u, compiled: %u)\n",
+				RefreshTimer() - uLaunchTime, uVideoInitMs, render.uProgramsCached, render.uProgramsCompiled);
+		}
+
+		if (uFramesDisplayed == uMaxFrames)
+		{
+			g_bQuitFlag = true;
+		}
+	}
+
+	// the decoder must be idle before it is shut down
+	if (bDecoding)
+	{
+		pJPEG->WaitJPEGDecompressorReady();
 	}
 
 	unsigned int uEndTime = RefreshTimer();
 	unsigned int uTotalMs = uEndTime - uStartTime;
 
-	printf("Total elapsed milliseconds: %u\n", uTotalMs);
-	printf("Total frames displayed: %u\n", uFramesDisplayed);
-	printf("Total frames / second is %f\n", (uFramesDisplayed * 1000.0) / uTotalMs);
+	// one more frame (with the latest decode on it) read back so the output can be checked
+	if (strSnapshotPath)
+	{
+		byteSA vFrame;
+		unsigned int uWidth = 0, uHeight = 0;
+
+		pVideo->RenderFrame();
+		pVideo->ReadFrame(vFrame, &uWidth, &uHeight);
+		pVideo->Flip();
+
+		if (WritePPM(strSnapshotPath, vFrame, uWidth, uHeight))
+		{
+			printf("Saved %ux%u frame to %s\n", uWidth, uHeight, strSnapshotPath);
+		}
+		else
+		{
+			printf("Could not write %s\n", strSnapshotPath);
+		}
+	}
+
+	if (uFramesDisplayed != 0)
+	{
+		printf("Total elapsed milliseconds: %u\n", uTotalMs);
+		printf("Total frames displayed: %u\n", uFramesDisplayed);
+		printf("Total frames / second is %f\n", (uFramesDisplayed * 1000.0) / uTotalMs);
+		printf("Decodes shown while rendering: %u\n", uDecodesShown);
+	}
+
+	VideoRenderStats render;
+	pVideo->GetRenderStats(&render);
+	if (render.uFrames != 0)
+	{
+		printf("GL calls per frame: %.1f (last frame %u), draw calls per frame: %.1f, redundant calls skipped per frame: %.1f (last frame %u)\n",
+			(double) render.uCalls / render.uFrames, render.uLastFrameCalls, (double) render.uDraws / render.uFrames,
+			(double) render.uSkipped / render.uFrames, render.uLastFrameSkipped);
+		printf("Decode targets that had to wait for the GPU: %u\n", render.uFenceStalls);
+
+		if (post.bEnabled)
+		{
+			printf("Post-processing passes: %u, frames that reused the result: %u\n", render.uPostPasses, render.uPostReused);
+		}
+	}
+
+	if (scheduler)
+	{
+		PresentStats present;
+		scheduler->GetStats(&present);
+		printf("Frame interval: %.2f ms average, %.2f ms jitter, %.2f ms worst; missed frame slots: %u, frames swapped without vsync: %u\n",
+			present.dMeanIntervalMs, present.dJitterMs, present.dMaxIntervalMs, present.uMissedDeadlines, present.uUnsyncedFrames);
+		printf("Decode to display latency: %.2f ms average, %.2f ms worst (%u images)\n",
+			present.dMeanLatencyMs, present.dMaxLatencyMs, present.uImagesShown);
+	}
+
+	JPEGRouteStats route;
+	pPlatform->GetJPEGRouteStats(&route);
+	printf("Hardware decodes: %u, software decodes: %u (progressive: %u, unsupported coding: %u, unsupported subsampling: %u, CMYK/YCCK: %u, rejected by hardware: %u), PNG decodes: %u, invalid: %u\n",
+		route.uHardware, route.uSoftware, route.uProgressive, route.uUnsupportedCoding, route.uUnsupportedSubsampling, route.uUnsupportedColor, route.uHardwareRejected, route.uPNG, route.uInvalid);
+
+#ifdef USE_LIBJPEG
+	if (tiles)
+	{
+		JPEGTileStats stats;
+		tiles->GetStats(&stats);
+		printf("Tiles decoded: %u (%u started at a restart marker) in %u ms, already resident: %u, evictions: %u\n",
+			stats.uTilesDecoded, stats.uRestartSeeks, stats.uDecodeMs, stats.uTileHits, stats.uEvictions);
+		printf("Tiles resident: %u, bytes: %u\n", stats.uTilesResident, (unsigned int) stats.stBytesResident);
+	}
 
-	// shutdown
+	if (atlas)
+	{
+		TextureAtlasStats stats;
+		atlas->GetStats(&stats);
+		printf("Atlas pages: %u (%u%% used, %u free rectangles), images: %u, added: %u, removed: %u, failed: %u\n",
+			stats.uPages, stats.uUsedPercent, stats.uFreeRects, stats.uImages, stats.uAdds, stats.uRemoves, stats.uFailedAdds);
+	}
+
+	// tiles and the atlas are freed through the video object too
+	tiles.reset();
+	pVideo->ToSprites()->ClearSprites();
+	atlas.reset();
+#endif // USE_LIBJPEG
+
+	if (cache)
+	{
+		JPEGCacheStats stats;
+		((JPEGCache *) cache.get())->GetStats(&stats);
+		printf("Cache hits: %u, misses: %u, evictions: %u\n", stats.uHits, stats.uMisses, stats.uEvictions);
+		printf("Cache entries: %u, bytes used: %u of %u\n", stats.uEntries, (unsigned int) stats.stBytesUsed, (unsigned int) stats.stBudgetBytes);
+	}
+
+	// shutdown (cache must go first since it frees images through the video object)
+	cache.reset();
 	platform.reset();
 
 	return 0;
 }
 
-#endif // IS_RPI
+#endif // IS_RPI || IS_HEADLESS
 #endif // USE_EGL
@@ -162,6 +162,26 @@ bool OMXComponent::IsEventPending(OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32
 	return bRes;
 }
 
+bool OMXComponent::IsFillPending(const OMX_BUFFERHEADERTYPE *pBuf)
+{
+	bool bRes = false;
+
+	Lock();
+
+	for (list<FillBufferDoneData>::iterator li = m_lstFill.begin(); li != m_lstFill.end(); li++)
+	{
+		if (li->pBuffer == pBuf)
+		{
+			bRes = true;
+			break;
+		}
+	}
+
+	Unlock();
+
+	return bRes;
+}
+
 IEventSPtr OMXComponent::WaitForEvent(OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, unsigned int uTimeoutMs)
 {
 	list<IEventSPtr> lstEvents;
@@ -36,6 +36,7 @@ public:
 	virtual void FillThisBuffer(OMX_BUFFERHEADERTYPE *pHeader) = 0;
 	virtual void FreeBuffer(OMX_U32 nPortIdx, OMX_BUFFERHEADERTYPE *pBuffer) = 0;
 	virtual bool IsEventPending(OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2) = 0;
+	virtual bool IsFillPending(const OMX_BUFFERHEADERTYPE *pBuf) = 0;
 	virtual IEventSPtr WaitForEvent(OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, unsigned int uTimeoutMs) = 0;
 	virtual IEventSPtr WaitForEmpty(const OMX_BUFFERHEADERTYPE* pBuf, unsigned int uTimeoutMs) = 0;
 	virtual IEventSPtr WaitForFill(const OMX_BUFFERHEADERTYPE* pBuf, unsigned int uTimeoutMs) = 0;
@@ -66,6 +67,7 @@ public:
 	void FillThisBuffer(OMX_BUFFERHEADERTYPE *pHeader);
 	void FreeBuffer(OMX_U32 nPortIdx, OMX_BUFFERHEADERTYPE *pBuffer);
 	bool IsEventPending(OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2);
+	bool IsFillPending(const OMX_BUFFERHEADERTYPE *pBuf);
 	IEventSPtr WaitForEvent(OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, unsigned int uTimeoutMs);
 	IEventSPtr WaitForEmpty(const OMX_BUFFERHEADERTYPE* pBuf, unsigned int uTimeoutMs);
 	IEventSPtr WaitForFill(const OMX_BUFFERHEADERTYPE* pBuf, unsigned int uTimeoutMs);
@@ -0,0 +1,79 @@
+#ifdef USE_EGL
+#ifdef IS_HEADLESS
+
+#include "../video/VideoObjects/VideoObjectGLES2_Headless.h"
+#include "PlatformHeadless.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+IPlatformSPtr PlatformHeadless::GetInstance(unsigned int uWidth, unsigned int uHeight)
+{
+	return IPlatformSPtr(new PlatformHeadless(uWidth, uHeight), PlatformHeadless::deleter());
+}
+
+IVideoObject *PlatformHeadless::VideoInit()
+{
+	m_video = VideoObjectGLES2_Headless::GetInstance(m_pLogger, m_uWidth, m_uHeight);
+	m_pVideo = m_video.get();
+
+	if (!m_pVideo)
+	{
+		m_pLogger->Log("Could not create an offscreen EGL context (is EGL/GLES2 installed?)");
+	}
+
+	return(m_pVideo);
+}
+
+void PlatformHeadless::SetLogger(ILogger *pLogger)
+{
+	m_pLogger = pLogger;
+}
+
+IJPEGDecode *PlatformHeadless::GetJPEGDecoder()
+{
+	// deferred so we get an instance of logger and so we can get a video object
+	if (m_pJPEG == 0)
+	{
+#ifdef USE_LIBJPEG
+		m_jpegSW = JPEGSoftware::GetInstance(m_pVideo->ToEGLImage(), m_pVideo->ToYUV(), m_pLogger);
+#endif // USE_LIBJPEG
+#ifdef USE_PNG
+		m_png = PNGDecode::GetInstance(m_pVideo->ToEGLImage(), m_pLogger);
+#endif // USE_PNG
+		m_jpeg = JPEGRouter::GetInstance(NULL, m_jpegSW.get(), m_png.get(), m_pLogger);
+		m_pJPEG = m_jpeg.get();
+	}
+
+	return m_pJPEG;
+}
+
+void PlatformHeadless::GetJPEGRouteStats(JPEGRouteStats *pStats)
+{
+	((JPEGRouter *) m_pJPEG)->GetStats(pStats);
+}
+
+PlatformHeadless::PlatformHeadless(unsigned int uWidth, unsigned int uHeight) :
+m_pLogger(NULL),
+m_uWidth(uWidth),
+m_uHeight(uHeight),
+m_pVideo(NULL),
+m_pJPEG(NULL)
+{
+}
+
+PlatformHeadless::~PlatformHeadless()
+{
+	// decoders free their images through the video object
+	m_jpeg.reset();
+	m_jpegSW.reset();
+	m_png.reset();
+	m_video.reset();
+}
+
+void PlatformHeadless::DeleteInstance()
+{
+	delete this;
+}
+
+#endif // IS_HEADLESS
+#endif // USE_EGL
@@ -0,0 +1,52 @@
+#ifndef PLATFORMHEADLESS_H
+#define PLATFORMHEADLESS_H
+
+#ifdef IS_HEADLESS
+
+#include "IPlatform.h"
+#include "../jpeg/JPEGSoftware.h"
+#include "../jpeg/JPEGRouter.h"
+#include "../jpeg/PNGDecode.h"
+
+// Any linux box with EGL and GLES2 (Mesa's software rasterizer will do).
+// Frames are rendered offscreen and JPEGs are decoded with libjpeg since there is no hardware decoder.
+class PlatformHeadless : public MpoDeleter, public IPlatform
+{
+public:
+	// size of the offscreen frame
+	static IPlatformSPtr GetInstance(unsigned int uWidth = 1280, unsigned int uHeight = 720);
+
+	IVideoObject *VideoInit();
+
+	void SetLogger(ILogger *pLogger);
+
+	// returns the software decoder and the PNG decoder (behind a router so that stats look the same as on the pi)
+	IJPEGDecode *GetJPEGDecoder();
+
+	// how many images went to which decoder (and why)
+	void GetJPEGRouteStats(JPEGRouteStats *pStats);
+
+private:
+	PlatformHeadless(unsigned int uWidth, unsigned int uHeight);
+	virtual ~PlatformHeadless();
+
+	void DeleteInstance();
+
+	////////////////////////////////////////
+
+	ILogger *m_pLogger;
+
+	unsigned int m_uWidth, m_uHeight;
+
+	IVideoObjectSPtr m_video;
+	IVideoObject *m_pVideo;
+
+	IJPEGDecodeSPtr m_jpegSW;
+	IJPEGDecodeSPtr m_png;
+
+	IJPEGDecodeSPtr m_jpeg;
+	IJPEGDecode *m_pJPEG;
+};
+
+#endif // IS_HEADLESS
+#endif // PLATFORMHEADLESS_H
@@ -58,16 +58,30 @@ IJPEGDecode *PlatformRPI::GetJPEGDecoder()
 	if (m_pJPEG == 0)
 	{
 		m_lockerDecode = PosixLocker::GetInstance();
+		m_lockerResize = PosixLocker::GetInstance();
 		m_lockerRender = PosixLocker::GetInstance();
 		m_pCompDecode = m_pCore->GetHandle("OMX.broadcom.image_decode", m_lockerDecode.get());
+		m_pCompResize = m_pCore->GetHandle("OMX.broadcom.resize", m_lockerResize.get());
 		m_pCompRender = m_pCore->GetHandle("OMX.broadcom.egl_render", m_lockerRender.get());
-		m_jpeg = JPEGOpenMax::GetInstance(m_pVideo->ToEGLImage(), m_pCompDecode, m_pCompRender, this, m_pLogger);
+		m_jpegHW = JPEGOpenMax::GetInstance(m_pVideo->ToEGLImage(), m_pCompDecode, m_pCompResize, m_pCompRender, this, m_pLogger);
+#ifdef USE_LIBJPEG
+		m_jpegSW = JPEGSoftware::GetInstance(m_pVideo->ToEGLImage(), m_pVideo->ToYUV(), m_pLogger);
+#endif // USE_LIBJPEG
+#ifdef USE_PNG
+		m_png = PNGDecode::GetInstance(m_pVideo->ToEGLImage(), m_pLogger);
+#endif // USE_PNG
+		m_jpeg = JPEGRouter::GetInstance(m_jpegHW.get(), m_jpegSW.get(), m_png.get(), m_pLogger);
 		m_pJPEG = m_jpeg.get();
 	}
 
 	return m_pJPEG;
 }
 
+void PlatformRPI::GetJPEGRouteStats(JPEGRouteStats *pStats)
+{
+	((JPEGRouter *) m_pJPEG)->GetStats(pStats);
+}
+
 bool PlatformRPI::MyMalloc(void **memptr, size_t alignment, size_t size)
 {
 	return (posix_memalign(memptr, alignment, size) == 0);
@@ -91,6 +105,7 @@ m_pLogger(NULL),
 m_pVideo(NULL),
 m_pJPEG(NULL),
 m_pCompDecode(NULL),
+m_pCompResize(NULL),
 m_pCompRender(NULL)
 {
 }
@@ -99,6 +114,9 @@ PlatformRPI::~PlatformRPI()
 {
 	// de-initialize components before de-initalizing core
 	m_jpeg.reset();
+	m_jpegSW.reset();
+	m_jpegHW.reset();
+	m_png.reset();
 
 	m_core.reset();
 
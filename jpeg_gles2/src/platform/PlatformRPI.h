@@ -12,6 +12,9 @@
 #include "../openmax/IClock.h"
 #include "../openmax/OMXCore.h"
 #include "../jpeg/JPEGOpenMax.h"
+#include "../jpeg/JPEGSoftware.h"
+#include "../jpeg/JPEGRouter.h"
+#include "../jpeg/PNGDecode.h"
 #include "PosixLocker.h"
 #include <list>
 using namespace std;
@@ -25,8 +28,12 @@ public:
 
 	void SetLogger(ILogger *pLogger);
 
+	// returns a decoder that uses the hardware where it can and falls back to software otherwise
 	IJPEGDecode *GetJPEGDecoder();
 
+	// how many images went to which decoder (and why)
+	void GetJPEGRouteStats(JPEGRouteStats *pStats);
+
 	/////////////
 	// IMemoryAligned methods
 	bool MyMalloc(void **memptr, size_t alignment, size_t size);
@@ -55,14 +62,17 @@ private:
 	IVideoObjectSPtr m_video;
 	IVideoObject *m_pVideo;
 
+	IJPEGDecodeSPtr m_jpegHW, m_jpegSW, m_png;
+
+	// the router that sits in front of the hardware and software decoders
 	IJPEGDecodeSPtr m_jpeg;
 	IJPEGDecode *m_pJPEG;
 
 	IOMXCoreSPtr m_core;
 	IOMXCore *m_pCore;
-	IOMXComponent *m_pCompDecode, *m_pCompRender;
+	IOMXComponent *m_pCompDecode, *m_pCompResize, *m_pCompRender;
 
-	ILockerSPtr m_lockerDecode, m_lockerRender;
+	ILockerSPtr m_lockerDecode, m_lockerResize, m_lockerRender;
 };
 
 #endif // IS_RPI
@@ -0,0 +1,179 @@
+#include "PresentScheduler.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+PresentSchedulerSPtr PresentScheduler::GetInstance(IVideoObject *pVideo, unsigned int uTargetFPS, bool bAdaptiveVsync, ILogger *pLogger)
+{
+	PresentSchedulerSPtr pRes;
+	PresentScheduler *pInstance = new PresentScheduler(pVideo, uTargetFPS, bAdaptiveVsync, pLogger);
+
+	if (pInstance->Init())
+	{
+		pRes = PresentSchedulerSPtr(pInstance, PresentScheduler::deleter());
+	}
+	else
+	{
+		delete pInstance;
+	}
+
+	return pRes;
+}
+
+bool PresentScheduler::Init()
+{
+	if (m_u64PeriodUs == 0)
+	{
+		m_pLogger->Log("PresentScheduler: target frame rate must be at least 1");
+		return false;
+	}
+
+	m_iTimerFD = timerfd_create(CLOCK_MONOTONIC, 0);
+
+	if (m_iTimerFD == -1)
+	{
+		m_pLogger->Log("PresentScheduler: timerfd_create failed");
+		return false;
+	}
+
+	// periodic from now on, so frame slots stay evenly spaced no matter how long each frame takes
+	struct itimerspec spec;
+	spec.it_interval.tv_sec = m_u64PeriodUs / 1000000;
+	spec.it_interval.tv_nsec = (m_u64PeriodUs % 1000000) * 1000;
+	spec.it_value = spec.it_interval;
+
+	if (timerfd_settime(m_iTimerFD, 0, &spec, NULL) != 0)
+	{
+		m_pLogger->Log("PresentScheduler: timerfd_settime failed");
+		return false;
+	}
+
+	// the timer sets the cadence so vsync only comes into it when adaptive vsync is on
+	m_pVideo->SetVsync(m_bAdaptiveVsync);
+
+	return true;
+}
+
+void PresentScheduler::WaitForNextFrame()
+{
+	uint64_t u64Expirations = 0;
+
+	// blocks until the timer fires, and tells us how many times it fired since the last read
+	if (read(m_iTimerFD, &u64Expirations, sizeof(u64Expirations)) != sizeof(u64Expirations))
+	{
+		return;
+	}
+
+	m_bLate = (u64Expirations > 1);
+
+	if (m_bLate)
+	{
+		m_stats.uMissedDeadlines += (unsigned int) (u64Expirations - 1);
+	}
+}
+
+void PresentScheduler::Present()
+{
+	// a late frame goes out right away instead of waiting for the next vsync
+	if (m_bAdaptiveVsync)
+	{
+		m_pVideo->SetVsync(!m_bLate);
+
+		if (m_bLate)
+		{
+			m_stats.uUnsyncedFrames++;
+		}
+	}
+
+	m_pVideo->RenderFrame();
+	m_pVideo->Flip();
+
+	uint64_t u64Now = GetTimeUs();
+
+	if (m_u64LastPresentUs != 0)
+	{
+		double dIntervalMs = (u64Now - m_u64LastPresentUs) / 1000.0;
+		m_dIntervalSumMs += dIntervalMs;
+		m_dIntervalSumSqMs += dIntervalMs * dIntervalMs;
+		m_uIntervals++;
+
+		if (dIntervalMs > m_stats.dMaxIntervalMs)
+		{
+			m_stats.dMaxIntervalMs = dIntervalMs;
+		}
+	}
+
+	if (m_u64PendingStartUs != 0)
+	{
+		double dLatencyMs = (u64Now - m_u64PendingStartUs) / 1000.0;
+		m_dLatencySumMs += dLatencyMs;
+		m_stats.uImagesShown++;
+
+		if (dLatencyMs > m_stats.dMaxLatencyMs)
+		{
+			m_stats.dMaxLatencyMs = dLatencyMs;
+		}
+
+		m_u64PendingStartUs = 0;
+	}
+
+	m_u64LastPresentUs = u64Now;
+	m_stats.uFrames++;
+}
+
+void PresentScheduler::ImageReady(uint64_t u64StartUs)
+{
+	m_u64PendingStartUs = u64StartUs;
+}
+
+void PresentScheduler::GetStats(PresentStats *pStats) const
+{
+	*pStats = m_stats;
+
+	if (m_uIntervals != 0)
+	{
+		double dMean = m_dIntervalSumMs / m_uIntervals;
+		double dVariance = (m_dIntervalSumSqMs / m_uIntervals) - (dMean * dMean);
+		pStats->dMeanIntervalMs = dMean;
+		pStats->dJitterMs = (dVariance > 0) ? sqrt(dVariance) : 0;
+	}
+
+	if (m_stats.uImagesShown != 0)
+	{
+		pStats->dMeanLatencyMs = m_dLatencySumMs / m_stats.uImagesShown;
+	}
+}
+
+uint64_t PresentScheduler::GetTimeUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+PresentScheduler::PresentScheduler(IVideoObject *pVideo, unsigned int uTargetFPS, bool bAdaptiveVsync, ILogger *pLogger) :
+m_pVideo(pVideo),
+m_pLogger(pLogger),
+m_iTimerFD(-1),
+m_u64PeriodUs((uTargetFPS != 0) ? (1000000 / uTargetFPS) : 0),
+m_bAdaptiveVsync(bAdaptiveVsync),
+m_bLate(false),
+m_u64LastPresentUs(0),
+m_u64PendingStartUs(0),
+m_dIntervalSumMs(0),
+m_dIntervalSumSqMs(0),
+m_dLatencySumMs(0),
+m_uIntervals(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+PresentScheduler::~PresentScheduler()
+{
+	if (m_iTimerFD != -1)
+	{
+		close(m_iTimerFD);
+	}
+}
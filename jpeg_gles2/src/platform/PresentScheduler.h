@@ -0,0 +1,79 @@
+#ifndef PRESENTSCHEDULER_H
+#define PRESENTSCHEDULER_H
+
+#include "../video/VideoObjects/IVideoObject.h"
+#include "../io/logger.h"
+#include "../common/mpo_deleter.h"
+
+struct PresentStats
+{
+	unsigned int uFrames;
+	unsigned int uMissedDeadlines;	// frame slots that went by without a frame because the one before was late
+	unsigned int uUnsyncedFrames;	// frames that were swapped without waiting for vsync (adaptive vsync only)
+	double dMeanIntervalMs;		// between presents
+	double dJitterMs;		// standard deviation of the interval between presents
+	double dMaxIntervalMs;
+	unsigned int uImagesShown;
+	double dMeanLatencyMs;		// from when a decode was started until the first frame that showed it was presented
+	double dMaxLatencyMs;
+};
+
+// Paces rendering at a fixed frame rate (normally the display's) instead of as fast as possible.
+// A timerfd wakes us up once per frame period, so a slow frame doesn't push every frame after it back,
+//  and decoded images are simply picked up by whichever frame comes after they are done.
+// With adaptive vsync, frames wait for vsync unless the one before was late, in which case the frame is
+//  swapped right away (it may tear, but it doesn't cost another whole refresh).
+class PresentScheduler : public MpoDeleter
+{
+public:
+	// returns an empty pointer if the timer could not be created
+	static shared_ptr<PresentScheduler> GetInstance(IVideoObject *pVideo, unsigned int uTargetFPS, bool bAdaptiveVsync, ILogger *pLogger);
+
+	// sleeps until the next frame is due (returns early if a signal comes in)
+	void WaitForNextFrame();
+
+	// renders and flips, then records when the frame went out
+	void Present();
+
+	// an image whose decode was started at u64StartUs (see GetTimeUs) will be on the next frame
+	void ImageReady(uint64_t u64StartUs);
+
+	void GetStats(PresentStats *pStats) const;
+
+	// monotonic clock in microseconds
+	static uint64_t GetTimeUs();
+
+private:
+	PresentScheduler(IVideoObject *pVideo, unsigned int uTargetFPS, bool bAdaptiveVsync, ILogger *pLogger);
+	virtual ~PresentScheduler();
+
+	void DeleteInstance() { delete this; }
+
+	bool Init();
+
+	IVideoObject *m_pVideo;
+	ILogger *m_pLogger;
+
+	int m_iTimerFD;
+	uint64_t m_u64PeriodUs;
+
+	bool m_bAdaptiveVsync;
+
+	// the last WaitForNextFrame found that one or more frame slots had already gone by
+	bool m_bLate;
+
+	uint64_t m_u64LastPresentUs;
+
+	// decode start time of the image that the next frame will show (0 if none)
+	uint64_t m_u64PendingStartUs;
+
+	PresentStats m_stats;
+
+	// for the mean and standard deviation
+	double m_dIntervalSumMs, m_dIntervalSumSqMs, m_dLatencySumMs;
+	unsigned int m_uIntervals;
+};
+
+typedef shared_ptr<PresentScheduler> PresentSchedulerSPtr;
+
+#endif // PRESENTSCHEDULER_H
@@ -0,0 +1,230 @@
+#ifdef USE_OPENGL
+
+#include "GLStateCache.h"
+#include <string.h>
+
+GLStateCache::GLStateCache() :
+m_bInFrame(false),
+m_uFrameCalls(0),
+m_uFrameSkipped(0),
+m_uFrameDraws(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	Invalidate();
+}
+
+void GLStateCache::Invalidate()
+{
+	m_bProgramValid = false;
+	m_uProgram = 0;
+	m_bActiveTextureValid = false;
+	m_uActiveTextureUnit = 0;
+
+	for (unsigned int u = 0; u < MAX_TEXTURE_UNITS; u++)
+	{
+		m_bTextureValid[u] = false;
+		m_uTextures[u] = 0;
+	}
+
+	m_bArrayBufferValid = false;
+	m_bElementBufferValid = false;
+	m_uArrayBuffer = 0;
+	m_uElementBuffer = 0;
+
+	memset(m_attribs, 0, sizeof(m_attribs));
+}
+
+void GLStateCache::BeginFrame()
+{
+	// calls made before the first frame (ie during init) aren't counted
+	if (m_bInFrame)
+	{
+		m_stats.uFrames++;
+		m_stats.uCalls += m_uFrameCalls;
+		m_stats.uSkipped += m_uFrameSkipped;
+		m_stats.uDraws += m_uFrameDraws;
+		m_stats.uLastFrameCalls = m_uFrameCalls;
+		m_stats.uLastFrameSkipped = m_uFrameSkipped;
+		m_stats.uLastFrameDraws = m_uFrameDraws;
+	}
+
+	m_bInFrame = true;
+	m_uFrameCalls = 0;
+	m_uFrameSkipped = 0;
+	m_uFrameDraws = 0;
+}
+
+void GLStateCache::UseProgram(GLuint uProgram)
+{
+	if (m_bProgramValid && (m_uProgram == uProgram))
+	{
+		m_uFrameSkipped++;
+		return;
+	}
+
+	glUseProgram(uProgram);
+	m_uFrameCalls++;
+	m_uProgram = uProgram;
+	m_bProgramValid = true;
+}
+
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+	unsigned int uUnit = unit - GL_TEXTURE0;
+
+	if (m_bActiveTextureValid && (m_uActiveTextureUnit == uUnit))
+	{
+		m_uFrameSkipped++;
+		return;
+	}
+
+	glActiveTexture(unit);
+	m_uFrameCalls++;
+	m_uActiveTextureUnit = uUnit;
+	m_bActiveTextureValid = (uUnit < MAX_TEXTURE_UNITS);
+}
+
+void GLStateCache::BindTexture(GLuint uTexture)
+{
+	unsigned int uUnit = m_uActiveTextureUnit;
+
+	if (m_bActiveTextureValid && m_bTextureValid[uUnit] && (m_uTextures[uUnit] == uTexture))
+	{
+		m_uFrameSkipped++;
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, uTexture);
+	m_uFrameCalls++;
+
+	// if we don't know which unit is active we can't know what this replaced
+	if (m_bActiveTextureValid)
+	{
+		m_uTextures[uUnit] = uTexture;
+		m_bTextureValid[uUnit] = true;
+	}
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint uBuffer)
+{
+	bool *pbValid = (target == GL_ARRAY_BUFFER) ? &m_bArrayBufferValid : &m_bElementBufferValid;
+	GLuint *puBuffer = (target == GL_ARRAY_BUFFER) ? &m_uArrayBuffer : &m_uElementBuffer;
+
+	if (*pbValid && (*puBuffer == uBuffer))
+	{
+		m_uFrameSkipped++;
+		return;
+	}
+
+	glBindBuffer(target, uBuffer);
+	m_uFrameCalls++;
+	*puBuffer = uBuffer;
+	*pbValid = true;
+}
+
+void GLStateCache::VertexAttribPointer(GLuint uIdx, GLuint uBuffer, GLint iSize, GLenum type, GLboolean bNormalized, GLsizei iStride, const GLvoid *pOffset)
+{
+	AttribState *pAttrib = (uIdx < MAX_ATTRIBS) ? &m_attribs[uIdx] : NULL;
+
+	// the buffer is captured when glVertexAttribPointer is called, so if nothing has changed we don't even need to bind it
+	if (pAttrib && pAttrib->bValid && (pAttrib->uBuffer == uBuffer) && (pAttrib->iSize == iSize) && (pAttrib->type == type) &&
+		(pAttrib->bNormalized == bNormalized) && (pAttrib->iStride == iStride) && (pAttrib->pOffset == pOffset))
+	{
+		m_uFrameSkipped++;
+		return;
+	}
+
+	BindBuffer(GL_ARRAY_BUFFER, uBuffer);
+	glVertexAttribPointer(uIdx, iSize, type, bNormalized, iStride, pOffset);
+	m_uFrameCalls++;
+
+	if (pAttrib)
+	{
+		pAttrib->bValid = true;
+		pAttrib->uBuffer = uBuffer;
+		pAttrib->iSize = iSize;
+		pAttrib->type = type;
+		pAttrib->bNormalized = bNormalized;
+		pAttrib->iStride = iStride;
+		pAttrib->pOffset = pOffset;
+	}
+}
+
+void GLStateCache::CacheUniformLocations(GLuint uProgram)
+{
+	GLint iCount = 0, iMaxLen = 0;
+	glGetProgramiv(uProgram, GL_ACTIVE_UNIFORMS, &iCount);
+	glGetProgramiv(uProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &iMaxLen);
+
+	map<string, GLint> &mapLocs = m_mapUniforms[uProgram];
+	string strName;
+	strName.resize(iMaxLen + 1);
+
+	for (GLint i = 0; i < iCount; i++)
+	{
+		GLsizei iLen = 0;
+		GLint iSize = 0;
+		GLenum type = 0;
+		glGetActiveUniform(uProgram, i, iMaxLen + 1, &iLen, &iSize, &type, &strName[0]);
+
+		string strUniform(strName.c_str(), iLen);
+		mapLocs[strUniform] = glGetUniformLocation(uProgram, strUniform.c_str());
+	}
+}
+
+GLint GLStateCache::GetUniformLocation(GLuint uProgram, const char *cpszName)
+{
+	map<string, GLint> &mapLocs = m_mapUniforms[uProgram];
+	map<string, GLint>::iterator mi = mapLocs.find(cpszName);
+
+	if (mi != mapLocs.end())
+	{
+		m_uFrameSkipped++;
+		return mi->second;
+	}
+
+	GLint iLoc = glGetUniformLocation(uProgram, cpszName);
+	m_uFrameCalls++;
+	mapLocs[cpszName] = iLoc;
+	return iLoc;
+}
+
+void GLStateCache::OnDeleteTexture(GLuint uTexture)
+{
+	for (unsigned int u = 0; u < MAX_TEXTURE_UNITS; u++)
+	{
+		if (m_bTextureValid[u] && (m_uTextures[u] == uTexture))
+		{
+			m_uTextures[u] = 0;
+		}
+	}
+}
+
+void GLStateCache::OnDeleteBuffer(GLuint uBuffer)
+{
+	if (m_uArrayBuffer == uBuffer)
+	{
+		m_uArrayBuffer = 0;
+	}
+
+	if (m_uElementBuffer == uBuffer)
+	{
+		m_uElementBuffer = 0;
+	}
+
+	// the attribute still points at the deleted buffer, but it can't match any buffer we bind in the future either
+	for (unsigned int u = 0; u < MAX_ATTRIBS; u++)
+	{
+		if (m_attribs[u].uBuffer == uBuffer)
+		{
+			m_attribs[u].bValid = false;
+		}
+	}
+}
+
+void GLStateCache::GetStats(VideoRenderStats *pStats) const
+{
+	*pStats = m_stats;
+}
+
+#endif // USE_OPENGL
@@ -0,0 +1,97 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include "IVideoObject.h"
+#include <GLES2/gl2.h>
+#include <map>
+#include <string>
+
+using namespace std;
+
+// Remembers what is bound so that redundant glUseProgram/glBindTexture/glBindBuffer/glVertexAttribPointer calls never reach the driver
+//  (on the raspberry pi every GL call is a round trip to the VideoCore, so these add up on the frame time).
+// Also keeps uniform locations so that nothing has to be looked up by name while rendering.
+// All GL state changes must go through here (or Invalidate must be called afterwards) or the cache will be wrong.
+class GLStateCache
+{
+public:
+	GLStateCache();
+
+	// forget everything we think is bound
+	void Invalidate();
+
+	// marks the start of a frame (per-frame statistics are counted from here)
+	void BeginFrame();
+
+	void UseProgram(GLuint uProgram);
+
+	void ActiveTexture(GLenum unit);
+
+	// binds to GL_TEXTURE_2D of the active texture unit
+	void BindTexture(GLuint uTexture);
+
+	// target is GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+	void BindBuffer(GLenum target, GLuint uBuffer);
+
+	// Points an attribute at uBuffer. uBuffer is only bound (to GL_ARRAY_BUFFER) if the attribute isn't already set up this way.
+	void VertexAttribPointer(GLuint uIdx, GLuint uBuffer, GLint iSize, GLenum type, GLboolean bNormalized, GLsizei iStride, const GLvoid *pOffset);
+
+	// looks up every active uniform of a freshly linked program
+	void CacheUniformLocations(GLuint uProgram);
+
+	// returns the cached location (looking it up if it isn't cached)
+	GLint GetUniformLocation(GLuint uProgram, const char *cpszName);
+
+	// deleting something that is bound unbinds it
+	void OnDeleteTexture(GLuint uTexture);
+	void OnDeleteBuffer(GLuint uBuffer);
+
+	// for GL calls that don't change cached state (draws, uniforms, buffer uploads, etc) so they show up in the statistics
+	void CountCalls(unsigned int uCalls = 1) { m_uFrameCalls += uCalls; }
+
+	// for glDrawArrays/glDrawElements
+	void CountDraw() { m_uFrameCalls++; m_uFrameDraws++; }
+
+	void GetStats(VideoRenderStats *pStats) const;
+
+private:
+	enum
+	{
+		MAX_TEXTURE_UNITS = 8,
+		MAX_ATTRIBS = 8
+	};
+
+	struct AttribState
+	{
+		bool bValid;
+		GLuint uBuffer;
+		GLint iSize;
+		GLenum type;
+		GLboolean bNormalized;
+		GLsizei iStride;
+		const GLvoid *pOffset;
+	};
+
+	// each member is only trusted if its matching bValid flag is set
+	bool m_bProgramValid;
+	GLuint m_uProgram;
+
+	bool m_bActiveTextureValid;
+	unsigned int m_uActiveTextureUnit;
+
+	bool m_bTextureValid[MAX_TEXTURE_UNITS];
+	GLuint m_uTextures[MAX_TEXTURE_UNITS];
+
+	bool m_bArrayBufferValid, m_bElementBufferValid;
+	GLuint m_uArrayBuffer, m_uElementBuffer;
+
+	AttribState m_attribs[MAX_ATTRIBS];
+
+	map<GLuint, map<string, GLint> > m_mapUniforms;
+
+	bool m_bInFrame;
+	unsigned int m_uFrameCalls, m_uFrameSkipped, m_uFrameDraws;
+	VideoRenderStats m_stats;
+};
+
+#endif // GL_STATE_CACHE_H
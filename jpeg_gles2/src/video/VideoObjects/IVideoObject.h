@@ -7,6 +7,39 @@
 
 #include "IVideoObjectPublic.h"
 #include "../../common/mpo_deleter.h"
+#include "../../common/common.h"
+
+// counts of calls that reach the graphics driver
+struct VideoRenderStats
+{
+	unsigned int uFrames;
+	unsigned int uCalls;		// total over all frames
+	unsigned int uSkipped;		// redundant state changes that were never sent to the driver
+	unsigned int uDraws;		// draw calls (these are included in uCalls)
+	unsigned int uLastFrameCalls;
+	unsigned int uLastFrameSkipped;
+	unsigned int uLastFrameDraws;
+	unsigned int uFenceStalls;	// times a decode target had to wait for the GPU to finish reading it
+	unsigned int uProgramsCached;	// shader programs that were loaded from the program cache at startup
+	unsigned int uProgramsCompiled;	// shader programs that had to be compiled from source
+	unsigned int uPostPasses;	// render to texture passes run by the post-processing chain
+	unsigned int uPostReused;	// frames that drew the chain's cached result instead of running it again
+};
+
+// What RenderFrame does to the full screen image before it is shown (sprites are never post-processed).
+// The result is rendered to a texture once and drawn from there until the image on screen changes.
+struct VideoPostProcess
+{
+	VideoPostProcess() : bEnabled(false), bLetterbox(true), fSharpen(0.0f) { }
+
+	bool bEnabled;
+
+	// keep the image's aspect ratio with black bars (otherwise it is stretched over the whole screen)
+	bool bLetterbox;
+
+	// unsharp mask strength after downscaling (0 for none, around 0.5 is plenty)
+	float fSharpen;
+};
 
 class IVideoObject : public IVideoObjectPublic
 {
@@ -16,6 +49,20 @@ public:
 
 	// makes back buffer the front buffer (this must be called after RenderFrame)
 	virtual void Flip() = 0;
+
+	// whether Flip waits for the display's vertical blank (off by default so that benchmarks run flat out)
+	virtual void SetVsync(bool bWait) = 0;
+
+	// Downscales the image to the size it is shown at (and optionally sharpens it) once, instead of
+	//  minifying the full resolution texture every frame.
+	virtual void SetPostProcess(const VideoPostProcess &post) = 0;
+
+	// statistics for the frames rendered so far
+	virtual void GetRenderStats(VideoRenderStats *pStats) const = 0;
+
+	// Copies what has been rendered so far (call it between RenderFrame and Flip) as tightly packed RGBA, top row first.
+	// This is slow and is meant for checking the output, not for every frame.
+	virtual void ReadFrame(byteSA &vRGBA, unsigned int *puWidth, unsigned int *puHeight) = 0;
 };
 
 typedef shared_ptr<IVideoObject> IVideoObjectSPtr;
@@ -5,13 +5,45 @@
 #ifndef IVIDEOOBJECTEGLIMAGE_H
 #define IVIDEOOBJECTEGLIMAGE_H
 
+#include "../../common/datatypes.h"
+
 // used for rendering to texture
 
 class IVideoObjectEGLImage
 {
 public:
+	// each EGL image gets its own texture so that several decoded images can stay resident at once
 	virtual void *CreateEGLImage(unsigned int uTextureWidth, unsigned int uTextureHeight) = 0;
 	virtual void DeleteEGLImage(void *) = 0;
+
+	// uploads tightly packed RGBA pixels (top row first) into the texture behind an EGL image (for software decoders)
+	virtual void UpdateEGLImage(void *eglImage, const uint8_t *p8RGBA, unsigned int uWidth, unsigned int uHeight) = 0;
+
+	// same as UpdateEGLImage but only replaces the rectangle whose top left corner is at uX, uY (for atlases)
+	virtual void UpdateEGLImageRect(void *eglImage, unsigned int uX, unsigned int uY, const uint8_t *p8RGBA, unsigned int uWidth, unsigned int uHeight) = 0;
+
+	// selects which EGL image RenderFrame will display (must have been returned by CreateEGLImage).
+	// This takes effect right away and cancels any published decode target that hasn't been shown yet.
+	virtual void SetDisplayEGLImage(void *) = 0;
+
+	// Decode targets are a ring of EGL images (3 by default) owned by the video object so that a decoder never writes
+	//  into the image that is on screen. A decoder acquires a target, decodes into it and publishes it;
+	//  when the next frame starts, RenderFrame switches to the most recently published target.
+	// Only one decode at a time should be using the ring.
+
+	// 2 (double buffering) to 4, takes effect as targets are acquired
+	virtual void SetDecodeTargetCount(unsigned int uCount) = 0;
+
+	// returns a uWidth x uHeight target that is neither on screen nor waiting to be shown (call from the GL thread)
+	virtual void *AcquireDecodeTarget(unsigned int uWidth, unsigned int uHeight) = 0;
+
+	// Marks a target as completely decoded. May be called from any thread.
+	// If a previously published target hasn't been shown yet, it is skipped.
+	// Anything that is not a decode target is displayed right away instead (as with SetDisplayEGLImage).
+	virtual void PublishDecodeTarget(void *eglImage) = 0;
+
+	// takes a target out of the ring so that it is never reused; it becomes a normal EGL image that the caller must delete
+	virtual void ReleaseDecodeTarget(void *eglImage) = 0;
 };
 
 #endif
@@ -7,6 +7,8 @@
 
 #include "VideoObjectCommon.h"
 #include "IVideoObjectEGLImage.h"
+#include "IVideoObjectSprites.h"
+#include "IVideoObjectYUV.h"
 
 class IVideoObjectPublic
 {
@@ -24,6 +26,8 @@ public:
 	// cast this class to any one of the following interfaces.
 	// If class implements interface, it will return 'this' otherwise it will return NULL.
 	virtual IVideoObjectEGLImage *ToEGLImage() = 0;
+	virtual IVideoObjectSprites *ToSprites() = 0;
+	virtual IVideoObjectYUV *ToYUV() = 0;
 
 };
 
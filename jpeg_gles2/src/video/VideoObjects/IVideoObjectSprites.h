@@ -0,0 +1,44 @@
+#ifndef IVIDEOOBJECTSPRITES_H
+#define IVIDEOOBJECTSPRITES_H
+
+// one textured rectangle on the screen
+struct VideoSprite
+{
+	VideoSprite() :
+	eglImage(0), fLeft(0), fTop(0), fRight(1), fBottom(1), fU0(0), fV0(0), fU1(1), fV1(1), fRotation(0), iLayer(0)
+	{
+	}
+
+	// must have been returned by IVideoObjectEGLImage::CreateEGLImage
+	void *eglImage;
+
+	// where on the screen it goes (0,0 is the top left of the screen, 1,1 the bottom right)
+	float fLeft, fTop, fRight, fBottom;
+
+	// which part of the texture to show (0,0 is the first pixel of the image, 1,1 the last)
+	float fU0, fV0, fU1, fV1;
+
+	// radians, clockwise around the center of the rectangle
+	float fRotation;
+
+	// higher layers are drawn on top of lower ones
+	int iLayer;
+};
+
+// used for drawing several images (or pieces of images) at once
+
+class IVideoObjectSprites
+{
+public:
+	// removes all sprites (RenderFrame goes back to drawing the full screen EGL image)
+	virtual void ClearSprites() = 0;
+
+	// sprites are drawn by RenderFrame instead of the full screen EGL image.
+	// Sprites on the same layer are grouped by image so that they can be drawn together,
+	//  so use layers if the order that overlapping sprites are drawn in matters.
+	// They stay until cleared or until their EGL image is deleted.
+	// Throws if the image is unknown or if there are already too many sprites (16384).
+	virtual void AddSprite(const VideoSprite &sprite) = 0;
+};
+
+#endif
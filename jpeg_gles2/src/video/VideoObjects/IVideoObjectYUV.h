@@ -0,0 +1,23 @@
+#ifndef IVIDEOOBJECTYUV_H
+#define IVIDEOOBJECTYUV_H
+
+#include "../../common/datatypes.h"
+
+// Planar YCbCr images (the way JPEGs are stored) that get converted to RGB by the fragment shader when they are drawn.
+// Each plane is its own 8-bit texture, so a 4:2:0 image takes 1.5 bytes per pixel instead of 4 and the decoder
+//  doesn't have to do any color conversion (or chroma upsampling).
+class IVideoObjectYUV
+{
+public:
+	// Y is uWidth x uHeight, Cb and Cr are uChromaWidth x uChromaHeight each. Throws on error.
+	virtual void *CreateYUVImage(unsigned int uWidth, unsigned int uHeight, unsigned int uChromaWidth, unsigned int uChromaHeight) = 0;
+	virtual void DeleteYUVImage(void *yuvImage) = 0;
+
+	// uploads tightly packed planes (top row first) of the sizes the image was created with
+	virtual void UpdateYUVImage(void *yuvImage, const uint8_t *p8Y, const uint8_t *p8Cb, const uint8_t *p8Cr) = 0;
+
+	// RenderFrame displays this until another YUV image or an EGL image is selected
+	virtual void SetDisplayYUVImage(void *yuvImage) = 0;
+};
+
+#endif // IVIDEOOBJECTYUV_H
@@ -0,0 +1,184 @@
+#ifdef USE_OPENGL
+
+#include "ProgramCache.h"
+#include "../../common/common.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef USE_EGL
+#include <EGL/egl.h>
+#endif // USE_EGL
+
+// bump this if the file layout changes
+#define PROGRAM_CACHE_MAGIC 0x31424750	// "PGB1"
+
+struct ProgramCacheHeader
+{
+	uint32_t u32Magic;
+	uint32_t u32Format;		// the driver's binary format
+	uint32_t u32Length;		// bytes of binary that follow the header
+};
+
+ProgramCache::ProgramCache() :
+m_u64DriverHash(0),
+m_pfnGetProgramBinary(NULL),
+m_pfnProgramBinary(NULL),
+m_uHits(0),
+m_uMisses(0)
+{
+}
+
+void ProgramCache::Init(const string &strDir)
+{
+	const char *cpszExtensions = (const char *) glGetString(GL_EXTENSIONS);
+	GLint iFormats = 0;
+
+	if (strDir.empty() || !cpszExtensions || !strstr(cpszExtensions, "GL_OES_get_program_binary"))
+	{
+		return;
+	}
+
+	// some drivers advertise the extension without supporting any binary format
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &iFormats);
+	if (iFormats <= 0)
+	{
+		return;
+	}
+
+#ifdef USE_EGL
+	m_pfnGetProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC) eglGetProcAddress("glGetProgramBinaryOES");
+	m_pfnProgramBinary = (PFNGLPROGRAMBINARYOESPROC) eglGetProcAddress("glProgramBinaryOES");
+#endif // USE_EGL
+
+	if (!m_pfnGetProgramBinary || !m_pfnProgramBinary)
+	{
+		m_pfnGetProgramBinary = NULL;
+		return;
+	}
+
+	// only the last directory level is created
+	mkdir(strDir.c_str(), 0755);
+	m_strDir = strDir;
+
+	// a binary is only good for the driver that made it
+	m_u64DriverHash = HashString64((const char *) glGetString(GL_VENDOR));
+	m_u64DriverHash = HashString64((const char *) glGetString(GL_RENDERER), m_u64DriverHash);
+	m_u64DriverHash = HashString64((const char *) glGetString(GL_VERSION), m_u64DriverHash);
+}
+
+GLuint ProgramCache::Load(uint64_t u64Key)
+{
+	if (!IsEnabled())
+	{
+		return 0;
+	}
+
+	string strPath = GetPath(u64Key);
+	FILE *F = fopen(strPath.c_str(), "rb");
+
+	if (!F)
+	{
+		m_uMisses++;
+		return 0;
+	}
+
+	ProgramCacheHeader hdr;
+	byteSA vBinary;
+	bool bRead = false;
+
+	if ((fread(&hdr, sizeof(hdr), 1, F) == 1) && (hdr.u32Magic == PROGRAM_CACHE_MAGIC) && (hdr.u32Length != 0))
+	{
+		vBinary.resize(hdr.u32Length);
+		bRead = (fread(vBinary.data(), 1, vBinary.size(), F) == vBinary.size());
+	}
+
+	fclose(F);
+
+	GLuint uProgram = 0;
+
+	if (bRead)
+	{
+		uProgram = glCreateProgram();
+		m_pfnProgramBinary(uProgram, hdr.u32Format, vBinary.data(), (GLint) vBinary.size());
+
+		GLint iLinked = 0;
+		glGetProgramiv(uProgram, GL_LINK_STATUS, &iLinked);
+
+		if (iLinked != GL_TRUE)
+		{
+			glDeleteProgram(uProgram);
+			uProgram = 0;
+		}
+	}
+
+	// the driver may reject binaries for reasons we can't know about, so start over with this one
+	if (uProgram == 0)
+	{
+		unlink(strPath.c_str());
+		m_uMisses++;
+		return 0;
+	}
+
+	m_uHits++;
+	return uProgram;
+}
+
+void ProgramCache::Save(uint64_t u64Key, GLuint uProgram)
+{
+	if (!IsEnabled())
+	{
+		return;
+	}
+
+	GLint iLength = 0;
+	glGetProgramiv(uProgram, GL_PROGRAM_BINARY_LENGTH_OES, &iLength);
+
+	if (iLength <= 0)
+	{
+		return;
+	}
+
+	byteSA vBinary(iLength);
+	GLenum format = 0;
+	GLsizei iWritten = 0;
+	m_pfnGetProgramBinary(uProgram, iLength, &iWritten, &format, vBinary.data());
+
+	if (iWritten <= 0)
+	{
+		return;
+	}
+
+	ProgramCacheHeader hdr;
+	hdr.u32Magic = PROGRAM_CACHE_MAGIC;
+	hdr.u32Format = format;
+	hdr.u32Length = iWritten;
+
+	// written to the side and renamed so that a restart halfway through never leaves a truncated file behind
+	string strPath = GetPath(u64Key);
+	string strTemp = strPath + ".tmp";
+	FILE *F = fopen(strTemp.c_str(), "wb");
+
+	if (!F)
+	{
+		return;
+	}
+
+	bool bOK = (fwrite(&hdr, sizeof(hdr), 1, F) == 1) && (fwrite(vBinary.data(), 1, iWritten, F) == (size_t) iWritten);
+	bOK = (fclose(F) == 0) && bOK;
+
+	if (!bOK || (rename(strTemp.c_str(), strPath.c_str()) != 0))
+	{
+		unlink(strTemp.c_str());
+	}
+}
+
+string ProgramCache::GetPath(uint64_t u64Key) const
+{
+	char s[32];
+	snprintf(s, sizeof(s), "/%016llx.bin", (unsigned long long) u64Key);
+	return m_strDir + s;
+}
+
+#endif // USE_OPENGL
@@ -0,0 +1,54 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#ifdef USE_OPENGL
+
+#include "../../common/datatypes.h"
+#include "../../common/hash.h"
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <string>
+
+using namespace std;
+
+// Keeps linked shader programs on disk (GL_OES_get_program_binary) so that they don't have to be compiled on every start.
+// Programs are keyed by a hash of the driver's vendor/renderer/version strings and everything that went into the program,
+//  so a driver update or a shader change just misses the cache.
+// If the driver doesn't have the extension (or rejects a stored binary) callers compile from source as usual.
+class ProgramCache
+{
+public:
+	ProgramCache();
+
+	// Must be called with the GL context current. An empty directory turns the cache off.
+	void Init(const string &strDir);
+
+	bool IsEnabled() const { return m_pfnGetProgramBinary != NULL; }
+
+	// a key for one program, start with this and chain each piece of source into it with HashString64
+	uint64_t GetBaseKey() const { return m_u64DriverHash; }
+
+	// returns a linked program or 0 if it isn't in the cache (or no longer loads)
+	GLuint Load(uint64_t u64Key);
+
+	// stores a linked program (failure is harmless, it just gets compiled again next time)
+	void Save(uint64_t u64Key, GLuint uProgram);
+
+	unsigned int GetHits() const { return m_uHits; }
+	unsigned int GetMisses() const { return m_uMisses; }
+
+private:
+	string GetPath(uint64_t u64Key) const;
+
+	string m_strDir;
+	uint64_t m_u64DriverHash;
+
+	PFNGLGETPROGRAMBINARYOESPROC m_pfnGetProgramBinary;
+	PFNGLPROGRAMBINARYOESPROC m_pfnProgramBinary;
+
+	unsigned int m_uHits, m_uMisses;
+};
+
+#endif // USE_OPENGL
+
+#endif // PROGRAM_CACHE_H
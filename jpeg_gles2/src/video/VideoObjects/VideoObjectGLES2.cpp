@@ -8,6 +8,9 @@
 #include <string.h>	// for memcpy
 #include <stdexcept>
 #include <assert.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include <cmath>
 
@@ -16,6 +19,9 @@
 #define MY_VERTEX_ARRAY 0
 #define MY_TEXCOORD_ARRAY 1
 
+// x, y, u, v
+#define SPRITE_VERTEX_FLOATS 4
+
 // this can be replaced with whatever
 #define GL_ASSERT(str) assert(glGetError() == GL_NO_ERROR)
 
@@ -26,11 +32,171 @@ IVideoObject::VideoType VideoObjectGLES2::GetType() const
 
 void VideoObjectGLES2::RenderFrame()
 {
+	m_gl.BeginFrame();
+
 	// clear to a black frame
 	glClear( GL_COLOR_BUFFER_BIT );
+	m_gl.CountCalls();
 	
-	// draw the RGBA texture
-	DrawRGBA();
+	// draw the RGBA (or YUV) texture, or the sprites if there are any
+	if (!m_vSprites.empty())
+	{
+		DrawSprites();
+	}
+	else if (m_postSettings.bEnabled && DrawPost())
+	{
+	}
+	else if (m_pDisplayYUV)
+	{
+		DrawYUV();
+	}
+	else
+	{
+		DrawRGBA();
+	}
+}
+
+void VideoObjectGLES2::GetRenderStats(VideoRenderStats *pStats) const
+{
+	m_gl.GetStats(pStats);
+	pStats->uProgramsCached = m_programs.GetHits();
+	pStats->uProgramsCompiled = m_uProgramsCompiled;
+	pStats->uPostPasses = m_post.uPasses;
+	pStats->uPostReused = m_post.uReused;
+}
+
+void VideoObjectGLES2::SetPostProcess(const VideoPostProcess &post)
+{
+	m_postSettings = post;
+	InvalidatePost();
+}
+
+void VideoObjectGLES2::ReadFrame(byteSA &vRGBA, unsigned int *puWidth, unsigned int *puHeight)
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	unsigned int uWidth = viewport[2];
+	unsigned int uHeight = viewport[3];
+	unsigned int uPitch = uWidth * 4;
+
+	vRGBA.resize(uPitch * uHeight);
+
+	// RGBA rows are always 4 byte aligned
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(viewport[0], viewport[1], uWidth, uHeight, GL_RGBA, GL_UNSIGNED_BYTE, vRGBA.data());
+	m_gl.CountCalls(3);
+
+	// GL's first row is the bottom one
+	byteSA vRow(uPitch);
+	for (unsigned int uTop = 0, uBottom = uHeight - 1; (uTop < uBottom) && (uHeight != 0); uTop++, uBottom--)
+	{
+		memcpy(vRow.data(), &vRGBA[uTop * uPitch], uPitch);
+		memcpy(&vRGBA[uTop * uPitch], &vRGBA[uBottom * uPitch], uPitch);
+		memcpy(&vRGBA[uBottom * uPitch], vRow.data(), uPitch);
+	}
+
+	*puWidth = uWidth;
+	*puHeight = uHeight;
+}
+
+void *VideoObjectGLES2::CreateYUVImage(unsigned int uWidth, unsigned int uHeight, unsigned int uChromaWidth, unsigned int uChromaHeight)
+{
+	YUVImageGL *pImage = new YUVImageGL();
+
+	pImage->uWidths[0] = uWidth;
+	pImage->uHeights[0] = uHeight;
+	pImage->uWidths[1] = pImage->uWidths[2] = uChromaWidth;
+	pImage->uHeights[1] = pImage->uHeights[2] = uChromaHeight;
+
+	glGenTextures(YUV_PLANES, pImage->uTextures);
+
+	for (unsigned int u = 0; u < YUV_PLANES; u++)
+	{
+		InitTextureParams(pImage->uTextures[u]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, pImage->uWidths[u], pImage->uHeights[u], 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
+	}
+
+	if (glGetError() != GL_NO_ERROR)
+	{
+		for (unsigned int u = 0; u < YUV_PLANES; u++)
+		{
+			m_gl.OnDeleteTexture(pImage->uTextures[u]);
+		}
+		glDeleteTextures(YUV_PLANES, pImage->uTextures);
+		delete pImage;
+		throw runtime_error("CreateYUVImage: could not create plane textures");
+	}
+
+	m_setYUVImages.insert(pImage);
+
+	return pImage;
+}
+
+void VideoObjectGLES2::DeleteYUVImage(void *yuvImage)
+{
+	YUVImageGL *pImage = (YUVImageGL *) yuvImage;
+
+	if (m_setYUVImages.erase(pImage) == 0)
+	{
+		throw runtime_error("DeleteYUVImage: unknown YUV image");
+	}
+
+	if (m_pDisplayYUV == pImage)
+	{
+		m_pDisplayYUV = NULL;
+		InvalidatePost();
+	}
+
+	for (unsigned int u = 0; u < YUV_PLANES; u++)
+	{
+		m_gl.OnDeleteTexture(pImage->uTextures[u]);
+	}
+	glDeleteTextures(YUV_PLANES, pImage->uTextures);
+
+	delete pImage;
+}
+
+void VideoObjectGLES2::UpdateYUVImage(void *yuvImage, const uint8_t *p8Y, const uint8_t *p8Cb, const uint8_t *p8Cr)
+{
+	YUVImageGL *pImage = (YUVImageGL *) yuvImage;
+
+	if (m_setYUVImages.find(pImage) == m_setYUVImages.end())
+	{
+		throw runtime_error("UpdateYUVImage: unknown YUV image");
+	}
+
+	const uint8_t *p8Planes[YUV_PLANES] = { p8Y, p8Cb, p8Cr };
+
+	// plane widths are often odd
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (unsigned int u = 0; u < YUV_PLANES; u++)
+	{
+		m_gl.BindTexture(pImage->uTextures[u]);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pImage->uWidths[u], pImage->uHeights[u], GL_LUMINANCE, GL_UNSIGNED_BYTE, p8Planes[u]);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	m_gl.CountCalls(2 + YUV_PLANES);
+
+	if (pImage == m_pDisplayYUV)
+	{
+		InvalidatePost();
+	}
+}
+
+void VideoObjectGLES2::SetDisplayYUVImage(void *yuvImage)
+{
+	YUVImageGL *pImage = (YUVImageGL *) yuvImage;
+
+	if (m_setYUVImages.find(pImage) == m_setYUVImages.end())
+	{
+		throw runtime_error("SetDisplayYUVImage: unknown YUV image");
+	}
+
+	m_pDisplayYUV = pImage;
+	InvalidatePost();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -40,12 +206,17 @@ bool VideoObjectGLES2::Init()
 	try
 	{
 		InitGLAttributes();
+
+		// we only ever use texture unit 0; selecting it up front lets the state cache track every texture bind
+		m_gl.ActiveTexture(GL_TEXTURE0);
+
 		InitTextures();
+		m_programs.Init(GetProgramCacheDir());
 		InitShaders();
 		InitSamplers();
 		InitBuffers();
 		InitProjectionMatrices();
-		InitViewMatrices();
+		InitViewMatrices(m_ProgramRGBA);
 
 		// enabling these is expensive (on raspberry pi) so just keep them always enabled
 		glEnableVertexAttribArray(MY_VERTEX_ARRAY);
@@ -65,6 +236,26 @@ bool VideoObjectGLES2::Init()
 	return m_Common.m_bInitialized;
 }
 
+string VideoObjectGLES2::GetProgramCacheDir()
+{
+	// JPEG_GLES2_PROGRAM_CACHE overrides the default (set it to an empty string to always compile)
+	const char *cpszDir = getenv("JPEG_GLES2_PROGRAM_CACHE");
+
+	if (cpszDir)
+	{
+		return cpszDir;
+	}
+
+	const char *cpszHome = getenv("HOME");
+
+	if (!cpszHome)
+	{
+		return "";
+	}
+
+	return (string) cpszHome + "/.cache/jpeg_gles2";
+}
+
 void VideoObjectGLES2::InitShaders()
 {
 	// create shaders/programs
@@ -81,8 +272,6 @@ void VideoObjectGLES2::InitShaders()
 		"	fragTexCoord = inTexCoord;\n"
 		"}";
 
-	m_uVertexShader = CreateShader(GL_VERTEX_SHADER, cpszGenericVertexShader);
-
 	const char *cpszStandardFragmentShader =
 		"uniform sampler2D StandardTex;\n"
 		"varying vec2 fragTexCoord;\n"
@@ -91,12 +280,62 @@ void VideoObjectGLES2::InitShaders()
 		"   gl_FragColor = texture2D(StandardTex,fragTexCoord);\n"
 		"}";
 
-	m_uFragmentShader = CreateShader(GL_FRAGMENT_SHADER, cpszStandardFragmentShader);
+	m_ProgramRGBA = CreateCachedProgram(cpszGenericVertexShader, cpszStandardFragmentShader);
+
+	// full range YCbCr (JFIF) to RGB, chroma is sampled with the same coordinates since its plane covers the same area
+	const char *cpszYUVFragmentShader =
+		"uniform sampler2D YTex;\n"
+		"uniform sampler2D CbTex;\n"
+		"uniform sampler2D CrTex;\n"
+		"varying vec2 fragTexCoord;\n"
+		"void main(void)\n"
+		"{\n"
+		"   float y = texture2D(YTex,fragTexCoord).r;\n"
+		"   float cb = texture2D(CbTex,fragTexCoord).r - 0.5;\n"
+		"   float cr = texture2D(CrTex,fragTexCoord).r - 0.5;\n"
+		"   gl_FragColor = vec4(y + 1.402 * cr, y - 0.344136 * cb - 0.714136 * cr, y + 1.772 * cb, 1.0);\n"
+		"}";
+
+	m_ProgramYUV = CreateCachedProgram(cpszGenericVertexShader, cpszYUVFragmentShader);
+
+	// post-processing passes cover their whole target and read texRect (x, y, w, h) of their input
+	const char *cpszPostVertexShader =
+		"attribute vec4 myVertex;\n"
+		"attribute vec2 inTexCoord;\n"
+		"uniform vec4 texRect;\n"
+		"varying vec2 fragTexCoord;\n"
+		"void main(void)\n"
+		"{\n"
+		"   gl_Position = myVertex;\n"
+		"	fragTexCoord = texRect.xy + inTexCoord * texRect.zw;\n"
+		"}";
+
+	m_ProgramPostRGBA = CreateCachedProgram(cpszPostVertexShader, cpszStandardFragmentShader);
+	m_ProgramPostYUV = CreateCachedProgram(cpszPostVertexShader, cpszYUVFragmentShader);
 
-	ShaderList lstShadersRGBA;
-	lstShadersRGBA.push_back(m_uVertexShader);
-	lstShadersRGBA.push_back(m_uFragmentShader);
+	// unsharp mask: the difference between a texel and its 4 neighbors is added back
+	const char *cpszSharpenFragmentShader =
+		"uniform sampler2D StandardTex;\n"
+		"uniform vec2 texelSize;\n"
+		"uniform vec4 texClamp;\n"
+		"uniform float sharpen;\n"
+		"varying vec2 fragTexCoord;\n"
+		"vec3 tap(vec2 offset)\n"
+		"{\n"
+		"   return texture2D(StandardTex,clamp(fragTexCoord + offset * texelSize, texClamp.xy, texClamp.zw)).rgb;\n"
+		"}\n"
+		"void main(void)\n"
+		"{\n"
+		"   vec3 c = texture2D(StandardTex,fragTexCoord).rgb;\n"
+		"   vec3 edges = 4.0 * c - tap(vec2(1.0,0.0)) - tap(vec2(-1.0,0.0)) - tap(vec2(0.0,1.0)) - tap(vec2(0.0,-1.0));\n"
+		"   gl_FragColor = vec4(c + sharpen * edges, 1.0);\n"
+		"}";
 
+	m_ProgramPostSharpen = CreateCachedProgram(cpszPostVertexShader, cpszSharpenFragmentShader);
+}
+
+GLuint VideoObjectGLES2::CreateCachedProgram(const char *cpszVertexShader, const char *cpszFragmentShader)
+{
 	attrib_loc_s loc;
 
 	AttribLocList lstAttribLocs;
@@ -107,8 +346,41 @@ void VideoObjectGLES2::InitShaders()
 	loc.cpszName = "inTexCoord";
 	lstAttribLocs.push_back(loc);
 
-	m_ProgramRGBA = CreateProgram(lstShadersRGBA, lstAttribLocs);
+	// the attribute bindings are part of the linked program too
+	uint64_t u64Key = HashString64(cpszVertexShader, m_programs.GetBaseKey());
+	u64Key = HashString64(cpszFragmentShader, u64Key);
+	for (AttribLocList::const_iterator li = lstAttribLocs.begin(); li != lstAttribLocs.end(); li++)
+	{
+		char s[16];
+		snprintf(s, sizeof(s), "%u", li->uIdx);
+		u64Key = HashString64(li->cpszName, HashString64(s, u64Key));
+	}
+
+	GLuint uProgram = m_programs.Load(u64Key);
 
+	// no compiling at all if the cache has it
+	if (uProgram != 0)
+	{
+		m_gl.CacheUniformLocations(uProgram);
+		return uProgram;
+	}
+
+	ShaderList lstShaders;
+	lstShaders.push_back(CreateShader(GL_VERTEX_SHADER, cpszVertexShader));
+	lstShaders.push_back(CreateShader(GL_FRAGMENT_SHADER, cpszFragmentShader));
+
+	uProgram = CreateProgram(lstShaders, lstAttribLocs);
+	m_uProgramsCompiled++;
+
+	// the program keeps what it needs, the shaders are freed along with it
+	for (ShaderList::const_iterator li = lstShaders.begin(); li != lstShaders.end(); li++)
+	{
+		glDeleteShader(*li);
+	}
+
+	m_programs.Save(u64Key, uProgram);
+
+	return uProgram;
 }
 
 void VideoObjectGLES2::InitSamplers()
@@ -117,12 +389,29 @@ void VideoObjectGLES2::InitSamplers()
 
 	// now set up sampler(s)
 
-	glUseProgram(m_ProgramRGBA);
-	i=glGetUniformLocation(m_ProgramRGBA,"StandardTex");
+	m_gl.UseProgram(m_ProgramRGBA);
+	i=m_gl.GetUniformLocation(m_ProgramRGBA,"StandardTex");
 	GL_ASSERT("glGetUniformLocation StandardTex");
 	glUniform1i(i,0);	// texture unit 0 to correspond with "StandardTex" inside shader
 	GL_ASSERT("glUniform1i");
 
+	// one texture unit per plane
+	m_gl.UseProgram(m_ProgramYUV);
+	glUniform1i(m_gl.GetUniformLocation(m_ProgramYUV, "YTex"), 0);
+	glUniform1i(m_gl.GetUniformLocation(m_ProgramYUV, "CbTex"), 1);
+	glUniform1i(m_gl.GetUniformLocation(m_ProgramYUV, "CrTex"), 2);
+	GL_ASSERT("glUniform1i (YUV)");
+
+	m_gl.UseProgram(m_ProgramPostRGBA);
+	glUniform1i(m_gl.GetUniformLocation(m_ProgramPostRGBA, "StandardTex"), 0);
+	m_gl.UseProgram(m_ProgramPostSharpen);
+	glUniform1i(m_gl.GetUniformLocation(m_ProgramPostSharpen, "StandardTex"), 0);
+	m_gl.UseProgram(m_ProgramPostYUV);
+	glUniform1i(m_gl.GetUniformLocation(m_ProgramPostYUV, "YTex"), 0);
+	glUniform1i(m_gl.GetUniformLocation(m_ProgramPostYUV, "CbTex"), 1);
+	glUniform1i(m_gl.GetUniformLocation(m_ProgramPostYUV, "CrTex"), 2);
+	GL_ASSERT("glUniform1i (post)");
+
 }
 
 void VideoObjectGLES2::InitBuffers()
@@ -172,21 +461,30 @@ void VideoObjectGLES2::InitBuffers()
 	};
 
 	InitBuffersHelper(verticesFullScreen, sizeof(verticesFullScreen), &m_uVertexBufferFullScreen);
+
+	/////////////////////////////////////////
+
+	// sprite buffers get their contents when there are sprites
+	glGenBuffers(1, &m_uSpriteBuffer);
+	GL_ASSERT("glGenBuffers (sprites)");
+
+	glGenBuffers(1, &m_uSpriteIndexBuffer);
+	GL_ASSERT("glGenBuffers (sprite indices)");
 }
 
-void VideoObjectGLES2::InitBuffersHelper(GLfloat *pSrc, GLuint uSrcSizeBytes, GLuint *puBufID)
+void VideoObjectGLES2::InitBuffersHelper(GLfloat *pSrc, GLuint uSrcSizeBytes, GLuint *puBufID, GLenum usage)
 {
 	// store vertices in a buffer for fast access
 	glGenBuffers(1, puBufID);
 	GL_ASSERT("glGenBuffersOverlay");
 
-	glBindBuffer(GL_ARRAY_BUFFER, *puBufID);
+	m_gl.BindBuffer(GL_ARRAY_BUFFER, *puBufID);
 	GL_ASSERT("glBindBufferOverlay");
 
-	glBufferData(GL_ARRAY_BUFFER, uSrcSizeBytes, pSrc, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, uSrcSizeBytes, pSrc, usage);
 	GL_ASSERT("glBufferDataOverlay");
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_gl.BindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void VideoObjectGLES2::InitProjectionMatrices()
@@ -207,13 +505,14 @@ void VideoObjectGLES2::InitProjectionMatrices()
 	};
 
 	InitProjectionMatricesHelper(m_ProgramRGBA, mProjection);
+	InitProjectionMatricesHelper(m_ProgramYUV, mProjection);
 }
 
 void VideoObjectGLES2::InitProjectionMatricesHelper(GLuint uProgram, GLfloat *pMatrix)
 {
-	glUseProgram(uProgram);
+	m_gl.UseProgram(uProgram);
 
-	int i = glGetUniformLocation(uProgram, "matProjection");
+	int i = m_gl.GetUniformLocation(uProgram, "matProjection");
 	GL_ASSERT("glGetUniformLocation matProjection");
 	glUniformMatrix4fv(i,
 		1,	// 1 matrix
@@ -224,7 +523,7 @@ void VideoObjectGLES2::InitProjectionMatricesHelper(GLuint uProgram, GLfloat *pM
 
 float stupidIncrementing = 0;
 
-void VideoObjectGLES2::InitViewMatrices()
+void VideoObjectGLES2::InitViewMatrices(GLuint uProgram)
 {
 	// NOW setup view matrices
 
@@ -241,19 +540,21 @@ void VideoObjectGLES2::InitViewMatrices()
 		0, 0, 0, 1
 	};
 
-	InitViewMatricesHelper(m_ProgramRGBA, mView);
+	InitViewMatricesHelper(uProgram, mView);
 }
 
 void VideoObjectGLES2::InitViewMatricesHelper(GLuint uProgram, GLfloat *pMatrix)
 {
-	glUseProgram(uProgram);
+	m_gl.UseProgram(uProgram);
 
-	int i = glGetUniformLocation(uProgram, "matView");
+	// this runs every frame so the location must come from the cache, not the driver
+	int i = m_gl.GetUniformLocation(uProgram, "matView");
 	GL_ASSERT("glGetUniformLocation matView");
 	glUniformMatrix4fv(i,
 		1,	// 1 matrix
 		GL_FALSE,	// column major order
 		pMatrix);
+	m_gl.CountCalls();
 	GL_ASSERT("glUniformMatrix4fv");
 }
 
@@ -279,6 +580,10 @@ void VideoObjectGLES2::InitGLAttributes()
 
 	// Setting the viewport on OMAP3 (Beagleboard) seems to not work for some reason
 	// If we don't set this on Raspberry Pi, it gets the right res by default, so it seems better to not call glViewPort on the raspberry pi
+
+	// the default viewport is the size of the surface
+	glGetIntegerv(GL_VIEWPORT, m_iViewport);
+	m_fAspect = (m_iViewport[3] != 0) ? ((GLfloat) m_iViewport[2] / m_iViewport[3]) : 1.0f;
 }
 
 void VideoObjectGLES2::Shutdown()
@@ -293,9 +598,24 @@ void VideoObjectGLES2::Shutdown()
 	// TODO : free shaders, buffers, etc
 }
 
-VideoObjectGLES2::VideoObjectGLES2(ILogger *pLogger)
+VideoObjectGLES2::VideoObjectGLES2(ILogger *pLogger) :
+m_uDisplayTexture(0),
+m_pDisplayYUV(NULL),
+m_bSpritesDirty(false),
+m_ProgramRGBA(0),
+m_ProgramYUV(0),
+m_ProgramPostRGBA(0),
+m_ProgramPostYUV(0),
+m_ProgramPostSharpen(0),
+m_uProgramsCompiled(0),
+m_fAspect(1.0f),
+m_uSpriteBuffer(0),
+m_uSpriteIndexBuffer(0),
+m_uSpriteIndexQuads(0)
 {
 	m_Common.m_pLogger = pLogger;
+	memset(m_iViewport, 0, sizeof(m_iViewport));
+	memset(&m_post, 0, sizeof(m_post));
 }
 
 VideoObjectGLES2::~VideoObjectGLES2()
@@ -393,6 +713,9 @@ GLuint VideoObjectGLES2::CreateProgram(const ShaderList &lstShaders, const Attri
 		throw runtime_error((string) "OpenGL Shader Link Failed: " + s);
 	}
 
+	// so that nothing needs to be looked up by name while rendering
+	m_gl.CacheUniformLocations(uRes);
+
 	return uRes;
 }
 
@@ -403,55 +726,474 @@ void VideoObjectGLES2::InitTextures()
 
 	for (int i = 0; i < NUM_TEXTURES; i++)
 	{
-		glBindTexture(GL_TEXTURE_2D, m_textures[i]);
-		GL_ASSERT("InitYUVTextures");
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		GL_ASSERT("InitYUVTextures");
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		GL_ASSERT("InitYUVTextures");
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		GL_ASSERT("InitYUVTextures");
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		GL_ASSERT("InitYUVTextures");
+		InitTextureParams(m_textures[i]);
 	}
+
+	m_uDisplayTexture = m_textures[TEX_RGBA];
 }
 
-void VideoObjectGLES2::DrawRGBA()
+void VideoObjectGLES2::InitTextureParams(GLuint uTexID)
 {
-	InitViewMatrices();
+	m_gl.BindTexture(uTexID);
+	GL_ASSERT("InitTextureParams");
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	GL_ASSERT("InitTextureParams");
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GL_ASSERT("InitTextureParams");
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	GL_ASSERT("InitTextureParams");
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	GL_ASSERT("InitTextureParams");
+}
 
-	glUseProgram(m_ProgramRGBA);
+void VideoObjectGLES2::DrawRGBA()
+{
+	// (this also selects the program)
+	InitViewMatrices(m_ProgramRGBA);
 
 	// setting active texture and binding the current texture only needs to be done once for this demo,
 	//  however typically it needs to be done regularly, so I am leaving this code in here to that people can build on it if they want.
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D,m_textures[TEX_RGBA]);
+	// (the state cache makes these free when nothing has changed)
+	m_gl.ActiveTexture(GL_TEXTURE0);
+	m_gl.BindTexture(m_uDisplayTexture);
 	GL_ASSERT("DrawRGBA");
 
-	// indicate vertex buffer to use for rendering
+	DrawFullScreen(m_uTexCoordFlippedBuffer);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_uVertexBufferFullScreen);
-	GL_ASSERT("glBindBuffer");
+void VideoObjectGLES2::DrawYUV()
+{
+	InitViewMatrices(m_ProgramYUV);
+	BindYUV(m_pDisplayYUV);
+	GL_ASSERT("DrawYUV");
 
-	// indicate that each vertex has 2 elements
-	glVertexAttribPointer(MY_VERTEX_ARRAY, 2, GL_FLOAT, GL_FALSE, 0, 0);
-	GL_ASSERT("glVertexAttribPointer");
+	DrawFullScreen(m_uTexCoordFlippedBuffer);
+}
+
+void VideoObjectGLES2::BindYUV(YUVImageGL *pImage)
+{
+	// unit 0 last so that it stays the active unit for everything else
+	for (int i = YUV_PLANES - 1; i >= 0; i--)
+	{
+		m_gl.ActiveTexture(GL_TEXTURE0 + i);
+		m_gl.BindTexture(pImage->uTextures[i]);
+	}
+}
+
+bool VideoObjectGLES2::DrawPost()
+{
+	if (!m_post.bValid || (m_post.uSrcTexture != m_uDisplayTexture) || (m_post.pSrcYUV != m_pDisplayYUV))
+	{
+		unsigned int uSrcWidth = 0, uSrcHeight = 0;
+
+		if (m_pDisplayYUV)
+		{
+			uSrcWidth = m_pDisplayYUV->uWidths[0];
+			uSrcHeight = m_pDisplayYUV->uHeights[0];
+		}
+		else
+		{
+			map<GLuint, TextureSize>::const_iterator mi = m_mapTextureSizes.find(m_uDisplayTexture);
+
+			if (mi != m_mapTextureSizes.end())
+			{
+				uSrcWidth = mi->second.uWidth;
+				uSrcHeight = mi->second.uHeight;
+			}
+		}
+
+		if ((uSrcWidth == 0) || (uSrcHeight == 0))
+		{
+			return false;
+		}
+
+		try
+		{
+			BuildPost(uSrcWidth, uSrcHeight);
+		}
+		catch (std::exception &ex)
+		{
+			// don't try again every frame
+			m_Common.m_pLogger->Log((string) "Post-processing disabled: " + ex.what());
+			m_postSettings.bEnabled = false;
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(m_iViewport[0], m_iViewport[1], m_iViewport[2], m_iViewport[3]);
+			return false;
+		}
+	}
+	else
+	{
+		m_post.uReused++;
+	}
+
+	// the final blit scales up (if the image is smaller than the screen) and does the letterboxing
+	DrawPostPass(m_post.pInputYUV ? m_ProgramPostYUV : m_ProgramPostRGBA, 0, m_post.iOutX, m_post.iOutY, m_post.uOutWidth, m_post.uOutHeight,
+		m_uTexCoordFlippedBuffer);
+
+	glViewport(m_iViewport[0], m_iViewport[1], m_iViewport[2], m_iViewport[3]);
+	m_gl.CountCalls();
+
+	return true;
+}
+
+void VideoObjectGLES2::BuildPost(unsigned int uSrcWidth, unsigned int uSrcHeight)
+{
+	unsigned int uScreenWidth = m_iViewport[2], uScreenHeight = m_iViewport[3];
+
+	m_post.iOutX = m_iViewport[0];
+	m_post.iOutY = m_iViewport[1];
+	m_post.uOutWidth = uScreenWidth;
+	m_post.uOutHeight = uScreenHeight;
+
+	if (m_postSettings.bLetterbox)
+	{
+		// bars above and below, or to the sides
+		if ((unsigned long long) uSrcWidth * uScreenHeight > (unsigned long long) uSrcHeight * uScreenWidth)
+		{
+			m_post.uOutHeight = (unsigned int) (((unsigned long long) uSrcHeight * uScreenWidth) / uSrcWidth);
+		}
+		else
+		{
+			m_post.uOutWidth = (unsigned int) (((unsigned long long) uSrcWidth * uScreenHeight) / uSrcHeight);
+		}
+
+		m_post.uOutWidth = max(m_post.uOutWidth, 1U);
+		m_post.uOutHeight = max(m_post.uOutHeight, 1U);
+		m_post.iOutX += (uScreenWidth - m_post.uOutWidth) / 2;
+		m_post.iOutY += (uScreenHeight - m_post.uOutHeight) / 2;
+	}
+
+	// the textures never hold more than the source has (the final blit does any upscaling)
+	unsigned int uTargetWidth = min(m_post.uOutWidth, uSrcWidth);
+	unsigned int uTargetHeight = min(m_post.uOutHeight, uSrcHeight);
+	bool bSharpen = (m_postSettings.fSharpen > 0.0f);
+
+	// Bilinear filtering only looks at 2x2 texels, so anything minified by more than half skips texels (and
+	//  thrashes the texture cache). Halving at a time averages every texel, the last pass goes to the exact size.
+	vector<pair<unsigned int, unsigned int> > vPasses;
+	unsigned int uWidth = uSrcWidth, uHeight = uSrcHeight;
+
+	while ((uWidth > uTargetWidth * 2) || (uHeight > uTargetHeight * 2))
+	{
+		uWidth = max(uTargetWidth, (uWidth + 1) / 2);
+		uHeight = max(uTargetHeight, (uHeight + 1) / 2);
+		vPasses.push_back(make_pair(uWidth, uHeight));
+	}
+
+	if ((uWidth != uTargetWidth) || (uHeight != uTargetHeight))
+	{
+		vPasses.push_back(make_pair(uTargetWidth, uTargetHeight));
+	}
+
+	// the sharpen shader reads RGB
+	if (bSharpen && m_pDisplayYUV && vPasses.empty())
+	{
+		vPasses.push_back(make_pair(uTargetWidth, uTargetHeight));
+	}
+
+	m_post.uSrcTexture = m_uDisplayTexture;
+	m_post.pSrcYUV = m_pDisplayYUV;
+	m_post.uInput = m_uDisplayTexture;
+	m_post.pInputYUV = m_pDisplayYUV;
+	m_post.fInputRect[0] = m_post.fInputRect[1] = 0.0f;
+	m_post.fInputRect[2] = m_post.fInputRect[3] = 1.0f;
+	m_post.uInputWidth = uSrcWidth;
+	m_post.uInputHeight = uSrcHeight;
+
+	if (!vPasses.empty() || bSharpen)
+	{
+		// the first pass writes the biggest image
+		GrowPostTextures(vPasses.empty() ? uTargetWidth : vPasses[0].first, vPasses.empty() ? uTargetHeight : vPasses[0].second);
+	}
+
+	unsigned int uTarget = 0;
+
+	for (unsigned int u = 0; u <= vPasses.size(); u++)
+	{
+		GLuint uProgram = 0;
+
+		if (u < vPasses.size())
+		{
+			uWidth = vPasses[u].first;
+			uHeight = vPasses[u].second;
+			uProgram = m_post.pInputYUV ? m_ProgramPostYUV : m_ProgramPostRGBA;
+		}
+		// sharpening is done last, at the final size
+		else if (bSharpen)
+		{
+			uWidth = m_post.uInputWidth;
+			uHeight = m_post.uInputHeight;
+			uProgram = m_ProgramPostSharpen;
+
+			// neighbors are sampled one texel away but never from outside the image
+			GLfloat fTexelW = m_post.fInputRect[2] / m_post.uInputWidth, fTexelH = m_post.fInputRect[3] / m_post.uInputHeight;
+			m_gl.UseProgram(uProgram);
+			glUniform2f(m_gl.GetUniformLocation(uProgram, "texelSize"), fTexelW, fTexelH);
+			glUniform4f(m_gl.GetUniformLocation(uProgram, "texClamp"), m_post.fInputRect[0] + fTexelW * 0.5f, m_post.fInputRect[1] + fTexelH * 0.5f,
+				m_post.fInputRect[0] + m_post.fInputRect[2] - fTexelW * 0.5f, m_post.fInputRect[1] + m_post.fInputRect[3] - fTexelH * 0.5f);
+			glUniform1f(m_gl.GetUniformLocation(uProgram, "sharpen"), m_postSettings.fSharpen);
+			m_gl.CountCalls(3);
+		}
+		else
+		{
+			break;
+		}
+
+		DrawPostPass(uProgram, m_post.uFramebuffers[uTarget], 0, 0, uWidth, uHeight, m_uTexCoordBuffer);
+		m_post.uPasses++;
+
+		// what was just written is the input of the next pass
+		m_post.uInput = m_post.uTextures[uTarget];
+		m_post.pInputYUV = NULL;
+		m_post.fInputRect[2] = (GLfloat) uWidth / m_post.uTexWidth;
+		m_post.fInputRect[3] = (GLfloat) uHeight / m_post.uTexHeight;
+		m_post.uInputWidth = uWidth;
+		m_post.uInputHeight = uHeight;
+		uTarget ^= 1;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	m_gl.CountCalls();
+
+	m_post.bValid = true;
+}
+
+void VideoObjectGLES2::DrawPostPass(GLuint uProgram, GLuint uFramebuffer, int iX, int iY, unsigned int uWidth, unsigned int uHeight, GLuint uTexCoordBuffer)
+{
+	// the screen's framebuffer is bound everywhere else, so the final blit doesn't need to bind it
+	if (uFramebuffer != 0)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, uFramebuffer);
+		m_gl.CountCalls();
+	}
+
+	glViewport(iX, iY, uWidth, uHeight);
+	m_gl.CountCalls();
+
+	m_gl.UseProgram(uProgram);
+	glUniform4fv(m_gl.GetUniformLocation(uProgram, "texRect"), 1, m_post.fInputRect);
+	m_gl.CountCalls();
+
+	if (m_post.pInputYUV)
+	{
+		BindYUV(m_post.pInputYUV);
+	}
+	else
+	{
+		m_gl.BindTexture(m_post.uInput);
+	}
+
+	DrawFullScreen(uTexCoordBuffer);
+}
+
+void VideoObjectGLES2::GrowPostTextures(unsigned int uWidth, unsigned int uHeight)
+{
+	if ((uWidth <= m_post.uTexWidth) && (uHeight <= m_post.uTexHeight))
+	{
+		return;
+	}
+
+	if (m_post.uTextures[0] == 0)
+	{
+		glGenTextures(2, m_post.uTextures);
+		glGenFramebuffers(2, m_post.uFramebuffers);
+	}
 
-	// indicate texture coordinate buffer to use for rendering
-	// (note we used flipped texture coordinates because OpenMAX loads our texture this way)
+	m_post.uTexWidth = max(uWidth, m_post.uTexWidth);
+	m_post.uTexHeight = max(uHeight, m_post.uTexHeight);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_uTexCoordFlippedBuffer);
-	GL_ASSERT("glBindBuffer");
+	for (unsigned int u = 0; u < 2; u++)
+	{
+		InitTextureParams(m_post.uTextures[u]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_post.uTexWidth, m_post.uTexHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_post.uFramebuffers[u]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_post.uTextures[u], 0);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			throw runtime_error("post-processing framebuffer is incomplete");
+		}
+	}
 
-	// indivate the each texture coordinate has 2 elements
-	glVertexAttribPointer(MY_TEXCOORD_ARRAY, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	m_gl.CountCalls(8);
+}
+
+void VideoObjectGLES2::DrawFullScreen(GLuint uTexCoordBuffer)
+{
+	// indicate vertex buffer to use for rendering, and that each vertex has 2 elements
+	m_gl.VertexAttribPointer(MY_VERTEX_ARRAY, m_uVertexBufferFullScreen, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	GL_ASSERT("glVertexAttribPointer");
+
+	// indicate texture coordinate buffer to use for rendering, and that each texture coordinate has 2 elements
+	// (the screen uses flipped texture coordinates because OpenMAX loads our texture this way)
+	m_gl.VertexAttribPointer(MY_TEXCOORD_ARRAY, uTexCoordBuffer, 2, GL_FLOAT, GL_FALSE, 0, 0);
 	GL_ASSERT("glVertexAttribPointer (texcoord)");
 
 	// draw the 6 vertices that make up our full-screen rectangle
 	glDrawArrays(GL_TRIANGLES, 0, 6);
+	m_gl.CountDraw();
 	GL_ASSERT("glDrawArrays");
 }
 
+void VideoObjectGLES2::DrawSprites()
+{
+	// sprites are positioned in screen space so they don't get the animated view matrix
+	GLfloat mView[16] =
+	{
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		0, 0, 0, 1
+	};
+
+	InitViewMatricesHelper(m_ProgramRGBA, mView);
+
+	// if nothing has changed, last frame's vertices are still in the buffer
+	if (m_bSpritesDirty)
+	{
+		BuildSpriteBatches();
+	}
+
+	m_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_uSpriteIndexBuffer);
+	m_gl.VertexAttribPointer(MY_VERTEX_ARRAY, m_uSpriteBuffer, 2, GL_FLOAT, GL_FALSE, SPRITE_VERTEX_FLOATS * sizeof(GLfloat), 0);
+	m_gl.VertexAttribPointer(MY_TEXCOORD_ARRAY, m_uSpriteBuffer, 2, GL_FLOAT, GL_FALSE, SPRITE_VERTEX_FLOATS * sizeof(GLfloat), (const GLvoid *) (2 * sizeof(GLfloat)));
+	m_gl.ActiveTexture(GL_TEXTURE0);
+
+	for (vector<SpriteBatch>::const_iterator vi = m_vSpriteBatches.begin(); vi != m_vSpriteBatches.end(); vi++)
+	{
+		m_gl.BindTexture(vi->uTexture);
+		glDrawElements(GL_TRIANGLES, vi->uCount * 6, GL_UNSIGNED_SHORT, (const GLvoid *) (vi->uFirst * 6 * sizeof(GLushort)));
+		m_gl.CountDraw();
+		GL_ASSERT("glDrawElements (sprites)");
+	}
+}
+
+bool VideoObjectGLES2::SpriteLess(const SpriteGL &a, const SpriteGL &b)
+{
+	if (a.sprite.iLayer != b.sprite.iLayer)
+	{
+		return a.sprite.iLayer < b.sprite.iLayer;
+	}
+
+	return a.uTexture < b.uTexture;
+}
+
+void VideoObjectGLES2::BuildSpriteBatches()
+{
+	// stable so that sprites that share a layer and texture are still drawn in the order they were added
+	stable_sort(m_vSprites.begin(), m_vSprites.end(), SpriteLess);
+
+	m_vSpriteBatches.clear();
+	m_vSpriteVertices.resize(m_vSprites.size() * 4 * SPRITE_VERTEX_FLOATS);
+	GLfloat *pVertex = m_vSpriteVertices.data();
+
+	for (unsigned int u = 0; u < m_vSprites.size(); u++)
+	{
+		const SpriteGL &sgl = m_vSprites[u];
+		const VideoSprite &s = sgl.sprite;
+
+		// screen coordinates are top to bottom, normalized device coordinates are bottom to top
+		GLfloat fLeft = (s.fLeft * 2) - 1;
+		GLfloat fRight = (s.fRight * 2) - 1;
+		GLfloat fTop = 1 - (s.fTop * 2);
+		GLfloat fBottom = 1 - (s.fBottom * 2);
+
+		// lower left, lower right, upper right, upper left (the same winding as the full screen rectangle so that culling leaves it alone)
+		// textures are laid out top to bottom (like the flipped texture coordinates)
+		GLfloat corners[4][4] =
+		{
+			{ fLeft, fBottom, s.fU0, s.fV1 },
+			{ fRight, fBottom, s.fU1, s.fV1 },
+			{ fRight, fTop, s.fU1, s.fV0 },
+			{ fLeft, fTop, s.fU0, s.fV0 },
+		};
+
+		if (s.fRotation != 0)
+		{
+			GLfloat fCenterX = (fLeft + fRight) * 0.5f;
+			GLfloat fCenterY = (fTop + fBottom) * 0.5f;
+			GLfloat fCos = cosf(s.fRotation);
+			GLfloat fSin = sinf(s.fRotation);
+
+			for (int i = 0; i < 4; i++)
+			{
+				// rotate in screen proportions or the rectangle gets skewed
+				GLfloat fX = (corners[i][0] - fCenterX) * m_fAspect;
+				GLfloat fY = corners[i][1] - fCenterY;
+				corners[i][0] = fCenterX + (((fX * fCos) + (fY * fSin)) / m_fAspect);
+				corners[i][1] = fCenterY + ((fY * fCos) - (fX * fSin));
+			}
+		}
+
+		memcpy(pVertex, corners, sizeof(corners));
+		pVertex += 4 * SPRITE_VERTEX_FLOATS;
+
+		// start a new draw whenever the texture changes
+		if (m_vSpriteBatches.empty() || (m_vSpriteBatches.back().uTexture != sgl.uTexture))
+		{
+			SpriteBatch batch;
+			batch.uTexture = sgl.uTexture;
+			batch.uFirst = u;
+			batch.uCount = 0;
+			m_vSpriteBatches.push_back(batch);
+		}
+
+		m_vSpriteBatches.back().uCount++;
+	}
+
+	GrowSpriteIndexBuffer(m_vSprites.size());
+
+	// replacing the whole buffer (rather than updating it) means that we never wait for the GPU to finish with last frame's vertices
+	m_gl.BindBuffer(GL_ARRAY_BUFFER, m_uSpriteBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_vSpriteVertices.size() * sizeof(GLfloat), m_vSpriteVertices.data(), GL_DYNAMIC_DRAW);
+	m_gl.CountCalls();
+	GL_ASSERT("glBufferData (sprites)");
+
+	m_bSpritesDirty = false;
+}
+
+void VideoObjectGLES2::GrowSpriteIndexBuffer(unsigned int uQuads)
+{
+	if (uQuads <= m_uSpriteIndexQuads)
+	{
+		return;
+	}
+
+	// grow in big steps so that this rarely happens
+	unsigned int uNewQuads = (m_uSpriteIndexQuads != 0) ? m_uSpriteIndexQuads : 64;
+	while (uNewQuads < uQuads)
+	{
+		uNewQuads *= 2;
+	}
+
+	if (uNewQuads > MAX_SPRITES)
+	{
+		uNewQuads = MAX_SPRITES;
+	}
+
+	vector<GLushort> vIndices(uNewQuads * 6);
+
+	for (unsigned int u = 0; u < uNewQuads; u++)
+	{
+		GLushort uBase = (GLushort) (u * 4);
+		GLushort *pIdx = &vIndices[u * 6];
+		pIdx[0] = uBase;
+		pIdx[1] = uBase + 1;
+		pIdx[2] = uBase + 2;
+		pIdx[3] = uBase + 2;
+		pIdx[4] = uBase + 3;
+		pIdx[5] = uBase;
+	}
+
+	m_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_uSpriteIndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, vIndices.size() * sizeof(GLushort), vIndices.data(), GL_STATIC_DRAW);
+	m_gl.CountCalls();
+	GL_ASSERT("glBufferData (sprite indices)");
+
+	m_uSpriteIndexQuads = uNewQuads;
+}
+
 //////////////////////////////////////////////////////////////////
 
 #endif // USE_OPENGL
@@ -6,7 +6,12 @@
 #define VIDEO_OBJECT_GLES2
 
 #include "IVideoObject.h"
+#include "GLStateCache.h"
+#include "ProgramCache.h"
 #include <list>
+#include <vector>
+#include <set>
+#include <map>
 #include <GLES2/gl2.h>
 
 using namespace std;
@@ -20,12 +25,22 @@ struct attrib_loc_s
 typedef list<attrib_loc_s> AttribLocList;
 typedef list<GLuint> ShaderList;
 
-class VideoObjectGLES2 : public IVideoObject
+class VideoObjectGLES2 : public IVideoObject, public IVideoObjectYUV
 {
 public:
 
 	VideoType GetType() const;
 	void RenderFrame();
+	void GetRenderStats(VideoRenderStats *pStats) const;
+	void SetPostProcess(const VideoPostProcess &post);
+	void ReadFrame(byteSA &vRGBA, unsigned int *puWidth, unsigned int *puHeight);
+
+	// YUV images only need GL so they are handled here
+	IVideoObjectYUV *ToYUV() { return this; }
+	void *CreateYUVImage(unsigned int uWidth, unsigned int uHeight, unsigned int uChromaWidth, unsigned int uChromaHeight);
+	void DeleteYUVImage(void *yuvImage);
+	void UpdateYUVImage(void *yuvImage, const uint8_t *p8Y, const uint8_t *p8Cb, const uint8_t *p8Cr);
+	void SetDisplayYUVImage(void *yuvImage);
 
 protected:
 
@@ -42,17 +57,72 @@ protected:
 
 	void Shutdown();
 
+	// sets up filtering/wrapping for a freshly generated texture
+	void InitTextureParams(GLuint uTexID);
+
+	// must be called whenever the image on screen (or what is in it) changes so that the post-processing result is redone
+	void InvalidatePost() { m_post.bValid = false; }
+
 	GLuint m_textures[NUM_TEXTURES];
 
+	// the texture that DrawRGBA samples from (defaults to TEX_RGBA until a decoded image is selected)
+	GLuint m_uDisplayTexture;
+
+	enum { YUV_PLANES = 3 };
+
+	struct YUVImageGL
+	{
+		GLuint uTextures[YUV_PLANES];	// Y, Cb, Cr
+		unsigned int uWidths[YUV_PLANES], uHeights[YUV_PLANES];
+	};
+
+	// if set, this is drawn instead of m_uDisplayTexture (whoever selects a texture to display must clear it)
+	YUVImageGL *m_pDisplayYUV;
+
+	struct TextureSize
+	{
+		unsigned int uWidth, uHeight;
+	};
+
+	// GLES2 can't be asked how big a texture is, so whoever creates one that can be displayed records it here
+	map<GLuint, TextureSize> m_mapTextureSizes;
+
+	// sprite vertex indices are 16 bits
+	enum { MAX_SPRITES = 65536 / 4 };
+
+	struct SpriteGL
+	{
+		GLuint uTexture;
+		VideoSprite sprite;
+	};
+
+	// if there are any sprites, RenderFrame draws these instead of the full screen texture
+	vector<SpriteGL> m_vSprites;
+
+	// must be set whenever m_vSprites changes so that the vertex buffer gets rebuilt
+	bool m_bSpritesDirty;
+
+	// all program/texture/buffer binding goes through here
+	GLStateCache m_gl;
+
+	// linked programs from previous runs
+	ProgramCache m_programs;
+
 private:
 	// these init methods all called from Init, don't call them directly
 	void InitShaders();
+
+	// compiles (or loads from the program cache) one program with the standard attribute locations
+	GLuint CreateCachedProgram(const char *cpszVertexShader, const char *cpszFragmentShader);
+
+	// where linked programs are kept between runs ("" for nowhere)
+	static string GetProgramCacheDir();
 	void InitSamplers();
 	void InitBuffers();
-	void InitBuffersHelper(GLfloat *pSrc, GLuint uSrcSizeBytes, GLuint *puBufID);
+	void InitBuffersHelper(GLfloat *pSrc, GLuint uSrcSizeBytes, GLuint *puBufID, GLenum usage = GL_STATIC_DRAW);
 	void InitProjectionMatrices();
 	void InitProjectionMatricesHelper(GLuint uProgram, GLfloat *pMatrix);
-	void InitViewMatrices();
+	void InitViewMatrices(GLuint uProgram);
 	void InitViewMatricesHelper(GLuint uProgram, GLfloat *pMatrix);
 	void InitGLAttributes();
 
@@ -70,15 +140,112 @@ private:
 	// draw the RGBA frame
 	void DrawRGBA();
 
+	// draw the YUV frame, converting to RGB in the shader
+	void DrawYUV();
+
+	// the full screen rectangle that DrawRGBA, DrawYUV and the post-processing passes share
+	void DrawFullScreen(GLuint uTexCoordBuffer);
+
+	// binds the planes to texture units 0 to 2 (leaving unit 0 active)
+	void BindYUV(YUVImageGL *pImage);
+
+	// draws the displayed image through the post-processing chain (redoing the chain if its result is stale)
+	// returns false if the image's size isn't known, in which case it has to be drawn the normal way
+	bool DrawPost();
+
+	// renders the chain's passes into the ping-pong textures
+	void BuildPost(unsigned int uSrcWidth, unsigned int uSrcHeight);
+
+	// one post-processing pass (or the final blit if uFramebuffer is 0) from m_post's current input
+	void DrawPostPass(GLuint uProgram, GLuint uFramebuffer, int iX, int iY, unsigned int uWidth, unsigned int uHeight, GLuint uTexCoordBuffer);
+
+	// makes sure the ping-pong textures are at least this big
+	void GrowPostTextures(unsigned int uWidth, unsigned int uHeight);
+
+	// draw all sprites, one draw call for each run of sprites that share a texture
+	void DrawSprites();
+
+	// sorts the sprites and uploads their vertices
+	void BuildSpriteBatches();
+
+	// draw order is by layer, and sprites that share a texture should be next to each other
+	static bool SpriteLess(const SpriteGL &a, const SpriteGL &b);
+
+	// makes sure that the index buffer covers at least uQuads quads
+	void GrowSpriteIndexBuffer(unsigned int uQuads);
+
 	//////////////////////////////////////////////////////////////////////////////////////////////////
 
 	VideoObjectCommon m_Common;
 
-	GLuint m_uVertexShader, m_uFragmentShader;
 	GLuint m_ProgramRGBA;
+	GLuint m_ProgramYUV;
+
+	// post-processing passes draw without the view matrix and read a sub-rectangle of their input
+	GLuint m_ProgramPostRGBA, m_ProgramPostYUV, m_ProgramPostSharpen;
+
+	// programs that couldn't be loaded from m_programs
+	unsigned int m_uProgramsCompiled;
+
 	GLuint m_uVertexBufferFullScreen;
 	GLuint m_uTexCoordFlippedBuffer, m_uTexCoordBuffer;
 
+	// width / height of the screen (so that rotated sprites aren't skewed)
+	GLfloat m_fAspect;
+
+	// the screen's viewport (post-processing passes change the viewport and put this back)
+	GLint m_iViewport[4];
+
+	// interleaved x, y, u, v for 4 vertices per sprite, rebuilt when the sprites change
+	GLuint m_uSpriteBuffer;
+	vector<GLfloat> m_vSpriteVertices;
+
+	// two triangles per sprite, this only ever grows
+	GLuint m_uSpriteIndexBuffer;
+	unsigned int m_uSpriteIndexQuads;
+
+	// a run of (sorted) sprites that share a texture
+	struct SpriteBatch
+	{
+		GLuint uTexture;
+		unsigned int uFirst, uCount;
+	};
+
+	vector<SpriteBatch> m_vSpriteBatches;
+
+	// every YUV image that has been created (so that handles can be checked)
+	set<YUVImageGL *> m_setYUVImages;
+
+	VideoPostProcess m_postSettings;
+
+	// The post-processing chain renders into two textures in turn (each pass reads the one the last pass wrote),
+	//  using only the lower left part of them when the image is smaller than they are.
+	struct PostChain
+	{
+		GLuint uTextures[2], uFramebuffers[2];
+		unsigned int uTexWidth, uTexHeight;	// the textures only ever grow
+
+		// the result is good for as long as these are still what is displayed
+		bool bValid;
+		GLuint uSrcTexture;
+		YUVImageGL *pSrcYUV;
+
+		// the input of the next pass: a texture (or YUV image) and the part of it that holds the image (x, y, w, h in texture coordinates)
+		GLuint uInput;
+		YUVImageGL *pInputYUV;
+		GLfloat fInputRect[4];
+		unsigned int uInputWidth, uInputHeight;	// in pixels
+
+		// where on the screen the result goes
+		int iOutX, iOutY;
+		unsigned int uOutWidth, uOutHeight;
+
+		unsigned int uPasses;
+		unsigned int uReused;
+	};
+
+	PostChain m_post;
+
 };
 
 //////////////////////////////////////////////////////////////////
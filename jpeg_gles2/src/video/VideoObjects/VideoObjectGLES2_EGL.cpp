@@ -4,11 +4,11 @@
 
 #ifdef USE_OPENGL
 #ifdef USE_EGL
-#ifdef IS_RPI
 
-// This code is written for the raspberry pi
+// This code is written for the raspberry pi (the window surface is the only part that is pi specific)
 
 #include <stdio.h>
+#include <string.h>
 #include <stdexcept>
 #include <assert.h>
 #include "VideoObjectGLES2_EGL.h"
@@ -24,7 +24,7 @@ bool VideoObjectGLES2_EGL::InitPlatform()
 
 	try
 	{
-		m_eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		m_eglDisplay = OpenDisplay();
 		assert(m_eglDisplay != EGL_NO_DISPLAY);
 		EGL_ASSERT();
 
@@ -34,18 +34,19 @@ bool VideoObjectGLES2_EGL::InitPlatform()
 		}
 		EGL_ASSERT();
 
-		static const EGLint pi32ConfigAttribs[] =
+		const EGLint pi32ConfigAttribs[] =
 		{
 			EGL_RED_SIZE, 8,
 			EGL_GREEN_SIZE, 8,
 			EGL_BLUE_SIZE, 8,
 			EGL_ALPHA_SIZE, 8,
-			EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+			EGL_SURFACE_TYPE, GetSurfaceType(),
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
 			EGL_NONE
 		};
 
 		EGLint num_config;
-		if (!eglChooseConfig(m_eglDisplay, pi32ConfigAttribs, &m_eglConfig, 1, &num_config))
+		if (!eglChooseConfig(m_eglDisplay, pi32ConfigAttribs, &m_eglConfig, 1, &num_config) || (num_config == 0))
 		{
 			throw runtime_error("Error: eglChooseConfig() failed.");
 		}
@@ -66,47 +67,7 @@ bool VideoObjectGLES2_EGL::InitPlatform()
 		assert(m_eglContext != EGL_NO_CONTEXT);
 		EGL_ASSERT();
 
-		uint32_t uScreenWidth, uScreenHeight;
-		int32_t iSuccess = graphics_get_display_size(0, &uScreenWidth, &uScreenHeight);
-
-		if (iSuccess < 0)
-		{
-			throw runtime_error("Error, unable to determine screen size");
-		}
-
-		VC_RECT_T dst_rect;
-		VC_RECT_T src_rect;
-
-		dst_rect.x = 0;
-		dst_rect.y = 0;
-		dst_rect.width = uScreenWidth;
-		dst_rect.height = uScreenHeight;
-
-		src_rect.x = 0;
-		src_rect.y = 0;
-		src_rect.width = uScreenWidth << 16;
-		src_rect.height = uScreenHeight << 16;
-
-		DISPMANX_DISPLAY_HANDLE_T dispman_display;
-		DISPMANX_UPDATE_HANDLE_T dispman_update;
-		DISPMANX_ELEMENT_HANDLE_T dispman_element;
-
-		dispman_display = vc_dispmanx_display_open( 0 /* LCD */);
-		dispman_update = vc_dispmanx_update_start( 0 );
-
-		dispman_element = vc_dispmanx_element_add ( dispman_update, dispman_display,
-			0/*layer*/, &dst_rect, 0/*src*/,
-			&src_rect, DISPMANX_PROTECTION_NONE, 0 /*alpha*/, 0/*clamp*/,
-			(DISPMANX_TRANSFORM_T) 0/*transform*/);
-
-		m_nativewindow.element = dispman_element;
-		m_nativewindow.width = uScreenWidth;
-		m_nativewindow.height = uScreenHeight;
-		vc_dispmanx_update_submit_sync( dispman_update );
-
-		EGL_ASSERT();
-
-		m_eglSurface = eglCreateWindowSurface( m_eglDisplay, m_eglConfig, &m_nativewindow, NULL );
+		m_eglSurface = CreateSurface();
 		assert(m_eglSurface != EGL_NO_SURFACE);
 		EGL_ASSERT();
 
@@ -128,66 +89,520 @@ bool VideoObjectGLES2_EGL::InitPlatform()
 			throw runtime_error("eglSwapInterval failed");
 		}
 
+		m_pfnCreateImage = (PFNEGLCREATEIMAGEKHRPROC) eglGetProcAddress("eglCreateImageKHR");
+		m_pfnDestroyImage = (PFNEGLDESTROYIMAGEKHRPROC) eglGetProcAddress("eglDestroyImageKHR");
+
+		if (!m_pfnCreateImage || !m_pfnDestroyImage)
+		{
+			throw runtime_error("EGL_KHR_image_base is not supported");
+		}
+
+		// fences let a decode target be reused as soon as the GPU has finished reading it
+		const char *cpszExtensions = eglQueryString(m_eglDisplay, EGL_EXTENSIONS);
+		if (cpszExtensions && strstr(cpszExtensions, "EGL_KHR_fence_sync"))
+		{
+			m_pfnCreateSync = (PFNEGLCREATESYNCKHRPROC) eglGetProcAddress("eglCreateSyncKHR");
+			m_pfnDestroySync = (PFNEGLDESTROYSYNCKHRPROC) eglGetProcAddress("eglDestroySyncKHR");
+			m_pfnClientWaitSync = (PFNEGLCLIENTWAITSYNCKHRPROC) eglGetProcAddress("eglClientWaitSyncKHR");
+
+			if (!m_pfnCreateSync || !m_pfnDestroySync || !m_pfnClientWaitSync)
+			{
+				m_pfnCreateSync = NULL;
+			}
+		}
+
 		// common init here
 		bRes = Init();
 	}
-	catch (std::exception &)
+	catch (std::exception &ex)
 	{
 		// TODO log
+		fprintf(stderr, "Video init failed: %s\n", ex.what());
 		bRes = false;
 	}
 
 	return bRes;
 }
 
+EGLDisplay VideoObjectGLES2_EGL::OpenDisplay()
+{
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+EGLSurface VideoObjectGLES2_EGL::CreateSurface()
+{
+#ifdef IS_RPI
+	uint32_t uScreenWidth, uScreenHeight;
+	int32_t iSuccess = graphics_get_display_size(0, &uScreenWidth, &uScreenHeight);
+
+	if (iSuccess < 0)
+	{
+		throw runtime_error("Error, unable to determine screen size");
+	}
+
+	VC_RECT_T dst_rect;
+	VC_RECT_T src_rect;
+
+	dst_rect.x = 0;
+	dst_rect.y = 0;
+	dst_rect.width = uScreenWidth;
+	dst_rect.height = uScreenHeight;
+
+	src_rect.x = 0;
+	src_rect.y = 0;
+	src_rect.width = uScreenWidth << 16;
+	src_rect.height = uScreenHeight << 16;
+
+	DISPMANX_DISPLAY_HANDLE_T dispman_display;
+	DISPMANX_UPDATE_HANDLE_T dispman_update;
+	DISPMANX_ELEMENT_HANDLE_T dispman_element;
+
+	dispman_display = vc_dispmanx_display_open( 0 /* LCD */);
+	dispman_update = vc_dispmanx_update_start( 0 );
+
+	dispman_element = vc_dispmanx_element_add ( dispman_update, dispman_display,
+		0/*layer*/, &dst_rect, 0/*src*/,
+		&src_rect, DISPMANX_PROTECTION_NONE, 0 /*alpha*/, 0/*clamp*/,
+		(DISPMANX_TRANSFORM_T) 0/*transform*/);
+
+	m_nativewindow.element = dispman_element;
+	m_nativewindow.width = uScreenWidth;
+	m_nativewindow.height = uScreenHeight;
+	vc_dispmanx_update_submit_sync( dispman_update );
+
+	EGL_ASSERT();
+
+	return eglCreateWindowSurface( m_eglDisplay, m_eglConfig, &m_nativewindow, NULL );
+#else
+	throw runtime_error("No native window on this platform");
+#endif // IS_RPI
+}
+
+void VideoObjectGLES2_EGL::RenderFrame()
+{
+	// take the latest complete target (if there is one) so a decode that finishes mid-frame waits for the next frame
+	int iLatest = __sync_lock_test_and_set(&m_iLatestComplete, -1);
+
+	if (iLatest != -1)
+	{
+		m_iShownTarget = iLatest;
+		m_uDisplayTexture = m_mapEGLImageTextures[m_targets[iLatest].eglImage];
+		m_pDisplayYUV = NULL;
+		InvalidatePost();
+	}
+
+	VideoObjectGLES2::RenderFrame();
+}
+
 void VideoObjectGLES2_EGL::Flip()
 {
+	// the target on screen must not be decoded into again until the GPU has finished this frame
+	if (m_pfnCreateSync && (m_iShownTarget != -1))
+	{
+		DecodeTarget &target = m_targets[m_iShownTarget];
+
+		if (target.fence != EGL_NO_SYNC_KHR)
+		{
+			m_pfnDestroySync(m_eglDisplay, target.fence);
+		}
+
+		target.fence = m_pfnCreateSync(m_eglDisplay, EGL_SYNC_FENCE_KHR, NULL);
+		m_gl.CountCalls(2);
+	}
+
 	eglSwapBuffers(m_eglDisplay, m_eglSurface);
+	m_gl.CountCalls();
 	EGL_ASSERT();
 }
 
+void VideoObjectGLES2_EGL::SetVsync(bool bWait)
+{
+	if (bWait == m_bWaitForVsync)
+	{
+		return;
+	}
+
+	// not every surface supports a swap interval (a pbuffer never waits anyway), so failure isn't fatal
+	eglSwapInterval(m_eglDisplay, bWait ? 1 : 0);
+	m_gl.CountCalls();
+	m_bWaitForVsync = bWait;
+}
+
 void *VideoObjectGLES2_EGL::CreateEGLImage(unsigned int uTextureWidth, unsigned int uTextureHeight)
 {
 	void *pRes = 0;
 	GLuint uTexID = 0;
 
-	// map field index to texture ID
-	uTexID = m_textures[TEX_RGBA];
-
-	glBindTexture(GL_TEXTURE_2D, uTexID);
+	// every EGL image gets its own texture so that more than one decoded image can be kept around
+	glGenTextures(1, &uTexID);
+	InitTextureParams(uTexID);
 
 	// This call is necessary or else the eglCreateImage fails
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, uTextureWidth, uTextureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 
 	// make egl image
-	pRes = eglCreateImageKHR(
+	pRes = m_pfnCreateImage(
               	m_eglDisplay,
                	m_eglContext,
                	EGL_GL_TEXTURE_2D_KHR,
-               	(EGLClientBuffer) uTexID,
+               	(EGLClientBuffer) (uintptr_t) uTexID,
 		0);
 
 	if (pRes == EGL_NO_IMAGE_KHR)
 	{
+		m_gl.OnDeleteTexture(uTexID);
+		glDeleteTextures(1, &uTexID);
 		throw runtime_error("eglCreateImageKHR failed");
 	}
 
+	m_mapEGLImageTextures[pRes] = uTexID;
+
+	TextureSize size = { uTextureWidth, uTextureHeight };
+	m_mapTextureSizes[uTexID] = size;
+
 	return pRes;
 }
 
 void VideoObjectGLES2_EGL::DeleteEGLImage(void *eglImage)
 {
-	if (eglDestroyImageKHR(m_eglDisplay, eglImage) != EGL_TRUE)
+	map<void *, GLuint>::iterator mi = m_mapEGLImageTextures.find(eglImage);
+
+	if (m_pfnDestroyImage(m_eglDisplay, eglImage) != EGL_TRUE)
 	{
 		throw runtime_error("eglDestroyImageKHR failed");
 	}
+
+	// a deleted decode target leaves an empty slot that gets a new image when it is next acquired
+	int iTarget = FindDecodeTarget(eglImage);
+	if (iTarget != -1)
+	{
+		__sync_bool_compare_and_swap(&m_iLatestComplete, iTarget, -1);
+		if (m_iShownTarget == iTarget)
+		{
+			m_iShownTarget = -1;
+		}
+		ClearTarget(iTarget);
+	}
+
+	if (mi != m_mapEGLImageTextures.end())
+	{
+		// don't leave the renderer pointing at a texture that no longer exists
+		if (m_uDisplayTexture == mi->second)
+		{
+			m_uDisplayTexture = m_textures[TEX_RGBA];
+			InvalidatePost();
+		}
+
+		// nor at sprites that use it
+		for (vector<SpriteGL>::iterator vi = m_vSprites.begin(); vi != m_vSprites.end(); )
+		{
+			if (vi->uTexture == mi->second)
+			{
+				vi = m_vSprites.erase(vi);
+				m_bSpritesDirty = true;
+			}
+			else
+			{
+				vi++;
+			}
+		}
+
+		m_gl.OnDeleteTexture(mi->second);
+		glDeleteTextures(1, &mi->second);
+		m_mapTextureSizes.erase(mi->second);
+		m_mapEGLImageTextures.erase(mi);
+	}
+}
+
+void VideoObjectGLES2_EGL::DeleteEGLImageNoThrow(void *eglImage)
+{
+	try
+	{
+		DeleteEGLImage(eglImage);
+	}
+	catch (std::exception &ex)
+	{
+		m_pLogger->Log((string) "VideoObjectGLES2_EGL::DeleteEGLImageNoThrow: " + ex.what());
+	}
+}
+
+void VideoObjectGLES2_EGL::UpdateEGLImage(void *eglImage, const uint8_t *p8RGBA, unsigned int uWidth, unsigned int uHeight)
+{
+	UpdateEGLImageRect(eglImage, 0, 0, p8RGBA, uWidth, uHeight);
+}
+
+void VideoObjectGLES2_EGL::UpdateEGLImageRect(void *eglImage, unsigned int uX, unsigned int uY, const uint8_t *p8RGBA, unsigned int uWidth, unsigned int uHeight)
+{
+	map<void *, GLuint>::iterator mi = m_mapEGLImageTextures.find(eglImage);
+
+	if (mi == m_mapEGLImageTextures.end())
+	{
+		throw runtime_error("UpdateEGLImage: unknown EGL image");
+	}
+
+	m_gl.BindTexture(mi->second);
+
+	// rows are tightly packed RGBA so they are always 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// TexSubImage keeps the texture's storage (and therefore the EGL image) intact
+	glTexSubImage2D(GL_TEXTURE_2D, 0, uX, uY, uWidth, uHeight, GL_RGBA, GL_UNSIGNED_BYTE, p8RGBA);
+	m_gl.CountCalls(2);
+
+	// the post-processed copy of what is on screen is now out of date
+	if (mi->second == m_uDisplayTexture)
+	{
+		InvalidatePost();
+	}
+}
+
+void VideoObjectGLES2_EGL::SetDisplayEGLImage(void *eglImage)
+{
+	map<void *, GLuint>::iterator mi = m_mapEGLImageTextures.find(eglImage);
+
+	if (mi == m_mapEGLImageTextures.end())
+	{
+		throw runtime_error("SetDisplayEGLImage: unknown EGL image");
+	}
+
+	// whatever was published before this is older than what the caller wants on screen
+	__sync_lock_test_and_set(&m_iLatestComplete, -1);
+
+	m_uDisplayTexture = mi->second;
+	m_pDisplayYUV = NULL;
+	InvalidatePost();
+	m_iShownTarget = FindDecodeTarget(eglImage);
+}
+
+void VideoObjectGLES2_EGL::SetDisplayYUVImage(void *yuvImage)
+{
+	VideoObjectGLES2::SetDisplayYUVImage(yuvImage);
+
+	// same as SetDisplayEGLImage: a target published before this must not replace it at the next RenderFrame
+	__sync_lock_test_and_set(&m_iLatestComplete, -1);
+	m_iShownTarget = -1;
+}
+
+void VideoObjectGLES2_EGL::SetDecodeTargetCount(unsigned int uCount)
+{
+	if ((uCount < 2) || (uCount > MAX_DECODE_TARGETS))
+	{
+		throw runtime_error("SetDecodeTargetCount: must be 2 to 4");
+	}
+
+	// targets beyond the new count are freed unless something is still using them
+	for (unsigned int u = uCount; u < m_uDecodeTargets; u++)
+	{
+		if ((m_targets[u].eglImage != 0) && ((int) u != m_iShownTarget) && ((int) u != m_iLatestComplete))
+		{
+			DeleteEGLImage(m_targets[u].eglImage);
+		}
+	}
+
+	m_uDecodeTargets = uCount;
+}
+
+void *VideoObjectGLES2_EGL::AcquireDecodeTarget(unsigned int uWidth, unsigned int uHeight)
+{
+	int iPending = m_iLatestComplete;
+	int iBest = -1;
+	bool bBestIdle = false;
+
+	// the least recently used target that nobody is waiting to see, preferring ones that the GPU is done with
+	for (unsigned int u = 0; u < m_uDecodeTargets; u++)
+	{
+		if (((int) u == m_iShownTarget) || ((int) u == iPending))
+		{
+			continue;
+		}
+
+		bool bIdle = IsTargetIdle(u, false);
+
+		if ((iBest == -1) || (bIdle && !bBestIdle) ||
+			((bIdle == bBestIdle) && (m_targets[u].uLastAcquired < m_targets[iBest].uLastAcquired)))
+		{
+			iBest = u;
+			bBestIdle = bIdle;
+		}
+	}
+
+	// With double buffering, one target is on screen and the other may not have been shown yet.
+	// We are decoding something newer so take the unshown one back (it will never be displayed).
+	if (iBest == -1)
+	{
+		iBest = iPending;
+		__sync_bool_compare_and_swap(&m_iLatestComplete, iPending, -1);
+		bBestIdle = IsTargetIdle(iBest, false);
+	}
+
+	// the GPU is still drawing a frame that shows this target (this is the only place we ever stall on the GPU)
+	if (!bBestIdle)
+	{
+		m_uFenceStalls++;
+		IsTargetIdle(iBest, true);
+	}
+
+	DecodeTarget &target = m_targets[iBest];
+
+	// texture storage can't change size behind an EGL image, so a new size needs a new image
+	if ((target.eglImage != 0) && ((target.uWidth != uWidth) || (target.uHeight != uHeight)))
+	{
+		DeleteEGLImage(target.eglImage);
+	}
+
+	if (target.eglImage == 0)
+	{
+		target.eglImage = CreateEGLImage(uWidth, uHeight);
+		target.uWidth = uWidth;
+		target.uHeight = uHeight;
+	}
+
+	target.uLastAcquired = ++m_uAcquireCount;
+
+	return target.eglImage;
+}
+
+void VideoObjectGLES2_EGL::PublishDecodeTarget(void *eglImage)
+{
+	int iTarget = FindDecodeTarget(eglImage);
+
+	if (iTarget == -1)
+	{
+		SetDisplayEGLImage(eglImage);
+		return;
+	}
+
+	__sync_lock_test_and_set(&m_iLatestComplete, iTarget);
+}
+
+void VideoObjectGLES2_EGL::ReleaseDecodeTarget(void *eglImage)
+{
+	int iTarget = FindDecodeTarget(eglImage);
+
+	if (iTarget == -1)
+	{
+		return;
+	}
+
+	// if it was about to be shown, show it now since it won't be a target by the next frame
+	if (__sync_bool_compare_and_swap(&m_iLatestComplete, iTarget, -1))
+	{
+		m_uDisplayTexture = m_mapEGLImageTextures[eglImage];
+		m_pDisplayYUV = NULL;
+		InvalidatePost();
+	}
+
+	if (m_iShownTarget == iTarget)
+	{
+		m_iShownTarget = -1;
+	}
+
+	ClearTarget(iTarget);
+}
+
+bool VideoObjectGLES2_EGL::IsTargetIdle(unsigned int uTarget, bool bWait)
+{
+	DecodeTarget &target = m_targets[uTarget];
+
+	if (target.fence == EGL_NO_SYNC_KHR)
+	{
+		return true;
+	}
+
+	EGLint iRes = m_pfnClientWaitSync(m_eglDisplay, target.fence,
+		bWait ? EGL_SYNC_FLUSH_COMMANDS_BIT_KHR : 0, bWait ? EGL_FOREVER_KHR : 0);
+
+	if (iRes == EGL_TIMEOUT_EXPIRED_KHR)
+	{
+		return false;
+	}
+
+	// signaled (or the wait failed, in which case there is nothing more we can do about it)
+	m_pfnDestroySync(m_eglDisplay, target.fence);
+	target.fence = EGL_NO_SYNC_KHR;
+
+	return true;
+}
+
+void VideoObjectGLES2_EGL::ClearTarget(unsigned int uTarget)
+{
+	DecodeTarget &target = m_targets[uTarget];
+
+	if (target.fence != EGL_NO_SYNC_KHR)
+	{
+		m_pfnDestroySync(m_eglDisplay, target.fence);
+	}
+
+	memset(&target, 0, sizeof(target));
+}
+
+void VideoObjectGLES2_EGL::GetRenderStats(VideoRenderStats *pStats) const
+{
+	VideoObjectGLES2::GetRenderStats(pStats);
+	pStats->uFenceStalls = m_uFenceStalls;
+}
+
+int VideoObjectGLES2_EGL::FindDecodeTarget(void *eglImage) const
+{
+	int iRes = -1;
+
+	for (unsigned int u = 0; (u < MAX_DECODE_TARGETS) && (eglImage != 0); u++)
+	{
+		if (m_targets[u].eglImage == eglImage)
+		{
+			iRes = u;
+			break;
+		}
+	}
+
+	return iRes;
+}
+
+void VideoObjectGLES2_EGL::ClearSprites()
+{
+	m_vSprites.clear();
+	m_bSpritesDirty = true;
+}
+
+void VideoObjectGLES2_EGL::AddSprite(const VideoSprite &sprite)
+{
+	map<void *, GLuint>::iterator mi = m_mapEGLImageTextures.find(sprite.eglImage);
+
+	if (mi == m_mapEGLImageTextures.end())
+	{
+		throw runtime_error("AddSprite: unknown EGL image");
+	}
+
+	if (m_vSprites.size() >= MAX_SPRITES)
+	{
+		throw runtime_error("AddSprite: too many sprites");
+	}
+
+	SpriteGL s;
+	s.uTexture = mi->second;
+	s.sprite = sprite;
+	m_vSprites.push_back(s);
+	m_bSpritesDirty = true;
 }
 
 //////////////////////////////////////////////
 
 VideoObjectGLES2_EGL::VideoObjectGLES2_EGL(ILogger *pLogger) :
-VideoObjectGLES2(pLogger)
+VideoObjectGLES2(pLogger),
+m_pLogger(pLogger),
+m_uDecodeTargets(3),
+m_uAcquireCount(0),
+m_iLatestComplete(-1),
+m_iShownTarget(-1),
+m_pfnCreateImage(NULL),
+m_pfnDestroyImage(NULL),
+m_pfnCreateSync(NULL),
+m_pfnDestroySync(NULL),
+m_pfnClientWaitSync(NULL),
+m_uFenceStalls(0)
 {
+	memset(m_targets, 0, sizeof(m_targets));
+
 	// EGL variables
 	m_eglDisplay	= 0;
 	m_eglConfig	= 0;
@@ -198,6 +613,7 @@ VideoObjectGLES2(pLogger)
 	m_bWaitForVsync = false;
 }
 
+#ifdef IS_RPI
 IVideoObjectSPtr VideoObjectGLES2_EGL::GetInstance(ILogger *pLogger)
 {
 	IVideoObjectSPtr pRes;
@@ -218,9 +634,19 @@ IVideoObjectSPtr VideoObjectGLES2_EGL::GetInstance(ILogger *pLogger)
 
 	return pRes;
 }
+#endif // IS_RPI
 
 VideoObjectGLES2_EGL::~VideoObjectGLES2_EGL()
 {
+	// decode targets belong to us (anything else is freed by whoever created it)
+	for (unsigned int u = 0; u < MAX_DECODE_TARGETS; u++)
+	{
+		if (m_targets[u].eglImage != 0)
+		{
+			DeleteEGLImageNoThrow(m_targets[u].eglImage);
+		}
+	}
+
 	Shutdown();
 	
 	eglMakeCurrent( m_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
@@ -234,6 +660,5 @@ void VideoObjectGLES2_EGL::DeleteInstance()
 	delete this;
 }
 
-#endif // IS_RPI
 #endif // USE_EGL
 #endif // USE_OPENGL
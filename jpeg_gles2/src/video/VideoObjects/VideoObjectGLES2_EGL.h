@@ -6,42 +6,67 @@
 #define VIDEO_OBJECT_GLES2_EGL_H
 
 #ifdef USE_EGL
-#ifdef IS_RPI
 
 #include "VideoObjectGLES2.h"
 #include "IVideoObjectEGLImage.h"
 
 #include <GLES2/gl2.h>
+#ifdef IS_RPI
 #include <bcm_host.h>	// for dispmanx schlop
+#endif // IS_RPI
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include "../../common/mpo_deleter.h"
+#include <map>
 
-class VideoObjectGLES2_EGL : public VideoObjectGLES2, public MpoDeleter, public IVideoObjectEGLImage
+class VideoObjectGLES2_EGL : public VideoObjectGLES2, public MpoDeleter, public IVideoObjectEGLImage, public IVideoObjectSprites
 {
 	// since bcm_init(?) needs to be called, we only allow PlatformRPI to instantiate us
 	friend class PlatformRPI;
 
 public:
+	// switches to the latest published decode target before drawing
+	void RenderFrame();
+
+	// fences the frame (if it showed a decode target) and swaps
 	void Flip();
 
+	void SetVsync(bool bWait);
+
+	void GetRenderStats(VideoRenderStats *pStats) const;
+
+	// drops any decode target that was published but not shown yet, since the YUV image is newer
+	void SetDisplayYUVImage(void *yuvImage);
+
 	IVideoObjectEGLImage *ToEGLImage() { return this; }
 	void *CreateEGLImage(unsigned int uTextureWidth, unsigned int uTextureHeight);
 	void DeleteEGLImage(void *);
+	void UpdateEGLImage(void *eglImage, const uint8_t *p8RGBA, unsigned int uWidth, unsigned int uHeight);
+	void UpdateEGLImageRect(void *eglImage, unsigned int uX, unsigned int uY, const uint8_t *p8RGBA, unsigned int uWidth, unsigned int uHeight);
+	void SetDisplayEGLImage(void *);
+	void SetDecodeTargetCount(unsigned int uCount);
+	void *AcquireDecodeTarget(unsigned int uWidth, unsigned int uHeight);
+	void PublishDecodeTarget(void *eglImage);
+	void ReleaseDecodeTarget(void *eglImage);
 
-private:
+	IVideoObjectSprites *ToSprites() { return this; }
+	void ClearSprites();
+	void AddSprite(const VideoSprite &sprite);
+
+protected:
 
 	VideoObjectGLES2_EGL(ILogger *pLogger);
 	virtual ~VideoObjectGLES2_EGL();
 
-	// only let PlatformRPI instantiate
-	static IVideoObjectSPtr GetInstance(ILogger *pLogger);
-
 	void DeleteInstance();
 
 	bool InitPlatform();
 
-	/////
+	// The parts of InitPlatform that depend on where the frames go (the default is a full screen dispmanx window).
+	// These throw on error.
+	virtual EGLDisplay OpenDisplay();
+	virtual EGLint GetSurfaceType() const { return EGL_WINDOW_BIT; }
+	virtual EGLSurface CreateSurface();
 
 	// EGL variables
 	EGLDisplay			m_eglDisplay;
@@ -49,13 +74,72 @@ private:
 	EGLSurface			m_eglSurface;
 	EGLContext			m_eglContext;
 
+private:
+
+#ifdef IS_RPI
+	// only let PlatformRPI instantiate
+	static IVideoObjectSPtr GetInstance(ILogger *pLogger);
+#endif // IS_RPI
+
+	// returns the index of the decode target that uses this EGL image, or -1
+	int FindDecodeTarget(void *eglImage) const;
+
+	// returns true if the GPU has finished every frame that sampled this target (if bWait, waits for that to happen)
+	bool IsTargetIdle(unsigned int uTarget, bool bWait);
+
+	// clears a target's slot (the EGL image itself is left alone)
+	void ClearTarget(unsigned int uTarget);
+
+	// for the destructor: logs a failure instead of throwing
+	void DeleteEGLImageNoThrow(void *eglImage);
+
+	/////
+
+	ILogger *m_pLogger;
+
+#ifdef IS_RPI
 	// raspberry pi variables
 	EGL_DISPMANX_WINDOW_T	m_nativewindow;
+#endif // IS_RPI
 
 	bool m_bWaitForVsync;
+
+	// maps each EGL image we have created to the texture that backs it
+	map<void *, GLuint> m_mapEGLImageTextures;
+
+	enum { MAX_DECODE_TARGETS = 4 };
+
+	struct DecodeTarget
+	{
+		void *eglImage;	// 0 until the slot is first acquired (or after its image was released/deleted)
+		unsigned int uWidth, uHeight;
+		unsigned int uLastAcquired;	// the acquire count when this was last handed out (the oldest gets reused first)
+		EGLSyncKHR fence;		// signals when the GPU is done with the last frame that showed this target
+	};
+
+	DecodeTarget m_targets[MAX_DECODE_TARGETS];
+	unsigned int m_uDecodeTargets;
+	unsigned int m_uAcquireCount;
+
+	// The target that was published but not shown yet (-1 if none).
+	// Only ever changed with atomic swaps since it may be published from a decoder thread.
+	volatile int m_iLatestComplete;
+
+	// the target that is on screen (-1 if the screen shows something that isn't a decode target)
+	int m_iShownTarget;
+
+	// EGL_KHR_image_base (looked up at runtime since not every libEGL exports these)
+	PFNEGLCREATEIMAGEKHRPROC m_pfnCreateImage;
+	PFNEGLDESTROYIMAGEKHRPROC m_pfnDestroyImage;
+
+	// EGL_KHR_fence_sync (NULL if the driver doesn't have it, in which case targets are reused without waiting)
+	PFNEGLCREATESYNCKHRPROC m_pfnCreateSync;
+	PFNEGLDESTROYSYNCKHRPROC m_pfnDestroySync;
+	PFNEGLCLIENTWAITSYNCKHRPROC m_pfnClientWaitSync;
+
+	unsigned int m_uFenceStalls;
 };
 
-#endif // IS_RPI
 #endif // USE_EGL
 
 #endif // VIDEO_OBJECT_GLES2_EGL_H
@@ -0,0 +1,72 @@
+#ifdef USE_OPENGL
+#ifdef USE_EGL
+
+#include <string.h>
+#include "VideoObjectGLES2_Headless.h"
+
+IVideoObjectSPtr VideoObjectGLES2_Headless::GetInstance(ILogger *pLogger, unsigned int uWidth, unsigned int uHeight)
+{
+	IVideoObjectSPtr pRes;
+	VideoObjectGLES2_Headless *pInstance = new VideoObjectGLES2_Headless(pLogger, uWidth, uHeight);
+
+	if (!pInstance->InitPlatform())
+	{
+		delete pInstance;
+	}
+	else
+	{
+		pRes = IVideoObjectSPtr(pInstance, VideoObjectGLES2_Headless::deleter());
+	}
+
+	return pRes;
+}
+
+EGLDisplay VideoObjectGLES2_Headless::OpenDisplay()
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+	// client extensions (the ones that don't need a display)
+	const char *cpszExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	if (cpszExtensions && strstr(cpszExtensions, "EGL_MESA_platform_surfaceless"))
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC pfnGetPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+		if (pfnGetPlatformDisplay)
+		{
+			display = pfnGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		}
+	}
+#endif // EGL_PLATFORM_SURFACELESS_MESA
+
+	if (display == EGL_NO_DISPLAY)
+	{
+		display = VideoObjectGLES2_EGL::OpenDisplay();
+	}
+
+	return display;
+}
+
+EGLSurface VideoObjectGLES2_Headless::CreateSurface()
+{
+	const EGLint pbuffer_attributes[] =
+	{
+		EGL_WIDTH, (EGLint) m_uWidth,
+		EGL_HEIGHT, (EGLint) m_uHeight,
+		EGL_NONE
+	};
+
+	return eglCreatePbufferSurface(m_eglDisplay, m_eglConfig, pbuffer_attributes);
+}
+
+VideoObjectGLES2_Headless::VideoObjectGLES2_Headless(ILogger *pLogger, unsigned int uWidth, unsigned int uHeight) :
+VideoObjectGLES2_EGL(pLogger),
+m_uWidth(uWidth),
+m_uHeight(uHeight)
+{
+}
+
+#endif // USE_EGL
+#endif // USE_OPENGL
@@ -0,0 +1,32 @@
+#ifndef VIDEO_OBJECT_GLES2_HEADLESS_H
+#define VIDEO_OBJECT_GLES2_HEADLESS_H
+
+#ifdef USE_EGL
+
+#include "VideoObjectGLES2_EGL.h"
+
+// Renders into an offscreen pbuffer instead of a window so that the renderer runs without a display
+//  (for example on a PC or a build machine with Mesa's software rasterizer).
+// Frames can be checked with ReadFrame.
+class VideoObjectGLES2_Headless : public VideoObjectGLES2_EGL
+{
+	friend class PlatformHeadless;
+
+private:
+	VideoObjectGLES2_Headless(ILogger *pLogger, unsigned int uWidth, unsigned int uHeight);
+
+	static IVideoObjectSPtr GetInstance(ILogger *pLogger, unsigned int uWidth, unsigned int uHeight);
+
+	// uses Mesa's surfaceless platform if it is there so that no X server or GPU device is needed
+	EGLDisplay OpenDisplay();
+
+	EGLint GetSurfaceType() const { return EGL_PBUFFER_BIT; }
+
+	EGLSurface CreateSurface();
+
+	unsigned int m_uWidth, m_uHeight;
+};
+
+#endif // USE_EGL
+
+#endif // VIDEO_OBJECT_GLES2_HEADLESS_H
@@ -21,6 +21,8 @@
 #include <unistd.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <errno.h>
 
 #include <bcm_host.h>
 #include <GLES2/gl2.h>
@@ -114,24 +116,148 @@ static GLuint compile(GLenum type, const char *src)
     return sh;
 }
 
+/* ───── program binary cache (GL_OES_get_program_binary) ─────
+ * The linked program is kept in /var/tmp so a restart skips compiling.
+ * The file name is a hash of the driver strings + shader source, so a
+ * driver update or a shader edit just misses.  Anything that goes wrong
+ * falls back to compiling.                                         */
+static uint64_t fnv1a(uint64_t h, const char *s)
+{
+    for (; s && *s; s++) { h ^= (uint8_t)*s; h *= 0x100000001b3ULL; }
+    return h;
+}
 
-/* ----------------------------------------------------
- * wait until decoder has produced a valid output format
- * (old Stretch headers: no component->event_queue)     */
-static MMAL_STATUS_T
-wait_format_changed(MMAL_PORT_T *ctrl /*unused*/, MMAL_PORT_T *out)
+static GLuint build_program(void)
 {
-    (void)ctrl;                         /* silence “unused” warning */
+    PFNGLGETPROGRAMBINARYOESPROC getBinary = 0;
+    PFNGLPROGRAMBINARYOESPROC    putBinary = 0;
+    const char *ext = (const char *)glGetString(GL_EXTENSIONS);
+    GLint formats = 0;
+    char path[64] = "";
+
+    if (ext && strstr(ext, "GL_OES_get_program_binary")) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+        getBinary = (void*)eglGetProcAddress("glGetProgramBinaryOES");
+        putBinary = (void*)eglGetProcAddress("glProgramBinaryOES");
+    }
+    if (formats > 0 && getBinary && putBinary) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        h = fnv1a(h, (const char *)glGetString(GL_VENDOR));
+        h = fnv1a(h, (const char *)glGetString(GL_RENDERER));
+        h = fnv1a(h, (const char *)glGetString(GL_VERSION));
+        h = fnv1a(h, VS); h = fnv1a(h, FS); h = fnv1a(h, "aPos=0 aUV=1");
+        snprintf(path, sizeof path, "/var/tmp/texturecube_%016llx.bin",
+                 (unsigned long long)h);
+
+        /* file = GLenum format, then the binary */
+        FILE *f = fopen(path, "rb");
+        if (f) {
+            GLenum fmt = 0; long len = 0; void *bin = 0;
+            fseek(f, 0, SEEK_END); len = ftell(f) - (long)sizeof fmt;
+            fseek(f, 0, SEEK_SET);
+            if (len > 0 && fread(&fmt, sizeof fmt, 1, f) == 1 &&
+                (bin = malloc(len)) && fread(bin, 1, len, f) == (size_t)len) {
+                GLuint prog = glCreateProgram();
+                GLint linked = 0;
+                putBinary(prog, fmt, bin, (GLint)len);
+                glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+                free(bin); fclose(f);
+                if (linked) { printf("program loaded from %s\n", path); return prog; }
+                glDeleteProgram(prog);   /* driver rejected it, rebuild */
+            } else {
+                free(bin); fclose(f);
+            }
+            unlink(path);
+        }
+    }
 
-    /* give the firmware up to ~5 s (500 × 10 ms) */
-    for (int i = 0; i < 500; ++i) {
-        if (out->format->es->video.width  &&
-            out->format->es->video.height)
-            return MMAL_SUCCESS;        /* format ready */
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, compile(GL_VERTEX_SHADER,   VS));
+    glAttachShader(prog, compile(GL_FRAGMENT_SHADER, FS));
+    glBindAttribLocation(prog, 0, "aPos");       /* NEW */
+    glBindAttribLocation(prog, 1, "aUV");        /* NEW */
+    glLinkProgram(prog);    
+    
+    /* ---------- debug: program link status ---------- */
+    GLint linked = 0; GLsizei len = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[1024];
+        glGetProgramInfoLog(prog, sizeof log, &len, log);
+        fprintf(stderr, "Program link error:\n%.*s\n", len, log);
+        return prog;
+    }
+    /* ------------------------------------------------- */
 
-        usleep(10 * 1000);              /* 10 ms */
+    /* save it for next time (written aside + renamed so a restart
+       mid-write can't leave a truncated file)                       */
+    GLint size = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH_OES, &size);
+    if (path[0] && size > 0) {
+        void *bin = malloc(size); GLenum fmt = 0; GLsizei got = 0;
+        char tmp[72]; snprintf(tmp, sizeof tmp, "%s.tmp", path);
+        FILE *f = 0;
+        if (bin) getBinary(prog, size, &got, &fmt, bin);
+        if (got > 0 && (f = fopen(tmp, "wb"))) {
+            int ok = fwrite(&fmt, sizeof fmt, 1, f) == 1 &&
+                     fwrite(bin, 1, got, f) == (size_t)got;
+            if (fclose(f) != 0 || !ok || rename(tmp, path) != 0) unlink(tmp);
+        }
+        free(bin);
     }
-    return MMAL_ENOSYS;                 /* timeout → format never arrived */
+    return prog;
+}
+
+
+/* ───── MMAL callbacks → loader thread ─────
+ * Every callback that the loader may be waiting on broadcasts ev_cv, so
+ * the waits below wake as soon as something happens instead of polling. */
+static pthread_mutex_t ev_mx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  ev_cv = PTHREAD_COND_INITIALIZER;
+static MMAL_STATUS_T   ev_error;          /* from an MMAL_EVENT_ERROR    */
+
+/* absolute CLOCK_REALTIME deadline for pthread_cond_timedwait */
+static void deadline_in(struct timespec *ts, int ms)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec  += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) { ts->tv_sec++; ts->tv_nsec -= 1000000000L; }
+}
+
+/* control port events: the decoder/fx found its output format, or failed */
+static void cb_control(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buf)
+{
+    pthread_mutex_lock(&ev_mx);
+    if (buf->cmd == MMAL_EVENT_FORMAT_CHANGED) {
+        MMAL_EVENT_FORMAT_CHANGED_T *ev = mmal_event_format_changed_get(buf);
+        if (ev) mmal_format_full_copy(port->component->output[0]->format, ev->format);
+    } else if (buf->cmd == MMAL_EVENT_ERROR && buf->length >= sizeof(MMAL_STATUS_T)) {
+        ev_error = *(MMAL_STATUS_T *)buf->data;
+    }
+    pthread_cond_broadcast(&ev_cv);
+    pthread_mutex_unlock(&ev_mx);
+    mmal_buffer_header_release(buf);
+}
+
+/* ----------------------------------------------------
+ * wait until decoder has produced a valid output format
+ * (cb_control fills it in from MMAL_EVENT_FORMAT_CHANGED) */
+static MMAL_STATUS_T
+wait_format_changed(MMAL_PORT_T *out)
+{
+    MMAL_STATUS_T st = MMAL_SUCCESS;
+    struct timespec dl; deadline_in(&dl, 5000);   /* give the firmware up to 5 s */
+
+    pthread_mutex_lock(&ev_mx);
+    while (!(out->format->es->video.width && out->format->es->video.height) && !ev_error)
+        if (pthread_cond_timedwait(&ev_cv, &ev_mx, &dl) == ETIMEDOUT) {
+            st = MMAL_ENOSYS;                /* timeout → format never arrived */
+            break;
+        }
+    if (ev_error) st = ev_error;
+    pthread_mutex_unlock(&ev_mx);
+    return st;
 }
 
 /* -------------------------------------------------  */
@@ -147,86 +273,190 @@ static EGLDisplay   g_dpy;
 static GLuint       tex_front, tex_back;
 static volatile EGLImageKHR  next_img = 0;
 static volatile int image_ready = 0;
+static volatile unsigned img_seq = 0; /* bumped for every EGL image (the render loop owns image_ready) */
+static GLint        u_mvp = -1;       /* looked up once after linking    */
+static GLuint       tex_bound;        /* what GL_TEXTURE_2D has bound    */
 
 /* ───── MMAL callback ───── */
 static void cb_buffer(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buf)
 {
     if(buf->length >= sizeof(EGLImageKHR)){
+        pthread_mutex_lock(&ev_mx);
         memcpy((void*)&next_img, buf->data, sizeof(EGLImageKHR));
         image_ready = 1;
+        img_seq++;
+        pthread_cond_broadcast(&ev_cv);
+        pthread_mutex_unlock(&ev_mx);
     }
     mmal_buffer_header_release(buf);
 }
 
-/* ─── worker thread: decode file → image_fx → egl_render ─────────── */
-static void *loader(void *arg)
+/* compressed input the decoder is done with: back into the pool, which
+ * wakes mmal_queue_timedwait() in the feeding loop                     */
+static void cb_input(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buf)
 {
-    const char *file = arg;
+    (void)port;
+    mmal_buffer_header_release(buf);
+}
 
-/* 0. read compressed file ----------------------------------------- */
-    FILE *fp = fopen(file, "rb");
-    if (!fp) { perror(file); return NULL; }
-    fseek(fp, 0, SEEK_END); long sz = ftell(fp); rewind(fp);
-    uint8_t *data = malloc(sz); fread(data, 1, sz, fp); fclose(fp);
-
-/* 1. components ---------------------------------------------------- */
-    MMAL_COMPONENT_T *dec = NULL, *fx = NULL, *ren = NULL;
-    MMAL_CONNECTION_T *c1  = NULL, *c2 = NULL;
-    MMAL_STATUS_T st;
+/* ───── job queue: files for the loader thread ───── */
+#define MAX_JOBS 8
+static const char      *jobs[MAX_JOBS];
+static int              job_head, job_count, jobs_closed;
+static pthread_mutex_t  job_mx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   job_cv = PTHREAD_COND_INITIALIZER;
+
+/* returns 0 if the queue is full */
+static int queue_image(const char *file)
+{
+    int ok = 0;
+    pthread_mutex_lock(&job_mx);
+    if (job_count < MAX_JOBS) {
+        jobs[(job_head + job_count++) % MAX_JOBS] = file;
+        ok = 1;
+        pthread_cond_signal(&job_cv);
+    }
+    pthread_mutex_unlock(&job_mx);
+    return ok;
+}
 
-    if ((st = mmal_component_create("vc.ril.image_decode", &dec)))
-        { fprintf(stderr,"decoder create %d\n",st); goto end; }
-    if ((st = mmal_component_create("vc.ril.image_fx", &fx)))
-        { fprintf(stderr,"image_fx create %d\n",st); goto end; }
-    if ((st = mmal_component_create("vc.ril.egl_render", &ren)))
-        { fprintf(stderr,"render create %d\n",st); goto end; }
+/* no more jobs: the loader finishes the queued ones and exits */
+static void close_jobs(void)
+{
+    pthread_mutex_lock(&job_mx);
+    jobs_closed = 1;
+    pthread_cond_signal(&job_cv);
+    pthread_mutex_unlock(&job_mx);
+}
 
-    mmal_component_enable(dec);
-    mmal_component_enable(fx);
-    mmal_component_enable(ren);
+/* blocks until there is a job; NULL once closed and empty */
+static const char *next_job(void)
+{
+    const char *file = NULL;
+    pthread_mutex_lock(&job_mx);
+    while (!job_count && !jobs_closed)
+        pthread_cond_wait(&job_cv, &job_mx);
+    if (job_count) {
+        file = jobs[job_head];
+        job_head = (job_head + 1) % MAX_JOBS;
+        job_count--;
+    }
+    pthread_mutex_unlock(&job_mx);
+    return file;
+}
 
-    MMAL_PORT_T *dec_in  = dec->input[0];
-    MMAL_PORT_T *dec_out = dec->output[0];
-    MMAL_PORT_T *fx_in   =  fx->input[0];
-    MMAL_PORT_T *fx_out  =  fx->output[0];
-    MMAL_PORT_T *ren_in  = ren->input[0];
+/* ───── image size from the header (JPEG SOFn / PNG IHDR) ─────
+ * only to see whether the pipeline's formats still fit: PNG and JPEG
+ * decode to different formats too, so returns 1 = PNG, 2 = JPEG, 0 = unknown */
+static int image_size(const uint8_t *d, long sz, uint32_t *w, uint32_t *h)
+{
+    if (sz >= 24 && !memcmp(d, "\x89PNG\r\n\x1a\n", 8) && !memcmp(d + 12, "IHDR", 4)) {
+        *w = (uint32_t)d[16] << 24 | d[17] << 16 | d[18] << 8 | d[19];
+        *h = (uint32_t)d[20] << 24 | d[21] << 16 | d[22] << 8 | d[23];
+        return 1;
+    }
+    if (sz < 4 || d[0] != 0xFF || d[1] != 0xD8) return 0;
+    long i = 2;
+    while (i + 9 < sz) {
+        if (d[i] != 0xFF) return 0;
+        uint8_t m = d[i + 1];
+        if (m == 0xFF) { i++; continue; }             /* fill byte */
+        if (m == 0xD8 || (m >= 0xD0 && m <= 0xD7)) { i += 2; continue; }
+        int len = d[i + 2] << 8 | d[i + 3];
+        /* SOF0..SOF15 except DHT (C4), JPG (C8), DAC (CC) */
+        if (m >= 0xC0 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC) {
+            *h = d[i + 5] << 8 | d[i + 6];
+            *w = d[i + 7] << 8 | d[i + 8];
+            return 2;
+        }
+        if (m == 0xDA) return 0;                      /* scan before any SOF */
+        i += 2 + len;
+    }
+    return 0;
+}
 
-/* 2. feed compressed stream into decoder -------------------------- */
-    MMAL_POOL_T *pool = mmal_port_pool_create(dec_in,
+/* ───── persistent pipeline: image_decode → image_fx → egl_render ─────
+ * The components, their input pool and (while the resolution stays the
+ * same) the connections live as long as the loader thread; an image only
+ * costs feeding it in and waiting for the EGL image.                   */
+typedef struct {
+    MMAL_COMPONENT_T  *dec, *fx, *ren;
+    MMAL_CONNECTION_T *c1, *c2;
+    MMAL_POOL_T       *pool;       /* compressed input for dec_in        */
+    int                kind;       /* what the connections were set up for: */
+    uint32_t           w, h;       /*  image_size() of the last image        */
+} pipeline_t;
+
+static MMAL_STATUS_T pipe_open(pipeline_t *pl)
+{
+    MMAL_STATUS_T st;
+
+    if ((st = mmal_component_create("vc.ril.image_decode", &pl->dec)))
+        { fprintf(stderr,"decoder create %d\n",st); return st; }
+    if ((st = mmal_component_create("vc.ril.image_fx", &pl->fx)))
+        { fprintf(stderr,"image_fx create %d\n",st); return st; }
+    if ((st = mmal_component_create("vc.ril.egl_render", &pl->ren)))
+        { fprintf(stderr,"render create %d\n",st); return st; }
+
+    mmal_port_enable(pl->dec->control, cb_control);
+    mmal_port_enable(pl->fx->control, cb_control);
+    mmal_component_enable(pl->dec);
+    mmal_component_enable(pl->fx);
+    mmal_component_enable(pl->ren);
+
+    MMAL_PORT_T *dec_in = pl->dec->input[0];
+    pl->pool = mmal_port_pool_create(dec_in,
                         dec_in->buffer_num_recommended,
                         dec_in->buffer_size_recommended);
+    if (!pl->pool) { fprintf(stderr,"dec_in pool\n"); return MMAL_ENOMEM; }
+    if ((st = mmal_port_enable(dec_in, cb_input)))
+        { fprintf(stderr,"dec_in enable %d\n",st); return st; }
+    return MMAL_SUCCESS;
+}
 
-    uint8_t *p = data, *e = data + sz;
-    while (p < e) {
-        MMAL_BUFFER_HEADER_T *b = mmal_queue_get(pool->queue);
-        if (!b) { usleep(1000); continue; }
-        int cp = (e - p) < b->alloc_size ? (e - p) : b->alloc_size;
-        mmal_buffer_header_mem_lock(b);
-        memcpy(b->data, p, cp);
-        mmal_buffer_header_mem_unlock(b);
-        b->length = cp;
-        p += cp;
-        if (p == e) b->flags = MMAL_BUFFER_HEADER_FLAG_EOS;   /* <-- fixed */
-        mmal_port_send_buffer(dec_in, b);
-    }
+/* tear the connections down for a new resolution (components stay) */
+static void pipe_disconnect(pipeline_t *pl)
+{
+    MMAL_PORT_T *ren_in = pl->ren->input[0];
+    if (ren_in->is_enabled) mmal_port_disable(ren_in);
+    if (pl->c2) { mmal_connection_destroy(pl->c2); pl->c2 = NULL; }
+    if (pl->c1) { mmal_connection_destroy(pl->c1); pl->c1 = NULL; }
+    /* so wait_format_changed() waits for the new image's format */
+    pthread_mutex_lock(&ev_mx);
+    pl->dec->output[0]->format->es->video.width  = 0;
+    pl->dec->output[0]->format->es->video.height = 0;
+    pl->fx->output[0]->format->es->video.width   = 0;
+    pl->fx->output[0]->format->es->video.height  = 0;
+    pthread_mutex_unlock(&ev_mx);
+    pl->kind = 0; pl->w = pl->h = 0;
+}
+
+/* formats + connections for the image the decoder has just been fed */
+static MMAL_STATUS_T pipe_connect(pipeline_t *pl)
+{
+    MMAL_PORT_T *dec_out = pl->dec->output[0];
+    MMAL_PORT_T *fx_in   =  pl->fx->input[0];
+    MMAL_PORT_T *fx_out  =  pl->fx->output[0];
+    MMAL_PORT_T *ren_in  = pl->ren->input[0];
+    MMAL_STATUS_T st;
 
 /* 3. wait for decoder FORMAT_CHANGED ------------------------------ */
-    if ((st = wait_format_changed(dec->control, dec_out)))
-        { fprintf(stderr,"dec FORMAT_CHANGED %d\n",st); goto end; }
+    if ((st = wait_format_changed(dec_out)))
+        { fprintf(stderr,"dec FORMAT_CHANGED %d\n",st); return st; }
 
 /* 4. propagate format to fx_in ------------------------------------ */
     mmal_format_copy(fx_in->format, dec_out->format);
     if ((st = mmal_port_format_commit(fx_in)))
-        { fprintf(stderr,"fx_in commit %d\n",st); goto end; }
+        { fprintf(stderr,"fx_in commit %d\n",st); return st; }
 
 /* 5. wait for fx FORMAT_CHANGED ----------------------------------- */
-    if ((st = wait_format_changed(fx->control, fx_out)))
-        { fprintf(stderr,"fx FORMAT_CHANGED %d\n",st); goto end; }
+    if ((st = wait_format_changed(fx_out)))
+        { fprintf(stderr,"fx FORMAT_CHANGED %d\n",st); return st; }
 
 /* 6. request opaque output from fx -------------------------------- */
     fx_out->format->encoding = MMAL_ENCODING_OPAQUE;
     if ((st = mmal_port_format_commit(fx_out)))
-        { fprintf(stderr,"fx_out commit %d\n",st); goto end; }
+        { fprintf(stderr,"fx_out commit %d\n",st); return st; }
 
 /* 7. zero-copy on dec_out + fx_in + fx_out (NOT ren_in yet) ------- */
     MMAL_PARAMETER_BOOLEAN_T zc = {{MMAL_PARAMETER_ZERO_COPY,sizeof zc},1};
@@ -235,10 +465,10 @@ static void *loader(void *arg)
     mmal_port_parameter_set(fx_out, &zc.hdr);
 
 /* 8. connect decoder → fx ----------------------------------------- */
-    if (!(st = mmal_connection_create(&c1, dec_out, fx_in,
+    if (!(st = mmal_connection_create(&pl->c1, dec_out, fx_in,
             MMAL_CONNECTION_FLAG_TUNNELLING|MMAL_CONNECTION_FLAG_DIRECT)))
-        st = mmal_connection_enable(c1);
-    if (st) { fprintf(stderr,"c1 err %d\n",st); goto end; }
+        st = mmal_connection_enable(pl->c1);
+    if (st) { fprintf(stderr,"c1 err %d\n",st); return st; }
 
 /* 9. copy opaque format to ren_in (no commit yet) ----------------- */
     mmal_format_copy(ren_in->format, fx_out->format);
@@ -250,10 +480,10 @@ static void *loader(void *arg)
     }
 
 /* 10. connect fx → egl_render first ------------------------------- */
-    if (!(st = mmal_connection_create(&c2, fx_out, ren_in,
+    if (!(st = mmal_connection_create(&pl->c2, fx_out, ren_in,
             MMAL_CONNECTION_FLAG_TUNNELLING|MMAL_CONNECTION_FLAG_DIRECT)))
-        st = mmal_connection_enable(c2);
-    if (st) { fprintf(stderr,"c2 err %d\n",st); goto end; }
+        st = mmal_connection_enable(pl->c2);
+    if (st) { fprintf(stderr,"c2 err %d\n",st); return st; }
 
 /* 11. NOW switch ren_in to zero-copy and add EGL hint ------------- */
     mmal_port_parameter_set(ren_in, &zc.hdr);
@@ -264,17 +494,114 @@ static void *loader(void *arg)
 
     ren_in->userdata = (void*)cb_buffer;
     mmal_port_enable(ren_in, cb_buffer);
+    return MMAL_SUCCESS;
+}
+
+/* one image through the pipeline; *reconfigured = the formats changed */
+static MMAL_STATUS_T pipe_decode(pipeline_t *pl, const uint8_t *data, long sz,
+                                 int *reconfigured)
+{
+    MMAL_PORT_T *dec_in = pl->dec->input[0];
+    MMAL_STATUS_T st;
+    uint32_t w = 0, h = 0;
+
+    /* same kind and size as last time: the connections can stay as they are */
+    int kind = image_size(data, sz, &w, &h);
+    *reconfigured = !pl->c2 || !kind || kind != pl->kind ||
+                    w != pl->w || h != pl->h;
+    if (*reconfigured && pl->c2) pipe_disconnect(pl);
+
+    pthread_mutex_lock(&ev_mx);
+    unsigned seq = img_seq;                /* the image to wait for is the next one */
+    ev_error = MMAL_SUCCESS;
+    pthread_mutex_unlock(&ev_mx);
+
+/* 2. feed compressed stream into decoder -------------------------- */
+    const uint8_t *p = data, *e = data + sz;
+    while (p < e) {
+        /* blocks until cb_input has given a buffer back */
+        MMAL_BUFFER_HEADER_T *b = mmal_queue_timedwait(pl->pool->queue, 1000);
+        if (!b) { fprintf(stderr,"dec_in stalled\n"); return MMAL_EAGAIN; }
+        int cp = (e - p) < b->alloc_size ? (e - p) : b->alloc_size;
+        mmal_buffer_header_mem_lock(b);
+        memcpy(b->data, p, cp);
+        mmal_buffer_header_mem_unlock(b);
+        b->length = cp;
+        b->flags  = 0;
+        p += cp;
+        if (p == e) b->flags = MMAL_BUFFER_HEADER_FLAG_EOS;   /* <-- fixed */
+        mmal_port_send_buffer(dec_in, b);
+    }
+
+    if (*reconfigured) {
+        if ((st = pipe_connect(pl))) { pipe_disconnect(pl); return st; }
+        pl->kind = kind; pl->w = w; pl->h = h;
+    }
 
 /* 12. wait until callback fires ----------------------------------- */
-    while (!image_ready) usleep(1000);
-
-end:
-    if (c2)  mmal_connection_destroy(c2);
-    if (c1)  mmal_connection_destroy(c1);
-    if (ren) mmal_component_destroy(ren);
-    if (fx)  mmal_component_destroy(fx);
-    if (dec) mmal_component_destroy(dec);
-    free(data);
+    struct timespec dl; deadline_in(&dl, 5000);
+    st = MMAL_SUCCESS;
+    pthread_mutex_lock(&ev_mx);
+    while (img_seq == seq && !ev_error)
+        if (pthread_cond_timedwait(&ev_cv, &ev_mx, &dl) == ETIMEDOUT) {
+            st = MMAL_EAGAIN;                  /* no EGL image came out */
+            break;
+        }
+    if (ev_error) st = ev_error;
+    pthread_mutex_unlock(&ev_mx);
+    return st;
+}
+
+static void pipe_close(pipeline_t *pl)
+{
+    if (pl->ren)  pipe_disconnect(pl);
+    if (pl->dec && pl->dec->input[0]->is_enabled) mmal_port_disable(pl->dec->input[0]);
+    if (pl->pool) mmal_port_pool_destroy(pl->dec->input[0], pl->pool);
+    if (pl->ren)  mmal_component_destroy(pl->ren);
+    if (pl->fx)   mmal_component_destroy(pl->fx);
+    if (pl->dec)  mmal_component_destroy(pl->dec);
+}
+
+/* ─── worker thread: queued files → the pipeline, until close_jobs() ─── */
+static void *loader(void *arg)
+{
+    (void)arg;
+    pipeline_t pl = {0};
+
+/* 1. components, once --------------------------------------------- */
+    if (pipe_open(&pl)) {
+        pipe_close(&pl);
+        while (next_job()) ;               /* nothing can be decoded */
+        return NULL;
+    }
+
+    const char *file;
+    while ((file = next_job())) {
+        struct timespec t0, t1; clock_gettime(CLOCK_MONOTONIC, &t0);
+
+/* 0. read compressed file ----------------------------------------- */
+        FILE *fp = fopen(file, "rb");
+        if (!fp) { perror(file); continue; }
+        fseek(fp, 0, SEEK_END); long sz = ftell(fp); rewind(fp);
+        uint8_t *data = malloc(sz);
+        if (!data || fread(data, 1, sz, fp) != (size_t)sz) {
+            fprintf(stderr, "%s: read failed\n", file);
+            fclose(fp); free(data); continue;
+        }
+        fclose(fp);
+
+        int reconfigured = 0;
+        MMAL_STATUS_T st = pipe_decode(&pl, data, sz, &reconfigured);
+        free(data);
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (st) fprintf(stderr, "%s: decode failed %d\n", file, st);
+        else    printf("%s: %ld ms (%s)\n", file,
+                       (long)((t1.tv_sec-t0.tv_sec)*1000 + (t1.tv_nsec-t0.tv_nsec)/1000000),
+                       reconfigured ? "pipeline reconfigured" : "pipeline reused");
+    }
+
+    pipe_close(&pl);
     return NULL;
 }
 
@@ -331,24 +658,8 @@ static GLuint init_gl(uint32_t w,uint32_t h,EGLSurface *surf)
     glClearColor(0, 0.2f, 0.4f, 1);  /* non-black background to verify  */
     glEnable(GL_DEPTH_TEST);         /* cube faces won’t Z-fight        */
 
-    /* --- shader setup block --- */
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, compile(GL_VERTEX_SHADER,   VS));
-    glAttachShader(prog, compile(GL_FRAGMENT_SHADER, FS));
-    glBindAttribLocation(prog, 0, "aPos");       /* NEW */
-    glBindAttribLocation(prog, 1, "aUV");        /* NEW */
-    glLinkProgram(prog);    
-    
-    /* ---------- debug: program link status ---------- */
-    GLint linked = 0; GLsizei len = 0;
-    glGetProgramiv(prog, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        char log[1024];
-        glGetProgramInfoLog(prog, sizeof log, &len, log);
-        fprintf(stderr, "Program link error:\n%.*s\n", len, log);
-    }
-    /* ------------------------------------------------- */
-    
+    /* --- shader setup block (cached binary if possible) --- */
+    GLuint prog = build_program();
     glUseProgram(prog);
 
 
@@ -365,9 +676,9 @@ static GLuint init_gl(uint32_t w,uint32_t h,EGLSurface *surf)
     glEnableVertexAttribArray(aUV ); glVertexAttribPointer(aUV ,2,GL_FLOAT,0,20,(void*)12);
 
     /* identity MVP */
-    GLint uMVP=glGetUniformLocation(prog,"uMVP");
+    u_mvp=glGetUniformLocation(prog,"uMVP");
     float id[16]={1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
-    glUniformMatrix4fv(uMVP,1,GL_FALSE,id);
+    glUniformMatrix4fv(u_mvp,1,GL_FALSE,id);
 
     /* two textures (front/back) */
     glGenTextures(1,&tex_front); glGenTextures(1,&tex_back);
@@ -379,6 +690,7 @@ static GLuint init_gl(uint32_t w,uint32_t h,EGLSurface *surf)
         glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
     }
+    tex_bound = t[1];
     
     printf("init_gl finished, prog=%u  GL_VENDOR=%s\n",
        prog, glGetString(GL_VENDOR));
@@ -390,15 +702,17 @@ static GLuint init_gl(uint32_t w,uint32_t h,EGLSurface *surf)
 /* ───── main ───── */
 int main(int argc,char**argv)
 {
+    struct timespec t_start; clock_gettime(CLOCK_MONOTONIC, &t_start);
     setbuf(stdout, NULL);                 /* ← no stdout buffering  */
     fprintf(stderr, "--- texturecube start persele\n");   /* ← always visible */
 
     if(argc<2){fprintf(stderr,"usage: %s img1 [img2]\n",argv[0]);return 1;}
     uint32_t W=640,H=480; EGLSurface surf;
-    GLuint prog_id = init_gl(W,H,&surf);
+    init_gl(W,H,&surf);                   /* program stays bound for the whole run */
 
-    /* start first load */
-    pthread_t th; pthread_create(&th,0,loader,argv[1]); pthread_detach(th);
+    /* one loader thread (and MMAL pipeline) for the whole run */
+    pthread_t th; pthread_create(&th,0,loader,NULL);
+    queue_image(argv[1]);
 
     PFNGLEGLIMAGETARGETTEXTURE2DOESPROC bindImage =
         (void*)eglGetProcAddress("glEGLImageTargetTexture2DOES");
@@ -410,7 +724,7 @@ int main(int argc,char**argv)
         if((frame++ & 255)==0) printf("frame %d\n", frame);
     
         if(image_ready){
-            glBindTexture(GL_TEXTURE_2D,tex_back);
+            if(tex_bound!=tex_back){ glBindTexture(GL_TEXTURE_2D,tex_back); tex_bound=tex_back; }
             bindImage(GL_TEXTURE_2D,next_img);
             GLuint tmp=tex_front; tex_front=tex_back; tex_back=tmp;
             image_ready=0;
@@ -420,23 +734,27 @@ int main(int argc,char**argv)
         angle += 0.01f;
         float c=cosf(angle),s=sinf(angle);
         float mvp[16]={ c,0,s,0, 0,1,0,0, -s,0,c,0, 0,0,-5,1};
-        //glUniformMatrix4fv(glGetUniformLocation(
-        //    glGetIntegerv(GL_CURRENT_PROGRAM,&prog_id),"uMVP"),1,GL_FALSE,mvp);
-        glUniformMatrix4fv(glGetUniformLocation(prog_id, "uMVP"),
-                   1, GL_FALSE, mvp);
+        glUniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp);  /* no per-frame name lookup */
 
         glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-        glBindTexture(GL_TEXTURE_2D,tex_front);
+        /* after a swap the new front texture is the one that is still bound */
+        if(tex_bound!=tex_front){ glBindTexture(GL_TEXTURE_2D,tex_front); tex_bound=tex_front; }
         glDrawElements(GL_TRIANGLES,36,GL_UNSIGNED_SHORT,0);
         eglSwapBuffers(g_dpy,surf);
+        if(frame==1){                     /* cold start cost */
+            struct timespec t; clock_gettime(CLOCK_MONOTONIC, &t);
+            printf("time to first frame: %ld ms\n",
+                   (long)((t.tv_sec-t_start.tv_sec)*1000 + (t.tv_nsec-t_start.tv_nsec)/1000000));
+        }
         usleep(16666);                     /* ~60 Hz */
 
         int k = getchar();
         if(k==27) break;                  /* ESC */
         if(k==' ' && argc>2){             /* SPACE → load second */
-            pthread_t t2; pthread_create(&t2,0,loader,argv[2]);
-            pthread_detach(t2);
+            if(!queue_image(argv[2])) fprintf(stderr,"loader busy, SPACE ignored\n");
         }
     }
+    close_jobs();
+    pthread_join(th,NULL);                /* pipeline torn down once, here */
     return 0;
 }